@@ -44,6 +44,16 @@ CompactorStack::CompactorStack(int64_t inv_eps, int64_t inv_delta, int k, Random
     Reset();
 }
 
+CompactorStack::CompactorStack(const CompactorStack& other, RandomGenerator* random)
+    : compactors_(other.compactors_),
+      k_(other.k_),
+      overall_capacity_(other.overall_capacity_),
+      num_items_in_compactors_(other.num_items_in_compactors_),
+      random_(random),
+      sampler_(other.sampler_ != nullptr ? std::make_unique<KllSampler>(*other.sampler_, this)
+                                         : nullptr) {
+}
+
 CompactorStack::~CompactorStack() {
     ClearCompactors();
 }
@@ -66,6 +76,26 @@ void CompactorStack::Add(const int64_t value) {
     }
 }
 
+void CompactorStack::AddBatch(const int64_t* values, size_t num_values) {
+    size_t i = 0;
+    while (i < num_values) {
+        if (sampler_ != nullptr) {
+            for (; i < num_values; i++) {
+                sampler_->Add(values[i]);
+            }
+            return;
+        }
+        // Add() compacts as soon as the overall capacity is reached, so the items up
+        // to that point can be appended at once.
+        const size_t room = std::max(overall_capacity_ - num_items_in_compactors_, 1);
+        const size_t chunk = std::min(num_values - i, room);
+        compactors_[0].insert(compactors_[0].end(), values + i, values + i + chunk);
+        num_items_in_compactors_ += static_cast<int>(chunk);
+        i += chunk;
+        CompactStack();
+    }
+}
+
 // Adds an item to the compactor stack with weight >= 1.
 // Does nothing if weight <= 0.
 void CompactorStack::AddWithWeight(int64_t value, int weight) {
@@ -92,6 +122,24 @@ void CompactorStack::AddWithWeight(int64_t value, int weight) {
     }
 }
 
+void CompactorStack::AddToLevel(int level, const int64_t* items, size_t num_items) {
+    if (num_items == 0) {
+        return;
+    }
+    while (level >= static_cast<int>(compactors_.size())) {
+        AddLevel();
+    }
+    if (level < lowest_active_level()) {
+        for (size_t i = 0; i < num_items; i++) {
+            AddWithWeight(items[i], 1 << level);
+        }
+        return;
+    }
+    compactors_[level].insert(compactors_[level].end(), items, items + num_items);
+    num_items_in_compactors_ += static_cast<int>(num_items);
+    CompactStack();
+}
+
 void CompactorStack::SortCompactorContents() {
     for (std::vector<int64_t>& compactor : compactors_) {
         std::sort(compactor.begin(), compactor.end());
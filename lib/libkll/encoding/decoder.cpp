@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "decoder.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "varint.h"
+
+namespace dist_proc {
+namespace aggregation {
+namespace encoding {
+
+bool Decoder::DecodeFromString(const std::string& src, int64_t* dst) {
+    const char* const limit = src.data() + src.size();
+    uint64_t value;
+    if (Varint::Parse64WithLimit(src.data(), limit, &value) != limit) {
+        return false;
+    }
+    // int64s are encoded as uint64s.
+    *dst = static_cast<int64_t>(value);
+    return true;
+}
+
+bool Decoder::DecodePackedStringAll(const std::string& src, std::vector<int64_t>* dst) {
+    const char* p = src.data();
+    const char* const limit = src.data() + src.size();
+    while (p < limit) {
+        uint64_t value;
+        p = Varint::Parse64WithLimit(p, limit, &value);
+        if (p == nullptr) {
+            return false;
+        }
+        dst->push_back(static_cast<int64_t>(value));
+    }
+    return true;
+}
+
+}  // namespace encoding
+}  // namespace aggregation
+}  // namespace dist_proc
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dist_proc {
+namespace aggregation {
+namespace encoding {
+
+// Reverses the encodings of Encoder.
+class Decoder {
+public:
+    // Decodes a string written by Encoder::AppendToString that holds exactly one
+    // value. Returns false if src is not such a string.
+    static bool DecodeFromString(const std::string& src, int64_t* dst);
+
+    // Decodes a string written by Encoder::SerializeToPackedStringAll, appending
+    // the values to dst. Returns false if src is truncated.
+    static bool DecodePackedStringAll(const std::string& src, std::vector<int64_t>* dst);
+};
+
+}  // namespace encoding
+}  // namespace aggregation
+}  // namespace dist_proc
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "decoder.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "encoder.h"
+
+namespace dist_proc {
+namespace aggregation {
+namespace encoding {
+
+namespace {
+
+TEST(DecoderTest, DecodeFromString) {
+    const int64_t values[] = {0, 1, 10, 128, -1, std::numeric_limits<int64_t>::min(),
+                              std::numeric_limits<int64_t>::max()};
+    for (const int64_t value : values) {
+        std::string s;
+        Encoder::AppendToString(value, &s);
+        int64_t decoded = 0;
+        ASSERT_TRUE(Decoder::DecodeFromString(s, &decoded));
+        EXPECT_EQ(decoded, value);
+    }
+}
+
+TEST(DecoderTest, DecodeFromStringRejectsMalformed) {
+    int64_t decoded = 0;
+    EXPECT_FALSE(Decoder::DecodeFromString("", &decoded));
+    // Truncated.
+    EXPECT_FALSE(Decoder::DecodeFromString("\x80", &decoded));
+    // Trailing bytes.
+    EXPECT_FALSE(Decoder::DecodeFromString("\x1\x2", &decoded));
+}
+
+TEST(DecoderTest, DecodePackedStringAll) {
+    const std::vector<int64_t> values = {3, 0, -7, 300, std::numeric_limits<int64_t>::max()};
+    std::string s;
+    Encoder::SerializeToPackedStringAll(values.begin(), values.end(), &s);
+
+    std::vector<int64_t> decoded;
+    ASSERT_TRUE(Decoder::DecodePackedStringAll(s, &decoded));
+    EXPECT_EQ(decoded, values);
+
+    decoded.clear();
+    EXPECT_FALSE(Decoder::DecodePackedStringAll(s.substr(0, s.size() - 1), &decoded));
+
+    decoded.clear();
+    ASSERT_TRUE(Decoder::DecodePackedStringAll("", &decoded));
+    EXPECT_TRUE(decoded.empty());
+}
+
+}  // namespace
+
+}  // namespace encoding
+}  // namespace aggregation
+}  // namespace dist_proc
@@ -44,3 +44,21 @@ char* Varint::Encode64(char* sptr, uint64_t v) {
         }
     }
 }
+
+const char* Varint::Parse64WithLimit(const char* p, const char* l, uint64_t* OUTPUT) {
+    const unsigned char* ptr = reinterpret_cast<const unsigned char*>(p);
+    const unsigned char* limit = reinterpret_cast<const unsigned char*>(l);
+    uint64_t result = 0;
+    for (int shift = 0; shift < 7 * kMax64; shift += 7) {
+        if (ptr >= limit) {
+            return nullptr;
+        }
+        const uint64_t byte = *(ptr++);
+        result |= (byte & 127) << shift;
+        if (byte < 128) {
+            *OUTPUT = result;
+            return reinterpret_cast<const char*>(ptr);
+        }
+    }
+    return nullptr;
+}
@@ -33,6 +33,14 @@ public:
     // EFFECTS    Returns the encoding length of the specified value.
     static int Length64(uint64_t v);
 
+    // REQUIRES   "p" points to the start of a varint and "l" just past the
+    //            end of the buffer.
+    // EFFECTS    Decodes the varint at "p" into "*OUTPUT" and returns a
+    //            pointer to the byte just past it, or returns nullptr if the
+    //            buffer ends before the varint does or it is longer than
+    //            kMax64 bytes.
+    static const char* Parse64WithLimit(const char* p, const char* l, uint64_t* OUTPUT);
+
 private:
     // A fully inlined version of Encode32: useful in the most time critical
     // routines, but its code size is large
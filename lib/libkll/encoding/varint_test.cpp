@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 
 #include <cstdint>
+#include <limits>
 
 // A straightforward implementation of Length64 for testing
 inline int Varint_Length64Old(uint64_t v) {
@@ -84,3 +85,23 @@ TEST(VarintTest, Encode64) {
     *end_s = '\0';  // terminate the string
     ASSERT_EQ(std::string(s), std::string(reinterpret_cast<char*>(n_encrypt)));
 }
+
+TEST(VarintTest, Parse64WithLimit) {
+    const uint64_t values[] = {0, 1, 127, 128, 0xe499867, 0xe4998679470d98dull,
+                               std::numeric_limits<uint64_t>::max()};
+    for (const uint64_t v : values) {
+        char s[Varint::kMax64];
+        const char* end_s = Varint::Encode64(s, v);
+        uint64_t parsed = 0;
+        ASSERT_EQ(Varint::Parse64WithLimit(s, end_s, &parsed), end_s);
+        ASSERT_EQ(parsed, v);
+        // A truncated varint is not parsed.
+        ASSERT_EQ(Varint::Parse64WithLimit(s, end_s - 1, &parsed), nullptr);
+    }
+
+    // More than kMax64 bytes with the continuation bit set.
+    const char too_long[Varint::kMax64 + 1] = {'\x80', '\x80', '\x80', '\x80', '\x80', '\x80',
+                                               '\x80', '\x80', '\x80', '\x80', '\x01'};
+    uint64_t parsed = 0;
+    ASSERT_EQ(Varint::Parse64WithLimit(too_long, too_long + sizeof(too_long), &parsed), nullptr);
+}
@@ -39,6 +39,9 @@ class CompactorStack {
 public:
     CompactorStack(int64_t inv_eps, int64_t inv_delta, RandomGenerator* random);
     CompactorStack(int64_t inv_eps, int64_t inv_delta, int k, RandomGenerator* random);
+    // Copies the compactors and the sampler of other. The copy draws its random
+    // numbers from random.
+    CompactorStack(const CompactorStack& other, RandomGenerator* random);
     ~CompactorStack();
 
     // Initialize or reset the compactor stack and all counters and thresholds.
@@ -46,10 +49,25 @@ public:
 
     void Add(const int64_t value);
 
+    // Adds items with weight one. Equivalent to calling Add() for each of them in
+    // order, but fills the lowest compactor in bulk and only compacts the stack
+    // when Add() would have.
+    void AddBatch(const int64_t* values, size_t num_values);
+
     // Adds an item to the compactor stack with weight >= 1.
     // Does nothing if weight <= 0.
     void AddWithWeight(int64_t value, int weight);
 
+    // Items of level 'level' have weight 2^level, which has to fit in the int
+    // weights of AddWithWeight(), so a stack has at most kMaxLevels levels.
+    static constexpr int kMaxLevels = 31;
+
+    // Adds items with weight 2^level, e.g. the contents of compactor 'level' of
+    // another stack. They are appended to that level at once and the stack is
+    // compacted afterwards, unless the level is replaced by the sampler here.
+    // 'level' has to be less than kMaxLevels.
+    void AddToLevel(int level, const int64_t* items, size_t num_items);
+
     // Ensures that the contents of each compactor are sorted.
     void SortCompactorContents();
 
@@ -16,6 +16,8 @@
 
 #pragma once
 
+#include <array>
+
 #include "aggregator.pb.h"
 #include "compactor_stack.h"
 #include "random_generator.h"
@@ -46,7 +48,7 @@ public:
         return compactor_stack_.k();
     }
     int64_t num_stored_values() const {
-        return compactor_stack_.num_stored_items();
+        return compactor_stack_.num_stored_items() + num_exact_values_;
     }
     // Reset the aggregator to its state just after construction.
     void Reset();
@@ -65,9 +67,50 @@ public:
     // downscaling and randomized rounding is negligible.
     void AddWeighted(int64_t value, int weight);
 
+    // Adds num_values values, with the same error guarantees as calling Add()
+    // for each of them. The resulting sketch is not the same: the values are
+    // sorted once, runs of equal values are added as one weighted item and the
+    // remaining values are fed to the lowest compactor in bulk. KLL's error
+    // guarantees do not depend on the order of the input.
+    void AddBatch(const int64_t* values, size_t num_values);
+
+    // Adds values[i] with multiplicity weights[i] for each i < num_values, with
+    // the same error guarantees as calling AddWeighted() for each of them.
+    // Items with weight <= 0 are skipped, and the weights of equal values are
+    // summed before they are added, so the resulting sketch is not the same.
+    void AddWeightedBatch(const int64_t* values, const int* weights, size_t num_values);
+
+    // Merges the values of other into this aggregator. The items of each
+    // compactor of other keep their weight, so the result has the same error
+    // guarantees as a sketch of both inputs. The parameters of this aggregator
+    // are kept. other may be this aggregator.
+    void Merge(const KllQuantile& other);
+
+    // Returns a copy of this aggregator, without serializing it. The copy draws
+    // its random numbers from random, or from its own generator if random is
+    // null. Only reads this aggregator.
+    std::unique_ptr<KllQuantile> Clone(RandomGenerator* random = nullptr) const;
+
     // Not safe to be called concurrently.
     zetasketch::android::AggregatorStateProto SerializeToProto();
 
+    // Writes the same bytes as SerializeToProto().SerializeAsString() into
+    // dst, replacing its contents, but encodes the fields directly instead of
+    // building the proto first. Reusing dst avoids all allocations once it is
+    // large enough. Not safe to be called concurrently.
+    void SerializeToString(std::string* dst);
+
+    // Restores an aggregator from the output of SerializeToProto(). The stored
+    // compactors are merged into an empty aggregator with the same k, which
+    // yields the serialized state again. Returns nullptr and sets error if the
+    // proto is not a valid KLL state.
+    static std::unique_ptr<KllQuantile> CreateFromProto(
+            const zetasketch::android::AggregatorStateProto& aggregator_state,
+            std::string* error = nullptr);
+    static std::unique_ptr<KllQuantile> CreateFromProto(
+            const zetasketch::android::AggregatorStateProto& aggregator_state,
+            RandomGenerator* random, std::string* error = nullptr);
+
     bool IsSamplerOn() const {
         return compactor_stack_.IsSamplerOn();
     }
@@ -81,8 +124,32 @@ private:
                            random != nullptr ? random : owned_random_.get()) {
         Reset();
     }
+    // Copy constructor used by Clone().
+    KllQuantile(const KllQuantile& other, RandomGenerator* random)
+        : inv_eps_(other.inv_eps_),
+          min_(other.min_),
+          max_(other.max_),
+          num_values_(other.num_values_),
+          exact_values_(other.exact_values_),
+          num_exact_values_(other.num_exact_values_),
+          exact_mode_(other.exact_mode_),
+          owned_random_(random != nullptr ? nullptr : std::make_unique<MTRandomGenerator>()),
+          compactor_stack_(other.compactor_stack_,
+                           random != nullptr ? random : owned_random_.get()) {
+    }
     void UpdateMin(const int64_t value);
     void UpdateMax(const int64_t value);
+    // Moves the values kept in exact mode to the compactor stack and leaves
+    // exact mode. The compactor stack ends up as if they had been added to it
+    // directly.
+    void LeaveExactMode();
+    // Adds value with a weight that may exceed the int range to the compactor
+    // stack. Does not update min, max or num_values.
+    void AddRun(int64_t value, int64_t weight);
+    // Merges the state of another aggregator, given by its parts.
+    void MergeState(const std::vector<std::vector<int64_t>>& compactors,
+                    const std::optional<std::pair<const int64_t, int64_t>>& sampled_item_and_weight,
+                    int64_t min, int64_t max, int64_t num_values);
     int64_t inv_eps_;
     // The (exact) minimum item encountered among all items.
     int64_t min_{};
@@ -90,6 +157,13 @@ private:
     int64_t max_{};
     // Number of items added into the aggregator.
     int64_t num_values_;
+    // While only few values have been added with Add(), they are kept here
+    // instead of in the compactor stack, which saves its allocations for
+    // aggregators that never see more values.
+    static constexpr int kMaxExactValues = 8;
+    std::array<int64_t, kMaxExactValues> exact_values_;
+    int num_exact_values_;
+    bool exact_mode_;
     // Owned MTRandom instance, if not given a RandomGenerator.
     std::unique_ptr<MTRandomGenerator> owned_random_;
     // Stack of compactors to which newly added items are added;
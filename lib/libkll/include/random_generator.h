@@ -51,5 +51,42 @@ private:
     std::mt19937 bit_gen_;
 };
 
+// SplitMix64 generator. Its state is a single word, instead of the ~5 KB of
+// MTRandomGenerator, so it is cheap to create and suited to be shared by many
+// small aggregators.
+class SplitMixRandomGenerator : public RandomGenerator {
+public:
+    SplitMixRandomGenerator(std::optional<uint64_t> seed = std::nullopt) {
+        if (seed.has_value()) {
+            state_ = seed.value();
+        } else {
+            std::random_device rd;
+            state_ = (static_cast<uint64_t>(rd()) << 32) | rd();
+        }
+    }
+    uint64_t UnbiasedUniform(uint64_t n) override {
+        if (n <= 1) {
+            return 0;
+        }
+        // Rejects the values below 2^64 mod n, so that each remainder is equally likely.
+        const uint64_t threshold = -n % n;
+        uint64_t value;
+        do {
+            value = Next();
+        } while (value < threshold);
+        return value % n;
+    }
+
+private:
+    uint64_t Next() {
+        uint64_t z = (state_ += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t state_;
+};
+
 }  // namespace aggregation
 }  // namespace dist_proc
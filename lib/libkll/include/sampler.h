@@ -40,6 +40,16 @@ public:
         Reset();
     }
 
+    // Copies the state of other into a sampler of compactor_stack.
+    KllSampler(const KllSampler& other, CompactorStack* compactor_stack)
+        : sampled_item_(other.sampled_item_),
+          item_weight_(other.item_weight_),
+          capacity_(other.capacity_),
+          num_replaced_levels_(other.num_replaced_levels_),
+          compactor_stack_(compactor_stack) {
+        assert(compactor_stack != nullptr);
+    }
+
     void Reset();
 
     // Adds an item to the sampler with weight one.
@@ -16,11 +16,16 @@
 
 #include "kll.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <limits>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include "aggregator.pb.h"
 #include "compactor_stack.h"
+#include "encoding/decoder.h"
 #include "encoding/encoder.h"
 #include "kll-quantiles.pb.h"
 
@@ -28,6 +33,65 @@ namespace dist_proc {
 namespace aggregation {
 
 using zetasketch::android::AggregatorStateProto;
+using zetasketch::android::KllQuantilesStateProto;
+
+namespace {
+
+bool SetError(std::string* error, const char* message) {
+    if (error != nullptr) {
+        *error = message;
+    }
+    return false;
+}
+
+// Wire format helpers for SerializeToString().
+constexpr int kWireTypeVarint = 0;
+constexpr int kWireTypeLengthDelimited = 2;
+
+// Field numbers of AggregatorStateProto, KllQuantilesStateProto and its nested messages.
+// SerializeToString() writes fields in field number order, like protobuf does.
+constexpr int kTypeField = 1;
+constexpr int kNumValuesField = 2;
+constexpr int kValueTypeField = 4;
+constexpr int kKField = 1;
+constexpr int kInvEpsField = 2;
+constexpr int kMinField = 3;
+constexpr int kMaxField = 4;
+constexpr int kCompactorsField = 5;
+constexpr int kSamplerField = 6;
+constexpr int kPackedValuesField = 1;
+constexpr int kSampledItemField = 1;
+constexpr int kSampledWeightField = 2;
+constexpr int kLogCapacityField = 3;
+
+size_t VarintFieldSize(int field, uint64_t value) {
+    return Varint::Length64(field << 3) + Varint::Length64(value);
+}
+
+size_t LengthDelimitedFieldSize(int field, size_t length) {
+    return Varint::Length64((field << 3) | kWireTypeLengthDelimited) + Varint::Length64(length) +
+           length;
+}
+
+void AppendVarintField(int field, uint64_t value, std::string* dst) {
+    encoding::Encoder::AppendToString((field << 3) | kWireTypeVarint, dst);
+    encoding::Encoder::AppendToString(value, dst);
+}
+
+void AppendLengthDelimitedHeader(int field, size_t length, std::string* dst) {
+    encoding::Encoder::AppendToString((field << 3) | kWireTypeLengthDelimited, dst);
+    encoding::Encoder::AppendToString(length, dst);
+}
+
+size_t PackedSize(const int64_t* begin, const int64_t* end) {
+    size_t size = 0;
+    for (; begin != end; ++begin) {
+        size += Varint::Length64(*begin);
+    }
+    return size;
+}
+
+}  // namespace
 
 std::unique_ptr<KllQuantile> KllQuantile::Create(std::string* error) {
     return Create(KllQuantileOptions(), error);
@@ -46,6 +110,14 @@ std::unique_ptr<KllQuantile> KllQuantile::Create(const KllQuantileOptions& optio
 }
 
 void KllQuantile::Add(const int64_t value) {
+    if (exact_mode_ && num_exact_values_ < kMaxExactValues) {
+        exact_values_[num_exact_values_++] = value;
+        UpdateMin(value);
+        UpdateMax(value);
+        num_values_++;
+        return;
+    }
+    LeaveExactMode();
     compactor_stack_.Add(value);
     UpdateMin(value);
     UpdateMax(value);
@@ -54,6 +126,7 @@ void KllQuantile::Add(const int64_t value) {
 
 void KllQuantile::AddWeighted(int64_t value, int weight) {
     if (weight > 0) {
+        LeaveExactMode();
         compactor_stack_.AddWithWeight(value, weight);
         UpdateMin(value);
         UpdateMax(value);
@@ -61,6 +134,130 @@ void KllQuantile::AddWeighted(int64_t value, int weight) {
     }
 }
 
+void KllQuantile::AddBatch(const int64_t* values, size_t num_values) {
+    if (num_values == 0) {
+        return;
+    }
+    LeaveExactMode();
+    std::vector<int64_t> sorted(values, values + num_values);
+    std::sort(sorted.begin(), sorted.end());
+    UpdateMin(sorted.front());
+    UpdateMax(sorted.back());
+
+    // Values that occur once are moved to the front of 'sorted', in place.
+    size_t num_singles = 0;
+    for (size_t begin = 0; begin < sorted.size();) {
+        size_t end = begin + 1;
+        while (end < sorted.size() && sorted[end] == sorted[begin]) {
+            end++;
+        }
+        if (end - begin == 1) {
+            sorted[num_singles++] = sorted[begin];
+        } else {
+            AddRun(sorted[begin], end - begin);
+        }
+        begin = end;
+    }
+    compactor_stack_.AddBatch(sorted.data(), num_singles);
+    num_values_ += num_values;
+}
+
+void KllQuantile::AddWeightedBatch(const int64_t* values, const int* weights, size_t num_values) {
+    std::vector<std::pair<int64_t, int64_t>> items;
+    items.reserve(num_values);
+    for (size_t i = 0; i < num_values; i++) {
+        if (weights[i] > 0) {
+            items.emplace_back(values[i], weights[i]);
+        }
+    }
+    if (items.empty()) {
+        return;
+    }
+    LeaveExactMode();
+    std::sort(items.begin(), items.end());
+    UpdateMin(items.front().first);
+    UpdateMax(items.back().first);
+
+    std::vector<int64_t> singles;
+    for (size_t begin = 0; begin < items.size();) {
+        int64_t weight = 0;
+        size_t end = begin;
+        for (; end < items.size() && items[end].first == items[begin].first; end++) {
+            weight += items[end].second;
+        }
+        if (weight == 1) {
+            singles.push_back(items[begin].first);
+        } else {
+            AddRun(items[begin].first, weight);
+        }
+        num_values_ += weight;
+        begin = end;
+    }
+    compactor_stack_.AddBatch(singles.data(), singles.size());
+}
+
+void KllQuantile::LeaveExactMode() {
+    if (!exact_mode_) {
+        return;
+    }
+    exact_mode_ = false;
+    compactor_stack_.AddBatch(exact_values_.data(), num_exact_values_);
+    num_exact_values_ = 0;
+}
+
+void KllQuantile::AddRun(int64_t value, int64_t weight) {
+    while (weight > 0) {
+        const int chunk = static_cast<int>(
+                std::min(weight, static_cast<int64_t>(std::numeric_limits<int>::max())));
+        compactor_stack_.AddWithWeight(value, chunk);
+        weight -= chunk;
+    }
+}
+
+void KllQuantile::Merge(const KllQuantile& other) {
+    if (other.exact_mode_) {
+        // Copied first, since other may be this aggregator.
+        const std::array<int64_t, kMaxExactValues> exact_values = other.exact_values_;
+        const int num_exact_values = other.num_exact_values_;
+        for (int i = 0; i < num_exact_values; i++) {
+            Add(exact_values[i]);
+        }
+        return;
+    }
+    if (&other == this) {
+        // Merging adds to the compactors, so merge a copy of them.
+        const std::vector<std::vector<int64_t>> compactors = compactor_stack_.compactors();
+        MergeState(compactors, compactor_stack_.sampled_item_and_weight(), min_, max_,
+                   num_values_);
+        return;
+    }
+    MergeState(other.compactor_stack_.compactors(),
+               other.compactor_stack_.sampled_item_and_weight(), other.min_, other.max_,
+               other.num_values_);
+}
+
+void KllQuantile::MergeState(
+        const std::vector<std::vector<int64_t>>& compactors,
+        const std::optional<std::pair<const int64_t, int64_t>>& sampled_item_and_weight,
+        int64_t min, int64_t max, int64_t num_values) {
+    if (num_values == 0) {
+        return;
+    }
+    LeaveExactMode();
+    UpdateMin(min);
+    UpdateMax(max);
+    // Starting at the top grows the stack to its final height first, so compacting the lower
+    // levels does not push items into levels that are still to be filled.
+    for (size_t level = compactors.size(); level > 0; level--) {
+        const std::vector<int64_t>& items = compactors[level - 1];
+        compactor_stack_.AddToLevel(level - 1, items.data(), items.size());
+    }
+    if (sampled_item_and_weight.has_value()) {
+        AddRun(sampled_item_and_weight->first, sampled_item_and_weight->second);
+    }
+    num_values_ += num_values;
+}
+
 AggregatorStateProto KllQuantile::SerializeToProto() {
     AggregatorStateProto aggregator_state;
 
@@ -82,6 +279,16 @@ AggregatorStateProto KllQuantile::SerializeToProto() {
     encoding::Encoder::AppendToString(min_, quantile_state->mutable_min());
     encoding::Encoder::AppendToString(max_, quantile_state->mutable_max());
 
+    if (exact_mode_) {
+        // Same encoding as a compactor stack holding the values at its only level.
+        std::sort(exact_values_.begin(), exact_values_.begin() + num_exact_values_);
+        std::string* packed_values = quantile_state->add_compactors()->mutable_packed_values();
+        for (int i = 0; i < num_exact_values_; i++) {
+            encoding::Encoder::AppendToString(exact_values_[i], packed_values);
+        }
+        return aggregator_state;
+    }
+
     // Sort compactors before encoding them, to only do sorting work once (vs.
     // every time a sketch is read and extracted or merged), and to reduce sketch
     // cardinality, which saves space in e.g. column store dictionaries.
@@ -114,6 +321,151 @@ AggregatorStateProto KllQuantile::SerializeToProto() {
     return aggregator_state;
 }
 
+std::unique_ptr<KllQuantile> KllQuantile::Clone(RandomGenerator* random) const {
+    return std::unique_ptr<KllQuantile>(new KllQuantile(*this, random));
+}
+
+std::unique_ptr<KllQuantile> KllQuantile::CreateFromProto(
+        const AggregatorStateProto& aggregator_state, std::string* error) {
+    return CreateFromProto(aggregator_state, nullptr, error);
+}
+
+std::unique_ptr<KllQuantile> KllQuantile::CreateFromProto(
+        const AggregatorStateProto& aggregator_state, RandomGenerator* random,
+        std::string* error) {
+    if (aggregator_state.type() != zetasketch::android::KLL_QUANTILES ||
+        !aggregator_state.HasExtension(zetasketch::android::kll_quantiles_state)) {
+        SetError(error, "not a KLL quantiles state");
+        return nullptr;
+    }
+    const KllQuantilesStateProto& quantile_state =
+            aggregator_state.GetExtension(zetasketch::android::kll_quantiles_state);
+    if (quantile_state.k() <= 0 || quantile_state.inv_eps() <= 0) {
+        SetError(error, "k and inv_eps have to be > 0");
+        return nullptr;
+    }
+    std::unique_ptr<KllQuantile> aggregator(new KllQuantile(
+            quantile_state.inv_eps(), KllQuantileOptions().inv_delta(), quantile_state.k(),
+            random));
+    if (aggregator_state.num_values() == 0) {
+        return aggregator;
+    }
+
+    int64_t min;
+    int64_t max;
+    if (!encoding::Decoder::DecodeFromString(quantile_state.min(), &min) ||
+        !encoding::Decoder::DecodeFromString(quantile_state.max(), &max)) {
+        SetError(error, "invalid min or max");
+        return nullptr;
+    }
+    if (quantile_state.compactors_size() > internal::CompactorStack::kMaxLevels) {
+        SetError(error, "too many compactors");
+        return nullptr;
+    }
+    std::vector<std::vector<int64_t>> compactors(quantile_state.compactors_size());
+    for (int i = 0; i < quantile_state.compactors_size(); i++) {
+        if (!encoding::Decoder::DecodePackedStringAll(quantile_state.compactors(i).packed_values(),
+                                                      &compactors[i])) {
+            SetError(error, "invalid compactor");
+            return nullptr;
+        }
+    }
+    std::optional<std::pair<const int64_t, int64_t>> sampled_item_and_weight;
+    if (quantile_state.sampler().sampled_weight() > 0) {
+        int64_t sampled_item;
+        if (!encoding::Decoder::DecodeFromString(quantile_state.sampler().sampled_item(),
+                                                 &sampled_item)) {
+            SetError(error, "invalid sampled item");
+            return nullptr;
+        }
+        sampled_item_and_weight.emplace(sampled_item, quantile_state.sampler().sampled_weight());
+    }
+    aggregator->MergeState(compactors, sampled_item_and_weight, min, max,
+                           aggregator_state.num_values());
+    return aggregator;
+}
+
+void KllQuantile::SerializeToString(std::string* dst) {
+    // Calls visit(begin, end) for the sorted contents of each compactor.
+    const auto for_each_compactor = [this](const auto& visit) {
+        if (exact_mode_) {
+            std::sort(exact_values_.begin(), exact_values_.begin() + num_exact_values_);
+            visit(exact_values_.data(), exact_values_.data() + num_exact_values_);
+            return;
+        }
+        compactor_stack_.SortCompactorContents();
+        for (const std::vector<int64_t>& compactor : compactor_stack_.compactors()) {
+            visit(compactor.data(), compactor.data() + compactor.size());
+        }
+    };
+    const auto& sampled_item_and_weight = compactor_stack_.sampled_item_and_weight();
+
+    // Nested messages are prefixed with their length, so compute the sizes first.
+    size_t sampler_size = 0;
+    size_t state_size = VarintFieldSize(kKField, compactor_stack_.k()) +
+                        VarintFieldSize(kInvEpsField, inv_eps_);
+    if (num_values_ != 0) {
+        state_size += LengthDelimitedFieldSize(kMinField, Varint::Length64(min_)) +
+                      LengthDelimitedFieldSize(kMaxField, Varint::Length64(max_));
+        for_each_compactor([&state_size](const int64_t* begin, const int64_t* end) {
+            state_size += LengthDelimitedFieldSize(
+                    kCompactorsField,
+                    LengthDelimitedFieldSize(kPackedValuesField, PackedSize(begin, end)));
+        });
+        if (compactor_stack_.IsSamplerOn()) {
+            if (sampled_item_and_weight.has_value()) {
+                sampler_size +=
+                        LengthDelimitedFieldSize(kSampledItemField,
+                                                 Varint::Length64(sampled_item_and_weight->first)) +
+                        VarintFieldSize(kSampledWeightField, sampled_item_and_weight->second);
+            }
+            sampler_size +=
+                    VarintFieldSize(kLogCapacityField, compactor_stack_.lowest_active_level());
+            state_size += LengthDelimitedFieldSize(kSamplerField, sampler_size);
+        }
+    }
+
+    dst->clear();
+    dst->reserve(VarintFieldSize(kTypeField, zetasketch::android::KLL_QUANTILES) +
+                 VarintFieldSize(kNumValuesField, num_values_) +
+                 VarintFieldSize(kValueTypeField, zetasketch::android::DefaultOpsType::INT64) +
+                 LengthDelimitedFieldSize(zetasketch::android::kKllQuantilesStateFieldNumber,
+                                          state_size));
+    AppendVarintField(kTypeField, zetasketch::android::KLL_QUANTILES, dst);
+    AppendVarintField(kNumValuesField, num_values_, dst);
+    AppendVarintField(kValueTypeField, zetasketch::android::DefaultOpsType::INT64, dst);
+    AppendLengthDelimitedHeader(zetasketch::android::kKllQuantilesStateFieldNumber, state_size,
+                                dst);
+    AppendVarintField(kKField, compactor_stack_.k(), dst);
+    AppendVarintField(kInvEpsField, inv_eps_, dst);
+    if (num_values_ == 0) {
+        return;
+    }
+    AppendLengthDelimitedHeader(kMinField, Varint::Length64(min_), dst);
+    encoding::Encoder::AppendToString(min_, dst);
+    AppendLengthDelimitedHeader(kMaxField, Varint::Length64(max_), dst);
+    encoding::Encoder::AppendToString(max_, dst);
+    for_each_compactor([dst](const int64_t* begin, const int64_t* end) {
+        const size_t packed_size = PackedSize(begin, end);
+        AppendLengthDelimitedHeader(kCompactorsField,
+                                    LengthDelimitedFieldSize(kPackedValuesField, packed_size), dst);
+        AppendLengthDelimitedHeader(kPackedValuesField, packed_size, dst);
+        for (; begin != end; ++begin) {
+            encoding::Encoder::AppendToString(*begin, dst);
+        }
+    });
+    if (compactor_stack_.IsSamplerOn()) {
+        AppendLengthDelimitedHeader(kSamplerField, sampler_size, dst);
+        if (sampled_item_and_weight.has_value()) {
+            AppendLengthDelimitedHeader(kSampledItemField,
+                                        Varint::Length64(sampled_item_and_weight->first), dst);
+            encoding::Encoder::AppendToString(sampled_item_and_weight->first, dst);
+            AppendVarintField(kSampledWeightField, sampled_item_and_weight->second, dst);
+        }
+        AppendVarintField(kLogCapacityField, compactor_stack_.lowest_active_level(), dst);
+    }
+}
+
 void KllQuantile::UpdateMin(int64_t value) {
     if (num_values_ == 0 || min_ > value) {
         min_ = value;
@@ -128,6 +480,8 @@ void KllQuantile::UpdateMax(int64_t value) {
 
 void KllQuantile::Reset() {
     num_values_ = 0;
+    num_exact_values_ = 0;
+    exact_mode_ = true;
     compactor_stack_.Reset();
 }
 
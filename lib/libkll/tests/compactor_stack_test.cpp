@@ -308,6 +308,34 @@ TEST_P(AddWithSamplerTest, SampledItemIsPresent) {
     EXPECT_LE(sampled_item_weight, (1 << compactor_stack.lowest_active_level()));
 }
 
+TEST_P(AddWithSamplerTest, AddBatchMatchesAdd) {
+    const AddWithSamplerParam params = GetParam();
+    std::vector<int64_t> values(params.num_items);
+    MTRandomGenerator value_random(1);
+    for (int64_t& value : values) {
+        value = value_random.UnbiasedUniform(std::numeric_limits<uint64_t>::max());
+    }
+
+    // Both stacks use the same seed, so they only match if AddBatch compacts exactly when
+    // Add does, including after the sampler is switched on.
+    MTRandomGenerator random(5);
+    CompactorStack compactor_stack(params.inv_eps, params.inv_delta, &random);
+    for (const int64_t value : values) {
+        compactor_stack.Add(value);
+    }
+    MTRandomGenerator batch_random(5);
+    CompactorStack batch_compactor_stack(params.inv_eps, params.inv_delta, &batch_random);
+    batch_compactor_stack.AddBatch(values.data(), values.size() / 3);
+    batch_compactor_stack.AddBatch(values.data() + values.size() / 3,
+                                   values.size() - values.size() / 3);
+
+    EXPECT_EQ(batch_compactor_stack.IsSamplerOn(), compactor_stack.IsSamplerOn());
+    EXPECT_EQ(batch_compactor_stack.compactors(), compactor_stack.compactors());
+    EXPECT_EQ(batch_compactor_stack.sampled_item_and_weight(),
+              compactor_stack.sampled_item_and_weight());
+    EXPECT_EQ(batch_compactor_stack.num_stored_items(), compactor_stack.num_stored_items());
+}
+
 INSTANTIATE_TEST_SUITE_P(AddWithSamplerTestCases, AddWithSamplerTest,
                          ::testing::ValuesIn(std::vector<AddWithSamplerParam>{
                                  {10, 10, 2400},
@@ -17,6 +17,10 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+#include <vector>
+
+#include "encoding/encoder.h"
 #include "kll-quantiles.pb.h"
 
 namespace dist_proc {
@@ -171,6 +175,294 @@ TEST(KllQuantileSerializationTest, EmptyQuantilesProto) {
     EXPECT_EQ(quantiles_state.compactors_size(), 0);
     ASSERT_FALSE(quantiles_state.has_sampler());
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// ------------------------- Tests for AddBatch ----------------------------- //
+
+std::unique_ptr<KllQuantile> CreateWithRandom(RandomGenerator* random) {
+    KllQuantileOptions options;
+    options.set_inv_eps(10);
+    options.set_random(random);
+    return KllQuantile::Create(options);
+}
+
+TEST(KllQuantileAddBatchTest, MatchesSortedAdds) {
+    std::vector<int64_t> values(5000);
+    for (size_t i = 0; i < values.size(); i++) {
+        values[i] = (i * 7919) % values.size();
+    }
+
+    MTRandomGenerator random(3);
+    std::unique_ptr<KllQuantile> aggregator = CreateWithRandom(&random);
+    for (size_t i = 0; i < values.size(); i++) {
+        aggregator->Add(i);
+    }
+    MTRandomGenerator batch_random(3);
+    std::unique_ptr<KllQuantile> batch_aggregator = CreateWithRandom(&batch_random);
+    batch_aggregator->AddBatch(values.data(), values.size());
+
+    EXPECT_EQ(batch_aggregator->num_values(), 5000);
+    EXPECT_EQ(batch_aggregator->SerializeToProto().SerializeAsString(),
+              aggregator->SerializeToProto().SerializeAsString());
+}
+
+TEST(KllQuantileAddBatchTest, DuplicatesAreWeighted) {
+    const std::vector<int64_t> values = {5, 3, 5, 9, 5, 3, 2};
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->AddBatch(values.data(), values.size());
+    aggregator->AddBatch(values.data(), 0);
+
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    EXPECT_EQ(aggregator_state.num_values(), 7);
+    const KllQuantilesStateProto& quantiles_state =
+            aggregator_state.GetExtension(kll_quantiles_state);
+    EXPECT_EQ(quantiles_state.min(), "\x2");
+    EXPECT_EQ(quantiles_state.max(), "\x9");
+}
+
+TEST(KllQuantileAddBatchTest, AddWeightedBatch) {
+    const std::vector<int64_t> values = {4, 8, 4, 1, 100};
+    const std::vector<int> weights = {3, 1, 2, 0, -1};
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->AddWeightedBatch(values.data(), weights.data(), values.size());
+
+    // Items with a non-positive weight are skipped.
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    EXPECT_EQ(aggregator_state.num_values(), 6);
+    const KllQuantilesStateProto& quantiles_state =
+            aggregator_state.GetExtension(kll_quantiles_state);
+    EXPECT_EQ(quantiles_state.min(), "\x4");
+    EXPECT_EQ(quantiles_state.max(), "\x8");
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// --------------------- Tests for SerializeToString ------------------------ //
+
+class KllQuantileSerializeToStringTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(KllQuantileSerializeToStringTest, MatchesSerializeToProto) {
+    KllQuantileOptions options;
+    options.set_inv_eps(20);
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create(options);
+    for (int i = 0; i < GetParam(); i++) {
+        // Includes negative values, which take ten bytes each.
+        aggregator->Add((i * int64_t{7919}) % 1000 - 500);
+    }
+
+    std::string serialized = "previous contents";
+    aggregator->SerializeToString(&serialized);
+    EXPECT_EQ(serialized, aggregator->SerializeToProto().SerializeAsString());
+
+    aggregator->AddWeighted(-3, 1000);
+    aggregator->SerializeToString(&serialized);
+    EXPECT_EQ(serialized, aggregator->SerializeToProto().SerializeAsString());
+}
+
+INSTANTIATE_TEST_SUITE_P(KllQuantileSerializeToStringTestCases, KllQuantileSerializeToStringTest,
+                         ::testing::Values(0, 1, 5, 100, 10000, 1000000));
+
+////////////////////////////////////////////////////////////////////////////////
+// ------------------------ Tests for exact mode ----------------------------- //
+
+TEST(KllQuantileExactModeTest, FewValuesSerializeLikeCompactors) {
+    const std::vector<int64_t> values = {7, 3, 11, 3, 5};
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    for (const int64_t value : values) {
+        aggregator->Add(value);
+    }
+    EXPECT_EQ(aggregator->num_stored_values(), 5);
+
+    // A weighted add of weight one puts the values into the compactor stack.
+    std::unique_ptr<KllQuantile> compacted = KllQuantile::Create();
+    compacted->AddWeighted(values[0], 1);
+    for (size_t i = 1; i < values.size(); i++) {
+        compacted->Add(values[i]);
+    }
+    EXPECT_EQ(compacted->num_stored_values(), 5);
+
+    EXPECT_EQ(aggregator->SerializeToProto().SerializeAsString(),
+              compacted->SerializeToProto().SerializeAsString());
+}
+
+TEST(KllQuantileExactModeTest, ResetReturnsToExactMode) {
+    KllQuantileOptions options;
+    options.set_inv_eps(10);
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create(options);
+    for (int i = 0; i < 1000; i++) {
+        aggregator->Add(i);
+    }
+    aggregator->Reset();
+    aggregator->Add(4);
+    aggregator->Add(2);
+
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    EXPECT_EQ(aggregator_state.num_values(), 2);
+    const KllQuantilesStateProto& quantiles_state =
+            aggregator_state.GetExtension(kll_quantiles_state);
+    EXPECT_EQ(quantiles_state.min(), "\x2");
+    EXPECT_EQ(quantiles_state.max(), "\x4");
+    ASSERT_EQ(quantiles_state.compactors_size(), 1);
+    EXPECT_EQ(quantiles_state.compactors(0).packed_values(), "\x2\x4");
+    EXPECT_FALSE(quantiles_state.has_sampler());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ------------------ Tests for Merge and CreateFromProto ------------------- //
+
+TEST(KllQuantileMergeTest, MergeKeepsCompactorLevels) {
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->Add(1);
+    aggregator->Add(2);
+    std::unique_ptr<KllQuantile> other = KllQuantile::Create();
+    other->Add(3);
+    other->AddWeighted(20, 4);
+    aggregator->Merge(*other);
+
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    EXPECT_EQ(aggregator_state.num_values(), 7);
+    const KllQuantilesStateProto& quantiles_state =
+            aggregator_state.GetExtension(kll_quantiles_state);
+    EXPECT_EQ(quantiles_state.min(), "\x1");
+    EXPECT_EQ(quantiles_state.max(), "\x14");
+    ASSERT_EQ(quantiles_state.compactors_size(), 3);
+    EXPECT_EQ(quantiles_state.compactors(0).packed_values(), "\x1\x2\x3");
+    EXPECT_EQ(quantiles_state.compactors(1).packed_values(), "");
+    // The item with weight 4 stays at level 2.
+    EXPECT_EQ(quantiles_state.compactors(2).packed_values(), "\x14");
+}
+
+TEST(KllQuantileMergeTest, MergeWithSelf) {
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->Add(8);
+    aggregator->Add(9);
+    aggregator->Merge(*aggregator);
+
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    EXPECT_EQ(aggregator_state.num_values(), 4);
+    const KllQuantilesStateProto& quantiles_state =
+            aggregator_state.GetExtension(kll_quantiles_state);
+    ASSERT_EQ(quantiles_state.compactors_size(), 1);
+    EXPECT_EQ(quantiles_state.compactors(0).packed_values(), "\x8\x8\x9\x9");
+}
+
+TEST(KllQuantileMergeTest, MergeEmpty) {
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->Add(5);
+    aggregator->Merge(*KllQuantile::Create());
+    KllQuantile::Create()->Merge(*aggregator);
+
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    EXPECT_EQ(aggregator_state.num_values(), 1);
+}
+
+TEST(KllQuantileMergeTest, MergeLargeSketches) {
+    KllQuantileOptions options;
+    options.set_inv_eps(10);
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create(options);
+    std::unique_ptr<KllQuantile> other = KllQuantile::Create(options);
+    for (int i = 0; i < 100000; i++) {
+        aggregator->Add(i);
+        other->Add(-i);
+    }
+    const int64_t num_stored_values = aggregator->num_stored_values();
+    aggregator->Merge(*other);
+
+    EXPECT_EQ(aggregator->num_values(), 200000);
+    // Merging compacts the stack, so it does not grow with the number of merged values.
+    EXPECT_LT(aggregator->num_stored_values(), 2 * num_stored_values);
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    const KllQuantilesStateProto& quantiles_state =
+            aggregator_state.GetExtension(kll_quantiles_state);
+    std::string min;
+    encoding::Encoder::AppendToString(-99999, &min);
+    EXPECT_EQ(quantiles_state.min(), min);
+}
+
+class KllQuantileRoundTripTest : public ::testing::TestWithParam<int> {};
+
+TEST_P(KllQuantileRoundTripTest, CreateFromProtoRestoresState) {
+    KllQuantileOptions options;
+    options.set_inv_eps(20);
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create(options);
+    for (int i = 0; i < GetParam(); i++) {
+        aggregator->Add((i * int64_t{7919}) % 1000);
+    }
+    const AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+
+    std::string error;
+    std::unique_ptr<KllQuantile> restored = KllQuantile::CreateFromProto(aggregator_state, &error);
+    ASSERT_NE(restored, nullptr) << error;
+    EXPECT_EQ(restored->num_values(), aggregator->num_values());
+    EXPECT_EQ(restored->k(), aggregator->k());
+    EXPECT_EQ(restored->IsSamplerOn(), aggregator->IsSamplerOn());
+    EXPECT_EQ(restored->SerializeToProto().SerializeAsString(),
+              aggregator_state.SerializeAsString());
+}
+
+INSTANTIATE_TEST_SUITE_P(KllQuantileRoundTripTestCases, KllQuantileRoundTripTest,
+                         ::testing::Values(0, 1, 10, 1000, 100000, 1000000));
+
+TEST_P(KllQuantileRoundTripTest, CloneCopiesState) {
+    KllQuantileOptions options;
+    options.set_inv_eps(20);
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create(options);
+    for (int i = 0; i < GetParam(); i++) {
+        aggregator->Add((i * int64_t{7919}) % 1000);
+    }
+    const std::string aggregator_state = aggregator->SerializeToProto().SerializeAsString();
+
+    std::unique_ptr<KllQuantile> clone = aggregator->Clone();
+    EXPECT_EQ(clone->num_values(), aggregator->num_values());
+    EXPECT_EQ(clone->k(), aggregator->k());
+    EXPECT_EQ(clone->IsSamplerOn(), aggregator->IsSamplerOn());
+    EXPECT_EQ(clone->SerializeToProto().SerializeAsString(), aggregator_state);
+
+    // The clone and the original are independent.
+    for (int i = 0; i < 100; i++) {
+        aggregator->Add(i);
+    }
+    EXPECT_EQ(clone->num_values(), GetParam());
+    EXPECT_EQ(clone->SerializeToProto().SerializeAsString(), aggregator_state);
+    clone->Add(1);
+    EXPECT_EQ(aggregator->num_values(), GetParam() + 100);
+}
+
+TEST(KllQuantileCreateFromProtoTest, RejectsInvalidState) {
+    std::string error;
+    EXPECT_EQ(KllQuantile::CreateFromProto(AggregatorStateProto(), &error), nullptr);
+    EXPECT_FALSE(error.empty());
+
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->Add(1);
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    aggregator_state.MutableExtension(kll_quantiles_state)
+            ->mutable_compactors(0)
+            ->set_packed_values("\x80");
+    error.clear();
+    EXPECT_EQ(KllQuantile::CreateFromProto(aggregator_state, &error), nullptr);
+    EXPECT_FALSE(error.empty());
+}
+
+TEST(KllQuantileCreateFromProtoTest, RejectsTooManyCompactors) {
+    std::unique_ptr<KllQuantile> aggregator = KllQuantile::Create();
+    aggregator->Add(1);
+    AggregatorStateProto aggregator_state = aggregator->SerializeToProto();
+    KllQuantilesStateProto* quantile_state =
+            aggregator_state.MutableExtension(kll_quantiles_state);
+    // Items of the top compactor would have weight 2^31.
+    while (quantile_state->compactors_size() <= internal::CompactorStack::kMaxLevels) {
+        quantile_state->add_compactors()->set_packed_values(
+                quantile_state->compactors(0).packed_values());
+    }
+
+    std::string error;
+    EXPECT_EQ(KllQuantile::CreateFromProto(aggregator_state, &error), nullptr);
+    EXPECT_EQ(error, "too many compactors");
+
+    quantile_state->mutable_compactors()->RemoveLast();
+    EXPECT_NE(KllQuantile::CreateFromProto(aggregator_state, &error), nullptr);
+}
+
 }  // namespace
 
 }  // namespace aggregation
@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "random_generator.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace dist_proc {
+namespace aggregation {
+
+namespace {
+
+TEST(SplitMixRandomGeneratorTest, SameSeedSameSequence) {
+    SplitMixRandomGenerator random(42);
+    SplitMixRandomGenerator other(42);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(random.UnbiasedUniform(1000), other.UnbiasedUniform(1000));
+    }
+}
+
+TEST(SplitMixRandomGeneratorTest, UnbiasedUniformInRange) {
+    SplitMixRandomGenerator random(1);
+    EXPECT_EQ(random.UnbiasedUniform(0), 0);
+    EXPECT_EQ(random.UnbiasedUniform(1), 0);
+
+    std::vector<int> counts(10);
+    for (int i = 0; i < 100000; i++) {
+        const uint64_t value = random.UnbiasedUniform(counts.size());
+        ASSERT_LT(value, counts.size());
+        counts[value]++;
+    }
+    for (const int count : counts) {
+        EXPECT_GT(count, 9000);
+        EXPECT_LT(count, 11000);
+    }
+
+    const uint64_t large = std::numeric_limits<uint64_t>::max() / 3 * 2;
+    for (int i = 0; i < 1000; i++) {
+        EXPECT_LT(random.UnbiasedUniform(large), large);
+    }
+}
+
+}  // namespace
+
+}  // namespace aggregation
+}  // namespace dist_proc
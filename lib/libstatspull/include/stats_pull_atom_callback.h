@@ -97,6 +97,33 @@ int32_t AStatsManager_PullAtomMetadata_getNumAdditiveFields(
 void AStatsManager_PullAtomMetadata_getAdditiveFields(AStatsManager_PullAtomMetadata* metadata,
                                                       int32_t* fields);
 
+/**
+ * Set the key fields of this pulled atom.
+ *
+ * This is only applicable for atoms pulled with an AStatsManager_DeltaPullAtomCallback. The values
+ * of the key fields identify a row of the atom, so a changed row replaces the row with the same
+ * key fields, and a tombstone removes it.
+ */
+void AStatsManager_PullAtomMetadata_setKeyFields(AStatsManager_PullAtomMetadata* metadata,
+                                                 int32_t* key_fields, int32_t num_fields);
+
+/**
+ * Get the number of key fields for this pulled atom. This is intended to be called before
+ * AStatsManager_PullAtomMetadata_getKeyFields to determine the size of the array.
+ */
+int32_t AStatsManager_PullAtomMetadata_getNumKeyFields(AStatsManager_PullAtomMetadata* metadata);
+
+/**
+ * Get the key fields of this pulled atom.
+ *
+ * \param fields an output parameter containing the key fields for this PullAtomMetadata.
+ *               Fields is an array and it is assumed that it is at least as large as the number of
+ *               key fields, which can be obtained by calling
+ *               AStatsManager_PullAtomMetadata_getNumKeyFields.
+ */
+void AStatsManager_PullAtomMetadata_getKeyFields(AStatsManager_PullAtomMetadata* metadata,
+                                                 int32_t* fields);
+
 /**
  * Return codes for the result of a pull.
  */
@@ -125,6 +152,22 @@ typedef struct AStatsEventList AStatsEventList;
  */
 AStatsEvent* AStatsEventList_addStatsEvent(AStatsEventList* pull_data);
 
+/**
+ * Appends and returns a tombstone to the AStatsEventList of an
+ * AStatsManager_DeltaPullAtomCallback, for a row that was removed since the requested token.
+ *
+ * The tombstone is written like an AStatsEvent of the atom, up to the last key field. Only the
+ * key fields are used. Its memory is managed like that of AStatsEventList_addStatsEvent.
+ */
+AStatsEvent* AStatsEventList_addTombstone(AStatsEventList* pull_data);
+
+/**
+ * Marks the AStatsEventList of an AStatsManager_DeltaPullAtomCallback as holding all the rows of
+ * the atom, for instance because the changes since the requested token are not known anymore.
+ * The stats service then drops the rows that are not in the list.
+ */
+void AStatsEventList_setFullSnapshot(AStatsEventList* pull_data);
+
 /**
  * Callback interface for pulling atoms requested by the stats service.
  *
@@ -156,8 +199,52 @@ void AStatsManager_setPullAtomCallback(int32_t atom_tag, AStatsManager_PullAtomM
                                        AStatsManager_PullAtomCallback callback, void* cookie);
 
 /**
- * Clears a callback for an atom when that atom is to be pulled. Note that any ongoing
- * pulls will still occur.
+ * Callback interface for incrementally pulling atoms requested by the stats service.
+ *
+ * \param atom_tag the tag of the atom to pull.
+ * \param since_token the token returned by a previous pull. The callback should fill data with the
+ *                    rows that were added or changed since that pull, and tombstones for the rows
+ *                    that were removed. since_token is 0 if the stats service has no rows of the
+ *                    atom, in which case all rows must be returned.
+ * \param data an output parameter in which the caller should fill the results of the pull. This
+ *             param cannot be NULL and it's lifetime is as long as the execution of the callback.
+ *             It must not be accessed or modified after returning from the callback.
+ * \param token an output parameter in which the caller should write the token for the state
+ *              returned by this pull. It is passed to a later pull as since_token.
+ * \param cookie the opaque pointer passed in AStatsManager_setDeltaPullAtomCallback.
+ * \return AStatsManager_PULL_SUCCESS if the pull was successful, or AStatsManager_PULL_SKIP if not.
+ */
+typedef AStatsManager_PullAtomCallbackReturn (*AStatsManager_DeltaPullAtomCallback)(
+        int32_t atom_tag, int64_t since_token, AStatsEventList* data, int64_t* token,
+        void* cookie);
+
+/**
+ * Sets a callback for an atom when that atom is to be pulled. Unlike with
+ * AStatsManager_setPullAtomCallback, the callback only returns the rows that changed since the
+ * previous pull, and the stats service keeps the other rows. This is meant for atoms with many rows
+ * of which few change between pulls.
+ *
+ * Requires the REGISTER_STATS_PULL_ATOM permission.
+ *
+ * \param atom_tag          The tag of the atom for this pull atom callback.
+ * \param metadata          Metadata specifying the key fields of the atom. It also specifies the
+ *                          timeout, cool down time, and additive fields for mapping isolated to
+ *                          host uids. This param cannot be NULL, and at least one key field must
+ *                          be set with AStatsManager_PullAtomMetadata_setKeyFields. Otherwise no
+ *                          callback is set and an error is logged.
+ * \param callback          The callback to be invoked when the stats service pulls the atom.
+ * \param cookie            A pointer that will be passed back to the callback.
+ *                          It has no meaning to statsd.
+ */
+void AStatsManager_setDeltaPullAtomCallback(int32_t atom_tag,
+                                            AStatsManager_PullAtomMetadata* metadata,
+                                            AStatsManager_DeltaPullAtomCallback callback,
+                                            void* cookie);
+
+/**
+ * Clears a callback for an atom when that atom is to be pulled, whether it was set with
+ * AStatsManager_setPullAtomCallback or AStatsManager_setDeltaPullAtomCallback. Note that any
+ * ongoing pulls will still occur.
  *
  * Requires the REGISTER_STATS_PULL_ATOM permission.
  *
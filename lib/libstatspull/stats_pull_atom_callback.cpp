@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#define LOG_TAG "libstatspull"
+
+#include <aidl/android/os/BnDeltaPullAtomCallback.h>
 #include <aidl/android/os/BnPullAtomCallback.h>
 #include <aidl/android/os/IPullAtomResultReceiver.h>
 #include <aidl/android/os/IStatsd.h>
@@ -21,6 +24,7 @@
 #include <android/binder_auto_utils.h>
 #include <android/binder_ibinder.h>
 #include <android/binder_manager.h>
+#include <log/log.h>
 #include <stats_event.h>
 #include <stats_pull_atom_callback.h>
 
@@ -30,6 +34,7 @@
 #include <vector>
 
 using Status = ::ndk::ScopedAStatus;
+using aidl::android::os::BnDeltaPullAtomCallback;
 using aidl::android::os::BnPullAtomCallback;
 using aidl::android::os::IPullAtomResultReceiver;
 using aidl::android::os::IStatsd;
@@ -38,6 +43,9 @@ using ::ndk::SharedRefBase;
 
 struct AStatsEventList {
     std::vector<AStatsEvent*> data;
+    // Only used by delta pulls.
+    std::vector<AStatsEvent*> tombstones;
+    bool full_snapshot = false;
 };
 
 AStatsEvent* AStatsEventList_addStatsEvent(AStatsEventList* pull_data) {
@@ -46,6 +54,16 @@ AStatsEvent* AStatsEventList_addStatsEvent(AStatsEventList* pull_data) {
     return event;
 }
 
+AStatsEvent* AStatsEventList_addTombstone(AStatsEventList* pull_data) {
+    AStatsEvent* event = AStatsEvent_obtain();
+    pull_data->tombstones.push_back(event);
+    return event;
+}
+
+void AStatsEventList_setFullSnapshot(AStatsEventList* pull_data) {
+    pull_data->full_snapshot = true;
+}
+
 constexpr int64_t DEFAULT_COOL_DOWN_MILLIS = 1000LL;  // 1 second.
 constexpr int64_t DEFAULT_TIMEOUT_MILLIS = 1500LL;    // 1.5 seconds.
 
@@ -53,6 +71,7 @@ struct AStatsManager_PullAtomMetadata {
     int64_t cool_down_millis;
     int64_t timeout_millis;
     std::vector<int32_t> additive_fields;
+    std::vector<int32_t> key_fields;
 };
 
 AStatsManager_PullAtomMetadata* AStatsManager_PullAtomMetadata_obtain() {
@@ -60,6 +79,7 @@ AStatsManager_PullAtomMetadata* AStatsManager_PullAtomMetadata_obtain() {
     metadata->cool_down_millis = DEFAULT_COOL_DOWN_MILLIS;
     metadata->timeout_millis = DEFAULT_TIMEOUT_MILLIS;
     metadata->additive_fields = std::vector<int32_t>();
+    metadata->key_fields = std::vector<int32_t>();
     return metadata;
 }
 
@@ -101,6 +121,46 @@ void AStatsManager_PullAtomMetadata_getAdditiveFields(AStatsManager_PullAtomMeta
     std::copy(metadata->additive_fields.begin(), metadata->additive_fields.end(), fields);
 }
 
+void AStatsManager_PullAtomMetadata_setKeyFields(AStatsManager_PullAtomMetadata* metadata,
+                                                 int32_t* key_fields, int32_t num_fields) {
+    metadata->key_fields.assign(key_fields, key_fields + num_fields);
+}
+
+int32_t AStatsManager_PullAtomMetadata_getNumKeyFields(AStatsManager_PullAtomMetadata* metadata) {
+    return metadata->key_fields.size();
+}
+
+void AStatsManager_PullAtomMetadata_getKeyFields(AStatsManager_PullAtomMetadata* metadata,
+                                                 int32_t* fields) {
+    std::copy(metadata->key_fields.begin(), metadata->key_fields.end(), fields);
+}
+
+// Convert stats_events into StatsEventParcels.
+static std::vector<StatsEventParcel> toStatsEventParcels(const std::vector<AStatsEvent*>& events) {
+    std::vector<StatsEventParcel> parcels;
+
+    // Resolves fuzz build failure in b/161575591.
+#if defined(__ANDROID_APEX__) || defined(LIB_STATS_PULL_TESTS_FLAG)
+    for (int i = 0; i < events.size(); i++) {
+        size_t size;
+        uint8_t* buffer = AStatsEvent_getBuffer(events[i], &size);
+
+        StatsEventParcel p;
+        // vector.assign() creates a copy, but this is inevitable unless
+        // stats_event.h/c uses a vector as opposed to a buffer.
+        p.buffer.assign(buffer, buffer + size);
+        parcels.push_back(std::move(p));
+    }
+#endif
+    return parcels;
+}
+
+static void releaseStatsEvents(const std::vector<AStatsEvent*>& events) {
+    for (int i = 0; i < events.size(); i++) {
+        AStatsEvent_release(events[i]);
+    }
+}
+
 class StatsPullAtomCallbackInternal : public BnPullAtomCallback {
   public:
     StatsPullAtomCallbackInternal(const AStatsManager_PullAtomCallback callback, void* cookie,
@@ -118,31 +178,15 @@ class StatsPullAtomCallbackInternal : public BnPullAtomCallback {
         int successInt = mCallback(atomTag, &statsEventList, mCookie);
         bool success = successInt == AStatsManager_PULL_SUCCESS;
 
-        // Convert stats_events into StatsEventParcels.
-        std::vector<StatsEventParcel> parcels;
-
-        // Resolves fuzz build failure in b/161575591.
-#if defined(__ANDROID_APEX__) || defined(LIB_STATS_PULL_TESTS_FLAG)
-        for (int i = 0; i < statsEventList.data.size(); i++) {
-            size_t size;
-            uint8_t* buffer = AStatsEvent_getBuffer(statsEventList.data[i], &size);
-
-            StatsEventParcel p;
-            // vector.assign() creates a copy, but this is inevitable unless
-            // stats_event.h/c uses a vector as opposed to a buffer.
-            p.buffer.assign(buffer, buffer + size);
-            parcels.push_back(std::move(p));
-        }
-#endif
+        std::vector<StatsEventParcel> parcels = toStatsEventParcels(statsEventList.data);
 
         Status status = resultReceiver->pullFinished(atomTag, success, parcels);
         if (!status.isOk()) {
             std::vector<StatsEventParcel> emptyParcels;
             resultReceiver->pullFinished(atomTag, /*success=*/false, emptyParcels);
         }
-        for (int i = 0; i < statsEventList.data.size(); i++) {
-            AStatsEvent_release(statsEventList.data[i]);
-        }
+        releaseStatsEvents(statsEventList.data);
+        releaseStatsEvents(statsEventList.tombstones);
         return Status::ok();
     }
 
@@ -158,10 +202,65 @@ class StatsPullAtomCallbackInternal : public BnPullAtomCallback {
     const std::vector<int32_t> mAdditiveFields;
 };
 
+class StatsDeltaPullAtomCallbackInternal : public BnDeltaPullAtomCallback {
+  public:
+    StatsDeltaPullAtomCallbackInternal(const AStatsManager_DeltaPullAtomCallback callback,
+                                       void* cookie, const int64_t coolDownMillis,
+                                       const int64_t timeoutMillis,
+                                       const std::vector<int32_t> additiveFields,
+                                       const std::vector<int32_t> keyFields)
+        : mCallback(callback),
+          mCookie(cookie),
+          mCoolDownMillis(coolDownMillis),
+          mTimeoutMillis(timeoutMillis),
+          mAdditiveFields(additiveFields),
+          mKeyFields(keyFields) {}
+
+    Status onPullAtomDelta(int32_t atomTag, int64_t sinceToken,
+                           const std::shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        AStatsEventList statsEventList;
+        int64_t token = 0;
+        int successInt = mCallback(atomTag, sinceToken, &statsEventList, &token, mCookie);
+        bool success = successInt == AStatsManager_PULL_SUCCESS;
+
+        std::vector<StatsEventParcel> parcels = toStatsEventParcels(statsEventList.data);
+        std::vector<StatsEventParcel> tombstoneParcels =
+                toStatsEventParcels(statsEventList.tombstones);
+        // Without a token, statsd has no rows the changes could apply to.
+        bool fullSnapshot = statsEventList.full_snapshot || sinceToken == 0;
+
+        Status status = resultReceiver->pullDeltaFinished(atomTag, success, token, fullSnapshot,
+                                                          parcels, tombstoneParcels);
+        if (!status.isOk()) {
+            std::vector<StatsEventParcel> emptyParcels;
+            resultReceiver->pullDeltaFinished(atomTag, /*success=*/false, /*token=*/0,
+                                              /*fullSnapshot=*/false, emptyParcels, emptyParcels);
+        }
+        releaseStatsEvents(statsEventList.data);
+        releaseStatsEvents(statsEventList.tombstones);
+        return Status::ok();
+    }
+
+    int64_t getCoolDownMillis() const { return mCoolDownMillis; }
+    int64_t getTimeoutMillis() const { return mTimeoutMillis; }
+    const std::vector<int32_t>& getAdditiveFields() const { return mAdditiveFields; }
+    const std::vector<int32_t>& getKeyFields() const { return mKeyFields; }
+
+  private:
+    const AStatsManager_DeltaPullAtomCallback mCallback;
+    void* mCookie;
+    const int64_t mCoolDownMillis;
+    const int64_t mTimeoutMillis;
+    const std::vector<int32_t> mAdditiveFields;
+    const std::vector<int32_t> mKeyFields;
+};
+
 /**
- * @brief pullersMutex is used to guard simultaneous access to pullers from below threads
+ * @brief pullersMutex is used to guard simultaneous access to pullers and deltaPullers from below
+ * threads
  * Main thread
  * - AStatsManager_setPullAtomCallback()
+ * - AStatsManager_setDeltaPullAtomCallback()
  * - AStatsManager_clearPullAtomCallback()
  * Binder thread:
  * - StatsdProvider::binderDied()
@@ -170,6 +269,9 @@ static std::mutex pullersMutex;
 
 static std::map<int32_t, std::shared_ptr<StatsPullAtomCallbackInternal>> pullers;
 
+// An atom has either a puller or a delta puller.
+static std::map<int32_t, std::shared_ptr<StatsDeltaPullAtomCallbackInternal>> deltaPullers;
+
 class StatsdProvider {
 public:
     StatsdProvider() : mDeathRecipient(AIBinder_DeathRecipient_new(binderDied)) {
@@ -214,15 +316,22 @@ public:
         // Since we do not want to make an IPC with the lock held, we first create a
         // copy of the data with the lock held before iterating through the map.
         std::map<int32_t, std::shared_ptr<StatsPullAtomCallbackInternal>> pullersCopy;
+        std::map<int32_t, std::shared_ptr<StatsDeltaPullAtomCallbackInternal>> deltaPullersCopy;
         {
             std::lock_guard<std::mutex> lock(pullersMutex);
             pullersCopy = pullers;
+            deltaPullersCopy = deltaPullers;
         }
         for (const auto& it : pullersCopy) {
             statsService->registerNativePullAtomCallback(it.first, it.second->getCoolDownMillis(),
                                                          it.second->getTimeoutMillis(),
                                                          it.second->getAdditiveFields(), it.second);
         }
+        for (const auto& it : deltaPullersCopy) {
+            statsService->registerNativeDeltaPullAtomCallback(
+                    it.first, it.second->getCoolDownMillis(), it.second->getTimeoutMillis(),
+                    it.second->getAdditiveFields(), it.second->getKeyFields(), it.second);
+        }
     }
 
 private:
@@ -254,6 +363,21 @@ void registerStatsPullAtomCallbackBlocking(int32_t atomTag,
             atomTag, cb->getCoolDownMillis(), cb->getTimeoutMillis(), cb->getAdditiveFields(), cb);
 }
 
+void registerDeltaStatsPullAtomCallbackBlocking(
+        int32_t atomTag, std::shared_ptr<StatsdProvider> statsProvider,
+        std::shared_ptr<StatsDeltaPullAtomCallbackInternal> cb) {
+    const std::shared_ptr<IStatsd> statsService = statsProvider->getStatsService();
+    if (statsService == nullptr) {
+        // Statsd not available
+        return;
+    }
+
+    statsService->registerNativeDeltaPullAtomCallback(atomTag, cb->getCoolDownMillis(),
+                                                      cb->getTimeoutMillis(),
+                                                      cb->getAdditiveFields(), cb->getKeyFields(),
+                                                      cb);
+}
+
 void unregisterStatsPullAtomCallbackBlocking(int32_t atomTag,
                                              std::shared_ptr<StatsdProvider> statsProvider) {
     const std::shared_ptr<IStatsd> statsService = statsProvider->getStatsService();
@@ -267,11 +391,12 @@ void unregisterStatsPullAtomCallbackBlocking(int32_t atomTag,
 
 class CallbackOperationsHandler {
     struct Cmd {
-        enum Type { CMD_REGISTER, CMD_UNREGISTER };
+        enum Type { CMD_REGISTER, CMD_REGISTER_DELTA, CMD_UNREGISTER };
 
         Type type;
         int atomTag;
         std::shared_ptr<StatsPullAtomCallbackInternal> callback;
+        std::shared_ptr<StatsDeltaPullAtomCallbackInternal> deltaCallback;
     };
 
 public:
@@ -301,6 +426,19 @@ public:
         mWorkThreads.push_back(std::move(registerThread));
     }
 
+    void registerDeltaCallback(int atomTag,
+                               std::shared_ptr<StatsDeltaPullAtomCallbackInternal> callback) {
+        auto registerCmd = std::make_unique<Cmd>();
+        registerCmd->type = Cmd::CMD_REGISTER_DELTA;
+        registerCmd->atomTag = atomTag;
+        registerCmd->deltaCallback = std::move(callback);
+        pushToQueue(std::move(registerCmd));
+
+        std::thread registerThread(&CallbackOperationsHandler::processCommands, this,
+                                   statsProvider);
+        mWorkThreads.push_back(std::move(registerThread));
+    }
+
     void unregisterCallback(int atomTag) {
         auto unregisterCmd = std::make_unique<Cmd>();
         unregisterCmd->type = Cmd::CMD_UNREGISTER;
@@ -365,6 +503,11 @@ private:
                 registerStatsPullAtomCallbackBlocking(cmd->atomTag, statsProvider, cmd->callback);
                 break;
             }
+            case Cmd::CMD_REGISTER_DELTA: {
+                registerDeltaStatsPullAtomCallbackBlocking(cmd->atomTag, statsProvider,
+                                                           cmd->deltaCallback);
+                break;
+            }
             case Cmd::CMD_UNREGISTER: {
                 unregisterStatsPullAtomCallbackBlocking(cmd->atomTag, statsProvider);
                 break;
@@ -392,17 +535,48 @@ void AStatsManager_setPullAtomCallback(int32_t atom_tag, AStatsManager_PullAtomM
         std::lock_guard<std::mutex> lock(pullersMutex);
         // Always add to the map. If statsd is dead, we will add them when it comes back.
         pullers[atom_tag] = callbackBinder;
+        deltaPullers.erase(atom_tag);
     }
 
     CallbackOperationsHandler::getInstance().registerCallback(atom_tag, callbackBinder);
 }
 
+void AStatsManager_setDeltaPullAtomCallback(int32_t atom_tag,
+                                            AStatsManager_PullAtomMetadata* metadata,
+                                            AStatsManager_DeltaPullAtomCallback callback,
+                                            void* cookie) {
+    // Rows can't be matched across pulls without key fields.
+    if (metadata == nullptr) {
+        ALOGE("Delta pull atom callback for atom %d not set: metadata is null", atom_tag);
+        return;
+    }
+    if (metadata->key_fields.empty()) {
+        ALOGE("Delta pull atom callback for atom %d not set: no key fields", atom_tag);
+        return;
+    }
+
+    std::shared_ptr<StatsDeltaPullAtomCallbackInternal> callbackBinder =
+            SharedRefBase::make<StatsDeltaPullAtomCallbackInternal>(
+                    callback, cookie, metadata->cool_down_millis, metadata->timeout_millis,
+                    metadata->additive_fields, metadata->key_fields);
+
+    {
+        std::lock_guard<std::mutex> lock(pullersMutex);
+        // Always add to the map. If statsd is dead, we will add them when it comes back.
+        deltaPullers[atom_tag] = callbackBinder;
+        pullers.erase(atom_tag);
+    }
+
+    CallbackOperationsHandler::getInstance().registerDeltaCallback(atom_tag, callbackBinder);
+}
+
 void AStatsManager_clearPullAtomCallback(int32_t atom_tag) {
     {
         std::lock_guard<std::mutex> lock(pullersMutex);
         // Always remove the puller from our map.
         // If statsd is down, we will not register it when it comes back.
         pullers.erase(atom_tag);
+        deltaPullers.erase(atom_tag);
     }
 
     CallbackOperationsHandler::getInstance().unregisterCallback(atom_tag);
@@ -30,6 +30,7 @@ TEST(AStatsManager_PullAtomMetadataTest, TestEmpty) {
     EXPECT_EQ(AStatsManager_PullAtomMetadata_getCoolDownMillis(metadata), DEFAULT_COOL_DOWN_MILLIS);
     EXPECT_EQ(AStatsManager_PullAtomMetadata_getTimeoutMillis(metadata), DEFAULT_TIMEOUT_MILLIS);
     EXPECT_EQ(AStatsManager_PullAtomMetadata_getNumAdditiveFields(metadata), 0);
+    EXPECT_EQ(AStatsManager_PullAtomMetadata_getNumKeyFields(metadata), 0);
     AStatsManager_PullAtomMetadata_release(metadata);
 }
 
@@ -69,6 +70,21 @@ TEST(AStatsManager_PullAtomMetadataTest, TestSetAdditiveFields) {
     AStatsManager_PullAtomMetadata_release(metadata);
 }
 
+TEST(AStatsManager_PullAtomMetadataTest, TestSetKeyFields) {
+    const int numFields = 2;
+    int inputFields[numFields] = {1, 3};
+    AStatsManager_PullAtomMetadata* metadata = AStatsManager_PullAtomMetadata_obtain();
+    AStatsManager_PullAtomMetadata_setKeyFields(metadata, inputFields, numFields);
+    EXPECT_EQ(AStatsManager_PullAtomMetadata_getNumAdditiveFields(metadata), 0);
+    EXPECT_EQ(AStatsManager_PullAtomMetadata_getNumKeyFields(metadata), numFields);
+    int outputFields[numFields];
+    AStatsManager_PullAtomMetadata_getKeyFields(metadata, outputFields);
+    for (int i = 0; i < numFields; i++) {
+        EXPECT_EQ(inputFields[i], outputFields[i]);
+    }
+    AStatsManager_PullAtomMetadata_release(metadata);
+}
+
 TEST(AStatsManager_PullAtomMetadataTest, TestSetAllElements) {
     int64_t timeoutMillis = 500;
     int64_t coolDownMillis = 10000;
@@ -17,7 +17,10 @@
 #include "benchmark/benchmark.h"
 #include "FieldValue.h"
 #include "HashableDimensionKey.h"
+#include "condition/SimpleConditionTracker.h"
 #include "logd/LogEvent.h"
+#include "metrics/duration_helper/MaxDurationTracker.h"
+#include "metrics/duration_helper/OringDurationTracker.h"
 #include "stats_log_util.h"
 #include "metric_util.h"
 
@@ -25,6 +28,7 @@ namespace android {
 namespace os {
 namespace statsd {
 
+using std::unique_ptr;
 using std::vector;
 
 static StatsdConfig CreateDurationMetricConfig_NoLink_AND_CombinationCondition(
@@ -309,6 +313,212 @@ static void BM_DurationMetricLink(benchmark::State& state) {
 
 BENCHMARK(BM_DurationMetricLink);
 
+namespace {
+
+const int kTrackerKeyCount = 500;
+const int64_t kTrackerBucketSizeNs = 60 * NS_PER_SEC;
+
+// Condition of every linked key flips on each query round, as if the linked condition was
+// toggled for all keys at once.
+class FlippingConditionWizard : public ConditionWizard {
+public:
+    ConditionState query(const int conditionIndex, const ConditionKey& conditionParameters,
+                         const bool isPartialLink) override {
+        return mConditionMet ? ConditionState::kTrue : ConditionState::kFalse;
+    }
+
+    bool mConditionMet = true;
+};
+
+vector<HashableDimensionKey> createTrackerKeys() {
+    vector<HashableDimensionKey> keys;
+    for (int i = 0; i < kTrackerKeyCount; i++) {
+        int32_t pos[] = {1, 0, 0};
+        HashableDimensionKey key;
+        key.addValue(FieldValue(Field(10, pos, 0), Value(i)));
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+// Starts every key, toggles the condition a few times, stops every key and flushes the bucket, so
+// each iteration goes through the per-key state of a full bucket.
+template <typename Tracker>
+void runTrackerBucket(benchmark::State& state, bool linked) {
+    const vector<HashableDimensionKey> keys = createTrackerKeys();
+    sp<FlippingConditionWizard> wizard = new FlippingConditionWizard();
+    ConditionKey conditionKey;
+    conditionKey[StringToId("Condition")] = DEFAULT_DIMENSION_KEY;
+    MetricDimensionKey eventKey(DEFAULT_DIMENSION_KEY, DEFAULT_DIMENSION_KEY);
+    Tracker tracker(ConfigKey(), /*id=*/1, eventKey, wizard, /*conditionIndex=*/0,
+                    /*nesting=*/false, /*currentBucketStartNs=*/0, /*currentBucketNum=*/0,
+                    /*startTimeNs=*/0, kTrackerBucketSizeNs, /*conditionSliced=*/linked,
+                    /*fullLink=*/linked, {});
+    std::unordered_map<MetricDimensionKey, vector<DurationBucket>> buckets;
+
+    int64_t timeNs = 0;
+    while (state.KeepRunning()) {
+        for (const HashableDimensionKey& key : keys) {
+            tracker.noteStart(key, /*condition=*/true, ++timeNs, conditionKey);
+        }
+        for (int i = 0; i < 4; i++) {
+            wizard->mConditionMet = !wizard->mConditionMet;
+            if (linked) {
+                tracker.onSlicedConditionMayChange(++timeNs);
+            } else {
+                tracker.onConditionChanged(wizard->mConditionMet, ++timeNs);
+            }
+        }
+        for (const HashableDimensionKey& key : keys) {
+            tracker.noteStop(key, ++timeNs, /*stopAll=*/false);
+        }
+        timeNs += kTrackerBucketSizeNs;
+        tracker.flushIfNeeded(timeNs, /*uploadThreshold=*/nullopt, &buckets);
+        buckets.clear();
+    }
+}
+
+}  // anonymous namespace
+
+static void BM_OringDurationTrackerNoLink(benchmark::State& state) {
+    runTrackerBucket<OringDurationTracker>(state, /*linked=*/false);
+}
+
+BENCHMARK(BM_OringDurationTrackerNoLink);
+
+static void BM_OringDurationTrackerLink(benchmark::State& state) {
+    runTrackerBucket<OringDurationTracker>(state, /*linked=*/true);
+}
+
+BENCHMARK(BM_OringDurationTrackerLink);
+
+static void BM_MaxDurationTrackerNoLink(benchmark::State& state) {
+    runTrackerBucket<MaxDurationTracker>(state, /*linked=*/false);
+}
+
+BENCHMARK(BM_MaxDurationTrackerNoLink);
+
+static void BM_MaxDurationTrackerLink(benchmark::State& state) {
+    runTrackerBucket<MaxDurationTracker>(state, /*linked=*/true);
+}
+
+BENCHMARK(BM_MaxDurationTrackerLink);
+
+namespace {
+
+const int kStormAtomId = 10001;
+const int kStormSliceCount = 2000;
+
+unique_ptr<LogEvent> createStormEvent(int uid, int tag) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, kStormAtomId);
+    AStatsEvent_overwriteTimestamp(statsEvent, 1000);
+    AStatsEvent_writeInt32(statsEvent, uid);
+    AStatsEvent_writeInt32(statsEvent, tag);
+
+    unique_ptr<LogEvent> event = std::make_unique<LogEvent>(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, event.get());
+    return event;
+}
+
+// A condition sliced by (uid, tag) that is true for every uid, and an OringDurationTracker with
+// one key per uid linked to the condition by uid only. Every sliced condition change makes the
+// tracker re-evaluate the condition of all of its keys.
+struct ConditionStorm {
+    sp<SimpleConditionTracker> condition;
+    vector<sp<ConditionTracker>> allConditions;
+    sp<ConditionWizard> wizard;
+    vector<ConditionKey> conditionKeys;
+    unique_ptr<OringDurationTracker> tracker;
+
+    ConditionStorm() {
+        const int64_t conditionId = StringToId("Storm");
+        SimplePredicate predicate;
+        predicate.set_start(StringToId("StormStart"));
+        predicate.set_stop(StringToId("StormStop"));
+        *predicate.mutable_dimensions() = CreateDimensions(kStormAtomId, {1, 2});
+        std::unordered_map<int64_t, int> matcherIndices = {{StringToId("StormStart"), 0},
+                                                            {StringToId("StormStop"), 1}};
+        condition = new SimpleConditionTracker(ConfigKey(), conditionId, /*protoHash=*/0,
+                                               /*index=*/0, predicate, matcherIndices);
+        vector<Matcher> uidMatcher;
+        translateFieldMatcher(CreateDimensions(kStormAtomId, {1}), &uidMatcher);
+        condition->addLinkedDimensions(uidMatcher);
+        allConditions = {condition};
+        wizard = new ConditionWizard(allConditions);
+
+        for (int uid = 0; uid < kStormSliceCount; uid++) {
+            setSlice(uid, /*start=*/true);
+            HashableDimensionKey uidKey;
+            filterValues(uidMatcher, createStormEvent(uid, 0)->getValues(), &uidKey);
+            conditionKeys.push_back({{conditionId, uidKey}});
+        }
+
+        MetricDimensionKey eventKey(DEFAULT_DIMENSION_KEY, DEFAULT_DIMENSION_KEY);
+        tracker = std::make_unique<OringDurationTracker>(
+                ConfigKey(), /*id=*/1, eventKey, wizard, /*conditionIndex=*/0, /*nesting=*/false,
+                /*currentBucketStartNs=*/0, /*currentBucketNum=*/0, /*startTimeNs=*/0,
+                kTrackerBucketSizeNs, /*conditionSliced=*/true, /*fullLink=*/false,
+                vector<sp<AnomalyTracker>>());
+        for (int uid = 0; uid < kStormSliceCount; uid++) {
+            int32_t pos[] = {1, 0, 0};
+            HashableDimensionKey key;
+            key.addValue(FieldValue(Field(kStormAtomId, pos, 0), Value(uid)));
+            tracker->noteStart(key, /*condition=*/true, /*eventTime=*/1, conditionKeys[uid]);
+        }
+    }
+
+    // Starts or stops the slice of uid, as a matched condition event would.
+    void setSlice(int uid, bool start) {
+        unique_ptr<LogEvent> event = createStormEvent(uid, /*tag=*/7);
+        vector<MatchingState> matcherStates = {
+                start ? MatchingState::kMatched : MatchingState::kNotMatched,
+                start ? MatchingState::kNotMatched : MatchingState::kMatched};
+        vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+        vector<bool> changedCache(1, false);
+        condition->evaluateCondition(*event, matcherStates, allConditions, conditionCache,
+                                     changedCache);
+    }
+};
+
+}  // anonymous namespace
+
+// One slice of the condition flips, and the tracker re-evaluates all of its keys.
+static void BM_SlicedConditionStorm(benchmark::State& state) {
+    ConditionStorm storm;
+    int64_t timeNs = 2;
+    bool start = false;
+    while (state.KeepRunning()) {
+        storm.setSlice(/*uid=*/0, start);
+        start = !start;
+        storm.wizard->beginQueryCache();
+        storm.tracker->onSlicedConditionMayChange(timeNs++);
+        storm.wizard->endQueryCache();
+    }
+}
+
+BENCHMARK(BM_SlicedConditionStorm);
+
+// The same change answered with one query per key, as done before queryAll().
+static void BM_SlicedConditionStorm_queryPerKey(benchmark::State& state) {
+    ConditionStorm storm;
+    bool start = false;
+    while (state.KeepRunning()) {
+        storm.setSlice(/*uid=*/0, start);
+        start = !start;
+        storm.wizard->beginQueryCache();
+        int trueCount = 0;
+        for (const ConditionKey& conditionKey : storm.conditionKeys) {
+            trueCount += storm.wizard->query(/*conditionIndex=*/0, conditionKey,
+                                             /*isPartialLink=*/true) == ConditionState::kTrue;
+        }
+        benchmark::DoNotOptimize(trueCount);
+        storm.wizard->endQueryCache();
+    }
+}
+
+BENCHMARK(BM_SlicedConditionStorm_queryPerKey);
+
 }  //  namespace statsd
 }  //  namespace os
 }  //  namespace android
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "kll.h"
+#include "logd/LogEvent.h"
+#include "metric_util.h"
+#include "stats_event.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using dist_proc::aggregation::KllQuantile;
+using dist_proc::aggregation::KllQuantileOptions;
+using dist_proc::aggregation::SplitMixRandomGenerator;
+using std::unique_ptr;
+using std::vector;
+
+namespace {
+
+const int kAtomId = 10000;
+const int kValueCount = 100000;
+
+// Latency-like values: mostly small with a long tail, so that many values repeat.
+vector<int64_t> createValues() {
+    std::mt19937 gen(1);
+    std::lognormal_distribution<double> dis(4, 1);
+    vector<int64_t> values(kValueCount);
+    for (int64_t& value : values) {
+        value = static_cast<int64_t>(dis(gen));
+    }
+    return values;
+}
+
+StatsdConfig createKllMetricConfig() {
+    StatsdConfig config;
+    config.set_id(12345);
+    const AtomMatcher matcher = CreateSimpleAtomMatcher("Latency", kAtomId);
+    *config.add_atom_matcher() = matcher;
+
+    KllMetric* metric = config.add_kll_metric();
+    metric->set_id(StringToId("LatencyDistribution"));
+    metric->set_what(matcher.id());
+    metric->set_bucket(FIVE_MINUTES);
+    metric->mutable_kll_field()->set_field(kAtomId);
+    metric->mutable_kll_field()->add_child()->set_field(2);
+    *metric->mutable_dimensions_in_what() = CreateDimensions(kAtomId, {1});
+    return config;
+}
+
+vector<unique_ptr<LogEvent>> createEvents(const vector<int64_t>& values, int64_t startTimeNs) {
+    vector<unique_ptr<LogEvent>> events;
+    events.reserve(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        AStatsEvent* statsEvent = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(statsEvent, kAtomId);
+        AStatsEvent_overwriteTimestamp(statsEvent, startTimeNs + i);
+        AStatsEvent_writeInt32(statsEvent, i % 20);
+        AStatsEvent_writeInt64(statsEvent, values[i]);
+
+        unique_ptr<LogEvent> event = std::make_unique<LogEvent>(/*uid=*/0, /*pid=*/0);
+        parseStatsEventToLogEvent(statsEvent, event.get());
+        events.push_back(std::move(event));
+    }
+    return events;
+}
+
+}  // anonymous namespace
+
+static void BM_KllQuantileAdd(benchmark::State& state) {
+    const vector<int64_t> values = createValues();
+    while (state.KeepRunning()) {
+        unique_ptr<KllQuantile> kll = KllQuantile::Create();
+        for (const int64_t value : values) {
+            kll->Add(value);
+        }
+        benchmark::DoNotOptimize(kll->num_values());
+    }
+}
+
+BENCHMARK(BM_KllQuantileAdd);
+
+static void BM_KllQuantileAddBatch(benchmark::State& state) {
+    const vector<int64_t> values = createValues();
+    while (state.KeepRunning()) {
+        unique_ptr<KllQuantile> kll = KllQuantile::Create();
+        kll->AddBatch(values.data(), values.size());
+        benchmark::DoNotOptimize(kll->num_values());
+    }
+}
+
+BENCHMARK(BM_KllQuantileAddBatch);
+
+static void BM_KllQuantileAddWeightedBatch(benchmark::State& state) {
+    const vector<int64_t> values = createValues();
+    vector<int> weights(values.size());
+    for (size_t i = 0; i < weights.size(); i++) {
+        weights[i] = 1 + i % 4;
+    }
+    while (state.KeepRunning()) {
+        unique_ptr<KllQuantile> kll = KllQuantile::Create();
+        kll->AddWeightedBatch(values.data(), weights.data(), values.size());
+        benchmark::DoNotOptimize(kll->num_values());
+    }
+}
+
+BENCHMARK(BM_KllQuantileAddWeightedBatch);
+
+static void BM_KllQuantileSerializeToProto(benchmark::State& state) {
+    unique_ptr<KllQuantile> kll = KllQuantile::Create();
+    const vector<int64_t> values = createValues();
+    kll->AddBatch(values.data(), values.size());
+    while (state.KeepRunning()) {
+        const std::string serialized = kll->SerializeToProto().SerializeAsString();
+        benchmark::DoNotOptimize(serialized);
+    }
+}
+
+BENCHMARK(BM_KllQuantileSerializeToProto);
+
+static void BM_KllQuantileSerializeToString(benchmark::State& state) {
+    unique_ptr<KllQuantile> kll = KllQuantile::Create();
+    const vector<int64_t> values = createValues();
+    kll->AddBatch(values.data(), values.size());
+    std::string serialized;
+    while (state.KeepRunning()) {
+        kll->SerializeToString(&serialized);
+        benchmark::DoNotOptimize(serialized);
+    }
+}
+
+BENCHMARK(BM_KllQuantileSerializeToString);
+
+// Many dimensions with a few values each, as in a KLL metric sliced by uid.
+static void BM_KllQuantileSmallSketches(benchmark::State& state) {
+    SplitMixRandomGenerator random;
+    const bool sharedRandom = state.range(0);
+    while (state.KeepRunning()) {
+        vector<unique_ptr<KllQuantile>> sketches(1000);
+        for (size_t i = 0; i < sketches.size(); i++) {
+            KllQuantileOptions options;
+            if (sharedRandom) {
+                options.set_random(&random);
+            }
+            sketches[i] = KllQuantile::Create(options);
+            for (int j = 0; j < 5; j++) {
+                sketches[i]->Add(i * j);
+            }
+        }
+        benchmark::DoNotOptimize(sketches);
+    }
+}
+
+BENCHMARK(BM_KllQuantileSmallSketches)->Arg(false)->Arg(true);
+
+// Events of a KLL metric with 20 dimensions, from the log event to the sketch.
+static void BM_KllMetricProducer(benchmark::State& state) {
+    const StatsdConfig config = createKllMetricConfig();
+    const int64_t startTimeNs = 10000000000;
+    const vector<unique_ptr<LogEvent>> events = createEvents(createValues(), startTimeNs + 1);
+
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        sp<StatsLogProcessor> processor =
+                CreateStatsLogProcessor(startTimeNs / NS_PER_SEC, config, ConfigKey(111, 222));
+        state.ResumeTiming();
+        for (const auto& event : events) {
+            processor->OnLogEvent(event.get());
+        }
+    }
+}
+
+BENCHMARK(BM_KllMetricProducer);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
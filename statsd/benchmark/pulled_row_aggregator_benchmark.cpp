@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "FieldValue.h"
+#include "HashableDimensionKey.h"
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "metric_util.h"
+#include "metrics/PulledRowAggregator.h"
+#include "stats_event.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::optional;
+using std::pair;
+using std::shared_ptr;
+using std::unordered_map;
+using std::vector;
+
+namespace {
+
+const int kAtomId = 10000;
+const int kRowCount = 10000;
+// Every dimension appears twice in the pull, as if uids were merged into their host uid.
+const int kDimensionCount = kRowCount / 2;
+const DiffOptions kDiffOptions = {ValueMetric::INCREASING, /*useAbsoluteValueOnReset=*/false,
+                                  /*useZeroDefaultBase=*/false};
+
+vector<shared_ptr<LogEvent>> createPull() {
+    vector<shared_ptr<LogEvent>> pull;
+    pull.reserve(kRowCount);
+    for (int i = 0; i < kRowCount; i++) {
+        AStatsEvent* statsEvent = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(statsEvent, kAtomId);
+        AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+        AStatsEvent_writeInt32(statsEvent, 1000 + i % kDimensionCount);
+        AStatsEvent_writeInt64(statsEvent, i);
+        AStatsEvent_writeInt64(statsEvent, 2 * i);
+
+        shared_ptr<LogEvent> event = std::make_shared<LogEvent>(/*uid=*/0, /*pid=*/0);
+        parseStatsEventToLogEvent(statsEvent, event.get());
+        pull.push_back(event);
+    }
+    return pull;
+}
+
+void createMatchers(vector<Matcher>* dimensionsInWhat, vector<Matcher>* valueFields) {
+    translateFieldMatcher(CreateDimensions(kAtomId, {1}), dimensionsInWhat);
+    translateFieldMatcher(CreateDimensions(kAtomId, {2, 3}), valueFields);
+}
+
+}  // anonymous namespace
+
+static void BM_PulledRowAggregator(benchmark::State& state) {
+    const vector<shared_ptr<LogEvent>> pull = createPull();
+    vector<Matcher> dimensionsInWhat;
+    vector<Matcher> valueFields;
+    createMatchers(&dimensionsInWhat, &valueFields);
+    PulledRowAggregator aggregator(dimensionsInWhat, valueFields, kDiffOptions);
+
+    while (state.KeepRunning()) {
+        aggregator.reset(pull.size());
+        for (const auto& row : pull) {
+            aggregator.addRow(*row);
+        }
+        int64_t sum = 0;
+        aggregator.forEachMergedRow(/*hasGlobalBase=*/true, [&](const LogEvent&) {
+            for (size_t i = 0; i < valueFields.size(); i++) {
+                const PulledRowAggregator::MergedValue& merged = aggregator.getMergedValue(i);
+                if (merged.diffResult == DIFF_OK) {
+                    sum += merged.diff.long_value;
+                }
+                aggregator.acceptValue(i);
+            }
+        });
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK(BM_PulledRowAggregator);
+
+// Aggregation as previously done by NumericValueMetricProducer::accumulateEvents, which copies
+// the first row of every dimension into a map node, followed by the lookup of the bases of every
+// dimension in a second map, as done by NumericValueMetricProducer::aggregateFields.
+static void BM_PulledRowAggregator_copyPerDimension(benchmark::State& state) {
+    const vector<shared_ptr<LogEvent>> pull = createPull();
+    vector<Matcher> dimensionsInWhat;
+    vector<Matcher> valueFields;
+    createMatchers(&dimensionsInWhat, &valueFields);
+    unordered_map<HashableDimensionKey, vector<optional<Value>>> bases;
+
+    while (state.KeepRunning()) {
+        unordered_map<HashableDimensionKey, pair<LogEvent, vector<int>>> aggregateEvents;
+        for (const auto& row : pull) {
+            HashableDimensionKey key;
+            vector<int> valueIndices(valueFields.size(), -1);
+            filterValues(dimensionsInWhat, valueFields, row->getValues(), key, valueIndices);
+            auto it = aggregateEvents.find(key);
+            if (it == aggregateEvents.end()) {
+                aggregateEvents.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                                        std::forward_as_tuple(*row, valueIndices));
+                continue;
+            }
+            vector<FieldValue>* const values = it->second.first.getMutableValues();
+            for (size_t i = 0; i < valueIndices.size(); i++) {
+                if (valueIndices[i] != -1 && it->second.second[i] != -1) {
+                    (*values)[it->second.second[i]].mValue +=
+                            row->getValues()[valueIndices[i]].mValue;
+                }
+            }
+        }
+        int64_t sum = 0;
+        for (auto& [key, eventInfo] : aggregateEvents) {
+            eventInfo.first.setElapsedTimestampNs(1);
+            vector<optional<Value>>& keyBases = bases[key];
+            keyBases.resize(valueFields.size());
+            for (size_t i = 0; i < valueFields.size(); i++) {
+                const Value& value = eventInfo.first.getValues()[eventInfo.second[i]].mValue;
+                if (keyBases[i].has_value() && value >= keyBases[i].value()) {
+                    sum += (value - keyBases[i].value()).long_value;
+                }
+                keyBases[i] = value;
+            }
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+}
+
+BENCHMARK(BM_PulledRowAggregator_copyPerDimension);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <memory>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "external/puller_util.h"
+#include "logd/LogEvent.h"
+#include "metric_util.h"
+#include "packages/UidMap.h"
+#include "stats_event.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::shared_ptr;
+using std::vector;
+
+namespace {
+
+const int kNetworkAtomId = 10000;
+const int kCpuAtomId = 10001;
+const int kRowCount = 10000;
+const int kHostUidCount = 1000;
+const int kFirstHostUid = 10000;
+const int kFirstIsolatedUid = 90000;
+
+// The first rows are from host uids, the others from isolated uids spread over the host uids.
+int getUid(int row, int rowsPerUid) {
+    const int uidIndex = row / rowsPerUid;
+    return uidIndex < kHostUidCount ? kFirstHostUid + uidIndex
+                                    : kFirstIsolatedUid + uidIndex - kHostUidCount;
+}
+
+sp<UidMap> createUidMap(int rowsPerUid) {
+    sp<UidMap> uidMap = new UidMap();
+    for (int uidIndex = kHostUidCount; uidIndex < kRowCount / rowsPerUid; uidIndex++) {
+        uidMap->assignIsolatedUid(kFirstIsolatedUid + uidIndex - kHostUidCount,
+                                  kFirstHostUid + uidIndex % kHostUidCount);
+    }
+    return uidMap;
+}
+
+shared_ptr<LogEvent> toLogEvent(AStatsEvent* statsEvent) {
+    shared_ptr<LogEvent> event = std::make_shared<LogEvent>(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, event.get());
+    return event;
+}
+
+// Like the per uid network stats: uid, is_foreground, rx_bytes, rx_packets, tx_bytes and
+// tx_packets, with a foreground and a background row per uid.
+vector<shared_ptr<LogEvent>> createNetworkPull() {
+    vector<shared_ptr<LogEvent>> pull;
+    pull.reserve(kRowCount);
+    for (int i = 0; i < kRowCount; i++) {
+        AStatsEvent* statsEvent = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(statsEvent, kNetworkAtomId);
+        AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+        AStatsEvent_writeInt32(statsEvent, getUid(i, /*rowsPerUid=*/2));
+        AStatsEvent_addBoolAnnotation(statsEvent, ASTATSLOG_ANNOTATION_ID_IS_UID, true);
+        AStatsEvent_writeBool(statsEvent, i % 2 == 0);
+        AStatsEvent_writeInt64(statsEvent, 1000 * i);
+        AStatsEvent_writeInt64(statsEvent, i);
+        AStatsEvent_writeInt64(statsEvent, 500 * i);
+        AStatsEvent_writeInt64(statsEvent, i / 2);
+        pull.push_back(toLogEvent(statsEvent));
+    }
+    return pull;
+}
+
+// Like the per uid cpu time: uid, user_time_micros and sys_time_micros.
+vector<shared_ptr<LogEvent>> createCpuPull() {
+    vector<shared_ptr<LogEvent>> pull;
+    pull.reserve(kRowCount);
+    for (int i = 0; i < kRowCount; i++) {
+        AStatsEvent* statsEvent = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(statsEvent, kCpuAtomId);
+        AStatsEvent_overwriteTimestamp(statsEvent, 100000);
+        AStatsEvent_writeInt32(statsEvent, getUid(i, /*rowsPerUid=*/1));
+        AStatsEvent_addBoolAnnotation(statsEvent, ASTATSLOG_ANNOTATION_ID_IS_UID, true);
+        AStatsEvent_writeInt64(statsEvent, 300 * i);
+        AStatsEvent_writeInt64(statsEvent, 100 * i);
+        pull.push_back(toLogEvent(statsEvent));
+    }
+    return pull;
+}
+
+// The merge changes the events, so every iteration works on a copy of the pull.
+void runMerge(benchmark::State& state, const vector<shared_ptr<LogEvent>>& pull,
+              const sp<UidMap>& uidMap, int tagId, const vector<int>& additiveFields) {
+    while (state.KeepRunning()) {
+        state.PauseTiming();
+        vector<shared_ptr<LogEvent>> data;
+        data.reserve(pull.size());
+        for (const auto& event : pull) {
+            data.push_back(std::make_shared<LogEvent>(*event));
+        }
+        state.ResumeTiming();
+
+        mapAndMergeIsolatedUidsToHostUid(data, uidMap, tagId, additiveFields);
+        benchmark::DoNotOptimize(data.size());
+    }
+}
+
+}  // anonymous namespace
+
+static void BM_MapAndMergeIsolatedUids_network(benchmark::State& state) {
+    runMerge(state, createNetworkPull(), createUidMap(/*rowsPerUid=*/2), kNetworkAtomId,
+             {3, 4, 5, 6});
+}
+
+BENCHMARK(BM_MapAndMergeIsolatedUids_network);
+
+static void BM_MapAndMergeIsolatedUids_cpu(benchmark::State& state) {
+    runMerge(state, createCpuPull(), createUidMap(/*rowsPerUid=*/1), kCpuAtomId, {2, 3});
+}
+
+BENCHMARK(BM_MapAndMergeIsolatedUids_cpu);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -19,6 +19,8 @@
 #include "HashableDimensionKey.h"
 #include "FieldValue.h"
 
+#include <algorithm>
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -111,47 +113,58 @@ StatsDimensionsValueParcel HashableDimensionKey::toStatsDimensionsValueParcel()
     return root;
 }
 
+android::hash_t hashFieldValue(android::hash_t hash, const FieldValue& fieldValue) {
+    hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
+    hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
+    hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
+    switch (fieldValue.mValue.getType()) {
+        case INT:
+            return android::JenkinsHashMix(hash, android::hash_type(fieldValue.mValue.int_value));
+        case LONG:
+            return android::JenkinsHashMix(hash, android::hash_type(fieldValue.mValue.long_value));
+        case STRING:
+            return android::JenkinsHashMix(hash, static_cast<uint32_t>(std::hash<std::string>()(
+                                                         fieldValue.mValue.str_value)));
+        case FLOAT:
+            return android::JenkinsHashMix(hash,
+                                           android::hash_type(fieldValue.mValue.float_value));
+        case DOUBLE:
+            return android::JenkinsHashMix(hash,
+                                           android::hash_type(fieldValue.mValue.double_value));
+        case STORAGE:
+            return android::JenkinsHashMixBytes(hash, fieldValue.mValue.storage_value.data(),
+                                                fieldValue.mValue.storage_value.size());
+        default:
+            return hash;
+    }
+}
+
 android::hash_t hashDimension(const HashableDimensionKey& value) {
     android::hash_t hash = 0;
     for (const auto& fieldValue : value.getValues()) {
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getField()));
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mField.getTag()));
-        hash = android::JenkinsHashMix(hash, android::hash_type((int)fieldValue.mValue.getType()));
-        switch (fieldValue.mValue.getType()) {
-            case INT:
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.int_value));
-                break;
-            case LONG:
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.long_value));
-                break;
-            case STRING:
-                hash = android::JenkinsHashMix(hash, static_cast<uint32_t>(std::hash<std::string>()(
-                                                             fieldValue.mValue.str_value)));
-                break;
-            case FLOAT: {
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.float_value));
-                break;
-            }
-            case DOUBLE: {
-                hash = android::JenkinsHashMix(hash,
-                                               android::hash_type(fieldValue.mValue.double_value));
-                break;
-            }
-            case STORAGE: {
-                hash = android::JenkinsHashMixBytes(hash, fieldValue.mValue.storage_value.data(),
-                                                    fieldValue.mValue.storage_value.size());
-                break;
-            }
-            default:
-                break;
-        }
+        hash = hashFieldValue(hash, fieldValue);
     }
     return JenkinsHashWhiten(hash);
 }
 
+static bool lessByField(const FieldValue& lhs, const FieldValue& rhs) {
+    return lhs.mField < rhs.mField;
+}
+
+bool isSortedByField(const HashableDimensionKey& key) {
+    return std::is_sorted(key.getValues().begin(), key.getValues().end(), lessByField);
+}
+
+HashableDimensionKey sortByField(const HashableDimensionKey& key) {
+    HashableDimensionKey sortedKey(key);
+    std::sort(sortedKey.mutableValues()->begin(), sortedKey.mutableValues()->end(), lessByField);
+    return sortedKey;
+}
+
+android::hash_t hashDimensionSortedByField(const HashableDimensionKey& key) {
+    return isSortedByField(key) ? hashDimension(key) : hashDimension(sortByField(key));
+}
+
 bool filterValues(const Matcher& matcherField, const vector<FieldValue>& values,
                   FieldValue* output) {
     if (matcherField.hasAllPositionMatcher()) {
@@ -162,8 +162,27 @@ private:
     HashableDimensionKey mAtomFieldValues;
 };
 
+// Mixes the field and the value of fieldValue into hash. The result is not whitened.
+android::hash_t hashFieldValue(android::hash_t hash, const FieldValue& fieldValue);
+
 android::hash_t hashDimension(const HashableDimensionKey& key);
 
+/**
+ * Returns true if the values of key are sorted by field.
+ */
+bool isSortedByField(const HashableDimensionKey& key);
+
+/**
+ * Returns a copy of key with its values sorted by field.
+ */
+HashableDimensionKey sortByField(const HashableDimensionKey& key);
+
+/**
+ * Returns the hash of key with its values sorted by field, so that keys holding the same values
+ * in a different order have the same hash.
+ */
+android::hash_t hashDimensionSortedByField(const HashableDimensionKey& key);
+
 /**
  * Returns true if a FieldValue field matches the matcher field.
  * This function can only be used to match one field (i.e. matcher with position ALL will return
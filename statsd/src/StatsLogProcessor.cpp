@@ -24,6 +24,9 @@
 #include <cutils/multiuser.h>
 #include <src/active_config_list.pb.h>
 #include <src/experiment_ids.pb.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 
 #include "StatsService.h"
 #include "android-base/stringprintf.h"
@@ -40,6 +43,7 @@
 
 using namespace android;
 using android::base::StringPrintf;
+using android::base::unique_fd;
 using android::modules::sdklevel::IsAtLeastU;
 using android::util::FIELD_COUNT_REPEATED;
 using android::util::FIELD_TYPE_BOOL;
@@ -119,10 +123,9 @@ StatsLogProcessor::StatsLogProcessor(
 StatsLogProcessor::~StatsLogProcessor() {
 }
 
-static void flushProtoToBuffer(ProtoOutputStream& proto, vector<uint8_t>* outData) {
-    outData->clear();
-    outData->resize(proto.size());
-    size_t pos = 0;
+static void appendProtoToBuffer(ProtoOutputStream& proto, vector<uint8_t>* outData) {
+    size_t pos = outData->size();
+    outData->resize(pos + proto.size());
     sp<android::util::ProtoReader> reader = proto.data();
     while (reader->readBuffer() != NULL) {
         size_t toRead = reader->currentToRead();
@@ -132,6 +135,182 @@ static void flushProtoToBuffer(ProtoOutputStream& proto, vector<uint8_t>* outDat
     }
 }
 
+static void flushProtoToBuffer(ProtoOutputStream& proto, vector<uint8_t>* outData) {
+    outData->clear();
+    appendProtoToBuffer(proto, outData);
+}
+
+namespace {
+
+// Result of writing a report saved on disk to a ReportListSink.
+enum SavedReportWriteResult {
+    SAVED_REPORT_WRITTEN,
+    // The report could not be read, and nothing was written.
+    SAVED_REPORT_UNREADABLE,
+    SAVED_REPORT_WRITE_FAILED,
+};
+
+void writeReportHeader(size_t reportSize, ProtoOutputStream* header) {
+    header->writeLengthDelimitedHeader(FIELD_ID_REPORTS, reportSize);
+}
+
+size_t getReportHeaderSize(size_t reportSize) {
+    ProtoOutputStream header;
+    writeReportHeader(reportSize, &header);
+    return header.size();
+}
+
+// Destination of a ConfigMetricsReportList that is written one part at a time.
+class ReportListSink {
+public:
+    virtual ~ReportListSink() {
+    }
+
+    // Called once before the parts are written, with the size of the list if every saved report
+    // can be read.
+    virtual void reserve(size_t size) = 0;
+
+    virtual bool write(ProtoOutputStream& proto) = 0;
+
+    // Writes the report saved in the next size bytes of fd, with its header.
+    virtual SavedReportWriteResult writeSavedReport(int fd, size_t size) = 0;
+};
+
+// Writes the list to a buffer, which is only allocated once.
+class BufferReportListSink : public ReportListSink {
+public:
+    explicit BufferReportListSink(vector<uint8_t>* buffer) : mBuffer(buffer) {
+    }
+
+    void reserve(size_t size) override {
+        mBuffer->reserve(mBuffer->size() + size);
+    }
+
+    bool write(ProtoOutputStream& proto) override {
+        appendProtoToBuffer(proto, mBuffer);
+        return true;
+    }
+
+    SavedReportWriteResult writeSavedReport(int fd, size_t size) override {
+        // The report is read in place, and taken out again if the read fails.
+        const size_t headerPos = mBuffer->size();
+        ProtoOutputStream header;
+        writeReportHeader(size, &header);
+        appendProtoToBuffer(header, mBuffer);
+        const size_t pos = mBuffer->size();
+        mBuffer->resize(pos + size);
+        if (!android::base::ReadFully(fd, mBuffer->data() + pos, size)) {
+            mBuffer->resize(headerPos);
+            return SAVED_REPORT_UNREADABLE;
+        }
+        return SAVED_REPORT_WRITTEN;
+    }
+
+private:
+    vector<uint8_t>* const mBuffer;
+};
+
+// Writes the list to a file descriptor. Saved reports are read whole before their header is
+// written, since a partly written report would make the rest of the list unreadable.
+class FdReportListSink : public ReportListSink {
+public:
+    explicit FdReportListSink(int fd) : mFd(fd) {
+    }
+
+    void reserve(size_t size) override {
+    }
+
+    bool write(ProtoOutputStream& proto) override {
+        return proto.flush(mFd);
+    }
+
+    SavedReportWriteResult writeSavedReport(int fd, size_t size) override {
+        mSavedReport.resize(size);
+        if (!android::base::ReadFully(fd, mSavedReport.data(), size)) {
+            return SAVED_REPORT_UNREADABLE;
+        }
+        ProtoOutputStream header;
+        writeReportHeader(size, &header);
+        if (!header.flush(mFd) || !android::base::WriteFully(mFd, mSavedReport.data(), size)) {
+            return SAVED_REPORT_WRITE_FAILED;
+        }
+        return SAVED_REPORT_WRITTEN;
+    }
+
+private:
+    const int mFd;
+
+    // Reused for every saved report of the list.
+    vector<char> mSavedReport;
+};
+
+// Writes the ConfigMetricsReportList of a dump: the config key, the reports saved on disk and the
+// report of the data in memory, if any. Saved reports that can't be read are left out. Returns
+// the size of the list, or 0 if writing to the sink failed.
+size_t writeReportList(const ConfigKey& key, const vector<unique_fd>& savedReports,
+                       const StatsLogProcessor::ConfigMetricsReportWriter& writeReport,
+                       ReportListSink* sink) {
+    ProtoOutputStream configKey;
+    uint64_t configKeyToken = configKey.start(FIELD_TYPE_MESSAGE | FIELD_ID_CONFIG_KEY);
+    configKey.write(FIELD_TYPE_INT32 | FIELD_ID_UID, key.GetUid());
+    configKey.write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)key.GetId());
+    configKey.end(configKeyToken);
+
+    vector<std::pair<int, size_t>> savedReportSizes;
+    for (const unique_fd& fd : savedReports) {
+        struct stat fileStat;
+        if (fstat(fd.get(), &fileStat) != 0) {
+            ALOGE("Failed to stat a saved report of %s", key.ToString().c_str());
+            continue;
+        }
+        savedReportSizes.emplace_back(fd.get(), fileStat.st_size);
+    }
+
+    ProtoOutputStream report;
+    if (writeReport) {
+        writeReport(&report);
+    }
+
+    size_t size = configKey.size();
+    for (const auto& [fd, savedReportSize] : savedReportSizes) {
+        size += getReportHeaderSize(savedReportSize) + savedReportSize;
+    }
+    if (writeReport) {
+        size += getReportHeaderSize(report.size()) + report.size();
+    }
+    sink->reserve(size);
+
+    // A failed write would make the rest of the list unreadable.
+    if (!sink->write(configKey)) {
+        ALOGE("Failed to write the config key of %s", key.ToString().c_str());
+        return 0;
+    }
+    for (const auto& [fd, savedReportSize] : savedReportSizes) {
+        switch (sink->writeSavedReport(fd, savedReportSize)) {
+            case SAVED_REPORT_WRITTEN:
+                break;
+            case SAVED_REPORT_UNREADABLE:
+                ALOGE("Failed to read a saved report of %s", key.ToString().c_str());
+                size -= getReportHeaderSize(savedReportSize) + savedReportSize;
+                break;
+            case SAVED_REPORT_WRITE_FAILED:
+                ALOGE("Failed to write a saved report of %s", key.ToString().c_str());
+                return 0;
+        }
+    }
+    if (writeReport) {
+        ProtoOutputStream header;
+        writeReportHeader(report.size(), &header);
+        if (!sink->write(header) || !sink->write(report)) {
+            ALOGE("Failed to write the report of %s", key.ToString().c_str());
+            return 0;
+        }
+    }
+    return size;
+}
+
+}  // anonymous namespace
+
 void StatsLogProcessor::processFiredAnomalyAlarmsLocked(
         const int64_t& timestampNs,
         unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>& alarmSet) {
@@ -650,6 +829,49 @@ void StatsLogProcessor::dumpStates(int out, bool verbose) {
     fclose(fout);
 }
 
+bool StatsLogProcessor::prepareDumpReport(const ConfigKey& key, const int64_t dumpTimeStampNs,
+                                          const int64_t wallClockNs,
+                                          const bool include_current_partial_bucket,
+                                          const bool erase_data,
+                                          const DumpReportReason dumpReportReason,
+                                          const DumpLatency dumpLatency,
+                                          vector<unique_fd>* savedReports,
+                                          ConfigMetricsReportWriter* writeReport) {
+    std::lock_guard<std::mutex> lock(mMetricsMutex);
+
+    auto it = mMetricsManagers.find(key);
+    if (it != mMetricsManagers.end() && it->second->hasRestrictedMetricsDelegate()) {
+        VLOG("Unexpected call to StatsLogProcessor::onDumpReport for restricted metrics.");
+        return false;
+    }
+
+    bool keepFile = false;
+    if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
+        keepFile = true;
+    }
+
+    // Then, check stats-data directory to see there's any file containing
+    // ConfigMetricsReport from previous shutdowns to concatenate to reports.
+    // The files are opened under the lock, since WriteDataToDisk may be writing a file of this
+    // config. They are read after the lock is released.
+    *savedReports = StorageManager::openConfigMetricsReports(
+            key, erase_data && !keepFile /* should remove file after appending it */,
+            dumpReportReason == ADB_DUMP /*if caller is adb*/);
+
+    if (it == mMetricsManagers.end()) {
+        ALOGW("Config source %s does not exist", key.ToString().c_str());
+        return true;
+    }
+    // This allows another broadcast to be sent within the rate-limit period if we get close to
+    // filling the buffer again soon.
+    mLastBroadcastTimes.erase(key);
+
+    *writeReport = prepareConfigMetricsReportLocked(
+            key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
+            dumpReportReason, dumpLatency, false /* is this data going to be saved on disk */);
+    return true;
+}
+
 /*
  * onDumpReport dumps serialized ConfigMetricsReportList into proto.
  */
@@ -658,11 +880,11 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const bool erase_data, const DumpReportReason dumpReportReason,
                                      const DumpLatency dumpLatency, ProtoOutputStream* proto) {
-    std::lock_guard<std::mutex> lock(mMetricsMutex);
-
-    auto it = mMetricsManagers.find(key);
-    if (it != mMetricsManagers.end() && it->second->hasRestrictedMetricsDelegate()) {
-        VLOG("Unexpected call to StatsLogProcessor::onDumpReport for restricted metrics.");
+    vector<unique_fd> savedReports;
+    ConfigMetricsReportWriter writeReport;
+    if (!prepareDumpReport(key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
+                           erase_data, dumpReportReason, dumpLatency, &savedReports,
+                           &writeReport)) {
         return;
     }
 
@@ -673,31 +895,22 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
     proto->end(configKeyToken);
     // End of ConfigKey.
 
-    bool keepFile = false;
-    if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
-        keepFile = true;
+    for (const unique_fd& fd : savedReports) {
+        string content;
+        if (android::base::ReadFdToString(fd.get(), &content)) {
+            proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
+                         content.c_str(), content.size());
+        }
     }
 
-    // Then, check stats-data directory to see there's any file containing
-    // ConfigMetricsReport from previous shutdowns to concatenate to reports.
-    StorageManager::appendConfigMetricsReport(
-            key, proto, erase_data && !keepFile /* should remove file after appending it */,
-            dumpReportReason == ADB_DUMP /*if caller is adb*/);
-
-    if (it != mMetricsManagers.end()) {
-        // This allows another broadcast to be sent within the rate-limit period if we get close to
-        // filling the buffer again soon.
-        mLastBroadcastTimes.erase(key);
-
+    // The report is serialized after the lock is released, so that events keep being processed.
+    if (writeReport) {
+        ProtoOutputStream report;
+        writeReport(&report);
         vector<uint8_t> buffer;
-        onConfigMetricsReportLocked(key, dumpTimeStampNs, wallClockNs,
-                                    include_current_partial_bucket, erase_data, dumpReportReason,
-                                    dumpLatency, false /* is this data going to be saved on disk */,
-                                    &buffer);
+        flushProtoToBuffer(report, &buffer);
         proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
                      reinterpret_cast<char*>(buffer.data()), buffer.size());
-    } else {
-        ALOGW("Config source %s does not exist", key.ToString().c_str());
     }
 }
 
@@ -709,16 +922,47 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
                                      const bool include_current_partial_bucket,
                                      const bool erase_data, const DumpReportReason dumpReportReason,
                                      const DumpLatency dumpLatency, vector<uint8_t>* outData) {
-    ProtoOutputStream proto;
-    onDumpReport(key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
-                 dumpReportReason, dumpLatency, &proto);
+    vector<uint8_t> unusedData;
+    if (outData == nullptr) {
+        outData = &unusedData;
+    }
+    outData->clear();
+
+    vector<unique_fd> savedReports;
+    ConfigMetricsReportWriter writeReport;
+    size_t size = 0;
+    if (prepareDumpReport(key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
+                          erase_data, dumpReportReason, dumpLatency, &savedReports,
+                          &writeReport)) {
+        // The parts of the list are written to outData directly.
+        BufferReportListSink sink(outData);
+        size = writeReportList(key, savedReports, writeReport, &sink);
+    }
+    VLOG("output data size %zu", outData->size());
 
-    if (outData != nullptr) {
-        flushProtoToBuffer(proto, outData);
-        VLOG("output data size %zu", outData->size());
+    StatsdStats::getInstance().noteMetricsReportSent(key, size);
+}
+
+/*
+ * onDumpReport writes serialized ConfigMetricsReportList to outFd.
+ */
+void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTimeStampNs,
+                                     const int64_t wallClockNs,
+                                     const bool include_current_partial_bucket,
+                                     const bool erase_data, const DumpReportReason dumpReportReason,
+                                     const DumpLatency dumpLatency, const int outFd) {
+    vector<unique_fd> savedReports;
+    ConfigMetricsReportWriter writeReport;
+    size_t size = 0;
+    if (prepareDumpReport(key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
+                          erase_data, dumpReportReason, dumpLatency, &savedReports,
+                          &writeReport)) {
+        FdReportListSink sink(outFd);
+        size = writeReportList(key, savedReports, writeReport, &sink);
     }
+    VLOG("output data size %zu", size);
 
-    StatsdStats::getInstance().noteMetricsReportSent(key, proto.size());
+    StatsdStats::getInstance().noteMetricsReportSent(key, size);
 }
 
 /*
@@ -741,65 +985,93 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
         const bool include_current_partial_bucket, const bool erase_data,
         const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
         const bool dataSavedOnDisk, vector<uint8_t>* buffer) {
+    ConfigMetricsReportWriter writeReport = prepareConfigMetricsReportLocked(
+            key, dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data,
+            dumpReportReason, dumpLatency, dataSavedOnDisk);
+    if (writeReport) {
+        ProtoOutputStream report;
+        writeReport(&report);
+        flushProtoToBuffer(report, buffer);
+    }
+}
+
+StatsLogProcessor::ConfigMetricsReportWriter StatsLogProcessor::prepareConfigMetricsReportLocked(
+        const ConfigKey& key, const int64_t dumpTimeStampNs, const int64_t wallClockNs,
+        const bool include_current_partial_bucket, const bool erase_data,
+        const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+        const bool dataSavedOnDisk) {
     // We already checked whether key exists in mMetricsManagers in
     // WriteDataToDisk.
     auto it = mMetricsManagers.find(key);
     if (it == mMetricsManagers.end()) {
-        return;
+        return nullptr;
     }
     if (it->second->hasRestrictedMetricsDelegate()) {
         VLOG("Unexpected call to StatsLogProcessor::onConfigMetricsReportLocked for restricted "
              "metrics.");
         // Do not call onDumpReport for restricted metrics.
-        return;
+        return nullptr;
     }
-    int64_t lastReportTimeNs = it->second->getLastReportTimeNs();
-    int64_t lastReportWallClockNs = it->second->getLastReportWallClockNs();
+    const sp<MetricsManager>& metricsManager = it->second;
+    int64_t lastReportTimeNs = metricsManager->getLastReportTimeNs();
+    int64_t lastReportWallClockNs = metricsManager->getLastReportWallClockNs();
 
-    std::set<string> str_set;
+    // Take the data of the StatsLogReport's out of the metrics.
+    DumpReportWriter writeMetricsReports = metricsManager->prepareDumpReport(
+            dumpTimeStampNs, wallClockNs, include_current_partial_bucket, erase_data, dumpLatency);
 
-    ProtoOutputStream tempProto;
-    // First, fill in ConfigMetricsReport using current data on memory, which
-    // starts from filling in StatsLogReport's.
-    it->second->onDumpReport(dumpTimeStampNs, wallClockNs, include_current_partial_bucket,
-                             erase_data, dumpLatency, &str_set, &tempProto);
-
-    // Fill in UidMap if there is at least one metric to report.
     // This skips the uid map if it's an empty config.
-    if (it->second->getNumMetrics() > 0) {
-        uint64_t uidMapToken = tempProto.start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
-        mUidMap->appendUidMap(dumpTimeStampNs, key, it->second->versionStringsInReport(),
-                              it->second->installerInReport(),
-                              it->second->packageCertificateHashSizeBytes(),
-                              it->second->hashStringInReport() ? &str_set : nullptr, &tempProto);
-        tempProto.end(uidMapToken);
-    }
-
-    // Fill in the timestamps.
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
-                    (long long)lastReportTimeNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
-                    (long long)dumpTimeStampNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
-                    (long long)lastReportWallClockNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
-                    (long long)wallClockNs);
-    // Dump report reason
-    tempProto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
-
-    for (const auto& str : str_set) {
-        tempProto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
-    }
+    const bool writeUidMap = metricsManager->getNumMetrics() > 0;
+    const bool saveHistory =
+            erase_data && !dataSavedOnDisk && metricsManager->shouldPersistLocalHistory();
+
+    return [key, dumpTimeStampNs, wallClockNs, dumpReportReason, lastReportTimeNs,
+            lastReportWallClockNs, writeMetricsReports, writeUidMap, saveHistory,
+            uidMap = mUidMap, versionStringsInReport = metricsManager->versionStringsInReport(),
+            installerInReport = metricsManager->installerInReport(),
+            packageCertificateHashSizeBytes = metricsManager->packageCertificateHashSizeBytes(),
+            hashStringInReport = metricsManager->hashStringInReport()](ProtoOutputStream* report) {
+        std::set<string> str_set;
+
+        // First, fill in ConfigMetricsReport using current data on memory, which
+        // starts from filling in StatsLogReport's.
+        writeMetricsReports(&str_set, report);
+
+        // Fill in UidMap if there is at least one metric to report. The UidMap has its own lock.
+        if (writeUidMap) {
+            uint64_t uidMapToken = report->start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
+            uidMap->appendUidMap(dumpTimeStampNs, key, versionStringsInReport, installerInReport,
+                                 packageCertificateHashSizeBytes,
+                                 hashStringInReport ? &str_set : nullptr, report);
+            report->end(uidMapToken);
+        }
 
-    flushProtoToBuffer(tempProto, buffer);
+        // Fill in the timestamps.
+        report->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
+                      (long long)lastReportTimeNs);
+        report->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
+                      (long long)dumpTimeStampNs);
+        report->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
+                      (long long)lastReportWallClockNs);
+        report->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
+                      (long long)wallClockNs);
+        // Dump report reason
+        report->write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
+
+        for (const auto& str : str_set) {
+            report->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
+        }
 
-    // save buffer to disk if needed
-    if (erase_data && !dataSavedOnDisk && it->second->shouldPersistLocalHistory()) {
-        VLOG("save history to disk");
-        string file_name = StorageManager::getDataHistoryFileName((long)getWallClockSec(),
-                                                                  key.GetUid(), key.GetId());
-        StorageManager::writeFile(file_name.c_str(), buffer->data(), buffer->size());
-    }
+        // save buffer to disk if needed
+        if (saveHistory) {
+            VLOG("save history to disk");
+            vector<uint8_t> buffer;
+            flushProtoToBuffer(*report, &buffer);
+            string file_name = StorageManager::getDataHistoryFileName(
+                    (long)getWallClockSec(), key.GetUid(), key.GetId());
+            StorageManager::writeFile(file_name.c_str(), buffer.data(), buffer.size());
+        }
+    };
 }
 
 void StatsLogProcessor::resetConfigsLocked(const int64_t timestampNs,
@@ -1483,12 +1755,24 @@ void StatsLogProcessor::updateLogEventFilterLocked() const {
         return;
     }
     LogEventFilter::AtomIdSet allAtomIds = getDefaultAtomIdSet();
+    LogEventFilter::AtomIdSet bodyAtomIds = getDefaultAtomIdSet();
     for (const auto& metricsManager : mMetricsManagers) {
         metricsManager.second->addAllAtomIds(allAtomIds);
+        metricsManager.second->addBodyAtomIds(bodyAtomIds);
     }
     StateManager::getInstance().addAllAtomIds(allAtomIds);
-    VLOG("StatsLogProcessor: Updating allAtomIds done. Total atoms %d", (int)allAtomIds.size());
-    mLogEventFilter->setAtomIds(std::move(allAtomIds), this);
+    StateManager::getInstance().addAllAtomIds(bodyAtomIds);
+
+    // Atoms that every config only counts do not need their body parsed.
+    LogEventFilter::AtomIdSet headerOnlyAtomIds;
+    for (const int atomId : allAtomIds) {
+        if (bodyAtomIds.find(atomId) == bodyAtomIds.end()) {
+            headerOnlyAtomIds.insert(atomId);
+        }
+    }
+    VLOG("StatsLogProcessor: Updating allAtomIds done. Total atoms %d, header only %d",
+         (int)allAtomIds.size(), (int)headerOnlyAtomIds.size());
+    mLogEventFilter->setAtomIds(std::move(allAtomIds), std::move(headerOnlyAtomIds), this);
 }
 
 }  // namespace statsd
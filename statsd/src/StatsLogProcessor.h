@@ -17,9 +17,11 @@
 #pragma once
 
 #include <aidl/android/os/BnStatsd.h>
+#include <android-base/unique_fd.h>
 #include <gtest/gtest_prod.h>
 #include <stdio.h>
 
+#include <functional>
 #include <unordered_map>
 
 #include "config/ConfigListener.h"
@@ -70,12 +72,21 @@ public:
                       const bool include_current_partial_bucket, const bool erase_data,
                       const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
                       ProtoOutputStream* proto);
+    // Writes the report to outFd as it is serialized. The reports saved on disk are copied to
+    // outFd without being read into memory.
+    void onDumpReport(const ConfigKey& key, const int64_t dumpTimeNs, const int64_t wallClockNs,
+                      const bool include_current_partial_bucket, const bool erase_data,
+                      const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+                      const int outFd);
     // For testing only.
     void onDumpReport(const ConfigKey& key, const int64_t dumpTimeNs,
                       const bool include_current_partial_bucket, const bool erase_data,
                       const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
                       vector<uint8_t>* outData);
 
+    // Writes the fields of a ConfigMetricsReport to an empty proto.
+    using ConfigMetricsReportWriter = std::function<void(ProtoOutputStream* report)>;
+
     /* Tells MetricsManager that the alarms in alarmSet have fired. Modifies periodic alarmSet. */
     void onPeriodicAlarmFired(
             const int64_t& timestampNs,
@@ -255,6 +266,17 @@ private:
                                const int64_t wallClockNs, const DumpReportReason dumpReportReason,
                                const DumpLatency dumpLatency);
 
+    // Takes what a dump report of the config needs out of the processor, under mMetricsMutex.
+    // Returns false if the config is not dumped this way, e.g. restricted configs. Otherwise,
+    // savedReports has the reports saved on disk, and writeReport writes the report of the data
+    // in memory, or is empty if the config does not exist.
+    bool prepareDumpReport(const ConfigKey& key, const int64_t dumpTimeNs,
+                           const int64_t wallClockNs, const bool include_current_partial_bucket,
+                           const bool erase_data, const DumpReportReason dumpReportReason,
+                           const DumpLatency dumpLatency,
+                           vector<android::base::unique_fd>* savedReports,
+                           ConfigMetricsReportWriter* writeReport);
+
     void onConfigMetricsReportLocked(
             const ConfigKey& key, const int64_t dumpTimeStampNs, const int64_t wallClockNs,
             const bool include_current_partial_bucket, const bool erase_data,
@@ -263,6 +285,14 @@ private:
              (e.g., before reboot). So no need to further persist local history.*/
             const bool dataSavedToDisk, vector<uint8_t>* proto);
 
+    // Same as onConfigMetricsReportLocked, in two steps. The returned function writes the report
+    // and does not need mMetricsMutex. Returns an empty function if there is nothing to report.
+    ConfigMetricsReportWriter prepareConfigMetricsReportLocked(
+            const ConfigKey& key, const int64_t dumpTimeStampNs, const int64_t wallClockNs,
+            const bool include_current_partial_bucket, const bool erase_data,
+            const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+            const bool dataSavedToDisk);
+
     /* Check if it is time enforce data ttls for restricted metrics, and if it is, enforce ttls
      * on all restricted metrics. */
     void enforceDataTtlsIfNecessaryLocked(const int64_t wallClockNs,
@@ -371,6 +401,8 @@ private:
     FRIEND_TEST(StatsLogProcessorTest, TestRateLimitBroadcast);
     FRIEND_TEST(StatsLogProcessorTest, TestDropWhenByteSizeTooLarge);
     FRIEND_TEST(StatsLogProcessorTest, InvalidConfigRemoved);
+    FRIEND_TEST(StatsLogProcessorTest, TestOnDumpReportToFd);
+    FRIEND_TEST(StatsLogProcessorTest, TestOnDumpReportSkipsUnreadableSavedReport);
     FRIEND_TEST(StatsLogProcessorTest, TestActiveConfigMetricDiskWriteRead);
     FRIEND_TEST(StatsLogProcessorTest, TestActivationOnBoot);
     FRIEND_TEST(StatsLogProcessorTest, TestActivationOnBootMultipleActivations);
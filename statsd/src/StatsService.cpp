@@ -241,6 +241,22 @@ StatsService::~StatsService() {
     }
 }
 
+int64_t StatsService::noteDumpReportStarted() {
+    if (mEventQueue != nullptr) {
+        mEventQueue->noteDumpStarted();
+    }
+    return getLifetimePeakRssKb();
+}
+
+void StatsService::noteDumpReportFinished(const int64_t startLifetimePeakRssKb) {
+    if (mEventQueue != nullptr) {
+        StatsdStats::getInstance().noteDumpReportQueueSize(mEventQueue->noteDumpFinished());
+    }
+    const int64_t lifetimePeakRssKb = getLifetimePeakRssKb();
+    StatsdStats::getInstance().noteDumpReportLifetimePeakRss(
+            lifetimePeakRssKb, lifetimePeakRssKb - startLifetimePeakRssKb);
+}
+
 /* Runs on a dedicated thread to process pushed events. */
 void StatsService::readLogs() {
     // Read forever..... long live statsd
@@ -347,9 +363,11 @@ void StatsService::dumpIncidentSection(int out) {
         // Don't include the current bucket to avoid skipping buckets.
         // If we need to include the current bucket later, consider changing to NO_TIME_CONSTRAINTS
         // or other alternatives to avoid skipping buckets for pulled metrics.
+        const int64_t startLifetimePeakRssKb = noteDumpReportStarted();
         mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(), getWallClockNs(),
                                  false /* includeCurrentBucket */, false /* erase_data */, ADB_DUMP,
                                  FAST, &proto);
+        noteDumpReportFinished(startLifetimePeakRssKb);
         proto.end(reportsListToken);
         proto.flush(out);
         proto.clear();
@@ -757,17 +775,20 @@ status_t StatsService::cmd_dump_report(int out, const Vector<String8>& args) {
             name.assign(args[2].c_str(), args[2].size());
         }
         if (good) {
-            vector<uint8_t> data;
-            mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
-                                     getWallClockNs(), includeCurrentBucket, eraseData, ADB_DUMP,
-                                     NO_TIME_CONSTRAINTS, &data);
+            const int64_t startLifetimePeakRssKb = noteDumpReportStarted();
             if (proto) {
-                for (size_t i = 0; i < data.size(); i ++) {
-                    dprintf(out, "%c", data[i]);
-                }
+                // The report is written to out as it is serialized.
+                mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
+                                         getWallClockNs(), includeCurrentBucket, eraseData,
+                                         ADB_DUMP, NO_TIME_CONSTRAINTS, out);
             } else {
+                vector<uint8_t> data;
+                mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
+                                         getWallClockNs(), includeCurrentBucket, eraseData,
+                                         ADB_DUMP, NO_TIME_CONSTRAINTS, &data);
                 dprintf(out, "Non-proto stats data dump not currently supported.\n");
             }
+            noteDumpReportFinished(startLifetimePeakRssKb);
             return android::OK;
         } else {
             // If arg parsing failed, print the help text and return an error.
@@ -1194,9 +1215,11 @@ Status StatsService::getData(int64_t key, const int32_t callingUid, vector<uint8
     ConfigKey configKey(callingUid, key);
     // The dump latency does not matter here since we do not include the current bucket, we do not
     // need to pull any new data anyhow.
+    const int64_t startLifetimePeakRssKb = noteDumpReportStarted();
     mProcessor->onDumpReport(configKey, getElapsedRealtimeNs(), getWallClockNs(),
                              false /* include_current_bucket*/, true /* erase_data */,
                              GET_DATA_CALLED, FAST, output);
+    noteDumpReportFinished(startLifetimePeakRssKb);
     return Status::ok();
 }
 
@@ -1345,6 +1368,24 @@ Status StatsService::registerNativePullAtomCallback(
     return Status::ok();
 }
 
+Status StatsService::registerNativeDeltaPullAtomCallback(
+        int32_t atomTag, int64_t coolDownMillis, int64_t timeoutMillis,
+        const std::vector<int32_t>& additiveFields, const std::vector<int32_t>& keyFields,
+        const shared_ptr<IDeltaPullAtomCallback>& pullerCallback) {
+    if (!checkPermission(kPermissionRegisterPullAtom)) {
+        return exception(
+                EX_SECURITY,
+                StringPrintf("Uid %d does not have the %s permission when registering atom %d",
+                             AIBinder_getCallingUid(), kPermissionRegisterPullAtom, atomTag));
+    }
+    VLOG("StatsService::registerNativeDeltaPullAtomCallback called.");
+    int32_t uid = AIBinder_getCallingUid();
+    mPullerManager->RegisterDeltaPullAtomCallback(uid, atomTag, MillisToNano(coolDownMillis),
+                                                  MillisToNano(timeoutMillis), additiveFields,
+                                                  keyFields, pullerCallback);
+    return Status::ok();
+}
+
 Status StatsService::unregisterPullAtomCallback(int32_t uid, int32_t atomTag) {
     ENFORCE_UID(AID_SYSTEM);
     VLOG("StatsService::unregisterPullAtomCallback called.");
@@ -19,6 +19,7 @@
 
 #include <aidl/android/os/BnStatsd.h>
 #include <aidl/android/os/IPendingIntentRef.h>
+#include <aidl/android/os/IDeltaPullAtomCallback.h>
 #include <aidl/android/os/IPullAtomCallback.h>
 #include <aidl/android/os/IStatsSubscriptionCallback.h>
 #include <aidl/android/util/PropertyParcel.h>
@@ -45,6 +46,7 @@ using ::ndk::SpAIBinder;
 using Status = ::ndk::ScopedAStatus;
 using aidl::android::os::BnStatsd;
 using aidl::android::os::IPendingIntentRef;
+using aidl::android::os::IDeltaPullAtomCallback;
 using aidl::android::os::IPullAtomCallback;
 using aidl::android::os::IStatsQueryCallback;
 using aidl::android::os::IStatsSubscriptionCallback;
@@ -190,6 +192,15 @@ public:
             const vector<int32_t>& additiveFields,
             const shared_ptr<IPullAtomCallback>& pullerCallback) override;
 
+    /**
+     * Binder call to register a callback function for a pulled atom that only returns the rows
+     * that changed since the previous pull.
+     */
+    virtual Status registerNativeDeltaPullAtomCallback(
+            int32_t atomTag, int64_t coolDownMillis, int64_t timeoutMillis,
+            const vector<int32_t>& additiveFields, const vector<int32_t>& keyFields,
+            const shared_ptr<IDeltaPullAtomCallback>& pullerCallback) override;
+
     /**
      * Binder call to unregister any existing callback for the given uid and atom.
      */
@@ -287,6 +298,15 @@ private:
     /* Runs on its dedicated thread to process pushed stats event from socket. */
     void readLogs();
 
+    /**
+     * Track the size of the event queue while a dump report is built, and whether the dump raised
+     * the lifetime peak memory of statsd, and report them to StatsdStats when it is done.
+     * noteDumpReportStarted() returns the lifetime peak RSS before the dump, to pass to
+     * noteDumpReportFinished().
+     */
+    int64_t noteDumpReportStarted();
+    void noteDumpReportFinished(const int64_t startLifetimePeakRssKb);
+
     /**
      * Trigger a broadcast.
      */
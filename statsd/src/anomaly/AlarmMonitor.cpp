@@ -45,9 +45,8 @@ void AlarmMonitor::setStatsCompanionService(
         return;
     }
     VLOG("Creating link to statsCompanionService");
-    const sp<const InternalAlarm> top = mPq.top();
-    if (top != nullptr) {
-        updateRegisteredAlarmTime_l(top->timestampSec);
+    if (!mAlarms.empty()) {
+        updateRegisteredAlarmTime_l(mAlarms.soonestTimestampSec());
     }
 }
 
@@ -64,7 +63,9 @@ void AlarmMonitor::add(sp<const InternalAlarm> alarm) {
     }
     // TODO(b/110563466): Ensure that refractory period is respected.
     VLOG("Adding alarm with time %u", alarm->timestampSec);
-    mPq.push(alarm);
+    if (!mAlarms.add(alarm)) {
+        return;
+    }
     if (mRegisteredAlarmTimeSec < 1 ||
         alarm->timestampSec + mMinUpdateTimeSec < mRegisteredAlarmTimeSec) {
         updateRegisteredAlarmTime_l(alarm->timestampSec);
@@ -78,41 +79,42 @@ void AlarmMonitor::remove(sp<const InternalAlarm> alarm) {
         return;
     }
     VLOG("Removing alarm with time %u", alarm->timestampSec);
-    bool wasPresent = mPq.remove(alarm);
+    bool wasPresent = mAlarms.remove(alarm);
     if (!wasPresent) return;
-    if (mPq.empty()) {
+    if (mAlarms.empty()) {
         VLOG("Queue is empty. Cancel any alarm.");
         cancelRegisteredAlarmTime_l();
         return;
     }
-    uint32_t soonestAlarmTimeSec = mPq.top()->timestampSec;
+    // The soonest alarm is never later than mRegisteredAlarmTimeSec + mMinUpdateTimeSec, so
+    // removing a later alarm cannot change the registered alarm.
+    if (alarm->timestampSec > mRegisteredAlarmTimeSec + mMinUpdateTimeSec) {
+        return;
+    }
+    uint32_t soonestAlarmTimeSec = mAlarms.soonestTimestampSec();
     VLOG("Soonest alarm is %u", soonestAlarmTimeSec);
     if (soonestAlarmTimeSec > mRegisteredAlarmTimeSec + mMinUpdateTimeSec) {
         updateRegisteredAlarmTime_l(soonestAlarmTimeSec);
     }
 }
 
-// More efficient than repeatedly calling remove(mPq.top()) since it batches the
-// updates to the registered alarm.
+// More efficient than repeatedly removing the soonest alarm since it sweeps the timer wheel once
+// and batches the updates to the registered alarm.
 unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> AlarmMonitor::popSoonerThan(
         uint32_t timestampSec) {
     VLOG("Removing alarms with time <= %u", timestampSec);
     unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>> oldAlarms;
     std::lock_guard<std::mutex> lock(mLock);
 
-    for (sp<const InternalAlarm> t = mPq.top(); t != nullptr && t->timestampSec <= timestampSec;
-        t = mPq.top()) {
-        oldAlarms.insert(t);
-        mPq.pop();  // remove t
-    }
+    mAlarms.popSoonerThan(timestampSec, &oldAlarms);
     // Always update registered alarm time (if anything has changed).
     if (!oldAlarms.empty()) {
-        if (mPq.empty()) {
+        if (mAlarms.empty()) {
             VLOG("Queue is empty. Cancel any alarm.");
             cancelRegisteredAlarmTime_l();
         } else {
             // Always update the registered alarm in this case (unlike remove()).
-            updateRegisteredAlarmTime_l(mPq.top()->timestampSec);
+            updateRegisteredAlarmTime_l(mAlarms.soonestTimestampSec());
         }
     }
     return oldAlarms;
@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include "anomaly/AlarmTimerWheel.h"
 #include "anomaly/indexed_priority_queue.h"
 
 #include <aidl/android/os/IStatsCompanionService.h>
@@ -47,6 +48,13 @@ struct InternalAlarm : public RefBase {
 
     const uint32_t timestampSec;
 
+    // Links of the alarm in the AlarmTimerWheel that holds it, if any. Only that wheel reads or
+    // writes them, under the lock of its owner.
+    mutable const AlarmTimerWheel* wheel = nullptr;
+    mutable const InternalAlarm* wheelPrev = nullptr;
+    mutable const InternalAlarm* wheelNext = nullptr;
+    mutable uint16_t wheelSlot = 0;
+
     /** InternalAlarm a is smaller (higher priority) than b if its timestamp is sooner. */
     struct SmallerTimestamp {
         bool operator()(sp<const InternalAlarm> a, sp<const InternalAlarm> b) const {
@@ -113,15 +121,15 @@ private:
     /**
      * Timestamp (seconds since epoch) of the alarm registered with
      * StatsCompanionService. This, in general, may not be equal to the soonest
-     * alarm stored in mPq, but should be within minUpdateTimeSec of it.
+     * alarm stored in mAlarms, but should be within minUpdateTimeSec of it.
      * A value of 0 indicates that no alarm is currently registered.
      */
     uint32_t mRegisteredAlarmTimeSec;
 
     /**
-     * Priority queue of alarms, prioritized by soonest alarm.timestampSec.
+     * Timer wheel of alarms, ordered by alarm.timestampSec.
      */
-    indexed_priority_queue<InternalAlarm, InternalAlarm::SmallerTimestamp> mPq;
+    AlarmTimerWheel mAlarms;
 
     /**
      * Binder interface for communicating with StatsCompanionService.
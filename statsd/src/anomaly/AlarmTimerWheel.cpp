@@ -0,0 +1,188 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "anomaly/AlarmTimerWheel.h"
+
+#include <algorithm>
+
+#include "anomaly/AlarmMonitor.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::unordered_set;
+
+AlarmTimerWheel::AlarmTimerWheel() : mNowSec(0), mSlots(), mOccupied(), mSize(0) {
+}
+
+AlarmTimerWheel::~AlarmTimerWheel() {
+    for (const InternalAlarm* head : mSlots) {
+        while (head != nullptr) {
+            const InternalAlarm* alarm = head;
+            head = alarm->wheelNext;
+            alarm->wheel = nullptr;
+            alarm->wheelPrev = nullptr;
+            alarm->wheelNext = nullptr;
+            alarm->decStrong(this);
+        }
+    }
+}
+
+bool AlarmTimerWheel::add(const sp<const InternalAlarm>& alarm) {
+    if (alarm == nullptr || alarm->wheel != nullptr) {
+        return false;
+    }
+    alarm->incStrong(this);
+    alarm->wheel = this;
+    link(alarm.get());
+    mSize++;
+    return true;
+}
+
+bool AlarmTimerWheel::remove(const sp<const InternalAlarm>& alarm) {
+    if (alarm == nullptr || alarm->wheel != this) {
+        return false;
+    }
+    unlink(alarm.get());
+    alarm->wheel = nullptr;
+    mSize--;
+    alarm->decStrong(this);
+    return true;
+}
+
+void AlarmTimerWheel::popSoonerThan(uint32_t timestampSec,
+                                    unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>*
+                                            alarms) {
+    while (mSize > 0) {
+        const int level = lowestOccupiedLevel();
+        const int slot = __builtin_ctzll(mOccupied[level]);
+        const uint32_t startSec = slotStartSec(level, slot);
+        if (level > 0) {
+            if (startSec > timestampSec) {
+                return;
+            }
+            // The current time reaches the slot, so its alarms move to lower levels.
+            mNowSec = startSec;
+            const InternalAlarm* alarm = mSlots[level * kSlotsPerLevel + slot];
+            mSlots[level * kSlotsPerLevel + slot] = nullptr;
+            mOccupied[level] &= ~(1ULL << slot);
+            while (alarm != nullptr) {
+                const InternalAlarm* next = alarm->wheelNext;
+                link(alarm);
+                alarm = next;
+            }
+            continue;
+        }
+
+        // Alarms that were added in the past share the slot of mNowSec, so that slot may hold
+        // due alarms even if mNowSec is later than timestampSec.
+        if (startSec > timestampSec && startSec != mNowSec) {
+            return;
+        }
+        const InternalAlarm* alarm = mSlots[slot];
+        while (alarm != nullptr) {
+            const InternalAlarm* next = alarm->wheelNext;
+            if (alarm->timestampSec <= timestampSec) {
+                unlink(alarm);
+                alarm->wheel = nullptr;
+                mSize--;
+                alarms->insert(alarm);
+                alarm->decStrong(this);
+            }
+            alarm = next;
+        }
+        if (startSec > timestampSec) {
+            return;
+        }
+        mNowSec = startSec;
+    }
+}
+
+uint32_t AlarmTimerWheel::soonestTimestampSec() const {
+    if (mSize == 0) {
+        return 0;
+    }
+    // The lowest occupied slot holds the soonest alarms. Apart from level 0, its alarms may have
+    // different timestamps.
+    const int level = lowestOccupiedLevel();
+    const int slot = __builtin_ctzll(mOccupied[level]);
+    uint32_t soonestSec = UINT32_MAX;
+    for (const InternalAlarm* alarm = mSlots[level * kSlotsPerLevel + slot]; alarm != nullptr;
+         alarm = alarm->wheelNext) {
+        soonestSec = std::min(soonestSec, alarm->timestampSec);
+    }
+    return soonestSec;
+}
+
+void AlarmTimerWheel::link(const InternalAlarm* alarm) {
+    int level = 0;
+    int slot = mNowSec & (kSlotsPerLevel - 1);
+    if (alarm->timestampSec > mNowSec) {
+        const int highestDifferentBit = 31 - __builtin_clz(alarm->timestampSec ^ mNowSec);
+        level = highestDifferentBit / kBitsPerLevel;
+        slot = (alarm->timestampSec >> (level * kBitsPerLevel)) & (kSlotsPerLevel - 1);
+    }
+    const int index = level * kSlotsPerLevel + slot;
+    alarm->wheelSlot = index;
+    alarm->wheelPrev = nullptr;
+    alarm->wheelNext = mSlots[index];
+    if (mSlots[index] != nullptr) {
+        mSlots[index]->wheelPrev = alarm;
+    }
+    mSlots[index] = alarm;
+    mOccupied[level] |= 1ULL << slot;
+}
+
+void AlarmTimerWheel::unlink(const InternalAlarm* alarm) {
+    const int index = alarm->wheelSlot;
+    if (alarm->wheelPrev != nullptr) {
+        alarm->wheelPrev->wheelNext = alarm->wheelNext;
+    } else {
+        mSlots[index] = alarm->wheelNext;
+    }
+    if (alarm->wheelNext != nullptr) {
+        alarm->wheelNext->wheelPrev = alarm->wheelPrev;
+    }
+    alarm->wheelPrev = nullptr;
+    alarm->wheelNext = nullptr;
+    if (mSlots[index] == nullptr) {
+        mOccupied[index / kSlotsPerLevel] &= ~(1ULL << (index % kSlotsPerLevel));
+    }
+}
+
+int AlarmTimerWheel::lowestOccupiedLevel() const {
+    int level = 0;
+    while (level < kNumLevels && mOccupied[level] == 0) {
+        level++;
+    }
+    return level;
+}
+
+uint32_t AlarmTimerWheel::slotStartSec(int level, int slot) const {
+    const int shift = level * kBitsPerLevel;
+    // Keeps the bits of mNowSec above the level, which the alarms in the slot share.
+    const uint64_t higherBits = ((uint64_t)mNowSec >> (shift + kBitsPerLevel))
+                                << (shift + kBitsPerLevel);
+    return static_cast<uint32_t>(higherBits | ((uint64_t)slot << shift));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtest/gtest_prod.h>
+#include <utils/RefBase.h>
+
+#include <unordered_set>
+
+#include "anomaly/indexed_priority_queue.h"  // SpHash
+
+namespace android {
+namespace os {
+namespace statsd {
+
+struct InternalAlarm;
+
+/**
+ * Hierarchical timer wheel of InternalAlarms, keyed by their timestampSec.
+ *
+ * The wheel has kNumLevels levels of kSlotsPerLevel slots. Level l holds the alarms whose
+ * timestamp first differs from the wheel's current time in the l-th group of kBitsPerLevel bits,
+ * in the slot given by that group. Each slot is an intrusive list threaded through the alarms, so
+ * adding and removing an alarm is O(1) and allocates nothing. Popping the due alarms sweeps the
+ * occupied slots in time order, moving the alarms of a higher level slot down once the current
+ * time reaches it.
+ *
+ * An alarm can only be in one wheel at a time. The wheel holds a strong reference to each of its
+ * alarms. Not thread-safe.
+ */
+class AlarmTimerWheel {
+public:
+    AlarmTimerWheel();
+    ~AlarmTimerWheel();
+
+    AlarmTimerWheel(const AlarmTimerWheel&) = delete;
+    AlarmTimerWheel& operator=(const AlarmTimerWheel&) = delete;
+
+    /** Adds alarm. Returns false, and does nothing, if alarm is already in a wheel. */
+    bool add(const sp<const InternalAlarm>& alarm);
+
+    /** Removes alarm. Returns false, and does nothing, if alarm is not in this wheel. */
+    bool remove(const sp<const InternalAlarm>& alarm);
+
+    /** Removes all alarms whose timestamp <= timestampSec and inserts them into alarms. */
+    void popSoonerThan(uint32_t timestampSec,
+                       std::unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>* alarms);
+
+    /** Returns the soonest alarm timestamp, or 0 if the wheel is empty. */
+    uint32_t soonestTimestampSec() const;
+
+    size_t size() const {
+        return mSize;
+    }
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+private:
+    static constexpr int kBitsPerLevel = 6;
+    static constexpr int kSlotsPerLevel = 1 << kBitsPerLevel;
+    // Enough levels to cover all 32 bits of a timestamp.
+    static constexpr int kNumLevels = (32 + kBitsPerLevel - 1) / kBitsPerLevel;
+
+    // Links alarm into the slot for its timestamp relative to mNowSec.
+    void link(const InternalAlarm* alarm);
+
+    // Unlinks alarm from its slot.
+    void unlink(const InternalAlarm* alarm);
+
+    // Returns the lowest level with an occupied slot, or kNumLevels if the wheel is empty.
+    int lowestOccupiedLevel() const;
+
+    // Returns the time at which mNowSec reaches the given slot.
+    uint32_t slotStartSec(int level, int slot) const;
+
+    // All alarms have a timestamp >= mNowSec, except alarms added with an earlier timestamp,
+    // which are kept in the level 0 slot of mNowSec.
+    uint32_t mNowSec;
+
+    // Heads of the slot lists, level by level.
+    const InternalAlarm* mSlots[kNumLevels * kSlotsPerLevel];
+
+    // Bit s of mOccupied[l] is set iff slot s of level l is not empty.
+    uint64_t mOccupied[kNumLevels];
+
+    size_t mSize;
+
+    FRIEND_TEST(AlarmTimerWheelTest, TestCascade);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -27,6 +27,7 @@
 #include "subscriber/SubscriberReporter.h"
 
 #include <inttypes.h>
+#include <algorithm>
 #include <statslog_statsd.h>
 #include <time.h>
 
@@ -35,7 +36,12 @@ namespace os {
 namespace statsd {
 
 AnomalyTracker::AnomalyTracker(const Alert& alert, const ConfigKey& configKey)
-        : mAlert(alert), mConfigKey(configKey), mNumOfPastBuckets(mAlert.num_buckets() - 1) {
+        : AnomalyTracker(alert, configKey, alert.num_buckets() - 1) {
+}
+
+AnomalyTracker::AnomalyTracker(const Alert& alert, const ConfigKey& configKey,
+                               int numOfPastBuckets)
+        : mAlert(alert), mConfigKey(configKey), mNumOfPastBuckets(numOfPastBuckets) {
     VLOG("AnomalyTracker() called");
     resetStorage();  // initialization
 }
@@ -50,10 +56,11 @@ void AnomalyTracker::onConfigUpdated() {
 
 void AnomalyTracker::resetStorage() {
     VLOG("resetStorage() called.");
-    mPastBuckets.clear();
-    // Excludes the current bucket.
-    mPastBuckets.resize(mNumOfPastBuckets);
-    mSumOverPastBuckets.clear();
+    // Keeps the capacity, so that the histories are reused once the dimensions come back.
+    mHistoryIndex.clear();
+    mHistories.clear();
+    mFreeHistories.clear();
+    mBucketValues.clear();
 }
 
 size_t AnomalyTracker::index(int64_t bucketNum) const {
@@ -80,13 +87,98 @@ void AnomalyTracker::advanceMostRecentBucketTo(const int64_t& bucketNum) {
         return;
     }
 
-    // Clear out space by emptying out old mPastBuckets[i] values and update mSumOverPastBuckets.
-    for (int64_t i = mMostRecentBucketNum + 1; i <= bucketNum; i++) {
-        const int idx = index(i);
-        subtractBucketFromSum(mPastBuckets[idx]);
-        mPastBuckets[idx] = nullptr;  // release (but not clear) the old bucket.
-    }
+    // The histories drop their old buckets when they are next written. Histories of dimensions
+    // that stopped reporting are freed once every mNumOfPastBuckets buckets.
     mMostRecentBucketNum = bucketNum;
+    if (mMostRecentBucketNum >= mNextSweepBucketNum) {
+        freeEmptyHistories();
+        mNextSweepBucketNum = mMostRecentBucketNum + mNumOfPastBuckets;
+    }
+}
+
+void AnomalyTracker::freeEmptyHistories() {
+    for (size_t i = 0; i < mHistories.size(); i++) {
+        DimensionHistory& history = mHistories[i];
+        if (history.live &&
+            history.lastNonZeroBucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
+            history.live = false;
+            mHistoryIndex.erase(history.key);
+            mFreeHistories.push_back(i);
+        }
+    }
+}
+
+size_t AnomalyTracker::getOrCreateHistory(const MetricDimensionKey& key) {
+    const auto [it, inserted] = mHistoryIndex.emplace(key, 0);
+    if (!inserted) {
+        syncHistory(it->second);
+        return it->second;
+    }
+    if (mFreeHistories.empty()) {
+        it->second = mHistories.size();
+        mHistories.emplace_back();
+        mBucketValues.resize(mBucketValues.size() + mNumOfPastBuckets);
+    } else {
+        it->second = mFreeHistories.back();
+        mFreeHistories.pop_back();
+        std::fill_n(mBucketValues.begin() + it->second * mNumOfPastBuckets, mNumOfPastBuckets, 0);
+    }
+    DimensionHistory& history = mHistories[it->second];
+    history.key = key;
+    history.sum = 0;
+    history.sumOfSquares = 0;
+    history.syncedBucketNum = mMostRecentBucketNum;
+    history.lastNonZeroBucketNum = -1;
+    history.live = true;
+    return it->second;
+}
+
+void AnomalyTracker::syncHistory(size_t historyIndex) {
+    DimensionHistory& history = mHistories[historyIndex];
+    if (history.syncedBucketNum >= mMostRecentBucketNum) {
+        return;
+    }
+    int64_t* values = &mBucketValues[historyIndex * mNumOfPastBuckets];
+    if (history.lastNonZeroBucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
+        std::fill_n(values, mNumOfPastBuckets, 0);
+        history.sum = 0;
+        history.sumOfSquares = 0;
+    } else {
+        // The entries of buckets (syncedBucketNum, mMostRecentBucketNum] still hold the values of
+        // the buckets mNumOfPastBuckets earlier, which are now too old.
+        for (int64_t i = history.syncedBucketNum + 1; i <= mMostRecentBucketNum; i++) {
+            int64_t& value = values[index(i)];
+            history.sum -= value;
+            history.sumOfSquares -= (double)value * value;
+            value = 0;
+        }
+    }
+    history.syncedBucketNum = mMostRecentBucketNum;
+}
+
+int64_t AnomalyTracker::getSyncedSum(size_t historyIndex) const {
+    const DimensionHistory& history = mHistories[historyIndex];
+    if (history.lastNonZeroBucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
+        return 0;
+    }
+    const int64_t* values = &mBucketValues[historyIndex * mNumOfPastBuckets];
+    int64_t sum = history.sum;
+    for (int64_t i = history.syncedBucketNum + 1; i <= mMostRecentBucketNum; i++) {
+        sum -= values[index(i)];
+    }
+    return sum;
+}
+
+void AnomalyTracker::setPastBucketValue(size_t historyIndex, int64_t bucketNum,
+                                        int64_t bucketValue) {
+    DimensionHistory& history = mHistories[historyIndex];
+    int64_t& value = mBucketValues[historyIndex * mNumOfPastBuckets + index(bucketNum)];
+    history.sum += bucketValue - value;
+    history.sumOfSquares += (double)bucketValue * bucketValue - (double)value * value;
+    value = bucketValue;
+    if (bucketValue != 0 && bucketNum > history.lastNonZeroBucketNum) {
+        history.lastNonZeroBucketNum = bucketNum;
+    }
 }
 
 void AnomalyTracker::addPastBucket(const MetricDimensionKey& key,
@@ -98,25 +190,23 @@ void AnomalyTracker::addPastBucket(const MetricDimensionKey& key,
         return;
     }
 
-    const int bucketIndex = index(bucketNum);
-    if (bucketNum <= mMostRecentBucketNum && (mPastBuckets[bucketIndex] != nullptr)) {
-        // We need to insert into an already existing past bucket.
-        std::shared_ptr<DimToValMap>& bucket = mPastBuckets[bucketIndex];
-        auto itr = bucket->find(key);
-        if (itr != bucket->end()) {
-            // Old entry already exists; update it.
-            subtractValueFromSum(key, itr->second);
-            itr->second = bucketValue;
-        } else {
-            bucket->insert({key, bucketValue});
-        }
-        mSumOverPastBuckets[key] += bucketValue;
-    } else {
-        // Bucket does not exist yet (in future or was never made), so we must make it.
-        std::shared_ptr<DimToValMap> bucket = std::make_shared<DimToValMap>();
-        bucket->insert({key, bucketValue});
-        addPastBucket(bucket, bucketNum);
+    if (bucketNum > mMostRecentBucketNum) {
+        // Clear space for the new bucket to be at bucketNum.
+        advanceMostRecentBucketTo(bucketNum);
+    }
+    storePastBucketValue(key, bucketNum, bucketValue);
+}
+
+void AnomalyTracker::storePastBucketValue(const MetricDimensionKey& key, int64_t bucketNum,
+                                          int64_t bucketValue) {
+    const size_t historyIndex = getOrCreateHistory(key);
+    if (bucketNum == mMostRecentBucketNum) {
+        const DimensionHistory& history = mHistories[historyIndex];
+        const int64_t value = mBucketValues[historyIndex * mNumOfPastBuckets + index(bucketNum)];
+        onBucketClosed(key, bucketNum, bucketValue, history.sum - value,
+                       history.sumOfSquares - (double)value * value);
     }
+    setPastBucketValue(historyIndex, bucketNum, bucketValue);
 }
 
 void AnomalyTracker::addPastBucket(std::shared_ptr<DimToValMap> bucket,
@@ -128,45 +218,23 @@ void AnomalyTracker::addPastBucket(std::shared_ptr<DimToValMap> bucket,
     }
 
     if (bucketNum <= mMostRecentBucketNum) {
-        // We are updating an old bucket, not adding a new one.
-        subtractBucketFromSum(mPastBuckets[index(bucketNum)]);
+        // We are updating an old bucket, not adding a new one, so the dimensions that are not in
+        // the new bucket lose their values.
+        for (size_t i = 0; i < mHistories.size(); i++) {
+            if (mHistories[i].live) {
+                syncHistory(i);
+                setPastBucketValue(i, bucketNum, 0);
+            }
+        }
     } else {
         // Clear space for the new bucket to be at bucketNum.
         advanceMostRecentBucketTo(bucketNum);
     }
-    mPastBuckets[index(bucketNum)] = bucket;
-    addBucketToSum(bucket);
-}
-
-void AnomalyTracker::subtractBucketFromSum(const shared_ptr<DimToValMap>& bucket) {
     if (bucket == nullptr) {
         return;
     }
-    for (const auto& keyValuePair : *bucket) {
-        subtractValueFromSum(keyValuePair.first, keyValuePair.second);
-    }
-}
-
-
-void AnomalyTracker::subtractValueFromSum(const MetricDimensionKey& key,
-                                          const int64_t& bucketValue) {
-    auto itr = mSumOverPastBuckets.find(key);
-    if (itr == mSumOverPastBuckets.end()) {
-        return;
-    }
-    itr->second -= bucketValue;
-    if (itr->second == 0) {
-        mSumOverPastBuckets.erase(itr);
-    }
-}
-
-void AnomalyTracker::addBucketToSum(const shared_ptr<DimToValMap>& bucket) {
-    if (bucket == nullptr) {
-        return;
-    }
-    // For each dimension present in the bucket, add its value to its corresponding sum.
-    for (const auto& keyValuePair : *bucket) {
-        mSumOverPastBuckets[keyValuePair.first] += keyValuePair.second;
+    for (const auto& [key, value] : *bucket) {
+        storePastBucketValue(key, bucketNum, value);
     }
 }
 
@@ -178,22 +246,32 @@ int64_t AnomalyTracker::getPastBucketValue(const MetricDimensionKey& key,
         return 0;
     }
 
-    const auto& bucket = mPastBuckets[index(bucketNum)];
-    if (bucket == nullptr) {
+    const auto& itr = mHistoryIndex.find(key);
+    if (itr == mHistoryIndex.end() || bucketNum > mHistories[itr->second].syncedBucketNum) {
+        // The history has not been written since bucketNum was added.
         return 0;
     }
-    const auto& itr = bucket->find(key);
-    return itr == bucket->end() ? 0 : itr->second;
+    return mBucketValues[itr->second * mNumOfPastBuckets + index(bucketNum)];
 }
 
 int64_t AnomalyTracker::getSumOverPastBuckets(const MetricDimensionKey& key) const {
-    const auto& itr = mSumOverPastBuckets.find(key);
-    if (itr != mSumOverPastBuckets.end()) {
-        return itr->second;
+    const auto& itr = mHistoryIndex.find(key);
+    if (itr != mHistoryIndex.end()) {
+        return getSyncedSum(itr->second);
     }
     return 0;
 }
 
+size_t AnomalyTracker::getNumDimensionsWithPastSum() const {
+    size_t count = 0;
+    for (size_t i = 0; i < mHistories.size(); i++) {
+        if (mHistories[i].live && getSyncedSum(i) != 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
 bool AnomalyTracker::detectAnomaly(const int64_t& currentBucketNum,
                                    const MetricDimensionKey& key,
                                    const int64_t& currentBucketValue) {
@@ -41,6 +41,9 @@ class AnomalyTracker : public virtual RefBase {
 public:
     AnomalyTracker(const Alert& alert, const ConfigKey& configKey);
 
+    // Keeps numOfPastBuckets past buckets instead of the alert's num_buckets - 1.
+    AnomalyTracker(const Alert& alert, const ConfigKey& configKey, int numOfPastBuckets);
+
     virtual ~AnomalyTracker();
 
     // Reset appropriate state on a config update. Clear subscriptions so they can be reset.
@@ -170,17 +173,41 @@ protected:
     // for the anomaly detection (since the current bucket is not in the past).
     const int mNumOfPastBuckets;
 
-    // Values for each of the past mNumOfPastBuckets buckets. Always of size mNumOfPastBuckets.
-    // mPastBuckets[i] can be null, meaning that no data is present in that bucket.
-    std::vector<shared_ptr<DimToValMap>> mPastBuckets;
-
-    // Cached sum over all existing buckets in mPastBuckets.
-    // Its buckets never contain entries of 0.
-    DimToValMap mSumOverPastBuckets;
+    // The past bucket values of one dimension. Advancing mMostRecentBucketNum does not touch the
+    // histories; each one drops the buckets that are now too old the next time it is written
+    // (see syncHistory).
+    struct DimensionHistory {
+        MetricDimensionKey key;
+        // Sum over the values in the history's ring in mBucketValues.
+        int64_t sum = 0;
+        // Sum over the squares of those values.
+        double sumOfSquares = 0;
+        // The ring holds the values of buckets
+        //   [syncedBucketNum - mNumOfPastBuckets + 1, syncedBucketNum].
+        int64_t syncedBucketNum = -1;
+        // The most recent bucket with a non-zero value. Once it is too old, the history is empty.
+        int64_t lastNonZeroBucketNum = -1;
+        bool live = false;
+    };
+
+    // Index of each dimension's history in mHistories.
+    unordered_map<MetricDimensionKey, size_t> mHistoryIndex;
+
+    std::vector<DimensionHistory> mHistories;
+
+    // Histories that are not live, reused before mHistories grows.
+    std::vector<size_t> mFreeHistories;
+
+    // Column store of the past bucket values. History i keeps the value of bucket b at
+    // mBucketValues[i * mNumOfPastBuckets + index(b)].
+    std::vector<int64_t> mBucketValues;
 
     // The bucket number of the last added bucket.
     int64_t mMostRecentBucketNum = -1;
 
+    // When mMostRecentBucketNum reaches this bucket, histories that have become empty are freed.
+    int64_t mNextSweepBucketNum = 0;
+
     // Map from each dimension to the timestamp that its refractory period (if this anomaly was
     // declared for that dimension) ends, in seconds. From this moment and onwards, anomalies
     // can be declared again.
@@ -192,15 +219,26 @@ protected:
     //   [mMostRecentBucketNum - mNumOfPastBuckets + 1, bucketNum - mNumOfPastBuckets].
     void advanceMostRecentBucketTo(const int64_t& bucketNum);
 
-    // Add the information in the given bucket to mSumOverPastBuckets.
-    void addBucketToSum(const shared_ptr<DimToValMap>& bucket);
+    // Returns the index of the history of key, adding an empty one if there is none. The history
+    // is synced.
+    size_t getOrCreateHistory(const MetricDimensionKey& key);
+
+    // Drops the values of the buckets that are too old as of mMostRecentBucketNum from the
+    // history, i.e. clears the ring entries of buckets (syncedBucketNum, mMostRecentBucketNum].
+    void syncHistory(size_t historyIndex);
+
+    // Returns the sum of the history as if it were synced, without syncing it.
+    int64_t getSyncedSum(size_t historyIndex) const;
 
-    // Subtract the information in the given bucket from mSumOverPastBuckets
-    // and remove any items with value 0.
-    void subtractBucketFromSum(const shared_ptr<DimToValMap>& bucket);
+    // Sets the value of a past bucket, which must not be older than the oldest past bucket, in
+    // a synced history.
+    void setPastBucketValue(size_t historyIndex, int64_t bucketNum, int64_t bucketValue);
 
-    // From mSumOverPastBuckets[key], subtracts bucketValue, removing it if it is now 0.
-    void subtractValueFromSum(const MetricDimensionKey& key, const int64_t& bucketValue);
+    // Frees the histories that have no non-zero value left.
+    void freeEmptyHistories();
+
+    // For testing. Returns the number of dimensions with a non-zero sum over past buckets.
+    size_t getNumDimensionsWithPastSum() const;
 
     // Returns true if in the refractory period, else false.
     bool isInRefractoryPeriod(const int64_t& timestampNs, const MetricDimensionKey& key) const;
@@ -212,11 +250,23 @@ protected:
     // Resets all bucket data. For use when all the data gets stale.
     virtual void resetStorage();
 
+    // Called with the value of key in the most recent bucket, right before it is stored.
+    // pastSum and pastSumOfSquares are over the key's values in the mNumOfPastBuckets - 1
+    // buckets before it.
+    virtual void onBucketClosed(const MetricDimensionKey& key, int64_t bucketNum,
+                                int64_t bucketValue, int64_t pastSum, double pastSumOfSquares) {
+    }
+
+    // Stores bucketValue as the value of key in bucketNum, which must be a past bucket.
+    void storePastBucketValue(const MetricDimensionKey& key, int64_t bucketNum,
+                              int64_t bucketValue);
+
     // Informs the subscribers (incidentd, perfetto, broadcasts, etc) that an anomaly has occurred.
     void informSubscribers(const MetricDimensionKey& key, int64_t metricId, int64_t metricValue);
 
     FRIEND_TEST(AnomalyTrackerTest, TestConsecutiveBuckets);
     FRIEND_TEST(AnomalyTrackerTest, TestSparseBuckets);
+    FRIEND_TEST(AnomalyTrackerTest, TestPastBucketHistories);
     FRIEND_TEST(GaugeMetricProducerTest, TestAnomalyDetection);
     FRIEND_TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced);
     FRIEND_TEST(AnomalyDurationDetectionE2eTest, TestDurationMetric_SUM_single_bucket);
@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "StatisticalAnomalyTracker.h"
+
+#include <math.h>
+
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// Past buckets kept by the base AnomalyTracker for a detector. The z-score needs the
+// num_buckets - 1 buckets before the closing one, the other detectors keep their own state.
+int getDetectorNumOfPastBuckets(const Alert& alert) {
+    return alert.detector().type() == Alert::Detector::Z_SCORE ? alert.num_buckets() : 1;
+}
+
+}  // anonymous namespace
+
+StatisticalAnomalyTracker::StatisticalAnomalyTracker(const Alert& alert,
+                                                     const ConfigKey& configKey)
+        : AnomalyTracker(alert, configKey, getDetectorNumOfPastBuckets(alert)) {
+    VLOG("StatisticalAnomalyTracker() called");
+}
+
+StatisticalAnomalyTracker::~StatisticalAnomalyTracker() {
+    VLOG("~StatisticalAnomalyTracker() called");
+}
+
+bool StatisticalAnomalyTracker::isValidDetector(const Alert& alert) {
+    if (!alert.has_detector() || alert.has_trigger_if_sum_gt()) {
+        return false;
+    }
+    const Alert::Detector& detector = alert.detector();
+    if (!detector.has_trigger_if_gt() || detector.trigger_if_gt() <= 0) {
+        return false;
+    }
+    switch (detector.type()) {
+        case Alert::Detector::EWMA_DEVIATION:
+            return detector.ewma_alpha() > 0 && detector.ewma_alpha() <= 1;
+        case Alert::Detector::Z_SCORE:
+            // The variance needs at least two past buckets.
+            return alert.num_buckets() >= 3;
+        case Alert::Detector::RATE_OF_CHANGE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void StatisticalAnomalyTracker::onBucketClosed(const MetricDimensionKey& key, int64_t bucketNum,
+                                               int64_t bucketValue, int64_t pastSum,
+                                               double pastSumOfSquares) {
+    dropIdleStates(bucketNum);
+    const auto [it, inserted] = mStates.try_emplace(key);
+    DetectorState& state = it->second;
+    if (!inserted && bucketNum <= state.lastBucketNum) {
+        // The bucket was already evaluated and is only being updated.
+        return;
+    }
+    if (inserted || bucketNum - state.lastBucketNum > kMaxIdleBuckets) {
+        state = DetectorState();
+        state.firstBucketNum = bucketNum;
+    }
+
+    bool anomaly = false;
+    switch (mAlert.detector().type()) {
+        case Alert::Detector::EWMA_DEVIATION:
+            anomaly = evaluateEwmaDeviation(state, bucketNum, bucketValue);
+            break;
+        case Alert::Detector::Z_SCORE:
+            anomaly = evaluateZScore(state, bucketNum, bucketValue, pastSum, pastSumOfSquares);
+            break;
+        case Alert::Detector::RATE_OF_CHANGE:
+            anomaly = evaluateRateOfChange(state, bucketNum, bucketValue);
+            break;
+        default:
+            break;
+    }
+    state.lastBucketNum = bucketNum;
+    state.lastValue = bucketValue;
+
+    if (anomaly) {
+        declareAnomaly(getElapsedRealtimeNs(), mAlert.metric_id(), key, bucketValue);
+    }
+}
+
+bool StatisticalAnomalyTracker::evaluateEwmaDeviation(DetectorState& state, int64_t bucketNum,
+                                                      int64_t value) {
+    const double alpha = mAlert.detector().ewma_alpha();
+    const auto train = [&state, alpha](double x) {
+        if (state.numBuckets == 0) {
+            state.mean = x;
+        } else {
+            const double diff = x - state.mean;
+            state.mean += alpha * diff;
+            state.variance = (1 - alpha) * (state.variance + alpha * diff * diff);
+        }
+        state.numBuckets++;
+    };
+
+    // The buckets the dimension had no value in count as 0. There are at most kMaxIdleBuckets.
+    if (state.numBuckets > 0) {
+        for (int64_t i = state.lastBucketNum + 1; i < bucketNum; i++) {
+            train(0);
+        }
+    }
+
+    bool anomaly = false;
+    if (state.numBuckets >= mAlert.num_buckets() && state.variance > 0) {
+        anomaly = fabs(value - state.mean) > mAlert.detector().trigger_if_gt() *
+                                                     sqrt(state.variance);
+    }
+    train(value);
+    return anomaly;
+}
+
+bool StatisticalAnomalyTracker::evaluateZScore(const DetectorState& state, int64_t bucketNum,
+                                               int64_t value, int64_t pastSum,
+                                               double pastSumOfSquares) const {
+    const int64_t windowSize = mNumOfPastBuckets - 1;
+    if (bucketNum - state.firstBucketNum < windowSize) {
+        return false;
+    }
+    const double mean = (double)pastSum / windowSize;
+    const double variance = pastSumOfSquares / windowSize - mean * mean;
+    if (variance <= 0) {
+        return false;
+    }
+    return fabs(value - mean) > mAlert.detector().trigger_if_gt() * sqrt(variance);
+}
+
+bool StatisticalAnomalyTracker::evaluateRateOfChange(const DetectorState& state,
+                                                     int64_t bucketNum, int64_t value) const {
+    if (state.lastBucketNum != bucketNum - 1 || state.lastValue == 0) {
+        // The previous bucket had value 0, or this is the first bucket of the dimension.
+        return false;
+    }
+    return fabs((double)(value - state.lastValue) / state.lastValue) >
+           mAlert.detector().trigger_if_gt();
+}
+
+void StatisticalAnomalyTracker::dropIdleStates(int64_t bucketNum) {
+    if (bucketNum < mNextIdleSweepBucketNum) {
+        return;
+    }
+    for (auto it = mStates.begin(); it != mStates.end();) {
+        if (it->second.lastBucketNum + kMaxIdleBuckets < bucketNum) {
+            it = mStates.erase(it);
+        } else {
+            it++;
+        }
+    }
+    mNextIdleSweepBucketNum = bucketNum + kMaxIdleBuckets;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "AnomalyTracker.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Evaluates the Alert's Detector on the value of each dimension when a bucket closes, instead of
+// comparing the sum over the past buckets to a threshold. Anomalies are not detected in the
+// partial current bucket.
+class StatisticalAnomalyTracker : public virtual AnomalyTracker {
+public:
+    StatisticalAnomalyTracker(const Alert& alert, const ConfigKey& configKey);
+
+    virtual ~StatisticalAnomalyTracker();
+
+    // Returns whether the alert has a valid detector.
+    static bool isValidDetector(const Alert& alert);
+
+protected:
+    void onBucketClosed(const MetricDimensionKey& key, int64_t bucketNum, int64_t bucketValue,
+                        int64_t pastSum, double pastSumOfSquares) override;
+
+private:
+    // Per dimension state of the detector.
+    struct DetectorState {
+        int64_t firstBucketNum = 0;
+        int64_t lastBucketNum = 0;
+        int64_t lastValue = 0;
+        // Number of buckets that trained the moving average.
+        int64_t numBuckets = 0;
+        double mean = 0;
+        double variance = 0;
+    };
+
+    // Returns whether value is anomalous for the dimension, and updates the dimension's state.
+    bool evaluateEwmaDeviation(DetectorState& state, int64_t bucketNum, int64_t value);
+
+    bool evaluateZScore(const DetectorState& state, int64_t bucketNum, int64_t value,
+                        int64_t pastSum, double pastSumOfSquares) const;
+
+    bool evaluateRateOfChange(const DetectorState& state, int64_t bucketNum, int64_t value) const;
+
+    // Drops the states of the dimensions that have not had a value for kMaxIdleBuckets buckets.
+    void dropIdleStates(int64_t bucketNum);
+
+    // Buckets without a value for a dimension count as buckets with value 0 until the dimension
+    // has been idle for this many buckets. After that, it starts over.
+    static constexpr int64_t kMaxIdleBuckets = 64;
+
+    std::unordered_map<MetricDimensionKey, DetectorState> mStates;
+
+    // When a closing bucket reaches this bucket, idle states are dropped.
+    int64_t mNextIdleSweepBucketNum = 0;
+
+    FRIEND_TEST(StatisticalAnomalyTrackerTest, TestIdleDimensionsAreDropped);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -95,6 +95,15 @@ public:
         return nullptr;
     }
 
+    int getSlicedSimpleConditionIndex(
+            const std::vector<sp<ConditionTracker>>& allConditions) const override {
+        if (mSlicedChildren.size() == 1) {
+            return allConditions[mSlicedChildren.front()]->getSlicedSimpleConditionIndex(
+                    allConditions);
+        }
+        return -1;
+    }
+
 private:
     LogicalOperation mLogicalOperation;
 
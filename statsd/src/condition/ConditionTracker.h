@@ -111,6 +111,12 @@ public:
             const bool isPartialLink,
             std::vector<ConditionState>& conditionCache) const = 0;
 
+    // Notify this tracker that a metric queries it through a MetricConditionLink whose condition
+    // side is [conditionFields]. Sliced trackers may index their state by this projection so that
+    // partial-link queries do not need to scan every slice.
+    virtual void addLinkedDimensions(const std::vector<Matcher>& conditionFields) {
+    }
+
     // return the list of AtomMatchingTracker index that this ConditionTracker uses.
     virtual const std::set<int>& getAtomMatchingTrackerIndex() const {
         return mTrackerIndex;
@@ -140,6 +146,19 @@ public:
     virtual const std::map<HashableDimensionKey, int>* getSlicedDimensionMap(
             const std::vector<sp<ConditionTracker>>& allConditions) const = 0;
 
+    // Returns the index of the sliced SimpleConditionTracker that decides the sliced part of this
+    // condition, or -1 if this condition is not sliced or has more than one sliced descendant.
+    virtual int getSlicedSimpleConditionIndex(
+            const std::vector<sp<ConditionTracker>>& allConditions) const = 0;
+
+    // Returns the state of this condition for the slice [key], as isConditionMet() would for a
+    // ConditionKey that maps this condition to [key]. Only implemented by sliced
+    // SimpleConditionTrackers.
+    virtual ConditionState getSliceState(const HashableDimensionKey& key,
+                                         const bool isPartialLink) const {
+        return ConditionState::kNotEvaluated;
+    }
+
     virtual bool IsChangedDimensionTrackable() const = 0;
 
     virtual bool IsSimpleCondition() const = 0;
@@ -21,16 +21,100 @@ namespace statsd {
 
 using std::vector;
 
+std::size_t ConditionWizard::QueryKeyHash::operator()(const QueryKey& key) const {
+    android::hash_t hash = android::JenkinsHashMix(key.conditionIndex, key.isPartialLink);
+    for (const auto& [conditionId, dimensionKey] : key.conditionParameters) {
+        hash = android::JenkinsHashMix(hash, std::hash<int64_t>{}(conditionId));
+        hash = android::JenkinsHashMix(hash, hashDimension(dimensionKey));
+    }
+    return android::JenkinsHashWhiten(hash);
+}
+
 ConditionState ConditionWizard::query(const int index, const ConditionKey& parameters,
                                       const bool isPartialLink) {
+    if (mQueryCacheEnabled) {
+        const auto it = mQueryCache.find({index, isPartialLink, parameters});
+        if (it != mQueryCache.end()) {
+            mQueryCacheHits++;
+            return it->second;
+        }
+        mQueryCacheMisses++;
+    }
+
     vector<ConditionState> cache(mAllConditions.size(), ConditionState::kNotEvaluated);
 
     mAllConditions[index]->isConditionMet(
         parameters, mAllConditions, isPartialLink,
         cache);
+    if (mQueryCacheEnabled) {
+        mQueryCache[{index, isPartialLink, parameters}] = cache[index];
+    }
     return cache[index];
 }
 
+void ConditionWizard::queryAll(const int index, const vector<const ConditionKey*>& conditionKeys,
+                               const bool isPartialLink, vector<ConditionState>* conditionStates) {
+    conditionStates->resize(conditionKeys.size());
+    const int slicedIndex = index >= 0 && index < (int)mAllConditions.size()
+                                    ? mAllConditions[index]->getSlicedSimpleConditionIndex(
+                                              mAllConditions)
+                                    : -1;
+    if (slicedIndex < 0) {
+        for (size_t i = 0; i < conditionKeys.size(); i++) {
+            (*conditionStates)[i] = query(index, *conditionKeys[i], isPartialLink);
+        }
+        return;
+    }
+
+    // The other children of a combination are not sliced, so with a key that only links to the
+    // sliced condition the result only depends on the state of that slice.
+    const sp<ConditionTracker>& slicedCondition = mAllConditions[slicedIndex];
+    SliceStateResults localResults;
+    SliceStateResults* results = &localResults;
+    if (mQueryCacheEnabled) {
+        const auto [it, inserted] = mSliceStateCache.try_emplace({index, isPartialLink});
+        if (inserted) {
+            it->second.fill(ConditionState::kNotEvaluated);
+        }
+        results = &it->second;
+    } else {
+        localResults.fill(ConditionState::kNotEvaluated);
+    }
+    for (size_t i = 0; i < conditionKeys.size(); i++) {
+        const ConditionKey& conditionKey = *conditionKeys[i];
+        if (conditionKey.size() != 1 ||
+            conditionKey.begin()->first != slicedCondition->getConditionId()) {
+            (*conditionStates)[i] = query(index, conditionKey, isPartialLink);
+            continue;
+        }
+        const ConditionState sliceState =
+                slicedCondition->getSliceState(conditionKey.begin()->second, isPartialLink);
+        if (slicedIndex == index) {
+            (*conditionStates)[i] = sliceState;
+            continue;
+        }
+        ConditionState& result = (*results)[sliceState - ConditionState::kNotEvaluated];
+        if (result == ConditionState::kNotEvaluated) {
+            result = query(index, conditionKey, isPartialLink);
+        }
+        (*conditionStates)[i] = result;
+    }
+}
+
+void ConditionWizard::beginQueryCache() {
+    mQueryCacheEnabled = true;
+}
+
+std::pair<int64_t, int64_t> ConditionWizard::endQueryCache() {
+    mQueryCacheEnabled = false;
+    mQueryCache.clear();
+    mSliceStateCache.clear();
+    const std::pair<int64_t, int64_t> stats(mQueryCacheHits, mQueryCacheMisses);
+    mQueryCacheHits = 0;
+    mQueryCacheMisses = 0;
+    return stats;
+}
+
 const set<HashableDimensionKey>* ConditionWizard::getChangedToTrueDimensions(
         const int index) const {
     return mAllConditions[index]->getChangedToTrueDimensions(mAllConditions);
@@ -17,6 +17,12 @@
 #ifndef CONDITION_WIZARD_H
 #define CONDITION_WIZARD_H
 
+#include <gtest/gtest_prod.h>
+
+#include <array>
+#include <map>
+#include <unordered_map>
+
 #include "ConditionTracker.h"
 #include "condition_util.h"
 #include "stats_util.h"
@@ -39,9 +45,29 @@ public:
     //                       condition.
     // The ConditionTracker at [conditionIndex] can be a CombinationConditionTracker. In this case,
     // the conditionParameters contains the parameters for it's children SimpleConditionTrackers.
+    // While the query cache is enabled, the result is memoized per (conditionIndex,
+    // conditionParameters, isPartialLink).
     virtual ConditionState query(const int conditionIndex, const ConditionKey& conditionParameters,
                                  const bool isPartialLink);
 
+    // Queries the condition at [index] for each of [conditionKeys] in one call, filling
+    // [conditionStates] with the results of query() in the same order.
+    // If the condition has a single sliced SimpleConditionTracker and a key only links to it, the
+    // key is answered from the state of its slice, and the condition is only evaluated once per
+    // distinct slice state. While the query cache is enabled, these evaluations are shared by all
+    // calls.
+    void queryAll(const int conditionIndex,
+                  const std::vector<const ConditionKey*>& conditionKeys, const bool isPartialLink,
+                  std::vector<ConditionState>* conditionStates);
+
+    // Enables the query cache. Called once the conditions have been evaluated for an event; the
+    // conditions must not change until endQueryCache() is called.
+    void beginQueryCache();
+
+    // Disables and clears the query cache. Returns the number of cache hits and misses since the
+    // previous call, so that they can be reported to StatsdStats.
+    std::pair<int64_t, int64_t> endQueryCache();
+
     virtual const std::set<HashableDimensionKey>* getChangedToTrueDimensions(const int index) const;
     virtual const std::set<HashableDimensionKey>* getChangedToFalseDimensions(
             const int index) const;
@@ -60,6 +86,37 @@ public:
 
 private:
     std::vector<sp<ConditionTracker>> mAllConditions;
+
+    struct QueryKey {
+        int conditionIndex;
+        bool isPartialLink;
+        ConditionKey conditionParameters;
+
+        bool operator==(const QueryKey& that) const {
+            return conditionIndex == that.conditionIndex && isPartialLink == that.isPartialLink &&
+                   conditionParameters == that.conditionParameters;
+        }
+    };
+
+    struct QueryKeyHash {
+        std::size_t operator()(const QueryKey& key) const;
+    };
+
+    bool mQueryCacheEnabled = false;
+
+    std::unordered_map<QueryKey, ConditionState, QueryKeyHash> mQueryCache;
+
+    int64_t mQueryCacheHits = 0;
+
+    int64_t mQueryCacheMisses = 0;
+
+    // Result of a condition for each state of the slice of its sliced condition, indexed by
+    // ConditionState - kNotEvaluated. Keyed by condition index and isPartialLink, and cleared
+    // with the query cache.
+    using SliceStateResults = std::array<ConditionState, 4>;
+    std::map<std::pair<int, bool>, SliceStateResults> mSliceStateCache;
+
+    FRIEND_TEST(SimpleConditionTrackerTest, TestQueryCache);
 };
 
 }  // namespace statsd
@@ -26,6 +26,49 @@ namespace statsd {
 
 using std::unordered_map;
 
+namespace {
+
+// Sentinel for a key that has no entry in mSlicedConditionState.
+const int kNoSlice = -1;
+
+// Projects a sliced condition key onto the condition fields of a link, in link order.
+// Returns false if the projection is ambiguous because a field occurs more than once in [key].
+// If [key] lacks one of the fields, [output] is left shorter than [fields]; such a key can never
+// contain a query on this link.
+bool projectToLink(const HashableDimensionKey& key, const vector<Field>& fields,
+                   HashableDimensionKey* output) {
+    const vector<FieldValue>& values = key.getValues();
+    if (values.size() == fields.size()) {
+        // HashableDimensionKey::contains() falls back to an exact, ordered comparison when both
+        // keys have the same size.
+        for (size_t i = 0; i < fields.size(); i++) {
+            if (values[i].mField != fields[i]) {
+                return true;
+            }
+        }
+        *output = key;
+        return true;
+    }
+    for (const Field& field : fields) {
+        const FieldValue* match = nullptr;
+        for (const FieldValue& value : values) {
+            if (value.mField == field) {
+                if (match != nullptr) {
+                    return false;
+                }
+                match = &value;
+            }
+        }
+        if (match == nullptr) {
+            return true;
+        }
+        output->addValue(*match);
+    }
+    return true;
+}
+
+}  // anonymous namespace
+
 SimpleConditionTracker::SimpleConditionTracker(
         const ConfigKey& key, const int64_t& id, const uint64_t protoHash, const int index,
         const SimplePredicate& simplePredicate,
@@ -128,6 +171,93 @@ void SimpleConditionTracker::setMatcherIndices(
     }
 }
 
+void SimpleConditionTracker::addLinkedDimensions(const vector<Matcher>& conditionFields) {
+    // Only partial links are indexed. A link covering every output dimension queries with a key as
+    // large as the sliced keys, which contains() treats as an exact comparison.
+    if (!mSliced || conditionFields.empty() ||
+        conditionFields.size() >= mOutputDimensions.size()) {
+        return;
+    }
+    vector<Field> fields;
+    for (const Matcher& matcher : conditionFields) {
+        fields.push_back(matcher.mMatcher);
+    }
+    for (const LinkIndex& index : mLinkIndices) {
+        if (index.fields == fields) {
+            return;
+        }
+    }
+    LinkIndex index;
+    index.fields = std::move(fields);
+    // On config updates the tracker may already hold state.
+    for (const auto& slice : mSlicedConditionState) {
+        updateLinkIndex(&index, slice.first, kNoSlice, slice.second);
+    }
+    mLinkIndices.push_back(std::move(index));
+}
+
+void SimpleConditionTracker::updateLinkIndex(LinkIndex* index, const HashableDimensionKey& key,
+                                             const int oldCount, const int newCount) {
+    if (!index->valid) {
+        return;
+    }
+    HashableDimensionKey projection;
+    if (!projectToLink(key, index->fields, &projection)) {
+        index->valid = false;
+        index->slices.clear();
+        return;
+    }
+    if (projection.getValues().size() != index->fields.size()) {
+        return;
+    }
+    SliceCounts& counts = index->slices[projection];
+    if (oldCount > 0) {
+        counts.trueCount--;
+    } else if (oldCount == 0) {
+        counts.falseCount--;
+    }
+    if (newCount > 0) {
+        counts.trueCount++;
+    } else if (newCount == 0) {
+        counts.falseCount++;
+    }
+    if (counts.trueCount == 0 && counts.falseCount == 0) {
+        index->slices.erase(projection);
+    }
+}
+
+void SimpleConditionTracker::updateLinkIndices(const HashableDimensionKey& key,
+                                               const int oldCount, const int newCount) {
+    // Nested starts do not change whether a slice is true.
+    if (oldCount == newCount || (oldCount > 0 && newCount > 0)) {
+        return;
+    }
+    for (LinkIndex& index : mLinkIndices) {
+        updateLinkIndex(&index, key, oldCount, newCount);
+    }
+}
+
+const SimpleConditionTracker::LinkIndex* SimpleConditionTracker::findLinkIndex(
+        const HashableDimensionKey& queryKey) const {
+    const vector<FieldValue>& values = queryKey.getValues();
+    for (const LinkIndex& index : mLinkIndices) {
+        if (!index.valid || index.fields.size() != values.size()) {
+            continue;
+        }
+        bool fieldsMatch = true;
+        for (size_t i = 0; i < values.size(); i++) {
+            if (values[i].mField != index.fields[i]) {
+                fieldsMatch = false;
+                break;
+            }
+        }
+        if (fieldsMatch) {
+            return &index;
+        }
+    }
+    return nullptr;
+}
+
 void SimpleConditionTracker::dumpState() {
     VLOG("%lld DUMP:", (long long)mConditionId);
     for (const auto& pair : mSlicedConditionState) {
@@ -161,6 +291,10 @@ void SimpleConditionTracker::handleStopAll(std::vector<ConditionState>& conditio
     // After StopAll, we know everything has stopped. From now on, default condition is false.
     mInitialValue = ConditionState::kFalse;
     mSlicedConditionState.clear();
+    for (LinkIndex& index : mLinkIndices) {
+        index.valid = true;
+        index.slices.clear();
+    }
     conditionCache[mIndex] = ConditionState::kFalse;
 }
 
@@ -195,6 +329,7 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
         (*conditionCache) = ConditionState::kUnknown;
         return;
     }
+    const int oldCount = outputIt == mSlicedConditionState.end() ? kNoSlice : outputIt->second;
     if (outputIt == mSlicedConditionState.end()) {
         // We get a new output key.
         newCondition = matchStart ? ConditionState::kTrue : ConditionState::kFalse;
@@ -253,6 +388,12 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
         }
     }
 
+    if (!mLinkIndices.empty()) {
+        const auto newIt = mSlicedConditionState.find(outputKey);
+        updateLinkIndices(outputKey, oldCount,
+                          newIt == mSlicedConditionState.end() ? kNoSlice : newIt->second);
+    }
+
     // dump all dimensions for debugging
     if (STATSD_DEBUG) {
         dumpState();
@@ -379,17 +520,35 @@ void SimpleConditionTracker::isConditionMet(
         return;
     }
 
+    conditionCache[mIndex] = getSliceState(pair->second, isPartialLink);
+    VLOG("Predicate %lld return %d", (long long)mConditionId, conditionCache[mIndex]);
+}
+
+ConditionState SimpleConditionTracker::getSliceState(const HashableDimensionKey& key,
+                                                     const bool isPartialLink) const {
     ConditionState conditionState = ConditionState::kNotEvaluated;
-    const HashableDimensionKey& key = pair->second;
     if (isPartialLink) {
         // For unseen key, check whether the require dimensions are subset of sliced condition
         // output.
         conditionState = conditionState | mInitialValue;
-        for (const auto& slice : mSlicedConditionState) {
-            ConditionState sliceState =
-                slice.second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
-            if (slice.first.contains(key)) {
-                conditionState = conditionState | sliceState;
+        const LinkIndex* linkIndex = findLinkIndex(key);
+        if (linkIndex != nullptr) {
+            const auto it = linkIndex->slices.find(key);
+            if (it != linkIndex->slices.end()) {
+                if (it->second.trueCount > 0) {
+                    conditionState = conditionState | ConditionState::kTrue;
+                }
+                if (it->second.falseCount > 0) {
+                    conditionState = conditionState | ConditionState::kFalse;
+                }
+            }
+        } else {
+            for (const auto& slice : mSlicedConditionState) {
+                ConditionState sliceState =
+                    slice.second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
+                if (slice.first.contains(key)) {
+                    conditionState = conditionState | sliceState;
+                }
             }
         }
     } else {
@@ -400,10 +559,8 @@ void SimpleConditionTracker::isConditionMet(
                 startedCountIt->second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
             conditionState = conditionState | sliceState;
         }
-
     }
-    conditionCache[mIndex] = conditionState;
-    VLOG("Predicate %lld return %d", (long long)mConditionId, conditionCache[mIndex]);
+    return conditionState;
 }
 
 }  // namespace statsd
@@ -81,6 +81,16 @@ public:
         return &mSlicedConditionState;
     }
 
+    int getSlicedSimpleConditionIndex(
+            const std::vector<sp<ConditionTracker>>& allConditions) const override {
+        return mSliced ? mIndex : -1;
+    }
+
+    ConditionState getSliceState(const HashableDimensionKey& key,
+                                 const bool isPartialLink) const override;
+
+    void addLinkedDimensions(const std::vector<Matcher>& conditionFields) override;
+
     bool IsChangedDimensionTrackable() const  override { return true; }
 
     bool IsSimpleCondition() const  override { return true; }
@@ -116,6 +126,25 @@ private:
 
     std::map<HashableDimensionKey, int> mSlicedConditionState;
 
+    // Number of entries in mSlicedConditionState that project to the same key of a LinkIndex.
+    struct SliceCounts {
+        int trueCount = 0;
+        int falseCount = 0;
+    };
+
+    // Secondary index over mSlicedConditionState, keyed by the projection of each sliced key onto
+    // the condition fields of a partial MetricConditionLink. Lets isConditionMet answer
+    // partial-link queries with one hash lookup instead of a scan over all slices.
+    struct LinkIndex {
+        std::vector<Field> fields;
+        // Cleared if a sliced key cannot be projected unambiguously (e.g. repeated fields). Queries
+        // then fall back to scanning mSlicedConditionState.
+        bool valid = true;
+        std::unordered_map<HashableDimensionKey, SliceCounts> slices;
+    };
+
+    std::vector<LinkIndex> mLinkIndices;
+
     void setMatcherIndices(const SimplePredicate& predicate,
                            const std::unordered_map<int64_t, int>& logTrackerMap);
 
@@ -127,6 +156,16 @@ private:
 
     bool hitGuardRail(const HashableDimensionKey& newKey);
 
+    // Moves [key] between the true/false counts of [index]. A count of -1 means the key is absent
+    // from mSlicedConditionState.
+    static void updateLinkIndex(LinkIndex* index, const HashableDimensionKey& key,
+                                const int oldCount, const int newCount);
+
+    void updateLinkIndices(const HashableDimensionKey& key, const int oldCount,
+                           const int newCount);
+
+    const LinkIndex* findLinkIndex(const HashableDimensionKey& queryKey) const;
+
     void dumpState();
 
     FRIEND_TEST(SimpleConditionTrackerTest, TestSlicedCondition);
@@ -134,6 +173,7 @@ private:
     FRIEND_TEST(SimpleConditionTrackerTest, TestStopAll);
     FRIEND_TEST(SimpleConditionTrackerTest, TestGuardrailNotHitWhenDefaultFalse);
     FRIEND_TEST(SimpleConditionTrackerTest, TestGuardrailHitWhenDefaultUnknown);
+    FRIEND_TEST(SimpleConditionTrackerTest, TestPartialLinkIndex);
     FRIEND_TEST(ConfigUpdateTest, TestUpdateConditions);
 };
 
@@ -31,9 +31,42 @@ Status PullResultReceiver::pullFinished(int32_t atomTag, bool success,
     return Status::ok();
 }
 
+Status PullResultReceiver::pullDeltaFinished(int32_t atomTag, bool /*success*/,
+                                             int64_t /*token*/, bool /*fullSnapshot*/,
+                                             const vector<StatsEventParcel>& /*changed*/,
+                                             const vector<StatsEventParcel>& /*removed*/) {
+    pullFinishCallback(atomTag, /*success=*/false, {});
+    return Status::ok();
+}
+
 PullResultReceiver::~PullResultReceiver() {
 }
 
+DeltaPullResultReceiver::DeltaPullResultReceiver(
+        std::function<void(int32_t, bool, int64_t, bool, const vector<StatsEventParcel>&,
+                           const vector<StatsEventParcel>&)>
+                pullDeltaFinishCb)
+    : pullDeltaFinishCallback(std::move(pullDeltaFinishCb)) {
+}
+
+Status DeltaPullResultReceiver::pullFinished(int32_t atomTag, bool /*success*/,
+                                             const vector<StatsEventParcel>& /*output*/) {
+    pullDeltaFinishCallback(atomTag, /*success=*/false, /*token=*/0, /*fullSnapshot=*/false, {},
+                            {});
+    return Status::ok();
+}
+
+Status DeltaPullResultReceiver::pullDeltaFinished(int32_t atomTag, bool success, int64_t token,
+                                                  bool fullSnapshot,
+                                                  const vector<StatsEventParcel>& changed,
+                                                  const vector<StatsEventParcel>& removed) {
+    pullDeltaFinishCallback(atomTag, success, token, fullSnapshot, changed, removed);
+    return Status::ok();
+}
+
+DeltaPullResultReceiver::~DeltaPullResultReceiver() {
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
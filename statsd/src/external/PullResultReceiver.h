@@ -39,10 +39,47 @@ public:
     Status pullFinished(int32_t atomTag, bool success,
                         const vector<StatsEventParcel>& output) override;
 
+    /**
+     * Binder call for finishing a delta pull. Only delta pullers send it, so the pull failed.
+     */
+    Status pullDeltaFinished(int32_t atomTag, bool success, int64_t token, bool fullSnapshot,
+                             const vector<StatsEventParcel>& changed,
+                             const vector<StatsEventParcel>& removed) override;
+
 private:
     function<void(int32_t, bool, const vector<StatsEventParcel>&)> pullFinishCallback;
 };
 
+/**
+ * Result receiver of StatsDeltaCallbackPuller.
+ */
+class DeltaPullResultReceiver : public BnPullAtomResultReceiver {
+public:
+    DeltaPullResultReceiver(function<void(int32_t, bool, int64_t, bool,
+                                          const vector<StatsEventParcel>&,
+                                          const vector<StatsEventParcel>&)>
+                                    pullDeltaFinishCallback);
+    ~DeltaPullResultReceiver();
+
+    /**
+     * Binder call for finishing a pull. The puller did not return a delta, so the pull failed.
+     */
+    Status pullFinished(int32_t atomTag, bool success,
+                        const vector<StatsEventParcel>& output) override;
+
+    /**
+     * Binder call for finishing a delta pull.
+     */
+    Status pullDeltaFinished(int32_t atomTag, bool success, int64_t token, bool fullSnapshot,
+                             const vector<StatsEventParcel>& changed,
+                             const vector<StatsEventParcel>& removed) override;
+
+private:
+    function<void(int32_t, bool, int64_t, bool, const vector<StatsEventParcel>&,
+                  const vector<StatsEventParcel>&)>
+            pullDeltaFinishCallback;
+};
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
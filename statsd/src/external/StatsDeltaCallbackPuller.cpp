@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define STATSD_DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "StatsDeltaCallbackPuller.h"
+
+#include <aidl/android/util/StatsEventParcel.h>
+
+#include "PullResultReceiver.h"
+#include "guardrail/StatsdStats.h"
+#include "logd/LogEvent.h"
+#include "stats_log_util.h"
+
+using namespace std;
+
+using Status = ::ndk::ScopedAStatus;
+using aidl::android::util::StatsEventParcel;
+using ::ndk::SharedRefBase;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// Result of a delta pull, filled in by the result receiver.
+struct DeltaPullResult {
+    bool finished = false;
+    bool success = false;
+    // Whether all the rows could be parsed.
+    bool validRows = true;
+    int64_t token = 0;
+    bool fullSnapshot = false;
+    vector<shared_ptr<LogEvent>> changed;
+    vector<shared_ptr<LogEvent>> removed;
+};
+
+// Returns false if a parcel is not a valid event.
+bool parseRows(const vector<StatsEventParcel>& parcels, vector<shared_ptr<LogEvent>>* rows) {
+    rows->reserve(parcels.size());
+    for (const StatsEventParcel& parcel : parcels) {
+        shared_ptr<LogEvent> event = make_shared<LogEvent>(/*uid=*/-1, /*pid=*/-1);
+        if (!event->parseBuffer((uint8_t*)parcel.buffer.data(), parcel.buffer.size())) {
+            StatsdStats::getInstance().noteAtomError(event->GetTagId(), /*pull=*/true);
+            return false;
+        }
+        rows->push_back(event);
+    }
+    return true;
+}
+
+}  // anonymous namespace
+
+StatsDeltaCallbackPuller::StatsDeltaCallbackPuller(
+        int tagId, const shared_ptr<IDeltaPullAtomCallback>& callback, const int64_t coolDownNs,
+        int64_t timeoutNs, const vector<int> additiveFields, const vector<int>& keyFields)
+    : StatsPuller(tagId, coolDownNs, timeoutNs, additiveFields),
+      mCallback(callback),
+      mKeyFields(keyFields.begin(), keyFields.end()),
+      mToken(0) {
+    VLOG("StatsDeltaCallbackPuller created for tag %d", tagId);
+}
+
+PullErrorCode StatsDeltaCallbackPuller::PullInternal(vector<shared_ptr<LogEvent>>* data) {
+    VLOG("StatsDeltaCallbackPuller called for tag %d", mTagId);
+    if (mCallback == nullptr) {
+        ALOGW("No callback registered");
+        return PULL_FAIL;
+    }
+
+    // Shared variables needed in the result receiver.
+    shared_ptr<mutex> cv_mutex = make_shared<mutex>();
+    shared_ptr<condition_variable> cv = make_shared<condition_variable>();
+    shared_ptr<DeltaPullResult> result = make_shared<DeltaPullResult>();
+
+    shared_ptr<DeltaPullResultReceiver> resultReceiver =
+            SharedRefBase::make<DeltaPullResultReceiver>(
+                    [cv_mutex, cv, result](int32_t atomTag, bool success, int64_t token,
+                                           bool fullSnapshot,
+                                           const vector<StatsEventParcel>& changed,
+                                           const vector<StatsEventParcel>& removed) {
+                        // This is the result of the pull, executing in a statsd binder thread.
+                        // It is only applied if the pull did not time out.
+                        {
+                            lock_guard<mutex> lk(*cv_mutex);
+                            result->success = success;
+                            result->validRows = !success ||
+                                                (parseRows(changed, &result->changed) &&
+                                                 parseRows(removed, &result->removed));
+                            result->token = token;
+                            result->fullSnapshot = fullSnapshot;
+                            result->finished = true;
+                        }
+                        cv->notify_one();
+                    });
+
+    // Initiate the pull. This is a oneway call to a different process, except
+    // in unit tests. In process calls are not oneway.
+    const int64_t sinceToken = mToken;
+    Status status = mCallback->onPullAtomDelta(mTagId, sinceToken, resultReceiver);
+    if (!status.isOk()) {
+        StatsdStats::getInstance().notePullBinderCallFailed(mTagId);
+        if (status.getExceptionCode() == EX_TRANSACTION_FAILED &&
+            status.getStatus() == STATUS_DEAD_OBJECT) {
+            return PULL_DEAD_OBJECT;
+        }
+        return PULL_FAIL;
+    }
+
+    unique_lock<mutex> unique_lk(*cv_mutex);
+    // Wait until the pull finishes, or until the pull timeout.
+    cv->wait_for(unique_lk, chrono::nanoseconds(mPullTimeoutNs),
+                 [result] { return result->finished; });
+    if (!result->finished) {
+        // The provider may still send a delta that is never applied, so ask for all rows next
+        // time. The parent stats puller notes the timeout.
+        resetRows();
+        return PULL_SUCCESS;
+    }
+    if (!result->success) {
+        return PULL_FAIL;
+    }
+    if (!result->validRows) {
+        // The other rows of the delta can't be applied on their own.
+        resetRows();
+        return PULL_FAIL;
+    }
+
+    if (sinceToken == 0 || result->fullSnapshot) {
+        mRows.clear();
+    }
+    for (const shared_ptr<LogEvent>& row : result->removed) {
+        mRows.erase(getRowKey(*row));
+    }
+    for (shared_ptr<LogEvent>& row : result->changed) {
+        mRows[getRowKey(*row)] = std::move(row);
+    }
+    mToken = result->token;
+
+    // Unchanged rows were pulled earlier, but they describe the atom as of this pull.
+    const int64_t elapsedTimeNs = getElapsedRealtimeNs();
+    const int64_t wallClockNs = getWallClockNs();
+    data->reserve(mRows.size());
+    for (const auto& [key, row] : mRows) {
+        shared_ptr<LogEvent> event = make_shared<LogEvent>(*row);
+        event->setElapsedTimestampNs(elapsedTimeNs);
+        event->setLogdWallClockTimestampNs(wallClockNs);
+        data->push_back(std::move(event));
+    }
+    VLOG("StatsDeltaCallbackPuller::pull succeeded for %d, %zu changed and %zu removed rows of %zu",
+         mTagId, result->changed.size(), result->removed.size(), mRows.size());
+    return PULL_SUCCESS;
+}
+
+HashableDimensionKey StatsDeltaCallbackPuller::getRowKey(const LogEvent& row) const {
+    HashableDimensionKey key;
+    for (const FieldValue& value : row.getValues()) {
+        if (mKeyFields.find(value.mField.getPosAtDepth(0)) != mKeyFields.end()) {
+            key.addValue(value);
+        }
+    }
+    return key;
+}
+
+void StatsDeltaCallbackPuller::resetRows() {
+    mRows.clear();
+    mToken = 0;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <aidl/android/os/IDeltaPullAtomCallback.h>
+
+#include <set>
+#include <unordered_map>
+
+#include "HashableDimensionKey.h"
+#include "StatsPuller.h"
+
+using aidl::android::os::IDeltaPullAtomCallback;
+using std::shared_ptr;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Puller of an atom whose provider only returns the rows that changed since the previous pull,
+ * and the key fields of the rows that were removed. The puller keeps all the rows of the atom
+ * and returns them on every pull, so receivers see the same data as with StatsCallbackPuller.
+ */
+class StatsDeltaCallbackPuller : public StatsPuller {
+public:
+    explicit StatsDeltaCallbackPuller(int tagId,
+                                      const shared_ptr<IDeltaPullAtomCallback>& callback,
+                                      const int64_t coolDownNs, const int64_t timeoutNs,
+                                      const std::vector<int> additiveFields,
+                                      const std::vector<int>& keyFields);
+
+private:
+    PullErrorCode PullInternal(vector<std::shared_ptr<LogEvent>>* data) override;
+
+    // Returns the values of the key fields of the row.
+    HashableDimensionKey getRowKey(const LogEvent& row) const;
+
+    // Forgets the rows, so that the next pull asks for all of them.
+    void resetRows();
+
+    const shared_ptr<IDeltaPullAtomCallback> mCallback;
+
+    const std::set<int> mKeyFields;
+
+    // Token returned by the last applied pull, 0 if mRows is not in sync with the provider.
+    int64_t mToken;
+
+    // All rows of the atom as of mToken. Rows are copied when they are returned, since pulled
+    // data is modified by the caller.
+    std::unordered_map<HashableDimensionKey, std::shared_ptr<LogEvent>> mRows;
+
+    FRIEND_TEST(StatsDeltaCallbackPullerTest, PullFullSnapshot);
+    FRIEND_TEST(StatsDeltaCallbackPullerTest, PullDelta);
+    FRIEND_TEST(StatsDeltaCallbackPullerTest, PullFailKeepsRows);
+    FRIEND_TEST(StatsDeltaCallbackPullerTest, PullTimeoutResetsRows);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -25,12 +25,15 @@
 
 #include <algorithm>
 #include <iostream>
+#include <set>
+#include <unordered_map>
 
 #include "../StatsService.h"
 #include "../logd/LogEvent.h"
 #include "../stats_log_util.h"
 #include "../statscompanion_util.h"
 #include "StatsCallbackPuller.h"
+#include "StatsDeltaCallbackPuller.h"
 #include "TrainInfoPuller.h"
 #include "statslog_statsd.h"
 
@@ -67,6 +70,29 @@ bool StatsPullerManager::Pull(int tagId, const vector<int32_t>& uids, const int6
 bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
                                     const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
     vector<int32_t> uids;
+    if (!getPullAtomUidsLocked(tagId, configKey, &uids)) {
+        return false;
+    }
+    return PullLocked(tagId, uids, eventTimeNs, data);
+}
+
+bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
+                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
+    VLOG("Initiating pulling %d", tagId);
+    int pullerUid;
+    sp<StatsPuller> puller = findPullerLocked(tagId, uids, &pullerUid);
+    if (puller == nullptr) {
+        return false;  // Return early since we don't know what to pull.
+    }
+    PullErrorCode status = pullAndNoteStatus(tagId, puller, eventTimeNs, data);
+    if (status == PULL_DEAD_OBJECT) {
+        removeDeadPullerLocked(tagId, pullerUid, puller);
+    }
+    return status == PULL_SUCCESS;
+}
+
+bool StatsPullerManager::getPullAtomUidsLocked(int tagId, const ConfigKey& configKey,
+                                               vector<int32_t>* uids) {
     const auto& uidProviderIt = mPullUidProviders.find(configKey);
     if (uidProviderIt == mPullUidProviders.end()) {
         ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
@@ -81,36 +107,47 @@ bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
         StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
         return false;
     }
-    uids = pullUidProvider->getPullAtomUids(tagId);
-    return PullLocked(tagId, uids, eventTimeNs, data);
+    *uids = pullUidProvider->getPullAtomUids(tagId);
+    return true;
 }
 
-bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
-                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data) {
-    VLOG("Initiating pulling %d", tagId);
+sp<StatsPuller> StatsPullerManager::findPullerLocked(int tagId, const vector<int32_t>& uids,
+                                                     int* pullerUid) {
     for (int32_t uid : uids) {
         PullerKey key = {.atomTag = tagId, .uid = uid};
         auto pullerIt = kAllPullAtomInfo.find(key);
         if (pullerIt != kAllPullAtomInfo.end()) {
-            PullErrorCode status = pullerIt->second->Pull(eventTimeNs, data);
-            VLOG("pulled %zu items", data->size());
-            if (status != PULL_SUCCESS) {
-                StatsdStats::getInstance().notePullFailed(tagId);
-            }
-            // If we received a dead object exception, it means the client process has died.
-            // We can remove the puller from the map.
-            if (status == PULL_DEAD_OBJECT) {
-                StatsdStats::getInstance().notePullerCallbackRegistrationChanged(
-                        tagId,
-                        /*registered=*/false);
-                kAllPullAtomInfo.erase(pullerIt);
-            }
-            return status == PULL_SUCCESS;
+            *pullerUid = uid;
+            return pullerIt->second;
         }
     }
     StatsdStats::getInstance().notePullerNotFound(tagId);
     ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-    return false;  // Return early since we don't know what to pull.
+    return nullptr;
+}
+
+PullErrorCode StatsPullerManager::pullAndNoteStatus(int tagId, const sp<StatsPuller>& puller,
+                                                    const int64_t eventTimeNs,
+                                                    vector<shared_ptr<LogEvent>>* data) {
+    PullErrorCode status = puller->Pull(eventTimeNs, data);
+    VLOG("pulled %zu items", data->size());
+    if (status != PULL_SUCCESS) {
+        StatsdStats::getInstance().notePullFailed(tagId);
+    }
+    return status;
+}
+
+void StatsPullerManager::removeDeadPullerLocked(int tagId, int pullerUid,
+                                                const sp<StatsPuller>& puller) {
+    // If we received a dead object exception, it means the client process has died.
+    // We can remove the puller from the map.
+    PullerKey key = {.atomTag = tagId, .uid = pullerUid};
+    auto pullerIt = kAllPullAtomInfo.find(key);
+    if (pullerIt != kAllPullAtomInfo.end() && pullerIt->second == puller) {
+        StatsdStats::getInstance().notePullerCallbackRegistrationChanged(tagId,
+                                                                         /*registered=*/false);
+        kAllPullAtomInfo.erase(pullerIt);
+    }
 }
 
 bool StatsPullerManager::PullerForMatcherExists(int tagId) const {
@@ -172,12 +209,15 @@ void StatsPullerManager::RegisterReceiver(int tagId, const ConfigKey& configKey,
 
     receiverInfo.intervalNs = roundedIntervalNs;
     receiverInfo.nextPullTimeNs = nextPullTimeNs;
+    receiverInfo.alignmentToleranceNs = std::min(
+            roundedIntervalNs / kPullAlignmentToleranceDivisor, kMaxPullAlignmentToleranceNs);
     receivers.push_back(receiverInfo);
 
     // There is only one alarm for all pulled events. So only set it to the smallest denom.
-    if (nextPullTimeNs < mNextPullTimeNs) {
+    const int64_t nextScheduledPullTimeNs = getNextPullTimeLocked();
+    if (nextScheduledPullTimeNs < mNextPullTimeNs) {
         VLOG("Updating next pull time %lld", (long long)mNextPullTimeNs);
-        mNextPullTimeNs = nextPullTimeNs;
+        mNextPullTimeNs = nextScheduledPullTimeNs;
         updateAlarmLocked();
     }
     VLOG("Puller for tagId %d registered of %d", tagId, (int)receivers.size());
@@ -216,15 +256,62 @@ void StatsPullerManager::UnregisterPullUidProvider(const ConfigKey& configKey,
     }
 }
 
+std::map<int, int64_t> StatsPullerManager::getScheduledPullTimesLocked() const {
+    // Each receiver can be pulled between its next pull time and its tolerance after that. The
+    // earliest end of these windows is the latest time the next pull of the atom can happen, and
+    // the pull serves every receiver whose window has started by then.
+    std::map<int, int64_t> deadlines;
+    for (const auto& [key, receivers] : mReceivers) {
+        for (const ReceiverInfo& receiverInfo : receivers) {
+            const int64_t deadlineNs =
+                    receiverInfo.nextPullTimeNs + receiverInfo.alignmentToleranceNs;
+            const auto [it, inserted] = deadlines.try_emplace(key.atomTag, deadlineNs);
+            if (!inserted) {
+                it->second = std::min(it->second, deadlineNs);
+            }
+        }
+    }
+
+    // Pull as soon as all the receivers served by the pull are due.
+    std::map<int, int64_t> pullTimes;
+    for (const auto& [key, receivers] : mReceivers) {
+        for (const ReceiverInfo& receiverInfo : receivers) {
+            if (receiverInfo.nextPullTimeNs > deadlines[key.atomTag]) {
+                continue;
+            }
+            const auto [it, inserted] =
+                    pullTimes.try_emplace(key.atomTag, receiverInfo.nextPullTimeNs);
+            if (!inserted) {
+                it->second = std::max(it->second, receiverInfo.nextPullTimeNs);
+            }
+        }
+    }
+    return pullTimes;
+}
+
+int64_t StatsPullerManager::getNextPullTimeLocked() const {
+    int64_t nextPullTimeNs = NO_ALARM_UPDATE;
+    for (const auto& [atomTag, pullTimeNs] : getScheduledPullTimesLocked()) {
+        nextPullTimeNs = std::min(nextPullTimeNs, pullTimeNs);
+    }
+    return nextPullTimeNs;
+}
+
 void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
     std::lock_guard<std::mutex> _l(mLock);
     int64_t wallClockNs = getWallClockNs();
 
-    int64_t minNextPullTimeNs = NO_ALARM_UPDATE;
+    const std::map<int, int64_t> scheduledPullTimes = getScheduledPullTimesLocked();
 
     vector<pair<const ReceiverKey*, vector<ReceiverInfo*>>> needToPull;
     for (auto& pair : mReceivers) {
         vector<ReceiverInfo*> receivers;
+        const auto pullTimeIt = scheduledPullTimes.find(pair.first.atomTag);
+        if (pullTimeIt != scheduledPullTimes.end() && pullTimeIt->second > elapsedTimeNs) {
+            // The receivers that are due wait for receivers of the atom that are due a bit later,
+            // to share one pull with them.
+            continue;
+        }
         if (pair.second.size() != 0) {
             for (ReceiverInfo& receiverInfo : pair.second) {
                 // If pullNecessary and enough time has passed for the next bucket, then add
@@ -242,7 +329,6 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
                         receiverInfo.nextPullTimeNs +=
                                 (numBucketsAhead + 1) * receiverInfo.intervalNs;
                     }
-                    minNextPullTimeNs = min(receiverInfo.nextPullTimeNs, minNextPullTimeNs);
                 }
             }
             if (receivers.size() > 0) {
@@ -250,12 +336,72 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
             }
         }
     }
+
+    // Resolve the pullers while holding mLock. Configs that pull the atom from the same puller
+    // share one pull, and all their receivers get the same data. The pulls themselves only touch
+    // the pullers, which have their own lock, so the due atoms are pulled concurrently and one
+    // slow puller does not delay the others. Each pull still gives up after the timeout of its
+    // puller.
+    vector<ScheduledPull> scheduledPulls;
+    scheduledPulls.reserve(needToPull.size());
+    std::unordered_map<const StatsPuller*, size_t> pullIndexByPuller;
     for (const auto& pullInfo : needToPull) {
+        vector<int32_t> uids;
+        sp<StatsPuller> puller;
+        int pullerUid = -1;
+        if (getPullAtomUidsLocked(pullInfo.first->atomTag, pullInfo.first->configKey, &uids)) {
+            puller = findPullerLocked(pullInfo.first->atomTag, uids, &pullerUid);
+        }
+        if (puller != nullptr) {
+            const auto [it, inserted] =
+                    pullIndexByPuller.try_emplace(puller.get(), scheduledPulls.size());
+            if (!inserted) {
+                vector<ReceiverInfo*>& receivers = scheduledPulls[it->second].receivers;
+                receivers.insert(receivers.end(), pullInfo.second.begin(), pullInfo.second.end());
+                continue;
+            }
+        }
+        ScheduledPull& scheduledPull = scheduledPulls.emplace_back();
+        scheduledPull.atomTag = pullInfo.first->atomTag;
+        scheduledPull.puller = puller;
+        scheduledPull.pullerUid = pullerUid;
+        scheduledPull.receivers = pullInfo.second;
+    }
+
+    // Without the alignment, each distinct pull time of the receivers served by the scheduled pull
+    // would have had its own pull. Receivers due after the scheduled pull time are only pulled now
+    // because the alarm fired late, and would have shared the pull anyway.
+    for (const ScheduledPull& scheduledPull : scheduledPulls) {
+        if (scheduledPull.puller == nullptr) {
+            continue;
+        }
+        const int64_t scheduledPullTimeNs = scheduledPullTimes.at(scheduledPull.atomTag);
+        std::set<int64_t> alignedPullTimes;
+        for (const ReceiverInfo* receiverInfo : scheduledPull.receivers) {
+            if (receiverInfo->nextPullTimeNs <= scheduledPullTimeNs) {
+                alignedPullTimes.insert(receiverInfo->nextPullTimeNs);
+            }
+        }
+        if (alignedPullTimes.size() > 1) {
+            StatsdStats::getInstance().notePullsSavedByAlignment(scheduledPull.atomTag,
+                                                                 alignedPullTimes.size() - 1);
+        }
+    }
+
+    mPullRunner.run(scheduledPulls.size(), [&](size_t pullIndex) {
+        ScheduledPull& scheduledPull = scheduledPulls[pullIndex];
+
         vector<shared_ptr<LogEvent>> data;
-        PullResult pullResult =
-                PullLocked(pullInfo.first->atomTag, pullInfo.first->configKey, elapsedTimeNs, &data)
-                        ? PullResult::PULL_RESULT_SUCCESS
-                        : PullResult::PULL_RESULT_FAIL;
+        PullResult pullResult = PullResult::PULL_RESULT_FAIL;
+        if (scheduledPull.puller != nullptr) {
+            StatsdStats::getInstance().notePullAlarmToStart(
+                    scheduledPull.atomTag, getElapsedRealtimeNs() - elapsedTimeNs);
+            scheduledPull.status = pullAndNoteStatus(scheduledPull.atomTag, scheduledPull.puller,
+                                                     elapsedTimeNs, &data);
+            if (scheduledPull.status == PULL_SUCCESS) {
+                pullResult = PullResult::PULL_RESULT_SUCCESS;
+            }
+        }
         if (pullResult == PullResult::PULL_RESULT_FAIL) {
             VLOG("pull failed at %lld, will try again later", (long long)elapsedTimeNs);
         }
@@ -267,29 +413,53 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
         // Here the triggering event is alarm fired from AlarmManager.
         // In ValueMetricProducer and GaugeMetricProducer we do same thing
         // when pull on condition change, etc.
+        // The events may be shared with the cache of the puller. They are only stamped here, once
+        // per pull, and are not modified afterwards. Other pulls from the same puller wait for
+        // mLock.
         for (auto& event : data) {
             event->setElapsedTimestampNs(elapsedTimeNs);
             event->setLogdWallClockTimestampNs(wallClockNs);
         }
 
-        for (const auto& receiverInfo : pullInfo.second) {
-            sp<PullDataReceiver> receiverPtr = receiverInfo->receiver.promote();
-            if (receiverPtr != nullptr) {
-                receiverPtr->onDataPulled(data, pullResult, elapsedTimeNs);
+        // Every receiver is a different metric with its own lock, and the pulled data is not
+        // modified by the receivers, so they can process the same pull in parallel. The receivers
+        // of different pulls are different metrics as well. They share the threads of the pulls,
+        // and this thread keeps processing them if the other threads are busy.
+        const vector<ReceiverInfo*>& receivers = scheduledPull.receivers;
+        scheduledPull.receiverPtrs.resize(receivers.size());
+        mPullRunner.run(receivers.size(), [&](size_t i) {
+            scheduledPull.receiverPtrs[i] = receivers[i]->receiver.promote();
+            if (scheduledPull.receiverPtrs[i] != nullptr) {
+                scheduledPull.receiverPtrs[i]->onDataPulled(data, pullResult, elapsedTimeNs);
+            }
+        });
+        StatsdStats::getInstance().notePullAlarmToCompletion(
+                scheduledPull.atomTag, getElapsedRealtimeNs() - elapsedTimeNs);
+    });
+
+    for (const ScheduledPull& scheduledPull : scheduledPulls) {
+        if (scheduledPull.status == PULL_DEAD_OBJECT) {
+            removeDeadPullerLocked(scheduledPull.atomTag, scheduledPull.pullerUid,
+                                   scheduledPull.puller);
+        }
+
+        for (size_t i = 0; i < scheduledPull.receivers.size(); i++) {
+            ReceiverInfo* receiverInfo = scheduledPull.receivers[i];
+            if (scheduledPull.receiverPtrs[i] != nullptr) {
                 // We may have just come out of a coma, compute next pull time.
                 int numBucketsAhead =
                         (elapsedTimeNs - receiverInfo->nextPullTimeNs) / receiverInfo->intervalNs;
                 receiverInfo->nextPullTimeNs += (numBucketsAhead + 1) * receiverInfo->intervalNs;
-                minNextPullTimeNs = min(receiverInfo->nextPullTimeNs, minNextPullTimeNs);
             } else {
                 VLOG("receiver already gone.");
             }
         }
     }
 
+    const int64_t nextPullTimeNs = getNextPullTimeLocked();
     VLOG("mNextPullTimeNs: %lld updated to %lld", (long long)mNextPullTimeNs,
-         (long long)minNextPullTimeNs);
-    mNextPullTimeNs = minNextPullTimeNs;
+         (long long)nextPullTimeNs);
+    mNextPullTimeNs = nextPullTimeNs;
     updateAlarmLocked();
 }
 
@@ -328,6 +498,35 @@ void StatsPullerManager::RegisterPullAtomCallback(const int uid, const int32_t a
 
     sp<StatsCallbackPuller> puller = new StatsCallbackPuller(atomTag, callback, actualCoolDownNs,
                                                              actualTimeoutNs, additiveFields);
+    registerPullerLocked(uid, atomTag, puller);
+}
+
+void StatsPullerManager::RegisterDeltaPullAtomCallback(
+        const int uid, const int32_t atomTag, const int64_t coolDownNs, const int64_t timeoutNs,
+        const vector<int32_t>& additiveFields, const vector<int32_t>& keyFields,
+        const shared_ptr<IDeltaPullAtomCallback>& callback) {
+    std::lock_guard<std::mutex> _l(mLock);
+    VLOG("RegisterDeltaPullAtomCallback: adding puller for tag %d", atomTag);
+
+    if (callback == nullptr) {
+        ALOGW("SetDeltaPullAtomCallback called with null callback for atom %d.", atomTag);
+        return;
+    }
+    if (keyFields.empty()) {
+        ALOGW("SetDeltaPullAtomCallback called without key fields for atom %d.", atomTag);
+        return;
+    }
+
+    int64_t actualCoolDownNs = coolDownNs < kMinCoolDownNs ? kMinCoolDownNs : coolDownNs;
+    int64_t actualTimeoutNs = timeoutNs > kMaxTimeoutNs ? kMaxTimeoutNs : timeoutNs;
+
+    sp<StatsDeltaCallbackPuller> puller = new StatsDeltaCallbackPuller(
+            atomTag, callback, actualCoolDownNs, actualTimeoutNs, additiveFields, keyFields);
+    registerPullerLocked(uid, atomTag, puller);
+}
+
+void StatsPullerManager::registerPullerLocked(const int uid, const int32_t atomTag,
+                                              const sp<StatsPuller>& puller) {
     PullerKey key = {.atomTag = atomTag, .uid = uid};
     auto it = kAllPullAtomInfo.find(key);
     if (it != kAllPullAtomInfo.end()) {
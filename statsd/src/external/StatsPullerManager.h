@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <aidl/android/os/IDeltaPullAtomCallback.h>
 #include <aidl/android/os/IPullAtomCallback.h>
 #include <aidl/android/os/IStatsCompanionService.h>
 #include <utils/RefBase.h>
@@ -29,7 +30,9 @@
 #include "guardrail/StatsdStats.h"
 #include "logd/LogEvent.h"
 #include "packages/UidMap.h"
+#include "utils/ParallelRunner.h"
 
+using aidl::android::os::IDeltaPullAtomCallback;
 using aidl::android::os::IPullAtomCallback;
 using aidl::android::os::IStatsCompanionService;
 using std::shared_ptr;
@@ -68,7 +71,8 @@ public:
 
 
     // Registers a receiver for tagId. It will be pulled on the nextPullTimeNs
-    // and then every intervalNs thereafter.
+    // and then every intervalNs thereafter. A pull may be delayed by a small
+    // fraction of intervalNs to share it with other receivers of tagId.
     virtual void RegisterReceiver(int tagId, const ConfigKey& configKey,
                                   wp<PullDataReceiver> receiver, int64_t nextPullTimeNs,
                                   int64_t intervalNs);
@@ -120,6 +124,14 @@ public:
                                   const int64_t timeoutNs, const vector<int32_t>& additiveFields,
                                   const shared_ptr<IPullAtomCallback>& callback);
 
+    // Registers a callback that only returns the rows that changed since the previous pull.
+    // keyFields identify the rows and must not be empty.
+    void RegisterDeltaPullAtomCallback(const int uid, const int32_t atomTag,
+                                       const int64_t coolDownNs, const int64_t timeoutNs,
+                                       const vector<int32_t>& additiveFields,
+                                       const vector<int32_t>& keyFields,
+                                       const shared_ptr<IDeltaPullAtomCallback>& callback);
+
     void UnregisterPullAtomCallback(const int uid, const int32_t atomTag);
 
     std::map<const PullerKey, sp<StatsPuller>> kAllPullAtomInfo;
@@ -127,6 +139,14 @@ public:
 private:
     const static int64_t kMinCoolDownNs = NS_PER_SEC;
     const static int64_t kMaxTimeoutNs = 10 * NS_PER_SEC;
+    // Max number of threads pulling atoms and processing their receivers when the pull alarm
+    // fires, including the alarm thread.
+    const static size_t kMaxPullThreads = 4;
+    // A scheduled pull may be delayed by 1/kPullAlignmentToleranceDivisor of the pull interval of
+    // the receiver, and at most by kMaxPullAlignmentToleranceNs, to share the pull with other
+    // receivers of the atom. Pulled data is still attributed to the end of the bucket it closes.
+    const static int64_t kPullAlignmentToleranceDivisor = 100;
+    const static int64_t kMaxPullAlignmentToleranceNs = 10 * NS_PER_SEC;
     shared_ptr<IStatsCompanionService> mStatsCompanionService = nullptr;
 
     // A struct containing an atom id and a Config Key
@@ -142,6 +162,8 @@ private:
     typedef struct {
         int64_t nextPullTimeNs;
         int64_t intervalNs;
+        // How long the pull can be delayed after nextPullTimeNs.
+        int64_t alignmentToleranceNs;
         wp<PullDataReceiver> receiver;
     } ReceiverInfo;
 
@@ -157,11 +179,54 @@ private:
     bool PullLocked(int tagId, const vector<int32_t>& uids, const int64_t eventTimeNs,
                     vector<std::shared_ptr<LogEvent>>* data);
 
+    // Gets the uids to pull tagId from for the config. Returns false if the config has no
+    // PullUidProvider.
+    bool getPullAtomUidsLocked(int tagId, const ConfigKey& configKey, vector<int32_t>* uids);
+
+    // Returns the puller of tagId registered by the first of uids that has one, or nullptr.
+    sp<StatsPuller> findPullerLocked(int tagId, const vector<int32_t>& uids, int* pullerUid);
+
+    // Pulls from puller and notes failures. Does not need mLock.
+    static PullErrorCode pullAndNoteStatus(int tagId, const sp<StatsPuller>& puller,
+                                           const int64_t eventTimeNs,
+                                           vector<std::shared_ptr<LogEvent>>* data);
+
+    // Registers the puller of atomTag for uid, replacing the previous one.
+    void registerPullerLocked(const int uid, const int32_t atomTag, const sp<StatsPuller>& puller);
+
+    // Removes the puller after its process died, unless it was registered again since.
+    void removeDeadPullerLocked(int tagId, int pullerUid, const sp<StatsPuller>& puller);
+
+    // A pull issued when the pull alarm fires.
+    struct ScheduledPull {
+        int atomTag;
+        sp<StatsPuller> puller;
+        int pullerUid = -1;
+        PullErrorCode status = PULL_FAIL;
+        // The receivers of every config that pulls the atom from the puller.
+        vector<ReceiverInfo*> receivers;
+        // The receivers that were still alive when the data was delivered.
+        vector<sp<PullDataReceiver>> receiverPtrs;
+    };
+
     // locks for data receiver and StatsCompanionService changes
     std::mutex mLock;
 
+    // Runs the pulls due when the pull alarm fires, and the receivers of each pull. Its threads are
+    // started by the first alarm and kept for the lifetime of the manager, so an alarm does not
+    // start any thread.
+    ParallelRunner mPullRunner{kMaxPullThreads};
+
     void updateAlarmLocked();
 
+    // Returns the time of the next scheduled pull of every atom that has receivers. The pull is
+    // delayed to the latest pull time of the receivers that can share it without going past the
+    // tolerance of any of them, which is the fewest pulls that serve all the receivers on time.
+    std::map<int, int64_t> getScheduledPullTimesLocked() const;
+
+    // Returns the earliest scheduled pull time of all atoms, or NO_ALARM_UPDATE if there is none.
+    int64_t getNextPullTimeLocked() const;
+
     int64_t mNextPullTimeNs;
 
     FRIEND_TEST(GaugeMetricE2ePulledTest, TestFirstNSamplesPulledNoTrigger);
@@ -176,6 +241,9 @@ private:
 
     FRIEND_TEST(StatsLogProcessorTest, TestPullUidProviderSetOnConfigUpdate);
 
+    FRIEND_TEST(StatsPullerManagerTest, TestOnAlarmFiredAlignsPullsAcrossConfigs);
+    FRIEND_TEST(StatsPullerManagerTest, TestOnAlarmFiredDoesNotDelayPullsPastTolerance);
+
     FRIEND_TEST(ConfigUpdateE2eTest, TestGaugeMetric);
     FRIEND_TEST(ConfigUpdateE2eTest, TestValueMetric);
 };
@@ -18,6 +18,11 @@
 #include "Log.h"
 
 #include "puller_util.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "HashableDimensionKey.h"
 #include "stats_log_util.h"
 
 namespace android {
@@ -26,6 +31,70 @@ namespace statsd {
 
 using namespace std;
 
+namespace {
+
+// Repeated additive fields are treated as non-additive fields.
+inline bool isAdditiveField(const FieldValue& fieldValue, const set<int>& additiveFields) {
+    return !isPrimitiveRepeatedField(fieldValue.mField) &&
+           additiveFields.find(fieldValue.mField.getPosAtDepth(0)) != additiveFields.end();
+}
+
+// Hashes the fields of the event and the values of its non-additive fields, which is what events
+// must share to be merged.
+android::hash_t hashMergeKey(const vector<FieldValue>& values, const set<int>& additiveFields) {
+    android::hash_t hash = android::hash_type(values.size());
+    for (const FieldValue& fieldValue : values) {
+        if (isAdditiveField(fieldValue, additiveFields)) {
+            hash = android::JenkinsHashMix(hash, android::hash_type(fieldValue.mField.getField()));
+        } else {
+            hash = hashFieldValue(hash, fieldValue);
+        }
+    }
+    return JenkinsHashWhiten(hash);
+}
+
+// Events can be merged if they have the same length (attribution chains and repeated fields), the
+// same fields, and the same values in the non-additive fields.
+bool canMerge(const vector<FieldValue>& lhsValues, const vector<FieldValue>& rhsValues,
+              const set<int>& additiveFields) {
+    if (lhsValues.size() != rhsValues.size()) {
+        return false;
+    }
+    for (size_t p = 0; p < lhsValues.size(); p++) {
+        if (lhsValues[p].mField != rhsValues[p].mField) {
+            return false;
+        }
+        if (lhsValues[p].mValue != rhsValues[p].mValue &&
+            !isAdditiveField(lhsValues[p], additiveFields)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Orders events by size, then by their fields and the values of their non-additive fields. This is
+// the order of sorting the events before merging them, without depending on the additive values
+// that merging changes.
+bool lessIgnoringAdditiveValues(const vector<FieldValue>& lhsValues,
+                                const vector<FieldValue>& rhsValues,
+                                const set<int>& additiveFields) {
+    if (lhsValues.size() != rhsValues.size()) {
+        return lhsValues.size() < rhsValues.size();
+    }
+    for (size_t p = 0; p < lhsValues.size(); p++) {
+        if (lhsValues[p].mField != rhsValues[p].mField) {
+            return lhsValues[p].mField < rhsValues[p].mField;
+        }
+        if (lhsValues[p].mValue != rhsValues[p].mValue &&
+            !isAdditiveField(lhsValues[p], additiveFields)) {
+            return lhsValues[p].mValue < rhsValues[p].mValue;
+        }
+    }
+    return false;
+}
+
+}  // anonymous namespace
+
 /**
  * Process all data and merge isolated with host if necessary.
  * For example:
@@ -45,6 +114,8 @@ using namespace std;
  * [uid1, fg, 200, 400]
  * [uid1, bg, 100, 200]
  *
+ * The result is sorted by fields and non-additive values. GaugeMetricProducer keeps the first
+ * atoms of each dimension, so the order of the pulled atoms matters.
  * All atoms should be of the same tagId. All fields should be present.
  */
 void mapAndMergeIsolatedUidsToHostUid(vector<shared_ptr<LogEvent>>& data, const sp<UidMap>& uidMap,
@@ -80,77 +151,52 @@ void mapAndMergeIsolatedUidsToHostUid(vector<shared_ptr<LogEvent>>& data, const
         }
     }
 
-    // 2. sort the data, bit-wise
-    sort(data.begin(), data.end(),
-         [](const shared_ptr<LogEvent>& lhs, const shared_ptr<LogEvent>& rhs) {
-             if (lhs->size() != rhs->size()) {
-                 return lhs->size() < rhs->size();
-             }
-             const std::vector<FieldValue>& lhsValues = lhs->getValues();
-             const std::vector<FieldValue>& rhsValues = rhs->getValues();
-             for (int i = 0; i < (int)lhs->size(); i++) {
-                 if (lhsValues[i] != rhsValues[i]) {
-                     return lhsValues[i] < rhsValues[i];
-                 }
-             }
-             return false;
-         });
-
-    vector<shared_ptr<LogEvent>> mergedData;
+    // 2. Merge in one pass. Each event is merged into the first kept event it can be merged with.
     const set<int> additiveFields(additiveFieldsVec.begin(), additiveFieldsVec.end());
-    bool needMerge = true;
-
-    // 3. do the merge.
-    // The loop invariant is this: for every event,
-    // - check if it has a different length (means different attribution chains or repeated fields)
-    // - check if fields are different
-    // - check if non-additive field values are different (non-additive is default for repeated
-    // fields)
-    // If any are true, no need to merge, add itself to the result. Otherwise, merge the
-    // value onto the one immediately next to it.
-    for (int i = 0; i < (int)data.size() - 1; i++) {
-        // Size different, must be different chains or repeated fields.
-        if (data[i]->size() != data[i + 1]->size()) {
-            mergedData.push_back(data[i]);
-            continue;
-        }
-        vector<FieldValue>* lhsValues = data[i]->getMutableValues();
-        vector<FieldValue>* rhsValues = data[i + 1]->getMutableValues();
-        needMerge = true;
-        for (int p = 0; p < (int)lhsValues->size(); p++) {
-            if ((*lhsValues)[p].mField != (*rhsValues)[p].mField) {
-                needMerge = false;
-                break;
+    // Index of the last kept event with a given hash. Events with colliding hashes are chained
+    // through prevWithSameHash, which is indexed like the kept events.
+    unordered_map<android::hash_t, int> lastWithHash;
+    lastWithHash.reserve(data.size());
+    vector<int> prevWithSameHash;
+    prevWithSameHash.reserve(data.size());
+    size_t numKept = 0;
+    for (size_t i = 0; i < data.size(); i++) {
+        const vector<FieldValue>& values = data[i]->getValues();
+        const android::hash_t hash = hashMergeKey(values, additiveFields);
+        auto [it, inserted] = lastWithHash.try_emplace(hash, numKept);
+        if (!inserted) {
+            int target = it->second;
+            while (target >= 0 && !canMerge(data[target]->getValues(), values, additiveFields)) {
+                target = prevWithSameHash[target];
             }
-            if ((*lhsValues)[p].mValue != (*rhsValues)[p].mValue) {
-                int pos = (*lhsValues)[p].mField.getPosAtDepth(0);
-                // Differ on non-additive field, abort.
-                // Repeated additive fields are treated as non-additive fields.
-                if (isPrimitiveRepeatedField((*lhsValues)[p].mField) ||
-                    (additiveFields.find(pos) == additiveFields.end())) {
-                    needMerge = false;
-                    break;
+            if (target >= 0) {
+                vector<FieldValue>* targetValues = data[target]->getMutableValues();
+                for (size_t p = 0; p < values.size(); p++) {
+                    if (isAdditiveField(values[p], additiveFields)) {
+                        (*targetValues)[p].mValue += values[p].mValue;
+                    }
                 }
+                continue;
             }
+            // Hash collision with events it can't be merged with.
+            prevWithSameHash.push_back(it->second);
+            it->second = numKept;
+        } else {
+            prevWithSameHash.push_back(-1);
         }
-        if (!needMerge) {
-            mergedData.push_back(data[i]);
-            continue;
-        }
-        // This should be infrequent operation.
-        for (int p = 0; p < (int)lhsValues->size(); p++) {
-            int pos = (*lhsValues)[p].mField.getPosAtDepth(0);
-            // Don't merge repeated fields.
-            if (!isPrimitiveRepeatedField((*lhsValues)[p].mField) &&
-                (additiveFields.find(pos) != additiveFields.end())) {
-                (*rhsValues)[p].mValue += (*lhsValues)[p].mValue;
-            }
+        if (numKept != i) {
+            data[numKept] = std::move(data[i]);
         }
+        numKept++;
     }
-    mergedData.push_back(data.back());
+    data.resize(numKept);
 
-    data.clear();
-    data = mergedData;
+    // 3. Sort the merged events. Events merged away are not sorted.
+    sort(data.begin(), data.end(),
+         [&additiveFields](const shared_ptr<LogEvent>& lhs, const shared_ptr<LogEvent>& rhs) {
+             return lessIgnoringAdditiveValues(lhs->getValues(), rhs->getValues(),
+                                               additiveFields);
+         });
 }
 
 }  // namespace statsd
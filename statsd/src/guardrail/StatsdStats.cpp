@@ -58,6 +58,8 @@ const int FIELD_ID_OVERFLOW = 18;
 const int FIELD_ID_ACTIVATION_BROADCAST_GUARDRAIL = 19;
 const int FIELD_ID_RESTRICTED_METRIC_QUERY_STATS = 20;
 const int FIELD_ID_SHARD_OFFSET = 21;
+const int FIELD_ID_DUMP_REPORT_QUEUE_STATS = 22;
+const int FIELD_ID_DUMP_REPORT_MEMORY_STATS = 23;
 
 const int FIELD_ID_RESTRICTED_METRIC_QUERY_STATS_CALLING_UID = 1;
 const int FIELD_ID_RESTRICTED_METRIC_QUERY_STATS_CONFIG_ID = 2;
@@ -89,6 +91,12 @@ const int FIELD_ID_OVERFLOW_COUNT = 1;
 const int FIELD_ID_OVERFLOW_MAX_HISTORY = 2;
 const int FIELD_ID_OVERFLOW_MIN_HISTORY = 3;
 
+const int FIELD_ID_DUMP_REPORT_QUEUE_STATS_COUNT = 1;
+const int FIELD_ID_DUMP_REPORT_QUEUE_STATS_MAX_SIZE = 2;
+
+const int FIELD_ID_DUMP_REPORT_MEMORY_STATS_LIFETIME_PEAK_RSS = 1;
+const int FIELD_ID_DUMP_REPORT_MEMORY_STATS_MAX_LIFETIME_PEAK_RSS_INCREASE = 2;
+
 const int FIELD_ID_CONFIG_STATS_UID = 1;
 const int FIELD_ID_CONFIG_STATS_ID = 2;
 const int FIELD_ID_CONFIG_STATS_CREATION = 3;
@@ -121,6 +129,8 @@ const int FIELD_ID_CONFIG_STATS_RESTRICTED_DB_CORRUPTED_COUNT = 27;
 const int FIELD_ID_CONFIG_STATS_RESTRICTED_CONFIG_FLUSH_LATENCY = 28;
 const int FIELD_ID_CONFIG_STATS_RESTRICTED_CONFIG_DB_SIZE_TIME_SEC = 29;
 const int FIELD_ID_CONFIG_STATS_RESTRICTED_CONFIG_DB_SIZE_BYTES = 30;
+const int FIELD_ID_CONFIG_STATS_CONDITION_QUERY_CACHE_HITS = 31;
+const int FIELD_ID_CONFIG_STATS_CONDITION_QUERY_CACHE_MISSES = 32;
 
 const int FIELD_ID_INVALID_CONFIG_REASON_ENUM = 1;
 const int FIELD_ID_INVALID_CONFIG_REASON_METRIC_ID = 2;
@@ -321,6 +331,21 @@ void StatsdStats::noteEventQueueOverflow(int64_t oldestEventTimestampNs, int32_t
     noteAtomDroppedLocked(atomId);
 }
 
+void StatsdStats::noteDumpReportQueueSize(size_t maxQueueSize) {
+    lock_guard<std::mutex> lock(mLock);
+    mDumpReportCount++;
+    mMaxQueueSizeDuringDumps = std::max(mMaxQueueSizeDuringDumps, (int64_t)maxQueueSize);
+}
+
+void StatsdStats::noteDumpReportLifetimePeakRss(int64_t lifetimePeakRssKb,
+                                                int64_t lifetimePeakRssIncreaseKb) {
+    lock_guard<std::mutex> lock(mLock);
+    // Concurrent dumps may report out of order, and the lifetime peak never decreases.
+    mDumpReportLifetimePeakRssKb = std::max(mDumpReportLifetimePeakRssKb, lifetimePeakRssKb);
+    mMaxDumpReportLifetimePeakRssIncreaseKb =
+            std::max(mMaxDumpReportLifetimePeakRssIncreaseKb, lifetimePeakRssIncreaseKb);
+}
+
 void StatsdStats::noteAtomDroppedLocked(int32_t atomId) {
     constexpr int kMaxPushedAtomDroppedStatsSize = kMaxPushedAtomId + kMaxNonPlatformPushedAtoms;
     if (mPushedAtomDropsStats.size() < kMaxPushedAtomDroppedStatsSize ||
@@ -382,6 +407,16 @@ void StatsdStats::noteDbCorrupted(const ConfigKey& key) {
     it->second->db_corrupted_count++;
 }
 
+void StatsdStats::noteConditionQueryCache(const ConfigKey& key, int64_t hits, int64_t misses) {
+    lock_guard<std::mutex> lock(mLock);
+    auto it = mConfigStats.find(key);
+    if (it == mConfigStats.end()) {
+        return;
+    }
+    it->second->condition_query_cache_hits += hits;
+    it->second->condition_query_cache_misses += misses;
+}
+
 void StatsdStats::noteUidMapDropped(int deltas) {
     lock_guard<std::mutex> lock(mLock);
     mUidMapStats.dropped_changes += mUidMapStats.dropped_changes + deltas;
@@ -507,6 +542,33 @@ void StatsdStats::notePullDelay(int pullAtomId, int64_t pullDelayNs) {
     pullStats.numPullDelay += 1;
 }
 
+void StatsdStats::notePullAlarmToCompletion(int pullAtomId, int64_t latencyNs) {
+    lock_guard<std::mutex> lock(mLock);
+    auto& pullStats = mPulledAtomStats[pullAtomId];
+    pullStats.maxPullAlarmToCompletionNs =
+            std::max(pullStats.maxPullAlarmToCompletionNs, latencyNs);
+    pullStats.avgPullAlarmToCompletionNs =
+            (pullStats.avgPullAlarmToCompletionNs * pullStats.numPullAlarmToCompletion +
+             latencyNs) /
+            (pullStats.numPullAlarmToCompletion + 1);
+    pullStats.numPullAlarmToCompletion += 1;
+}
+
+void StatsdStats::notePullAlarmToStart(int pullAtomId, int64_t latencyNs) {
+    lock_guard<std::mutex> lock(mLock);
+    auto& pullStats = mPulledAtomStats[pullAtomId];
+    pullStats.maxPullAlarmToStartNs = std::max(pullStats.maxPullAlarmToStartNs, latencyNs);
+    pullStats.avgPullAlarmToStartNs =
+            (pullStats.avgPullAlarmToStartNs * pullStats.numPullAlarmToStart + latencyNs) /
+            (pullStats.numPullAlarmToStart + 1);
+    pullStats.numPullAlarmToStart += 1;
+}
+
+void StatsdStats::notePullsSavedByAlignment(int pullAtomId, int numPulls) {
+    lock_guard<std::mutex> lock(mLock);
+    mPulledAtomStats[pullAtomId].pullsSavedByAlignment += numPulls;
+}
+
 void StatsdStats::notePullDataError(int pullAtomId) {
     lock_guard<std::mutex> lock(mLock);
     mPulledAtomStats[pullAtomId].dataError++;
@@ -822,6 +884,10 @@ void StatsdStats::resetInternalLocked() {
     mOverflowCount = 0;
     mMinQueueHistoryNs = kInt64Max;
     mMaxQueueHistoryNs = 0;
+    mDumpReportCount = 0;
+    mMaxQueueSizeDuringDumps = 0;
+    mDumpReportLifetimePeakRssKb = 0;
+    mMaxDumpReportLifetimePeakRssIncreaseKb = 0;
     for (auto& config : mConfigStats) {
         config.second->broadcast_sent_time_sec.clear();
         config.second->activation_time_sec.clear();
@@ -840,6 +906,8 @@ void StatsdStats::resetInternalLocked() {
         config.second->total_flush_latency_ns.clear();
         config.second->total_db_size_timestamps.clear();
         config.second->total_db_sizes.clear();
+        config.second->condition_query_cache_hits = 0;
+        config.second->condition_query_cache_misses = 0;
     }
     for (auto& pullStats : mPulledAtomStats) {
         pullStats.second.totalPull = 0;
@@ -851,6 +919,13 @@ void StatsdStats::resetInternalLocked() {
         pullStats.second.avgPullDelayNs = 0;
         pullStats.second.maxPullDelayNs = 0;
         pullStats.second.numPullDelay = 0;
+        pullStats.second.avgPullAlarmToCompletionNs = 0;
+        pullStats.second.maxPullAlarmToCompletionNs = 0;
+        pullStats.second.numPullAlarmToCompletion = 0;
+        pullStats.second.avgPullAlarmToStartNs = 0;
+        pullStats.second.maxPullAlarmToStartNs = 0;
+        pullStats.second.numPullAlarmToStart = 0;
+        pullStats.second.pullsSavedByAlignment = 0;
         pullStats.second.dataError = 0;
         pullStats.second.pullTimeout = 0;
         pullStats.second.pullExceedMaxDelay = 0;
@@ -1017,6 +1092,10 @@ void StatsdStats::dumpStats(int out) const {
             dprintf(out, "alert %lld declared %d times\n", (long long)stats.first, stats.second);
         }
 
+        dprintf(out, "condition query cache hits %lld misses %lld\n",
+                (long long)configStats->condition_query_cache_hits,
+                (long long)configStats->condition_query_cache_misses);
+
         for (const auto& stats : configStats->restricted_metric_stats) {
             dprintf(out, "Restricted MetricId %lld: ", (long long)stats.first);
             dprintf(out, "Insert error %lld, ", (long long)stats.second.insertError);
@@ -1066,7 +1145,10 @@ void StatsdStats::dumpStats(int out) const {
                 "  (pull timeout)%ld, (pull exceed max delay)%ld"
                 "  (no uid provider count)%ld, (no puller found count)%ld\n"
                 "  (registered count) %ld, (unregistered count) %ld"
-                "  (atom error count) %d\n",
+                "  (atom error count) %d\n"
+                "  (average alarm to completion nanos)%lld, (max alarm to completion nanos)%lld\n"
+                "  (average alarm to start nanos)%lld, (max alarm to start nanos)%lld\n"
+                "  (pulls saved by alignment)%ld\n",
                 (int)pair.first, (long)pair.second.totalPull, (long)pair.second.totalPullFromCache,
                 (long)pair.second.pullFailed, (long)pair.second.minPullIntervalSec,
                 (long long)pair.second.avgPullTimeNs, (long long)pair.second.maxPullTimeNs,
@@ -1074,7 +1156,10 @@ void StatsdStats::dumpStats(int out) const {
                 pair.second.dataError, pair.second.pullTimeout, pair.second.pullExceedMaxDelay,
                 pair.second.pullUidProviderNotFound, pair.second.pullerNotFound,
                 pair.second.registeredCount, pair.second.unregisteredCount,
-                pair.second.atomErrorCount);
+                pair.second.atomErrorCount, (long long)pair.second.avgPullAlarmToCompletionNs,
+                (long long)pair.second.maxPullAlarmToCompletionNs,
+                (long long)pair.second.avgPullAlarmToStartNs,
+                (long long)pair.second.maxPullAlarmToStartNs, pair.second.pullsSavedByAlignment);
         if (pair.second.pullTimeoutMetadata.size() > 0) {
             string uptimeMillis = "(pull timeout system uptime millis) ";
             string pullTimeoutMillis = "(pull timeout elapsed time millis) ";
@@ -1120,6 +1205,11 @@ void StatsdStats::dumpStats(int out) const {
 
     dprintf(out, "Event queue overflow: %d; MaxHistoryNs: %lld; MinHistoryNs: %lld\n",
             mOverflowCount, (long long)mMaxQueueHistoryNs, (long long)mMinQueueHistoryNs);
+    dprintf(out, "Dump reports: %d; MaxQueueSize: %lld\n", mDumpReportCount,
+            (long long)mMaxQueueSizeDuringDumps);
+    dprintf(out, "Lifetime peak RSS after dump report: %lld KB; MaxIncreaseDuringDump: %lld KB\n",
+            (long long)mDumpReportLifetimePeakRssKb,
+            (long long)mMaxDumpReportLifetimePeakRssIncreaseKb);
 
     if (mActivationBroadcastGuardrailStats.size() > 0) {
         dprintf(out, "********mActivationBroadcastGuardrail stats***********\n");
@@ -1342,6 +1432,10 @@ void addConfigStatsToProto(const ConfigStats& configStats, ProtoOutputStream* pr
                              FIELD_COUNT_REPEATED,
                      dbSize);
     }
+    writeNonZeroStatToStream(FIELD_TYPE_INT64 | FIELD_ID_CONFIG_STATS_CONDITION_QUERY_CACHE_HITS,
+                             (long long)configStats.condition_query_cache_hits, proto);
+    writeNonZeroStatToStream(FIELD_TYPE_INT64 | FIELD_ID_CONFIG_STATS_CONDITION_QUERY_CACHE_MISSES,
+                             (long long)configStats.condition_query_cache_misses, proto);
     proto->end(token);
 }
 
@@ -1445,6 +1539,24 @@ void StatsdStats::dumpStats(std::vector<uint8_t>* output, bool reset) {
         proto.end(token);
     }
 
+    if (mDumpReportCount > 0) {
+        uint64_t token = proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_DUMP_REPORT_QUEUE_STATS);
+        proto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_QUEUE_STATS_COUNT, mDumpReportCount);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_DUMP_REPORT_QUEUE_STATS_MAX_SIZE,
+                    (long long)mMaxQueueSizeDuringDumps);
+        proto.end(token);
+    }
+
+    if (mDumpReportLifetimePeakRssKb > 0) {
+        uint64_t token = proto.start(FIELD_TYPE_MESSAGE | FIELD_ID_DUMP_REPORT_MEMORY_STATS);
+        proto.write(FIELD_TYPE_INT64 | FIELD_ID_DUMP_REPORT_MEMORY_STATS_LIFETIME_PEAK_RSS,
+                    (long long)mDumpReportLifetimePeakRssKb);
+        proto.write(
+                FIELD_TYPE_INT64 | FIELD_ID_DUMP_REPORT_MEMORY_STATS_MAX_LIFETIME_PEAK_RSS_INCREASE,
+                (long long)mMaxDumpReportLifetimePeakRssIncreaseKb);
+        proto.end(token);
+    }
+
     for (const auto& restart : mSystemServerRestartSec) {
         proto.write(FIELD_TYPE_INT32 | FIELD_ID_SYSTEM_SERVER_RESTART | FIELD_COUNT_REPEATED,
                     restart);
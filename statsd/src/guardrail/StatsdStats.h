@@ -139,6 +139,10 @@ struct ConfigStats {
 
     // Stores the last 20 sizes of the sqlite db.
     std::list<int64_t> total_db_sizes;
+
+    // Number of sliced condition queries answered from, or added to, the per-event query cache.
+    int64_t condition_query_cache_hits = 0;
+    int64_t condition_query_cache_misses = 0;
 };
 
 struct UidMapStats {
@@ -328,6 +332,11 @@ public:
      */
     void noteDbCorrupted(const ConfigKey& key);
 
+    /**
+     * Report the hits and misses of the condition query cache while processing one event.
+     */
+    void noteConditionQueryCache(const ConfigKey& key, int64_t hits, int64_t misses);
+
     /**
      * Report the size of output tuple of a condition.
      *
@@ -443,6 +452,24 @@ public:
      */
     void notePullDelay(int pullAtomId, int64_t pullDelayNs);
 
+    /*
+     * Records the time from a pull alarm firing to all metrics having processed the data pulled
+     * for the atom on that alarm.
+     */
+    void notePullAlarmToCompletion(int pullAtomId, int64_t latencyNs);
+
+    /*
+     * Records the time from a pull alarm firing to the pull of the atom being issued. Pulls due on
+     * the same alarm wait for each other when there are more of them than pull threads.
+     */
+    void notePullAlarmToStart(int pullAtomId, int64_t latencyNs);
+
+    /*
+     * Records the pulls of the atom avoided by delaying a scheduled pull, so that receivers with
+     * different bucket boundaries share it.
+     */
+    void notePullsSavedByAlignment(int pullAtomId, int numPulls);
+
     /*
      * Records pull exceeds timeout for the puller.
      */
@@ -557,6 +584,18 @@ public:
      * in the queue */
     void noteEventQueueOverflow(int64_t oldestEventTimestampNs, int32_t atomId, bool isSkipped);
 
+    /**
+     * Reports the largest size of the event queue while a dump report was built.
+     */
+    void noteDumpReportQueueSize(size_t maxQueueSize);
+
+    /**
+     * Reports the lifetime peak RSS of statsd after a dump report was built, and how much the
+     * dump raised it.
+     */
+    void noteDumpReportLifetimePeakRss(int64_t lifetimePeakRssKb,
+                                       int64_t lifetimePeakRssIncreaseKb);
+
     /**
      * Reports that the activation broadcast guardrail was hit for this uid. Namely, the broadcast
      * should have been sent, but instead was skipped due to hitting the guardrail.
@@ -656,6 +695,13 @@ public:
         int64_t avgPullDelayNs = 0;
         int64_t maxPullDelayNs = 0;
         long numPullDelay = 0;
+        int64_t avgPullAlarmToCompletionNs = 0;
+        int64_t maxPullAlarmToCompletionNs = 0;
+        long numPullAlarmToCompletion = 0;
+        int64_t avgPullAlarmToStartNs = 0;
+        int64_t maxPullAlarmToStartNs = 0;
+        long numPullAlarmToStart = 0;
+        long pullsSavedByAlignment = 0;
         long dataError = 0;
         long pullTimeout = 0;
         long pullExceedMaxDelay = 0;
@@ -767,6 +813,14 @@ private:
     // Total number of events that are lost due to queue overflow.
     int32_t mOverflowCount = 0;
 
+    // Number of dump reports, and the largest size of the event queue while one was built.
+    int32_t mDumpReportCount = 0;
+    int64_t mMaxQueueSizeDuringDumps = 0;
+
+    // Lifetime peak RSS after the latest dump report, and largest increase of it during one.
+    int64_t mDumpReportLifetimePeakRssKb = 0;
+    int64_t mMaxDumpReportLifetimePeakRssIncreaseKb = 0;
+
     // Timestamps when we detect log loss, and the number of logs lost.
     std::list<LogLossStats> mLogLossStats;
 
@@ -850,6 +904,7 @@ private:
     FRIEND_TEST(StatsdStatsTest, TestInvalidConfigMissingMetricId);
     FRIEND_TEST(StatsdStatsTest, TestInvalidConfigOnlyMetricId);
     FRIEND_TEST(StatsdStatsTest, TestConfigRemove);
+    FRIEND_TEST(StatsdStatsTest, TestConditionQueryCacheStats);
     FRIEND_TEST(StatsdStatsTest, TestSubStats);
     FRIEND_TEST(StatsdStatsTest, TestAtomLog);
     FRIEND_TEST(StatsdStatsTest, TestNonPlatformAtomLog);
@@ -866,6 +921,8 @@ private:
     FRIEND_TEST(StatsdStatsTest, TestAtomDroppedStats);
     FRIEND_TEST(StatsdStatsTest, TestAtomLoggedAndDroppedStats);
     FRIEND_TEST(StatsdStatsTest, TestAtomLoggedAndDroppedAndSkippedStats);
+    FRIEND_TEST(StatsdStatsTest, TestDumpReportQueueSize);
+    FRIEND_TEST(StatsdStatsTest, TestDumpReportLifetimePeakRss);
     FRIEND_TEST(StatsdStatsTest, TestShardOffsetProvider);
 
     FRIEND_TEST(StatsLogProcessorTest, InvalidConfigRemoved);
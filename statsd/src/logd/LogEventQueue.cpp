@@ -19,6 +19,8 @@
 
 #include "LogEventQueue.h"
 
+#include <algorithm>
+
 namespace android {
 namespace os {
 namespace statsd {
@@ -46,6 +48,9 @@ bool LogEventQueue::push(unique_ptr<LogEvent> item, int64_t* oldestTimestampNs)
         if (mQueue.size() < mQueueLimit) {
             mQueue.push(std::move(item));
             success = true;
+            if (mDumpsInProgress > 0) {
+                mMaxSizeDuringDumps = std::max(mMaxSizeDuringDumps, mQueue.size());
+            }
         } else {
             // safe operation as queue must not be empty.
             *oldestTimestampNs = mQueue.front()->GetElapsedTimestampNs();
@@ -57,6 +62,22 @@ bool LogEventQueue::push(unique_ptr<LogEvent> item, int64_t* oldestTimestampNs)
     return success;
 }
 
+void LogEventQueue::noteDumpStarted() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mDumpsInProgress == 0) {
+        mMaxSizeDuringDumps = mQueue.size();
+    }
+    mDumpsInProgress++;
+}
+
+size_t LogEventQueue::noteDumpFinished() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mDumpsInProgress > 0) {
+        mDumpsInProgress--;
+    }
+    return mMaxSizeDuringDumps;
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -47,12 +47,28 @@ public:
      */
     bool push(std::unique_ptr<LogEvent> event, int64_t* oldestTimestampNs);
 
+    /**
+     * Starts tracking the largest size of the queue until the matching noteDumpFinished().
+     */
+    void noteDumpStarted();
+
+    /**
+     * Returns the largest size of the queue since the first dump in progress started.
+     */
+    size_t noteDumpFinished();
+
 private:
     const size_t mQueueLimit;
     std::condition_variable mCondition;
     std::mutex mMutex;
     std::queue<std::unique_ptr<LogEvent>> mQueue;
 
+    // Number of dump reports in progress. The queue size is only tracked during dumps.
+    int mDumpsInProgress = 0;
+
+    // Largest size of the queue since the first dump in progress started.
+    size_t mMaxSizeDuringDumps = 0;
+
     friend class SocketParseMessageTest;
 
     FRIEND_TEST(SocketParseMessageTestNoFiltering, TestProcessMessageNoFiltering);
@@ -62,6 +78,7 @@ private:
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterCompleteSet);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterPartialSet);
     FRIEND_TEST(SocketParseMessageTest, TestProcessMessageFilterToggle);
+    FRIEND_TEST(LogEventQueue_test, TestMaxSizeDuringDumps);
 };
 
 }  // namespace statsd
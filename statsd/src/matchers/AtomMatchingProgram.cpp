@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+
+#include "AtomMatchingProgram.h"
+
+#include <unordered_map>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::unordered_map;
+using std::vector;
+
+namespace {
+
+const size_t kBitsPerWord = 64;
+
+// Appends the matchers reachable from matcherIndex to order, children first.
+void visit(const int matcherIndex, const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+           const unordered_map<int, size_t>& bits, vector<bool>& visited, vector<int>& order) {
+    const auto it = bits.find(matcherIndex);
+    if (it == bits.end() || visited[it->second]) {
+        return;
+    }
+    visited[it->second] = true;
+    for (const int child : allAtomMatchingTrackers[matcherIndex]->getChildren()) {
+        visit(child, allAtomMatchingTrackers, bits, visited, order);
+    }
+    order.push_back(matcherIndex);
+}
+
+}  // namespace
+
+AtomMatchingProgram::AtomMatchingProgram(
+        const vector<int>& matcherIndices,
+        const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers) {
+    unordered_map<int, size_t> bits;
+    for (const int matcherIndex : matcherIndices) {
+        bits.emplace(matcherIndex, bits.size());
+    }
+    // The last bit is never set. It stands for the children that do not match this atom id.
+    const size_t neverSetBit = bits.size();
+    mWordCount = neverSetBit / kBitsPerWord + 1;
+
+    // Config validation guarantees there are no cycles between matchers.
+    vector<bool> visited(bits.size(), false);
+    vector<int> order;
+    order.reserve(bits.size());
+    for (const int matcherIndex : matcherIndices) {
+        visit(matcherIndex, allAtomMatchingTrackers, bits, visited, order);
+    }
+
+    for (const int matcherIndex : order) {
+        const sp<AtomMatchingTracker>& matcher = allAtomMatchingTrackers[matcherIndex];
+        const size_t bit = bits[matcherIndex];
+        const vector<int>& children = matcher->getChildren();
+        if (children.empty()) {
+            mSimpleMatchers.emplace_back(matcherIndex, bit);
+            continue;
+        }
+
+        Instruction instruction;
+        instruction.matcherIndex = matcherIndex;
+        instruction.bit = bit;
+        instruction.operation = matcher->getLogicalOperation();
+        instruction.maskBegin = mMaskWords.size();
+        unordered_map<size_t, uint64_t> masks;
+        for (const int child : children) {
+            const auto it = bits.find(child);
+            const size_t childBit = it == bits.end() ? neverSetBit : it->second;
+            masks[childBit / kBitsPerWord] |= uint64_t(1) << (childBit % kBitsPerWord);
+        }
+        for (const auto& [word, mask] : masks) {
+            mMaskWords.push_back({word, mask});
+        }
+        instruction.maskEnd = mMaskWords.size();
+        mInstructions.push_back(instruction);
+    }
+}
+
+void AtomMatchingProgram::onLogEvent(const LogEvent& event,
+                                     const vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+                                     vector<MatchingState>& matcherResults) const {
+    uint64_t stackWords[4] = {0, 0, 0, 0};
+    vector<uint64_t> heapWords;
+    uint64_t* words = stackWords;
+    if (mWordCount > 4) {
+        heapWords.resize(mWordCount, 0);
+        words = heapWords.data();
+    }
+
+    for (const auto& [matcherIndex, bit] : mSimpleMatchers) {
+        allAtomMatchingTrackers[matcherIndex]->onLogEvent(event, allAtomMatchingTrackers,
+                                                          matcherResults);
+        if (matcherResults[matcherIndex] == MatchingState::kMatched) {
+            words[bit / kBitsPerWord] |= uint64_t(1) << (bit % kBitsPerWord);
+        }
+    }
+
+    for (const Instruction& instruction : mInstructions) {
+        bool allSet = true;
+        bool anySet = false;
+        for (size_t i = instruction.maskBegin; i < instruction.maskEnd; i++) {
+            const MaskWord& maskWord = mMaskWords[i];
+            const uint64_t set = words[maskWord.word] & maskWord.mask;
+            allSet &= set == maskWord.mask;
+            anySet |= set != 0;
+        }
+
+        bool matched;
+        switch (instruction.operation) {
+            case LogicalOperation::AND:
+                matched = allSet;
+                break;
+            case LogicalOperation::OR:
+                matched = anySet;
+                break;
+            case LogicalOperation::NOT:
+                // NOT has exactly one child.
+                matched = !anySet;
+                break;
+            case LogicalOperation::NAND:
+                matched = !allSet;
+                break;
+            case LogicalOperation::NOR:
+                matched = !anySet;
+                break;
+            default:
+                matched = false;
+                break;
+        }
+        if (matched) {
+            words[instruction.bit / kBitsPerWord] |= uint64_t(1)
+                                                     << (instruction.bit % kBitsPerWord);
+        }
+        matcherResults[instruction.matcherIndex] =
+                matched ? MatchingState::kMatched : MatchingState::kNotMatched;
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
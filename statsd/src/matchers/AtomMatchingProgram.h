@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtest/gtest_prod.h>
+
+#include <vector>
+
+#include "AtomMatchingTracker.h"
+#include "logd/LogEvent.h"
+#include "matchers/matcher_util.h"
+#include "src/statsd_config.pb.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Flattened form of the AtomMatchingTrackers that are interested in one atom id.
+//
+// The matchers are laid out in topological order, children before parents. Simple matchers are
+// still evaluated by their AtomMatchingTracker. Every combination matcher is compiled into an
+// instruction that tests the packed bitset of results computed so far: AND/NAND check that all
+// child bits are set and OR/NOR check that any child bit is set, one 64-bit word at a time.
+//
+// A child matcher that is not interested in the atom id never matches the event, so it is mapped
+// to a bit that is never set. This reproduces the results of the recursive
+// AtomMatchingTracker::onLogEvent(), which is kept as the reference implementation.
+class AtomMatchingProgram {
+public:
+    // matcherIndices: the indices of all matchers whose atom ids contain the atom id.
+    AtomMatchingProgram(const std::vector<int>& matcherIndices,
+                        const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers);
+
+    // Evaluates all matchers of this program on the event and stores their results in
+    // matcherResults. Results of matchers outside this program are left untouched.
+    void onLogEvent(const LogEvent& event,
+                    const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
+                    std::vector<MatchingState>& matcherResults) const;
+
+private:
+    // A set of bits within one word of the bitset.
+    struct MaskWord {
+        size_t word;
+        uint64_t mask;
+    };
+
+    struct Instruction {
+        // Index of the combination matcher in allAtomMatchingTrackers.
+        int matcherIndex;
+        // Bit holding the result of this matcher.
+        size_t bit;
+        LogicalOperation operation;
+        // Range of mMaskWords covering the children of this matcher.
+        size_t maskBegin;
+        size_t maskEnd;
+    };
+
+    // Indices of simple matchers, with the bit holding their result.
+    std::vector<std::pair<int, size_t>> mSimpleMatchers;
+
+    // Combination matchers in topological order.
+    std::vector<Instruction> mInstructions;
+
+    std::vector<MaskWord> mMaskWords;
+
+    // Number of 64-bit words in the bitset, including the never-set bit for unrelated children.
+    size_t mWordCount;
+
+    FRIEND_TEST(AtomMatchingProgramTest, TestTopologicalOrder);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
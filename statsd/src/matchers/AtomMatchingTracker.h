@@ -80,6 +80,22 @@ public:
         return mAtomIds;
     }
 
+    // Get the indices of the child matchers. Only CombinationAtomMatchingTrackers have children.
+    virtual const std::vector<int>& getChildren() const {
+        static const std::vector<int> kNoChildren;
+        return kNoChildren;
+    }
+
+    // Get the operation applied to the children. Only meaningful if getChildren() is not empty.
+    virtual LogicalOperation getLogicalOperation() const {
+        return LogicalOperation::LOGICAL_OPERATION_UNSPECIFIED;
+    }
+
+    // Whether every event of the atom ids matches, so that matching does not read any field.
+    virtual bool matchesAnyEventOfAtomIds() const {
+        return false;
+    }
+
     int64_t getId() const {
         return mId;
     }
@@ -46,6 +46,14 @@ public:
                     const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
                     std::vector<MatchingState>& matcherResults) override;
 
+    const std::vector<int>& getChildren() const override {
+        return mChildren;
+    }
+
+    LogicalOperation getLogicalOperation() const override {
+        return mLogicalOperation;
+    }
+
 private:
     LogicalOperation mLogicalOperation;
 
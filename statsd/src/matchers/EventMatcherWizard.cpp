@@ -25,9 +25,11 @@ MatchingState EventMatcherWizard::matchLogEvent(const LogEvent& event, int match
     if (matcher_index < 0 || matcher_index >= (int)mAllEventMatchers.size()) {
         return MatchingState::kNotComputed;
     }
-    std::fill(mMatcherCache.begin(), mMatcherCache.end(), MatchingState::kNotComputed);
-    mAllEventMatchers[matcher_index]->onLogEvent(event, mAllEventMatchers, mMatcherCache);
-    return mMatcherCache[matcher_index];
+    // Pulled data may be matched by several metrics in parallel, so each thread gets its own cache.
+    thread_local vector<MatchingState> matcherCache;
+    matcherCache.assign(mAllEventMatchers.size(), MatchingState::kNotComputed);
+    mAllEventMatchers[matcher_index]->onLogEvent(event, mAllEventMatchers, matcherCache);
+    return matcherCache[matcher_index];
 }
 
 }  // namespace statsd
@@ -26,16 +26,15 @@ class EventMatcherWizard : public virtual RefBase {
 public:
     EventMatcherWizard(){};  // for testing
     EventMatcherWizard(const std::vector<sp<AtomMatchingTracker>>& eventTrackers)
-        : mAllEventMatchers(eventTrackers),
-          mMatcherCache(eventTrackers.size(), MatchingState::kNotComputed){};
+        : mAllEventMatchers(eventTrackers){};
 
     virtual ~EventMatcherWizard(){};
 
+    // Safe to call from several threads at once, as long as the matchers are not updated.
     MatchingState matchLogEvent(const LogEvent& event, int matcher_index);
 
 private:
     std::vector<sp<AtomMatchingTracker>> mAllEventMatchers;
-    std::vector<MatchingState> mMatcherCache;
 };
 
 }  // namespace statsd
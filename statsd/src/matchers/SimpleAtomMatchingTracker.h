@@ -48,6 +48,10 @@ public:
                     const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
                     std::vector<MatchingState>& matcherResults) override;
 
+    bool matchesAnyEventOfAtomIds() const override {
+        return mMatcher.field_value_matcher_size() == 0;
+    }
+
 private:
     const SimpleAtomMatcher mMatcher;
     const sp<UidMap> mUidMap;
@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+
+#include "AtomEncoder.h"
+
+#include "hash.h"
+
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_BYTES;
+using android::util::FIELD_TYPE_FLOAT;
+using android::util::FIELD_TYPE_INT32;
+using android::util::FIELD_TYPE_MESSAGE;
+using android::util::FIELD_TYPE_SINT64;
+using android::util::FIELD_TYPE_STRING;
+using android::util::FIELD_TYPE_UINT64;
+using android::util::ProtoOutputStream;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+// for EncodedAtom
+const int FIELD_ID_LAYOUT_INDEX = 1;
+const int FIELD_ID_INT_DELTA = 2;
+const int FIELD_ID_STRING_INDEX = 3;
+const int FIELD_ID_FLOAT_VALUE = 4;
+const int FIELD_ID_STORAGE_VALUE = 5;
+// for AtomEncodingDictionary
+const int FIELD_ID_LAYOUT = 1;
+const int FIELD_ID_STRING = 2;
+const int FIELD_ID_STRING_HASH = 3;
+// for AtomEncodingDictionary.Layout
+const int FIELD_ID_LAYOUT_ATOM_ID = 1;
+const int FIELD_ID_LAYOUT_FIELD = 2;
+const int FIELD_ID_LAYOUT_TYPE = 3;
+
+// Only these types are written to reports, see writeFieldValueTreeToStream().
+bool isEncodedType(const Type type) {
+    return type == INT || type == LONG || type == FLOAT || type == STRING || type == STORAGE;
+}
+
+// Returns value - previous modulo 2^64. Unlike the signed difference, this cannot overflow, and
+// adding the delta to previous modulo 2^64 gives back value.
+int64_t wrappingDelta(int64_t value, int64_t previous) {
+    return (int64_t)((uint64_t)value - (uint64_t)previous);
+}
+
+}  // namespace
+
+AtomEncoder::AtomEncoder(set<string>* str_set) : mStrSet(str_set) {
+}
+
+void AtomEncoder::writeAtom(int tagId, const vector<FieldValue>& values, uint64_t fieldId,
+                            ProtoOutputStream* protoOutput) {
+    vector<int32_t> layoutKey;
+    layoutKey.reserve(1 + 2 * values.size());
+    layoutKey.push_back(tagId);
+    for (const FieldValue& value : values) {
+        if (isEncodedType(value.mValue.getType())) {
+            layoutKey.push_back(value.mField.getField());
+            layoutKey.push_back(value.mValue.getType());
+        }
+    }
+
+    auto [it, inserted] = mLayoutIndices.emplace(layoutKey, mLayouts.size());
+    if (inserted) {
+        Layout layout;
+        layout.atomId = tagId;
+        for (size_t i = 1; i < layoutKey.size(); i += 2) {
+            layout.fields.push_back(layoutKey[i]);
+            layout.types.push_back(layoutKey[i + 1]);
+            if (layoutKey[i + 1] == INT || layoutKey[i + 1] == LONG) {
+                layout.lastIntValues.push_back(0);
+            }
+        }
+        mLayouts.push_back(std::move(layout));
+    }
+    Layout& layout = mLayouts[it->second];
+
+    uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | fieldId);
+    protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_LAYOUT_INDEX, (int)it->second);
+    size_t intIndex = 0;
+    for (const FieldValue& value : values) {
+        switch (value.mValue.getType()) {
+            case INT:
+            case LONG: {
+                const int64_t intValue = value.mValue.getType() == INT
+                                                 ? value.mValue.int_value
+                                                 : value.mValue.long_value;
+                protoOutput->write(FIELD_TYPE_SINT64 | FIELD_COUNT_REPEATED | FIELD_ID_INT_DELTA,
+                                   (long long)wrappingDelta(intValue,
+                                                            layout.lastIntValues[intIndex]));
+                layout.lastIntValues[intIndex++] = intValue;
+                break;
+            }
+            case FLOAT:
+                protoOutput->write(FIELD_TYPE_FLOAT | FIELD_COUNT_REPEATED | FIELD_ID_FLOAT_VALUE,
+                                   value.mValue.float_value);
+                break;
+            case STRING: {
+                auto [stringIt, newString] =
+                        mStringIndices.emplace(value.mValue.str_value, mStrings.size());
+                if (newString) {
+                    mStrings.push_back(value.mValue.str_value);
+                }
+                protoOutput->write(
+                        FIELD_TYPE_INT32 | FIELD_COUNT_REPEATED | FIELD_ID_STRING_INDEX,
+                        stringIt->second);
+                break;
+            }
+            case STORAGE:
+                protoOutput->write(
+                        FIELD_TYPE_BYTES | FIELD_COUNT_REPEATED | FIELD_ID_STORAGE_VALUE,
+                        (const char*)value.mValue.storage_value.data(),
+                        value.mValue.storage_value.size());
+                break;
+            default:
+                break;
+        }
+    }
+    protoOutput->end(atomToken);
+}
+
+void AtomEncoder::writeTimestamps(const vector<int64_t>& timestampsNs, uint64_t fieldId,
+                                  ProtoOutputStream* protoOutput) {
+    int64_t previousNs = 0;
+    for (const int64_t timestampNs : timestampsNs) {
+        protoOutput->write(FIELD_TYPE_SINT64 | FIELD_COUNT_REPEATED | fieldId,
+                           (long long)wrappingDelta(timestampNs, previousNs));
+        previousNs = timestampNs;
+    }
+}
+
+void AtomEncoder::writeDictionary(uint64_t fieldId, ProtoOutputStream* protoOutput) const {
+    uint64_t dictionaryToken = protoOutput->start(FIELD_TYPE_MESSAGE | fieldId);
+    for (const Layout& layout : mLayouts) {
+        uint64_t layoutToken =
+                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_LAYOUT);
+        protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_LAYOUT_ATOM_ID, layout.atomId);
+        for (size_t i = 0; i < layout.fields.size(); i++) {
+            protoOutput->write(FIELD_TYPE_INT32 | FIELD_COUNT_REPEATED | FIELD_ID_LAYOUT_FIELD,
+                               layout.fields[i]);
+            protoOutput->write(FIELD_TYPE_INT32 | FIELD_COUNT_REPEATED | FIELD_ID_LAYOUT_TYPE,
+                               layout.types[i]);
+        }
+        protoOutput->end(layoutToken);
+    }
+    for (const string& str : mStrings) {
+        if (mStrSet == nullptr) {
+            protoOutput->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRING, str);
+        } else {
+            mStrSet->insert(str);
+            protoOutput->write(FIELD_TYPE_UINT64 | FIELD_COUNT_REPEATED | FIELD_ID_STRING_HASH,
+                               (long long)Hash64(str));
+        }
+    }
+    protoOutput->end(dictionaryToken);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android/util/ProtoOutputStream.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FieldValue.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Writes the atoms of one gauge or event metric report in the compact form described by
+// EncodedAtom and AtomEncodingDictionary in stats_log.proto.
+//
+// The atom id and leaf fields of every distinct atom shape are written once, as a layout in the
+// dictionary. Strings are written once in the dictionary and referenced by index. Integral leaves
+// are written as the difference from the same leaf of the previous atom with the same layout, so
+// slowly varying values take one or two bytes.
+class AtomEncoder {
+public:
+    // str_set: if not null, the dictionary holds string hashes and the strings are added to
+    // str_set, as for dimensions.
+    explicit AtomEncoder(std::set<std::string>* str_set);
+
+    AtomEncoder(const AtomEncoder&) = delete;
+    AtomEncoder& operator=(const AtomEncoder&) = delete;
+
+    // Writes the atom as an EncodedAtom message in fieldId.
+    void writeAtom(int tagId, const std::vector<FieldValue>& values, uint64_t fieldId,
+                   android::util::ProtoOutputStream* protoOutput);
+
+    // Writes the timestamps to the repeated sint64 fieldId: the first timestamp, then the
+    // difference between each timestamp and the previous one.
+    static void writeTimestamps(const std::vector<int64_t>& timestampsNs, uint64_t fieldId,
+                                android::util::ProtoOutputStream* protoOutput);
+
+    // Writes the AtomEncodingDictionary message in fieldId. Called once all atoms are written.
+    void writeDictionary(uint64_t fieldId, android::util::ProtoOutputStream* protoOutput) const;
+
+private:
+    struct Layout {
+        int32_t atomId;
+        std::vector<int32_t> fields;
+        std::vector<int32_t> types;
+        // INT and LONG leaves of the last atom written with this layout.
+        std::vector<int64_t> lastIntValues;
+    };
+
+    // Maps the atom id followed by the field and type of every leaf to the index in mLayouts.
+    std::map<std::vector<int32_t>, size_t> mLayoutIndices;
+
+    std::vector<Layout> mLayouts;
+
+    std::unordered_map<std::string, int32_t> mStringIndices;
+
+    std::vector<std::string> mStrings;
+
+    std::set<std::string>* const mStrSet;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -184,6 +184,14 @@ void CountMetricProducer::onStateChanged(const int64_t eventTimeNs, const int32_
          oldState.mValue.int_value, newState.mValue.int_value);
 }
 
+void CountMetricProducer::onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                                         const vector<StateChange>& changes) {
+    // Counts are sliced by the state queried when each event is counted, so state changes do not
+    // need to be matched against the counters.
+    VLOG("CountMetric %lld onStateChanges time %lld, State%d, %zu changes", (long long)mMetricId,
+         (long long)eventTimeNs, atomId, changes.size());
+}
+
 void CountMetricProducer::dumpStatesLocked(FILE* out, bool verbose) const {
     if (mCurrentSlicedCounter == nullptr ||
         mCurrentSlicedCounter->size() == 0) {
@@ -211,99 +219,110 @@ void CountMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mPastBuckets.clear();
 }
 
-void CountMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                             const bool include_current_partial_bucket,
-                                             const bool erase_data,
-                                             const DumpLatency dumpLatency,
-                                             std::set<string> *str_set,
-                                             ProtoOutputStream* protoOutput) {
+DumpReportWriter CountMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
 
-
-    if (mPastBuckets.empty()) {
-        return;
-    }
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
-
-    // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
-            uint64_t dimenPathToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
-            protoOutput->end(dimenPathToken);
-        }
+    auto pastBuckets = std::make_shared<
+            const std::unordered_map<MetricDimensionKey, std::vector<CountBucket>>>(
+            erase_data ? std::move(mPastBuckets) : mPastBuckets);
+    if (erase_data) {
+        mPastBuckets.clear();
     }
 
-    uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_COUNT_METRICS);
-
-    for (const auto& counter : mPastBuckets) {
-        const MetricDimensionKey& dimensionKey = counter.first;
-        VLOG("  dimension key %s", dimensionKey.toString().c_str());
+    // We only write the condition timer value if the metric has a
+    // condition and isn't sliced by state or condition.
+    // TODO(b/268531179): Slice the condition timer by state and condition
+    const bool writeConditionTrueNs =
+            mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced;
 
-        uint64_t wrapperToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
+    return [metricId = mMetricId, isActive = isActiveLocked(), timeBaseNs = mTimeBaseNs,
+            bucketSizeNs = mBucketSizeNs, shouldUseNestedDimensions = mShouldUseNestedDimensions,
+            dimensionsInWhat = mDimensionsInWhat, writeConditionTrueNs,
+            pastBuckets](std::set<string>* str_set, ProtoOutputStream* protoOutput) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)metricId);
+        protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActive);
 
-        // First fill dimension.
-        if (mShouldUseNestedDimensions) {
-            uint64_t dimensionToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
-            writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
-            protoOutput->end(dimensionToken);
-        } else {
-            writeDimensionLeafNodesToProto(dimensionKey.getDimensionKeyInWhat(),
-                                           FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set, protoOutput);
+        if (pastBuckets->empty()) {
+            return;
         }
-        // Then fill slice_by_state.
-        for (auto state : dimensionKey.getStateValuesKey().getValues()) {
-            uint64_t stateToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                                     FIELD_ID_SLICE_BY_STATE);
-            writeStateToProto(state, protoOutput);
-            protoOutput->end(stateToken);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)timeBaseNs);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)bucketSizeNs);
+
+        // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
+        if (!shouldUseNestedDimensions) {
+            if (!dimensionsInWhat.empty()) {
+                uint64_t dimenPathToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
+                writeDimensionPathToProto(dimensionsInWhat, protoOutput);
+                protoOutput->end(dimenPathToken);
+            }
         }
-        // Then fill bucket_info (CountBucketInfo).
-        for (const auto& bucket : counter.second) {
-            uint64_t bucketInfoToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-            // Partial bucket.
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketStartNs));
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketEndNs));
+
+        uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_COUNT_METRICS);
+
+        for (const auto& counter : *pastBuckets) {
+            const MetricDimensionKey& dimensionKey = counter.first;
+            VLOG("  dimension key %s", dimensionKey.toString().c_str());
+
+            uint64_t wrapperToken =
+                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
+
+            // First fill dimension.
+            if (shouldUseNestedDimensions) {
+                uint64_t dimensionToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
+                writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
+                protoOutput->end(dimensionToken);
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                writeDimensionLeafNodesToProto(dimensionKey.getDimensionKeyInWhat(),
+                                               FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set,
+                                               protoOutput);
             }
-            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_COUNT, (long long)bucket.mCount);
-
-            // We only write the condition timer value if the metric has a
-            // condition and isn't sliced by state or condition.
-            // TODO(b/268531179): Slice the condition timer by state and condition
-            if (mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
-                                   (long long)bucket.mConditionTrueNs);
+            // Then fill slice_by_state.
+            for (auto state : dimensionKey.getStateValuesKey().getValues()) {
+                uint64_t stateToken = protoOutput->start(FIELD_TYPE_MESSAGE |
+                                                         FIELD_COUNT_REPEATED |
+                                                         FIELD_ID_SLICE_BY_STATE);
+                writeStateToProto(state, protoOutput);
+                protoOutput->end(stateToken);
             }
+            // Then fill bucket_info (CountBucketInfo).
+            for (const auto& bucket : counter.second) {
+                uint64_t bucketInfoToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
+                // Partial bucket.
+                if (bucket.mBucketEndNs - bucket.mBucketStartNs != bucketSizeNs) {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+                                       (long long)NanoToMillis(bucket.mBucketStartNs));
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+                                       (long long)NanoToMillis(bucket.mBucketEndNs));
+                } else {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                                       (long long)(getBucketNumFromEndTimeNs(
+                                               timeBaseNs, bucketSizeNs, bucket.mBucketEndNs)));
+                }
+                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_COUNT, (long long)bucket.mCount);
 
-            protoOutput->end(bucketInfoToken);
-            VLOG("\t bucket [%lld - %lld] count: %lld", (long long)bucket.mBucketStartNs,
-                 (long long)bucket.mBucketEndNs, (long long)bucket.mCount);
-        }
-        protoOutput->end(wrapperToken);
-    }
+                if (writeConditionTrueNs) {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
+                                       (long long)bucket.mConditionTrueNs);
+                }
 
-    protoOutput->end(protoToken);
+                protoOutput->end(bucketInfoToken);
+                VLOG("\t bucket [%lld - %lld] count: %lld", (long long)bucket.mBucketStartNs,
+                     (long long)bucket.mBucketEndNs, (long long)bucket.mCount);
+            }
+            protoOutput->end(wrapperToken);
+        }
 
-    if (erase_data) {
-        mPastBuckets.clear();
-    }
+        protoOutput->end(protoToken);
+    };
 }
 
 void CountMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
@@ -386,6 +405,11 @@ void CountMetricProducer::onMatchedLogEventInternalLocked(
          (long long)(*mCurrentSlicedCounter)[eventKey]);
 }
 
+bool CountMetricProducer::isHeaderCountableLocked() const {
+    return mDimensionsInWhat.empty() && !mConditionSliced && mSlicedStateAtoms.empty() &&
+           mSampledWhatFields.empty();
+}
+
 // When a new matched event comes in, we check if event falls into the current
 // bucket. If not, flush the old counter to past buckets and initialize the new bucket.
 void CountMetricProducer::flushIfNeededLocked(const int64_t& eventTimeNs) {
@@ -59,6 +59,9 @@ public:
                         const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                         const FieldValue& newState) override;
 
+    void onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                        const std::vector<StateChange>& changes) override;
+
     MetricType getMetricType() const override {
         return METRIC_TYPE_COUNT;
     }
@@ -71,12 +74,12 @@ protected:
 
 private:
 
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            const bool erase_data,
-                            const DumpLatency dumpLatency,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    bool isHeaderCountableLocked() const override;
+
+    DumpReportWriter prepareDumpReportLocked(const int64_t dumpTimeNs,
+                                             const bool include_current_partial_bucket,
+                                             const bool erase_data,
+                                             const DumpLatency dumpLatency) override;
 
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
@@ -139,6 +142,7 @@ private:
     FRIEND_TEST(CountMetricProducerTest, TestFirstBucket);
     FRIEND_TEST(CountMetricProducerTest, TestOneWeekTimeUnit);
     FRIEND_TEST(CountMetricProducerTest, TestSplitOnAppUpgradeDisabled);
+    FRIEND_TEST(CountMetricProducerTest, TestPrepareDumpReportTakesPastBuckets);
 
     FRIEND_TEST(CountMetricProducerTest_PartialBucket, TestSplitInCurrentBucket);
     FRIEND_TEST(CountMetricProducerTest_PartialBucket, TestSplitInNextBucket);
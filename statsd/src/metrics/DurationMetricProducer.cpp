@@ -20,6 +20,7 @@
 
 #include "DurationMetricProducer.h"
 
+#include <algorithm>
 #include <limits.h>
 #include <stdlib.h>
 
@@ -150,6 +151,18 @@ DurationMetricProducer::DurationMetricProducer(
         }
         mMetric2StateLinks.push_back(ms);
     }
+    // State changes of atoms with more than one link are checked against every tracker.
+    for (const Metric2State& link : mMetric2StateLinks) {
+        const auto [it, inserted] = mStateLinkIndices.try_emplace(link.stateAtomId);
+        it->second.link = inserted ? &link : nullptr;
+    }
+    for (auto it = mStateLinkIndices.begin(); it != mStateLinkIndices.end();) {
+        if (it->second.link == nullptr) {
+            it = mStateLinkIndices.erase(it);
+        } else {
+            it++;
+        }
+    }
 
     mUseWhatDimensionAsInternalDimension = equalDimensions(mDimensionsInWhat, mInternalDimensions);
     if (mWizard != nullptr && mConditionTrackerIndex >= 0 &&
@@ -280,6 +293,12 @@ sp<AnomalyTracker> DurationMetricProducer::addAnomalyTracker(
         const Alert& alert, const sp<AlarmMonitor>& anomalyAlarmMonitor,
         const UpdateStatus& updateStatus, const int64_t updateTimeNs) {
     std::lock_guard<std::mutex> lock(mMutex);
+    if (alert.has_detector()) {
+        // Detectors are evaluated on closed buckets, so there is nothing to predict.
+        sp<AnomalyTracker> anomalyTracker = new StatisticalAnomalyTracker(alert, mConfigKey);
+        addAnomalyTrackerLocked(anomalyTracker, updateStatus, updateTimeNs);
+        return anomalyTracker;
+    }
     if (mAggregationType == DurationMetric_AggregationType_SUM) {
         if (alert.trigger_if_sum_gt() > alert.num_buckets() * mBucketSizeNs) {
             ALOGW("invalid alert for SUM: threshold (%f) > possible recordable value (%d x %lld)",
@@ -315,28 +334,92 @@ void DurationMetricProducer::onStateChanged(const int64_t eventTimeNs, const int
                                             const HashableDimensionKey& primaryKey,
                                             const FieldValue& oldState,
                                             const FieldValue& newState) {
-    // Check if this metric has a StateMap. If so, map the new state value to
-    // the correct state group id.
-    FieldValue newStateCopy = newState;
-    mapStateValue(atomId, &newStateCopy);
+    onStateChanges(eventTimeNs, atomId,
+                   {{primaryKey, hashDimensionSortedByField(primaryKey), oldState, newState}});
+}
 
+void DurationMetricProducer::onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                                            const vector<StateChange>& changes) {
     flushIfNeededLocked(eventTimeNs);
 
-    // Each duration tracker is mapped to a different whatKey (a set of values from the
-    // dimensionsInWhat fields). We notify all trackers iff the primaryKey field values from the
-    // state change event are a subset of the tracker's whatKey field values.
-    //
-    // Ex. For a duration metric dimensioned on uid and tag:
-    // DurationTracker1 whatKey = uid: 1001, tag: 1
-    // DurationTracker2 whatKey = uid: 1002, tag 1
-    //
-    // If the state change primaryKey = uid: 1001, we only notify DurationTracker1 of a state
-    // change.
-    for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
-        if (!containsLinkedStateValues(whatIt.first, primaryKey, mMetric2StateLinks, atomId)) {
+    const auto indexIt = mStateLinkIndices.find(atomId);
+    const StateLinkIndex* index = indexIt != mStateLinkIndices.end() ? &indexIt->second : nullptr;
+    HashableDimensionKey sortedPrimaryKey;
+    for (const StateChange& change : changes) {
+        // Check if this metric has a StateMap. If so, map the new state value to
+        // the correct state group id.
+        FieldValue newState = change.newState;
+        mapStateValue(atomId, &newState);
+
+        // If the link covers all primary fields, the trackers to notify are the ones whose what
+        // key is linked to the primary key of the change.
+        if (index != nullptr &&
+            change.primaryKey.getValues().size() == index->link->stateFields.size()) {
+            const auto range = index->trackers.equal_range(change.primaryKeyHash);
+            if (range.first == range.second) {
+                continue;
+            }
+            const bool sorted = isSortedByField(change.primaryKey);
+            if (!sorted) {
+                sortedPrimaryKey = sortByField(change.primaryKey);
+            }
+            const HashableDimensionKey& primaryKey = sorted ? change.primaryKey : sortedPrimaryKey;
+            for (auto it = range.first; it != range.second; it++) {
+                if (it->second.stateKey == primaryKey) {
+                    it->second.tracker->onStateChanged(eventTimeNs, atomId, newState);
+                }
+            }
             continue;
         }
-        whatIt.second->onStateChanged(eventTimeNs, atomId, newStateCopy);
+
+        // Each duration tracker is mapped to a different whatKey (a set of values from the
+        // dimensionsInWhat fields). We notify all trackers iff the primaryKey field values from
+        // the state change event are a subset of the tracker's whatKey field values.
+        //
+        // Ex. For a duration metric dimensioned on uid and tag:
+        // DurationTracker1 whatKey = uid: 1001, tag: 1
+        // DurationTracker2 whatKey = uid: 1002, tag 1
+        //
+        // If the state change primaryKey = uid: 1001, we only notify DurationTracker1 of a state
+        // change.
+        for (auto& whatIt : mCurrentSlicedDurationTrackerMap) {
+            if (containsLinkedStateValues(whatIt.first, change.primaryKey, mMetric2StateLinks,
+                                          atomId)) {
+                whatIt.second->onStateChanged(eventTimeNs, atomId, newState);
+            }
+        }
+    }
+}
+
+void DurationMetricProducer::addToStateLinkIndices(const HashableDimensionKey& whatKey,
+                                                   DurationTracker* tracker) {
+    for (auto& [_, index] : mStateLinkIndices) {
+        HashableDimensionKey stateKey;
+        getDimensionForState(whatKey.getValues(), *index.link, &stateKey);
+        if (stateKey.getValues().size() != index.link->stateFields.size()) {
+            // The what key is not linked to any primary key of the state atom.
+            continue;
+        }
+        if (!isSortedByField(stateKey)) {
+            stateKey = sortByField(stateKey);
+        }
+        const size_t hash = hashDimension(stateKey);
+        index.trackers.emplace(hash, LinkedDurationTracker{std::move(stateKey), tracker});
+    }
+}
+
+void DurationMetricProducer::removeFromStateLinkIndices(const HashableDimensionKey& whatKey,
+                                                        const DurationTracker* tracker) {
+    for (auto& [_, index] : mStateLinkIndices) {
+        HashableDimensionKey stateKey;
+        getDimensionForState(whatKey.getValues(), *index.link, &stateKey);
+        const auto range = index.trackers.equal_range(hashDimensionSortedByField(stateKey));
+        for (auto it = range.first; it != range.second; it++) {
+            if (it->second.tracker == tracker) {
+                index.trackers.erase(it);
+                break;
+            }
+        }
     }
 }
 
@@ -502,100 +585,114 @@ void DurationMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mPastBuckets.clear();
 }
 
-void DurationMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                                const bool include_current_partial_bucket,
-                                                const bool erase_data,
-                                                const DumpLatency dumpLatency,
-                                                std::set<string> *str_set,
-                                                ProtoOutputStream* protoOutput) {
+DumpReportWriter DurationMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency) {
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
     } else {
         flushIfNeededLocked(dumpTimeNs);
     }
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
 
-    if (mPastBuckets.empty()) {
-        VLOG(" Duration metric, empty return");
-        return;
+    auto pastBuckets = std::make_shared<
+            const std::unordered_map<MetricDimensionKey, std::vector<DurationBucket>>>(
+            erase_data ? std::move(mPastBuckets) : mPastBuckets);
+    if (erase_data) {
+        mPastBuckets.clear();
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
+    // We only write the condition timer value if the metric has a
+    // condition and isn't sliced by state or condition.
+    // TODO(b/268531762): Slice the condition timer by state and condition
+    const bool writeConditionTrueNs =
+            mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced;
+
+    return [metricId = mMetricId, isActive = isActiveLocked(), timeBaseNs = mTimeBaseNs,
+            bucketSizeNs = mBucketSizeNs, shouldUseNestedDimensions = mShouldUseNestedDimensions,
+            dimensionsInWhat = mDimensionsInWhat, writeConditionTrueNs,
+            pastBuckets](std::set<string>* str_set, ProtoOutputStream* protoOutput) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)metricId);
+        protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActive);
 
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
-            uint64_t dimenPathToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
-            protoOutput->end(dimenPathToken);
+        if (pastBuckets->empty()) {
+            VLOG(" Duration metric, empty return");
+            return;
         }
-    }
 
-    uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DURATION_METRICS);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)timeBaseNs);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)bucketSizeNs);
+
+        if (!shouldUseNestedDimensions) {
+            if (!dimensionsInWhat.empty()) {
+                uint64_t dimenPathToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
+                writeDimensionPathToProto(dimensionsInWhat, protoOutput);
+                protoOutput->end(dimenPathToken);
+            }
+        }
 
-    VLOG("Duration metric %lld dump report now...", (long long)mMetricId);
+        uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DURATION_METRICS);
 
-    for (const auto& pair : mPastBuckets) {
-        const MetricDimensionKey& dimensionKey = pair.first;
-        VLOG("  dimension key %s", dimensionKey.toString().c_str());
-
-        uint64_t wrapperToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
-
-        // First fill dimension.
-        if (mShouldUseNestedDimensions) {
-            uint64_t dimensionToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
-            writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
-            protoOutput->end(dimensionToken);
-        } else {
-            writeDimensionLeafNodesToProto(dimensionKey.getDimensionKeyInWhat(),
-                                           FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set, protoOutput);
-        }
-        // Then fill slice_by_state.
-        for (auto state : dimensionKey.getStateValuesKey().getValues()) {
-            uint64_t stateToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                                     FIELD_ID_SLICE_BY_STATE);
-            writeStateToProto(state, protoOutput);
-            protoOutput->end(stateToken);
-        }
-        // Then fill bucket_info (DurationBucketInfo).
-        for (const auto& bucket : pair.second) {
-            uint64_t bucketInfoToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketStartNs));
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketEndNs));
+        VLOG("Duration metric %lld dump report now...", (long long)metricId);
+
+        for (const auto& pair : *pastBuckets) {
+            const MetricDimensionKey& dimensionKey = pair.first;
+            VLOG("  dimension key %s", dimensionKey.toString().c_str());
+
+            uint64_t wrapperToken =
+                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
+
+            // First fill dimension.
+            if (shouldUseNestedDimensions) {
+                uint64_t dimensionToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
+                writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
+                protoOutput->end(dimensionToken);
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                writeDimensionLeafNodesToProto(dimensionKey.getDimensionKeyInWhat(),
+                                               FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set,
+                                               protoOutput);
             }
-            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DURATION, (long long)bucket.mDuration);
-
-            // We only write the condition timer value if the metric has a
-            // condition and isn't sliced by state or condition.
-            // TODO(b/268531762): Slice the condition timer by state and condition
-            if (mConditionTrackerIndex >= 0 && mSlicedStateAtoms.empty() && !mConditionSliced) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
-                                   (long long)bucket.mConditionTrueNs);
+            // Then fill slice_by_state.
+            for (auto state : dimensionKey.getStateValuesKey().getValues()) {
+                uint64_t stateToken = protoOutput->start(FIELD_TYPE_MESSAGE |
+                                                         FIELD_COUNT_REPEATED |
+                                                         FIELD_ID_SLICE_BY_STATE);
+                writeStateToProto(state, protoOutput);
+                protoOutput->end(stateToken);
             }
+            // Then fill bucket_info (DurationBucketInfo).
+            for (const auto& bucket : pair.second) {
+                uint64_t bucketInfoToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
+                if (bucket.mBucketEndNs - bucket.mBucketStartNs != bucketSizeNs) {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+                                       (long long)NanoToMillis(bucket.mBucketStartNs));
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+                                       (long long)NanoToMillis(bucket.mBucketEndNs));
+                } else {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                                       (long long)(getBucketNumFromEndTimeNs(
+                                               timeBaseNs, bucketSizeNs, bucket.mBucketEndNs)));
+                }
+                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DURATION,
+                                   (long long)bucket.mDuration);
 
-            protoOutput->end(bucketInfoToken);
-            VLOG("\t bucket [%lld - %lld] duration: %lld", (long long)bucket.mBucketStartNs,
-                 (long long)bucket.mBucketEndNs, (long long)bucket.mDuration);
-        }
+                if (writeConditionTrueNs) {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_CONDITION_TRUE_NS,
+                                       (long long)bucket.mConditionTrueNs);
+                }
 
-        protoOutput->end(wrapperToken);
-    }
+                protoOutput->end(bucketInfoToken);
+                VLOG("\t bucket [%lld - %lld] duration: %lld", (long long)bucket.mBucketStartNs,
+                     (long long)bucket.mBucketEndNs, (long long)bucket.mDuration);
+            }
 
-    protoOutput->end(protoToken);
-    if (erase_data) {
-        mPastBuckets.clear();
-    }
+            protoOutput->end(wrapperToken);
+        }
+
+        protoOutput->end(protoToken);
+    };
 }
 
 void DurationMetricProducer::flushIfNeededLocked(const int64_t& eventTimeNs) {
@@ -622,6 +719,7 @@ void DurationMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs
         if (whatIt->second->flushCurrentBucket(eventTimeNs, mUploadThreshold, globalConditionTrueNs,
                                                &mPastBuckets)) {
             VLOG("erase bucket for key %s", whatIt->first.toString().c_str());
+            removeFromStateLinkIndices(whatIt->first, whatIt->second.get());
             whatIt = mCurrentSlicedDurationTrackerMap.erase(whatIt);
         } else {
             ++whatIt;
@@ -682,7 +780,9 @@ void DurationMetricProducer::handleStartEvent(const MetricDimensionKey& eventKey
         if (hitGuardRailLocked(eventKey)) {
             return;
         }
-        mCurrentSlicedDurationTrackerMap[whatKey] = createDurationTracker(eventKey);
+        unique_ptr<DurationTracker>& tracker = mCurrentSlicedDurationTrackerMap[whatKey];
+        tracker = createDurationTracker(eventKey);
+        addToStateLinkIndices(whatKey, tracker.get());
     }
 
     auto it = mCurrentSlicedDurationTrackerMap.find(whatKey);
@@ -63,6 +63,9 @@ public:
                         const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                         const FieldValue& newState) override;
 
+    void onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                        const std::vector<StateChange>& changes) override;
+
     MetricType getMetricType() const override {
         return METRIC_TYPE_DURATION;
     }
@@ -86,12 +89,10 @@ private:
                           bool condition, const int64_t eventTimeNs,
                           const vector<FieldValue>& eventValues);
 
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            const bool erase_data,
-                            const DumpLatency dumpLatency,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    DumpReportWriter prepareDumpReportLocked(const int64_t dumpTimeNs,
+                                             const bool include_current_partial_bucket,
+                                             const bool erase_data,
+                                             const DumpLatency dumpLatency) override;
 
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
@@ -172,6 +173,29 @@ private:
     std::unordered_map<HashableDimensionKey, std::unique_ptr<DurationTracker>>
             mCurrentSlicedDurationTrackerMap;
 
+    // A duration tracker and the state primary key that its what key is linked to.
+    struct LinkedDurationTracker {
+        // Sorted by field.
+        HashableDimensionKey stateKey;
+        DurationTracker* tracker;
+    };
+
+    // Duration trackers by linked state primary key, for a state atom that has a single
+    // MetricStateLink. The linked key of a what key is computed once, when its tracker is created.
+    struct StateLinkIndex {
+        const Metric2State* link;
+        // Keyed by hashDimensionSortedByField() of the linked key, like StateChange.
+        std::unordered_multimap<size_t, LinkedDurationTracker> trackers;
+    };
+
+    // By state atom id.
+    std::unordered_map<int32_t, StateLinkIndex> mStateLinkIndices;
+
+    void addToStateLinkIndices(const HashableDimensionKey& whatKey, DurationTracker* tracker);
+
+    void removeFromStateLinkIndices(const HashableDimensionKey& whatKey,
+                                    const DurationTracker* tracker);
+
     // Helper function to create a duration tracker given the metric aggregation type.
     std::unique_ptr<DurationTracker> createDurationTracker(
             const MetricDimensionKey& eventKey) const;
@@ -188,6 +212,7 @@ private:
     FRIEND_TEST(DurationMetricTrackerTest, TestFirstBucket);
 
     FRIEND_TEST(DurationMetricProducerTest, TestSumDurationAppUpgradeSplitDisabled);
+    FRIEND_TEST(DurationMetricProducerTest, TestStateLinkIndex);
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket, TestSumDuration);
     FRIEND_TEST(DurationMetricProducerTest_PartialBucket,
                 TestSumDurationWithSplitInFollowingBucket);
@@ -22,6 +22,7 @@
 #include <limits.h>
 #include <stdlib.h>
 
+#include "metrics/AtomEncoder.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
 #include "stats_util.h"
@@ -48,6 +49,7 @@ namespace statsd {
 const int FIELD_ID_ID = 1;
 const int FIELD_ID_EVENT_METRICS = 4;
 const int FIELD_ID_IS_ACTIVE = 14;
+const int FIELD_ID_ATOM_ENCODING_DICTIONARY = 17;
 // for EventMetricDataWrapper
 const int FIELD_ID_DATA = 1;
 // for EventMetricData
@@ -55,6 +57,8 @@ const int FIELD_ID_AGGREGATED_ATOM = 4;
 // for AggregatedAtomInfo
 const int FIELD_ID_ATOM = 1;
 const int FIELD_ID_ATOM_TIMESTAMPS = 2;
+const int FIELD_ID_ENCODED_ATOM = 3;
+const int FIELD_ID_ELAPSED_TIMESTAMP_DELTAS = 4;
 
 EventMetricProducer::EventMetricProducer(
         const ConfigKey& key, const EventMetric& metric, const int conditionIndex,
@@ -66,7 +70,8 @@ EventMetricProducer::EventMetricProducer(
         const unordered_map<int, unordered_map<int, int64_t>>& stateGroupMap)
     : MetricProducer(metric.id(), key, startTimeNs, conditionIndex, initialConditionCache, wizard,
                      protoHash, eventActivationMap, eventDeactivationMap, slicedStateAtoms,
-                     stateGroupMap, /*splitBucketForAppUpgrade=*/nullopt) {
+                     stateGroupMap, /*splitBucketForAppUpgrade=*/nullopt),
+      mCompactAtomEncoding(metric.compact_atom_encoding()) {
     if (metric.links().size() > 0) {
         for (const auto& link : metric.links()) {
             Metric2Condition mc;
@@ -163,38 +168,57 @@ void EventMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     mTotalSize = 0;
 }
 
-void EventMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                             const bool include_current_partial_bucket,
-                                             const bool erase_data,
-                                             const DumpLatency dumpLatency,
-                                             std::set<string> *str_set,
-                                             ProtoOutputStream* protoOutput) {
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
-    uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_EVENT_METRICS);
-    for (const auto& [atomDimensionKey, elapsedTimestampsNs] : mAggregatedAtoms) {
-        uint64_t wrapperToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
-
-        uint64_t aggregatedToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_AGGREGATED_ATOM);
-
-        uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM);
-        writeFieldValueTreeToStream(atomDimensionKey.getAtomTag(),
-                                    atomDimensionKey.getAtomFieldValues().getValues(), protoOutput);
-        protoOutput->end(atomToken);
-        for (int64_t timestampNs : elapsedTimestampsNs) {
-            protoOutput->write(FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED | FIELD_ID_ATOM_TIMESTAMPS,
-                               (long long)timestampNs);
-        }
-        protoOutput->end(aggregatedToken);
-        protoOutput->end(wrapperToken);
-    }
-    protoOutput->end(protoToken);
+DumpReportWriter EventMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency) {
+    auto aggregatedAtoms =
+            std::make_shared<const std::unordered_map<AtomDimensionKey, std::vector<int64_t>>>(
+                    erase_data ? std::move(mAggregatedAtoms) : mAggregatedAtoms);
     if (erase_data) {
         mAggregatedAtoms.clear();
         mTotalSize = 0;
     }
+
+    return [metricId = mMetricId, isActive = isActiveLocked(),
+            compactAtomEncoding = mCompactAtomEncoding,
+            aggregatedAtoms](std::set<string>* str_set, ProtoOutputStream* protoOutput) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)metricId);
+        protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActive);
+        uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_EVENT_METRICS);
+        AtomEncoder encoder(str_set);
+        for (const auto& [atomDimensionKey, elapsedTimestampsNs] : *aggregatedAtoms) {
+            uint64_t wrapperToken =
+                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
+
+            uint64_t aggregatedToken =
+                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_AGGREGATED_ATOM);
+
+            if (compactAtomEncoding) {
+                encoder.writeAtom(atomDimensionKey.getAtomTag(),
+                                  atomDimensionKey.getAtomFieldValues().getValues(),
+                                  FIELD_ID_ENCODED_ATOM, protoOutput);
+                AtomEncoder::writeTimestamps(elapsedTimestampsNs,
+                                             FIELD_ID_ELAPSED_TIMESTAMP_DELTAS, protoOutput);
+            } else {
+                uint64_t atomToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM);
+                writeFieldValueTreeToStream(atomDimensionKey.getAtomTag(),
+                                            atomDimensionKey.getAtomFieldValues().getValues(),
+                                            protoOutput);
+                protoOutput->end(atomToken);
+                for (int64_t timestampNs : elapsedTimestampsNs) {
+                    protoOutput->write(
+                            FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED | FIELD_ID_ATOM_TIMESTAMPS,
+                            (long long)timestampNs);
+                }
+            }
+            protoOutput->end(aggregatedToken);
+            protoOutput->end(wrapperToken);
+        }
+        protoOutput->end(protoToken);
+        if (compactAtomEncoding) {
+            encoder.writeDictionary(FIELD_ID_ATOM_ENCODING_DICTIONARY, protoOutput);
+        }
+    };
 }
 
 void EventMetricProducer::onConditionChangedLocked(const bool conditionMet,
@@ -20,6 +20,7 @@
 #include "GaugeMetricProducer.h"
 
 #include "guardrail/StatsdStats.h"
+#include "metrics/AtomEncoder.h"
 #include "metrics/parsing_utils/metrics_manager_util.h"
 #include "stats_log_util.h"
 
@@ -49,6 +50,7 @@ const int FIELD_ID_TIME_BASE = 9;
 const int FIELD_ID_BUCKET_SIZE = 10;
 const int FIELD_ID_DIMENSION_PATH_IN_WHAT = 11;
 const int FIELD_ID_IS_ACTIVE = 14;
+const int FIELD_ID_ATOM_ENCODING_DICTIONARY = 17;
 // for GaugeMetricDataWrapper
 const int FIELD_ID_DATA = 1;
 const int FIELD_ID_SKIPPED = 2;
@@ -71,6 +73,8 @@ const int FIELD_ID_AGGREGATED_ATOM = 9;
 // for AggregatedAtomInfo
 const int FIELD_ID_ATOM_VALUE = 1;
 const int FIELD_ID_ATOM_TIMESTAMPS = 2;
+const int FIELD_ID_ENCODED_ATOM = 3;
+const int FIELD_ID_ELAPSED_TIMESTAMP_DELTAS = 4;
 
 GaugeMetricProducer::GaugeMetricProducer(
         const ConfigKey& key, const GaugeMetric& metric, const int conditionIndex,
@@ -96,6 +100,7 @@ GaugeMetricProducer::GaugeMetricProducer(
       mSamplingType(metric.sampling_type()),
       mMaxPullDelayNs(metric.max_pull_delay_sec() > 0 ? metric.max_pull_delay_sec() * NS_PER_SEC
                                                       : StatsdStats::kPullMaxDelayNs),
+      mCompactAtomEncoding(metric.compact_atom_encoding()),
       mDimensionSoftLimit(dimensionSoftLimit),
       mDimensionHardLimit(dimensionHardLimit),
       mGaugeAtomsPerDimensionLimit(metric.max_num_gauge_atoms_per_bucket()) {
@@ -236,15 +241,13 @@ void GaugeMetricProducer::dumpStatesLocked(FILE* out, bool verbose) const {
 void GaugeMetricProducer::clearPastBucketsLocked(const int64_t dumpTimeNs) {
     flushIfNeededLocked(dumpTimeNs);
     mPastBuckets.clear();
+    mPastAtoms.clear();
     mSkippedBuckets.clear();
 }
 
-void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
-                                             const bool include_current_partial_bucket,
-                                             const bool erase_data,
-                                             const DumpLatency dumpLatency,
-                                             std::set<string> *str_set,
-                                             ProtoOutputStream* protoOutput) {
+DumpReportWriter GaugeMetricProducer::prepareDumpReportLocked(
+        const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
+        const DumpLatency dumpLatency) {
     VLOG("Gauge metric %lld report now...", (long long)mMetricId);
     if (include_current_partial_bucket) {
         flushLocked(dumpTimeNs);
@@ -252,113 +255,145 @@ void GaugeMetricProducer::onDumpReportLocked(const int64_t dumpTimeNs,
         flushIfNeededLocked(dumpTimeNs);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
-
-    if (mPastBuckets.empty() && mSkippedBuckets.empty()) {
-        return;
+    // The buckets share the atoms of mPastAtoms, so the copies keep them alive after it's cleared.
+    auto pastBuckets = std::make_shared<
+            const std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>>>(
+            erase_data ? std::move(mPastBuckets) : mPastBuckets);
+    auto skippedBuckets = std::make_shared<const std::vector<SkippedBucket>>(
+            erase_data ? std::move(mSkippedBuckets) : mSkippedBuckets);
+    if (erase_data) {
+        mPastBuckets.clear();
+        mPastAtoms.clear();
+        mSkippedBuckets.clear();
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
+    return [metricId = mMetricId, isActive = isActiveLocked(), atomId = mAtomId,
+            timeBaseNs = mTimeBaseNs, bucketSizeNs = mBucketSizeNs,
+            shouldUseNestedDimensions = mShouldUseNestedDimensions,
+            dimensionsInWhat = mDimensionsInWhat, compactAtomEncoding = mCompactAtomEncoding,
+            pastBuckets, skippedBuckets](std::set<string>* str_set,
+                                         ProtoOutputStream* protoOutput) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)metricId);
+        protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActive);
 
-    // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
-            uint64_t dimenPathToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
-            protoOutput->end(dimenPathToken);
+        if (pastBuckets->empty() && skippedBuckets->empty()) {
+            return;
         }
-    }
 
-    uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_GAUGE_METRICS);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)timeBaseNs);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)bucketSizeNs);
 
-    for (const auto& skippedBucket : mSkippedBuckets) {
-        uint64_t wrapperToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED);
-        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
-                           (long long)(NanoToMillis(skippedBucket.bucketStartTimeNs)));
-        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_END_MILLIS,
-                           (long long)(NanoToMillis(skippedBucket.bucketEndTimeNs)));
-
-        for (const auto& dropEvent : skippedBucket.dropEvents) {
-            uint64_t dropEventToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                                         FIELD_ID_SKIPPED_DROP_EVENT);
-            protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_BUCKET_DROP_REASON, dropEvent.reason);
-            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DROP_TIME, (long long) (NanoToMillis(dropEvent.dropTimeNs)));
-            protoOutput->end(dropEventToken);
+        // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
+        if (!shouldUseNestedDimensions) {
+            if (!dimensionsInWhat.empty()) {
+                uint64_t dimenPathToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
+                writeDimensionPathToProto(dimensionsInWhat, protoOutput);
+                protoOutput->end(dimenPathToken);
+            }
         }
-        protoOutput->end(wrapperToken);
-    }
 
-    for (const auto& pair : mPastBuckets) {
-        const MetricDimensionKey& dimensionKey = pair.first;
-
-        VLOG("Gauge dimension key %s", dimensionKey.toString().c_str());
-        uint64_t wrapperToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
-
-        // First fill dimension.
-        if (mShouldUseNestedDimensions) {
-            uint64_t dimensionToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
-            writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
-            protoOutput->end(dimensionToken);
-        } else {
-            writeDimensionLeafNodesToProto(dimensionKey.getDimensionKeyInWhat(),
-                                           FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set, protoOutput);
+        uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_GAUGE_METRICS);
+        AtomEncoder encoder(str_set);
+
+        for (const auto& skippedBucket : *skippedBuckets) {
+            uint64_t wrapperToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                                       FIELD_ID_SKIPPED);
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
+                               (long long)(NanoToMillis(skippedBucket.bucketStartTimeNs)));
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_END_MILLIS,
+                               (long long)(NanoToMillis(skippedBucket.bucketEndTimeNs)));
+
+            for (const auto& dropEvent : skippedBucket.dropEvents) {
+                uint64_t dropEventToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED_DROP_EVENT);
+                protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_BUCKET_DROP_REASON,
+                                   dropEvent.reason);
+                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DROP_TIME,
+                                   (long long)(NanoToMillis(dropEvent.dropTimeNs)));
+                protoOutput->end(dropEventToken);
+            }
+            protoOutput->end(wrapperToken);
         }
 
-        // Then fill bucket_info (GaugeBucketInfo).
-        for (const auto& bucket : pair.second) {
-            uint64_t bucketInfoToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketStartNs));
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
-                                   (long long)NanoToMillis(bucket.mBucketEndNs));
+        for (const auto& pair : *pastBuckets) {
+            const MetricDimensionKey& dimensionKey = pair.first;
+
+            VLOG("Gauge dimension key %s", dimensionKey.toString().c_str());
+            uint64_t wrapperToken =
+                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
+
+            // First fill dimension.
+            if (shouldUseNestedDimensions) {
+                uint64_t dimensionToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
+                writeDimensionToProto(dimensionKey.getDimensionKeyInWhat(), str_set, protoOutput);
+                protoOutput->end(dimensionToken);
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                writeDimensionLeafNodesToProto(dimensionKey.getDimensionKeyInWhat(),
+                                               FIELD_ID_DIMENSION_LEAF_IN_WHAT, str_set,
+                                               protoOutput);
             }
 
-            if (!bucket.mAggregatedAtoms.empty()) {
-                for (const auto& [atomDimensionKey, elapsedTimestampsNs] :
-                     bucket.mAggregatedAtoms) {
-                    uint64_t aggregatedAtomToken = protoOutput->start(
-                            FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_AGGREGATED_ATOM);
-                    uint64_t atomToken =
-                            protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_VALUE);
-                    writeFieldValueTreeToStream(mAtomId,
-                                                atomDimensionKey.getAtomFieldValues().getValues(),
-                                                protoOutput);
-                    protoOutput->end(atomToken);
-                    for (int64_t timestampNs : elapsedTimestampsNs) {
-                        protoOutput->write(
-                                FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED | FIELD_ID_ATOM_TIMESTAMPS,
-                                (long long)timestampNs);
+            // Then fill bucket_info (GaugeBucketInfo).
+            for (const auto& bucket : pair.second) {
+                uint64_t bucketInfoToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
+
+                if (bucket.mBucketEndNs - bucket.mBucketStartNs != bucketSizeNs) {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_START_BUCKET_ELAPSED_MILLIS,
+                                       (long long)NanoToMillis(bucket.mBucketStartNs));
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_END_BUCKET_ELAPSED_MILLIS,
+                                       (long long)NanoToMillis(bucket.mBucketEndNs));
+                } else {
+                    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_NUM,
+                                       (long long)(getBucketNumFromEndTimeNs(
+                                               timeBaseNs, bucketSizeNs, bucket.mBucketEndNs)));
+                }
+
+                if (!bucket.mAggregatedAtoms.empty()) {
+                    for (const auto& [atomDimensionKey, elapsedTimestampsNs] :
+                         bucket.mAggregatedAtoms) {
+                        uint64_t aggregatedAtomToken = protoOutput->start(
+                                FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                FIELD_ID_AGGREGATED_ATOM);
+                        if (compactAtomEncoding) {
+                            encoder.writeAtom(atomId,
+                                              atomDimensionKey->getAtomFieldValues().getValues(),
+                                              FIELD_ID_ENCODED_ATOM, protoOutput);
+                            AtomEncoder::writeTimestamps(elapsedTimestampsNs,
+                                                         FIELD_ID_ELAPSED_TIMESTAMP_DELTAS,
+                                                         protoOutput);
+                            protoOutput->end(aggregatedAtomToken);
+                            continue;
+                        }
+                        uint64_t atomToken =
+                                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_ATOM_VALUE);
+                        writeFieldValueTreeToStream(
+                                atomId, atomDimensionKey->getAtomFieldValues().getValues(),
+                                protoOutput);
+                        protoOutput->end(atomToken);
+                        for (int64_t timestampNs : elapsedTimestampsNs) {
+                            protoOutput->write(FIELD_TYPE_INT64 | FIELD_COUNT_REPEATED |
+                                                       FIELD_ID_ATOM_TIMESTAMPS,
+                                               (long long)timestampNs);
+                        }
+                        protoOutput->end(aggregatedAtomToken);
                     }
-                    protoOutput->end(aggregatedAtomToken);
                 }
-            }
 
-            protoOutput->end(bucketInfoToken);
-            VLOG("Gauge \t bucket [%lld - %lld] includes %d atoms.",
-                 (long long)bucket.mBucketStartNs, (long long)bucket.mBucketEndNs,
-                 (int)bucket.mAggregatedAtoms.size());
+                protoOutput->end(bucketInfoToken);
+                VLOG("Gauge \t bucket [%lld - %lld] includes %d atoms.",
+                     (long long)bucket.mBucketStartNs, (long long)bucket.mBucketEndNs,
+                     (int)bucket.mAggregatedAtoms.size());
+            }
+            protoOutput->end(wrapperToken);
         }
-        protoOutput->end(wrapperToken);
-    }
-    protoOutput->end(protoToken);
-
-
-    if (erase_data) {
-        mPastBuckets.clear();
-        mSkippedBuckets.clear();
-    }
+        protoOutput->end(protoToken);
+        if (compactAtomEncoding) {
+            encoder.writeDictionary(FIELD_ID_ATOM_ENCODING_DICTIONARY, protoOutput);
+        }
+    };
 }
 
 void GaugeMetricProducer::prepareFirstBucketLocked() {
@@ -401,11 +436,9 @@ void GaugeMetricProducer::pullAndMatchEventsLocked(const int64_t timestampNs) {
         return;
     }
     for (const auto& data : allData) {
-        LogEvent localCopy = *data;
-        localCopy.setElapsedTimestampNs(timestampNs);
-        if (mEventMatcherWizard->matchLogEvent(localCopy, mWhatMatcherIndex) ==
+        if (mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex) ==
             MatchingState::kMatched) {
-            onMatchedLogEventLocked(mWhatMatcherIndex, localCopy);
+            onMatchedPulledEventLocked(mWhatMatcherIndex, *data, timestampNs);
         }
     }
 }
@@ -530,7 +563,7 @@ void GaugeMetricProducer::onMatchedLogEventInternalLocked(
     if (condition == false) {
         return;
     }
-    int64_t eventTimeNs = event.GetElapsedTimestampNs();
+    int64_t eventTimeNs = getEventTimeNsLocked(event);
     if (eventTimeNs < mCurrentBucketStartTimeNs) {
         VLOG("Gauge Skip event due to late arrival: %lld vs %lld", (long long)eventTimeNs,
              (long long)mCurrentBucketStartTimeNs);
@@ -559,7 +592,7 @@ void GaugeMetricProducer::onMatchedLogEventInternalLocked(
         return;
     }
 
-    const int64_t truncatedElapsedTimestampNs = truncateTimestampIfNecessary(event);
+    const int64_t truncatedElapsedTimestampNs = truncateTimestampIfNecessary(event, eventTimeNs);
     GaugeAtom gaugeAtom(getGaugeFields(event), truncatedElapsedTimestampNs);
     (*mCurrentSlicedBucket)[eventKey].push_back(gaugeAtom);
     // Anomaly detection on gauge metric only works when there is one numeric
@@ -601,6 +634,19 @@ void GaugeMetricProducer::dropDataLocked(const int64_t dropTimeNs) {
     flushIfNeededLocked(dropTimeNs);
     StatsdStats::getInstance().noteBucketDropped(mMetricId);
     mPastBuckets.clear();
+    mPastAtoms.clear();
+}
+
+std::shared_ptr<const AtomDimensionKey> GaugeMetricProducer::internPastAtomLocked(
+        const vector<FieldValue>& fields) {
+    AtomDimensionKey key(mAtomId, HashableDimensionKey(fields));
+    // Non-owning pointer to the local key, only used for the lookup.
+    const std::shared_ptr<const AtomDimensionKey> lookupKey(std::shared_ptr<void>(), &key);
+    const auto it = mPastAtoms.find(lookupKey);
+    if (it != mPastAtoms.end()) {
+        return *it;
+    }
+    return *mPastAtoms.insert(std::make_shared<const AtomDimensionKey>(std::move(key))).first;
 }
 
 // When a new matched event comes in, we check if event falls into the current
@@ -643,8 +689,8 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs,
         for (const auto& slice : *mCurrentSlicedBucket) {
             info.mAggregatedAtoms.clear();
             for (const GaugeAtom& atom : slice.second) {
-                AtomDimensionKey key(mAtomId, HashableDimensionKey(*atom.mFields));
-                vector<int64_t>& elapsedTimestampsNs = info.mAggregatedAtoms[key];
+                vector<int64_t>& elapsedTimestampsNs =
+                        info.mAggregatedAtoms[internPastAtomLocked(*atom.mFields)];
                 elapsedTimestampsNs.push_back(atom.mElapsedTimestampNs);
             }
             auto& bucketList = mPastBuckets[slice.first];
@@ -685,12 +731,14 @@ void GaugeMetricProducer::flushCurrentBucketLocked(const int64_t& eventTimeNs,
 
 size_t GaugeMetricProducer::byteSizeLocked() const {
     size_t totalSize = 0;
+    // Atoms shared by several buckets are only counted once.
+    for (const auto& atomDimensionKey : mPastAtoms) {
+        totalSize += sizeof(FieldValue) * atomDimensionKey->getAtomFieldValues().getValues().size();
+    }
     for (const auto& pair : mPastBuckets) {
         for (const auto& bucket : pair.second) {
-            for (const auto& [atomDimensionKey, elapsedTimestampsNs] : bucket.mAggregatedAtoms) {
-                totalSize += sizeof(FieldValue) *
-                             atomDimensionKey.getAtomFieldValues().getValues().size();
-                totalSize += sizeof(int64_t) * elapsedTimestampsNs.size();
+            for (const auto& aggregatedAtom : bucket.mAggregatedAtoms) {
+                totalSize += sizeof(int64_t) * aggregatedAtom.second.size();
             }
         }
     }
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <unordered_map>
+#include <unordered_set>
 
 #include <android/util/ProtoOutputStream.h>
 #include <gtest/gtest_prod.h>
@@ -47,7 +48,24 @@ struct GaugeBucket {
     std::vector<GaugeAtom> mGaugeAtoms;
 
     // Maps the field/value pairs of an atom to a list of timestamps used to deduplicate atoms.
-    std::unordered_map<AtomDimensionKey, std::vector<int64_t>> mAggregatedAtoms;
+    // The keys are interned by the GaugeMetricProducer, so that identical atoms share one copy
+    // across buckets and can be compared by pointer.
+    std::unordered_map<std::shared_ptr<const AtomDimensionKey>, std::vector<int64_t>>
+            mAggregatedAtoms;
+};
+
+// Hashes and compares interned AtomDimensionKeys by content.
+struct SharedAtomDimensionKeyHash {
+    size_t operator()(const std::shared_ptr<const AtomDimensionKey>& key) const {
+        return std::hash<AtomDimensionKey>{}(*key);
+    }
+};
+
+struct SharedAtomDimensionKeyEqual {
+    bool operator()(const std::shared_ptr<const AtomDimensionKey>& lhs,
+                    const std::shared_ptr<const AtomDimensionKey>& rhs) const {
+        return *lhs == *rhs;
+    }
 };
 
 typedef std::unordered_map<MetricDimensionKey, std::vector<GaugeAtom>>
@@ -114,12 +132,10 @@ protected:
             const std::map<int, HashableDimensionKey>& statePrimaryKeys) override;
 
 private:
-    void onDumpReportLocked(const int64_t dumpTimeNs,
-                            const bool include_current_partial_bucket,
-                            const bool erase_data,
-                            const DumpLatency dumpLatency,
-                            std::set<string> *str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    DumpReportWriter prepareDumpReportLocked(const int64_t dumpTimeNs,
+                                             const bool include_current_partial_bucket,
+                                             const bool erase_data,
+                                             const DumpLatency dumpLatency) override;
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
     // Internal interface to handle condition change.
@@ -190,6 +206,12 @@ private:
     // Save the past buckets and we can clear when the StatsLogReport is dumped.
     std::unordered_map<MetricDimensionKey, std::vector<GaugeBucket>> mPastBuckets;
 
+    // Content-addressed store of the atoms in mPastBuckets. Slow-changing gauges report the same
+    // atom bucket after bucket, and all of these buckets share the copy kept here.
+    std::unordered_set<std::shared_ptr<const AtomDimensionKey>, SharedAtomDimensionKeyHash,
+                       SharedAtomDimensionKeyEqual>
+            mPastAtoms;
+
     // The current partial bucket.
     std::shared_ptr<DimToGaugeAtomsMap> mCurrentSlicedBucket;
 
@@ -210,9 +232,15 @@ private:
 
     const int64_t mMaxPullDelayNs;
 
+    // Whether atoms are written as EncodedAtom in the report.
+    const bool mCompactAtomEncoding;
+
     // apply an allowlist on the original input
     std::shared_ptr<vector<FieldValue>> getGaugeFields(const LogEvent& event);
 
+    // Returns the copy of the atom with these fields in mPastAtoms, adding it if needed.
+    std::shared_ptr<const AtomDimensionKey> internPastAtomLocked(const vector<FieldValue>& fields);
+
     // Util function to check whether the specified dimension hits the guardrail.
     bool hitGuardRailLocked(const MetricDimensionKey& newKey);
 
@@ -233,6 +261,8 @@ private:
     FRIEND_TEST(GaugeMetricProducerTest, TestPullOnTrigger);
     FRIEND_TEST(GaugeMetricProducerTest, TestPullNWithoutTrigger);
     FRIEND_TEST(GaugeMetricProducerTest, TestRemoveDimensionInOutput);
+    FRIEND_TEST(GaugeMetricProducerTest, TestPastAtomsSharedAcrossBuckets);
+    FRIEND_TEST(GaugeMetricProducerTest, TestPrepareDumpReportKeepsPastAtoms);
     FRIEND_TEST(GaugeMetricProducerTest, TestPullDimensionalSampling);
 
     FRIEND_TEST(GaugeMetricProducerTest_PartialBucket, TestPushedEvents);
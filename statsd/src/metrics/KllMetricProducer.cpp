@@ -37,7 +37,6 @@ using std::optional;
 using std::shared_ptr;
 using std::string;
 using std::unordered_map;
-using zetasketch::android::AggregatorStateProto;
 
 namespace android {
 namespace os {
@@ -82,17 +81,25 @@ void KllMetricProducer::writePastBucketAggregateToProto(
             protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKETCHES);
     protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_SKETCH_INDEX, aggIndex);
 
-    // TODO(b/186737273): Serialize directly to ProtoOutputStream
-    const AggregatorStateProto& aggProto = kll->SerializeToProto();
-    const size_t numBytes = aggProto.ByteSizeLong();
-    const unique_ptr<char[]> buffer(new char[numBytes]);
-    aggProto.SerializeToArray(&buffer[0], numBytes);
-    protoOutput->write(FIELD_TYPE_BYTES | FIELD_ID_KLL_SKETCH, &buffer[0], numBytes);
+    // Holds the encoded sketch while it is written to the report. Reused for all sketches, so
+    // dumping does not allocate per sketch. Reports are written without mMutex, possibly by
+    // several binder threads at once.
+    thread_local string sketchBuffer;
+    kll->SerializeToString(&sketchBuffer);
+    protoOutput->write(FIELD_TYPE_BYTES | FIELD_ID_KLL_SKETCH, sketchBuffer.data(),
+                       sketchBuffer.size());
 
-    VLOG("\t\t sketch %d: %zu bytes", aggIndex, numBytes);
+    VLOG("\t\t sketch %d: %zu bytes", aggIndex, sketchBuffer.size());
     protoOutput->end(sketchesToken);
 }
 
+unique_ptr<KllQuantile> KllMetricProducer::copyPastBucketAggregate(
+        const unique_ptr<KllQuantile>& kll) {
+    // Copies the sketch without serializing it. The copy is only written to the report, so it
+    // never adds values and never draws from mRandom.
+    return kll->Clone(&mRandom);
+}
+
 optional<int64_t> getInt64ValueFromEvent(const LogEvent& event, const Matcher& matcher) {
     for (const FieldValue& value : event.getValues()) {
         if (value.mField.matches(matcher)) {
@@ -129,7 +136,9 @@ bool KllMetricProducer::aggregateFields(const int64_t eventTimeNs,
         // 2. Ownership of the unique_ptr<KllQuantile> at interval.aggregate being transferred to
         // PastBucket after flushing.
         if (!interval.aggregate) {
-            interval.aggregate = KllQuantile::Create();
+            KllQuantileOptions options;
+            options.set_random(&mRandom);
+            interval.aggregate = KllQuantile::Create(options);
         }
         seenNewData = true;
         interval.aggregate->Add(valueOpt.value());
@@ -31,6 +31,8 @@
 #include "stats_log_util.h"
 
 using dist_proc::aggregation::KllQuantile;
+using dist_proc::aggregation::KllQuantileOptions;
+using dist_proc::aggregation::SplitMixRandomGenerator;
 
 namespace android {
 namespace os {
@@ -102,6 +104,9 @@ private:
                                          const int sampleSize,
                                          ProtoOutputStream* const protoOutput) const override;
 
+    std::unique_ptr<KllQuantile> copyPastBucketAggregate(
+            const std::unique_ptr<KllQuantile>& kll) override;
+
     bool aggregateFields(const int64_t eventTimeNs, const MetricDimensionKey& eventKey,
                          const LogEvent& event, std::vector<Interval>& intervals,
                          Empty& empty) override;
@@ -109,10 +114,15 @@ private:
     // Internal function to calculate the current used bytes.
     size_t byteSizeLocked() const override;
 
+    // Shared by the sketches of all dimensions, which would otherwise own a Mersenne Twister of
+    // about 5 KB each.
+    SplitMixRandomGenerator mRandom;
+
     FRIEND_TEST(KllMetricProducerTest, TestByteSize);
     FRIEND_TEST(KllMetricProducerTest, TestPushedEventsWithoutCondition);
     FRIEND_TEST(KllMetricProducerTest, TestPushedEventsWithCondition);
     FRIEND_TEST(KllMetricProducerTest, TestForcedBucketSplitWhenConditionUnknownSkipsBucket);
+    FRIEND_TEST(KllMetricProducerTest, TestPrepareDumpReportCopiesPastBuckets);
 
     FRIEND_TEST(KllMetricProducerTest_BucketDrop, TestInvalidBucketWhenConditionUnknown);
     FRIEND_TEST(KllMetricProducerTest_BucketDrop, TestBucketDropWhenBucketTooSmall);
@@ -118,7 +118,7 @@ void MetricProducer::onMatchedLogEventLocked(const size_t matcherIndex, const Lo
     if (!mIsActive) {
         return;
     }
-    int64_t eventTimeNs = event.GetElapsedTimestampNs();
+    int64_t eventTimeNs = getEventTimeNsLocked(event);
     // this is old event, maybe statsd restarted?
     if (eventTimeNs < mTimeBaseNs) {
         return;
@@ -185,6 +185,32 @@ void MetricProducer::onMatchedLogEventLocked(const size_t matcherIndex, const Lo
                                     statePrimaryKeys);
 }
 
+void MetricProducer::onMatchedPulledEventLocked(const size_t matcherIndex, const LogEvent& event,
+                                                int64_t eventTimeNs) {
+    // Gauge metrics pull from within onMatchedLogEventLocked when a trigger atom arrives.
+    const optional<int64_t> outerEventTimeNs = mPulledEventTimeNs;
+    mPulledEventTimeNs = eventTimeNs;
+    onMatchedLogEventLocked(matcherIndex, event);
+    mPulledEventTimeNs = outerEventTimeNs;
+}
+
+void MetricProducer::onMatchedHeaderOnlyLogEventLocked(const size_t matcherIndex,
+                                                       const LogEvent& event) {
+    if (!mIsActive) {
+        return;
+    }
+    // this is old event, maybe statsd restarted?
+    if (event.GetElapsedTimestampNs() < mTimeBaseNs) {
+        return;
+    }
+
+    // Header countable metrics have no dimensions, no sliced state and no sliced condition.
+    static const MetricDimensionKey kUnslicedKey(DEFAULT_DIMENSION_KEY, DEFAULT_DIMENSION_KEY);
+    onMatchedLogEventInternalLocked(matcherIndex, kUnslicedKey, /*conditionKey=*/{},
+                                    mCondition == ConditionState::kTrue, event,
+                                    /*statePrimaryKeys=*/{});
+}
+
 bool MetricProducer::evaluateActiveStateLocked(int64_t elapsedTimestampNs) {
     bool isActive = mEventActivationMap.empty();
     for (auto& it : mEventActivationMap) {
@@ -20,10 +20,12 @@
 #include <src/active_config_list.pb.h>
 #include <utils/RefBase.h>
 
+#include <functional>
 #include <unordered_map>
 
 #include "HashableDimensionKey.h"
 #include "anomaly/AnomalyTracker.h"
+#include "anomaly/StatisticalAnomalyTracker.h"
 #include "condition/ConditionTimer.h"
 #include "condition/ConditionWizard.h"
 #include "config/ConfigKey.h"
@@ -144,6 +146,12 @@ struct SamplingInfo {
     int shardCount = 0;
 };
 
+// Writes the data that MetricProducer::prepareDumpReport() took out of a producer to a
+// StatsLogReport. It only reads its own copy of the data and of the metric settings, so it does not
+// need the producer's lock.
+using DumpReportWriter = std::function<void(std::set<string>* str_set,
+                                            android::util::ProtoOutputStream* protoOutput)>;
+
 template <class T>
 optional<bool> getAppUpgradeBucketSplit(const T& metric) {
     return metric.has_split_bucket_for_app_upgrade()
@@ -233,6 +241,20 @@ public:
         onMatchedLogEventLocked(matcherIndex, event);
     }
 
+    // Consume an event that matched the "what" of a header countable metric. Only the header of
+    // the event may have been parsed.
+    void onMatchedHeaderOnlyLogEvent(const size_t matcherIndex, const LogEvent& event) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        onMatchedHeaderOnlyLogEventLocked(matcherIndex, event);
+    }
+
+    // Whether the metric reads nothing but the atom id and timestamp of the matched events, so
+    // that they can be passed to onMatchedHeaderOnlyLogEvent().
+    bool isHeaderCountable() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return isHeaderCountableLocked();
+    }
+
     void onConditionChanged(const bool condition, const int64_t eventTime) {
         std::lock_guard<std::mutex> lock(mMutex);
         onConditionChangedLocked(condition, eventTime);
@@ -248,6 +270,11 @@ public:
         return mConditionSliced;
     };
 
+    sp<ConditionWizard> getConditionWizard() const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return mWizard;
+    }
+
     void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
                         const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                         const FieldValue& newState){};
@@ -265,6 +292,17 @@ public:
                 dumpLatency, str_set, protoOutput);
     }
 
+    // Same as onDumpReport, in two steps. The returned writer outputs the data to the report, and
+    // can be called after the caller released its locks. When erase_data is false, the writer
+    // gets a copy of the data instead.
+    DumpReportWriter prepareDumpReport(const int64_t dumpTimeNs,
+                                       const bool include_current_partial_bucket,
+                                       const bool erase_data, const DumpLatency dumpLatency) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return prepareDumpReportLocked(dumpTimeNs, include_current_partial_bucket, erase_data,
+                                       dumpLatency);
+    }
+
     virtual optional<InvalidConfigReason> onConfigUpdatedLocked(
             const StatsdConfig& config, const int configIndex, const int metricIndex,
             const std::vector<sp<AtomMatchingTracker>>& allAtomMatchingTrackers,
@@ -388,7 +426,9 @@ public:
                                                  const UpdateStatus& updateStatus,
                                                  const int64_t updateTimeNs) {
         std::lock_guard<std::mutex> lock(mMutex);
-        sp<AnomalyTracker> anomalyTracker = new AnomalyTracker(alert, mConfigKey);
+        sp<AnomalyTracker> anomalyTracker =
+                alert.has_detector() ? new StatisticalAnomalyTracker(alert, mConfigKey)
+                                     : new AnomalyTracker(alert, mConfigKey);
         mAnomalyTrackers.push_back(anomalyTracker);
         return anomalyTracker;
     }
@@ -458,15 +498,37 @@ protected:
 
     // Consume the parsed stats log entry that already matched the "what" of the metric.
     virtual void onMatchedLogEventLocked(const size_t matcherIndex, const LogEvent& event);
+    void onMatchedHeaderOnlyLogEventLocked(const size_t matcherIndex, const LogEvent& event);
+
+    // Same as onMatchedLogEventLocked, but the event is handled as if its elapsed timestamp were
+    // eventTimeNs. Pulled events are shared by all receivers of a pull and must not be modified, so
+    // a receiver that needs another timestamp passes it along instead of copying the event.
+    void onMatchedPulledEventLocked(const size_t matcherIndex, const LogEvent& event,
+                                    int64_t eventTimeNs);
+
+    // Returns the elapsed timestamp of the matched event being processed.
+    int64_t getEventTimeNsLocked(const LogEvent& event) const {
+        return mPulledEventTimeNs.value_or(event.GetElapsedTimestampNs());
+    }
+    virtual bool isHeaderCountableLocked() const {
+        return false;
+    }
     virtual void onConditionChangedLocked(const bool condition, const int64_t eventTime) = 0;
     virtual void onSlicedConditionMayChangeLocked(bool overallCondition,
                                                   const int64_t eventTime) = 0;
-    virtual void onDumpReportLocked(const int64_t dumpTimeNs,
-                                    const bool include_current_partial_bucket,
-                                    const bool erase_data,
-                                    const DumpLatency dumpLatency,
-                                    std::set<string> *str_set,
-                                    android::util::ProtoOutputStream* protoOutput) = 0;
+    void onDumpReportLocked(const int64_t dumpTimeNs, const bool include_current_partial_bucket,
+                            const bool erase_data, const DumpLatency dumpLatency,
+                            std::set<string>* str_set,
+                            android::util::ProtoOutputStream* protoOutput) {
+        prepareDumpReportLocked(dumpTimeNs, include_current_partial_bucket, erase_data,
+                                dumpLatency)(str_set, protoOutput);
+    }
+    // Flushes the buckets to report and moves them out of the producer, along with the settings
+    // needed to write them.
+    virtual DumpReportWriter prepareDumpReportLocked(const int64_t dumpTimeNs,
+                                                     const bool include_current_partial_bucket,
+                                                     const bool erase_data,
+                                                     const DumpLatency dumpLatency) = 0;
     virtual void clearPastBucketsLocked(const int64_t dumpTimeNs) = 0;
     virtual void prepareFirstBucketLocked(){};
     virtual size_t byteSizeLocked() const = 0;
@@ -495,7 +557,12 @@ protected:
     }
 
     int64_t getBucketNumFromEndTimeNs(const int64_t endNs) {
-        return (endNs - mTimeBaseNs) / mBucketSizeNs - 1;
+        return getBucketNumFromEndTimeNs(mTimeBaseNs, mBucketSizeNs, endNs);
+    }
+
+    static int64_t getBucketNumFromEndTimeNs(const int64_t timeBaseNs, const int64_t bucketSizeNs,
+                                             const int64_t endNs) {
+        return (endNs - timeBaseNs) / bucketSizeNs - 1;
     }
 
     // Query StateManager for original state value using the queryKey.
@@ -608,6 +675,9 @@ protected:
 
     int mShardCount;
 
+    // Timestamp of the pulled event being processed by onMatchedPulledEventLocked().
+    optional<int64_t> mPulledEventTimeNs;
+
     FRIEND_TEST(CountMetricE2eTest, TestSlicedState);
     FRIEND_TEST(CountMetricE2eTest, TestSlicedStateWithMap);
     FRIEND_TEST(CountMetricE2eTest, TestMultipleSlicedStates);
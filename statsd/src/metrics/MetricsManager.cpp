@@ -103,6 +103,9 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
     mHashStringsInReport = config.hash_strings_in_metric_report();
     mVersionStringsInReport = config.version_strings_in_metric_report();
     mInstallerInReport = config.installer_in_metric_report();
+    initAtomMatchingPrograms();
+    initHeaderCountableTagIds();
+    initConditionWizard();
 
     createAllLogSourcesFromConfig(config);
     mPullerManager->RegisterPullUidProvider(mConfigKey, this);
@@ -179,6 +182,9 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
     mAllAnomalyTrackers = newAnomalyTrackers;
     mAlertTrackerMap = newAlertTrackerMap;
     mAllPeriodicAlarmTrackers = newPeriodicAlarmTrackers;
+    initAtomMatchingPrograms();
+    initHeaderCountableTagIds();
+    initConditionWizard();
 
     mTtlNs = config.has_ttl_in_seconds() ? config.ttl_in_seconds() * NS_PER_SEC : -1;
     refreshTtl(currentTimeNs);
@@ -210,6 +216,60 @@ bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t time
     return !mInvalidConfigReason.has_value();
 }
 
+void MetricsManager::initConditionWizard() {
+    // All metric producers of a config share the same wizard.
+    mConditionWizard = mAllMetricProducers.empty() ? nullptr
+                                                   : mAllMetricProducers[0]->getConditionWizard();
+}
+
+void MetricsManager::initAtomMatchingPrograms() {
+    mTagIdsToMatchingPrograms.clear();
+    if (mInvalidConfigReason.has_value()) {
+        return;
+    }
+    for (const auto& [tagId, matcherIndices] : mTagIdsToMatchersMap) {
+        mTagIdsToMatchingPrograms.emplace(
+                tagId, AtomMatchingProgram(matcherIndices, mAllAtomMatchingTrackers));
+    }
+}
+
+void MetricsManager::initHeaderCountableTagIds() {
+    mHeaderCountableTagIds.clear();
+    if (mInvalidConfigReason.has_value()) {
+        return;
+    }
+    for (const auto& [tagId, matcherIndices] : mTagIdsToMatchersMap) {
+        bool headerCountable = true;
+        for (const int matcherIndex : matcherIndices) {
+            if (!mAllAtomMatchingTrackers[matcherIndex]->matchesAnyEventOfAtomIds() ||
+                mTrackerToConditionMap.find(matcherIndex) != mTrackerToConditionMap.end() ||
+                mActivationAtomTrackerToMetricMap.find(matcherIndex) !=
+                        mActivationAtomTrackerToMetricMap.end() ||
+                mDeactivationAtomTrackerToMetricMap.find(matcherIndex) !=
+                        mDeactivationAtomTrackerToMetricMap.end()) {
+                headerCountable = false;
+                break;
+            }
+            const auto metricsIt = mTrackerToMetricMap.find(matcherIndex);
+            if (metricsIt == mTrackerToMetricMap.end()) {
+                continue;
+            }
+            for (const int metricIndex : metricsIt->second) {
+                if (!mAllMetricProducers[metricIndex]->isHeaderCountable()) {
+                    headerCountable = false;
+                    break;
+                }
+            }
+            if (!headerCountable) {
+                break;
+            }
+        }
+        if (headerCountable) {
+            mHeaderCountableTagIds.insert(tagId);
+        }
+    }
+}
+
 void MetricsManager::createAllLogSourcesFromConfig(const StatsdConfig& config) {
     // Init allowed pushed atom uids.
     if (config.allowed_log_source_size() == 0) {
@@ -438,41 +498,27 @@ void MetricsManager::dropData(const int64_t dropTimeNs) {
     }
 }
 
-void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs, const int64_t wallClockNs,
-                                  const bool include_current_partial_bucket, const bool erase_data,
-                                  const DumpLatency dumpLatency, std::set<string>* str_set,
-                                  ProtoOutputStream* protoOutput) {
+DumpReportWriter MetricsManager::prepareDumpReport(const int64_t dumpTimeStampNs,
+                                                   const int64_t wallClockNs,
+                                                   const bool include_current_partial_bucket,
+                                                   const bool erase_data,
+                                                   const DumpLatency dumpLatency) {
     if (hasRestrictedMetricsDelegate()) {
         // TODO(b/268150038): report error to statsdstats
-        VLOG("Unexpected call to onDumpReport in restricted metricsmanager.");
-        return;
+        VLOG("Unexpected call to prepareDumpReport in restricted metricsmanager.");
+        return [](std::set<string>* str_set, ProtoOutputStream* protoOutput) {};
     }
-    VLOG("=========================Metric Reports Start==========================");
     // one StatsLogReport per MetricProduer
+    vector<DumpReportWriter> producerWriters;
+    producerWriters.reserve(mAllMetricProducers.size());
     for (const auto& producer : mAllMetricProducers) {
         if (mNoReportMetricIds.find(producer->getMetricId()) == mNoReportMetricIds.end()) {
-            uint64_t token = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
-            if (mHashStringsInReport) {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, str_set, protoOutput);
-            } else {
-                producer->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                                       dumpLatency, nullptr, protoOutput);
-            }
-            protoOutput->end(token);
+            producerWriters.push_back(producer->prepareDumpReport(
+                    dumpTimeStampNs, include_current_partial_bucket, erase_data, dumpLatency));
         } else {
             producer->clearPastBuckets(dumpTimeStampNs);
         }
     }
-    for (const auto& annotation : mAnnotations) {
-        uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                            FIELD_ID_ANNOTATIONS);
-        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ANNOTATIONS_INT64,
-                           (long long)annotation.first);
-        protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_ANNOTATIONS_INT32, annotation.second);
-        protoOutput->end(token);
-    }
 
     // Do not update the timestamps when data is not cleared to avoid timestamps from being
     // misaligned.
@@ -480,7 +526,27 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs, const int64_t w
         mLastReportTimeNs = dumpTimeStampNs;
         mLastReportWallClockNs = wallClockNs;
     }
-    VLOG("=========================Metric Reports End==========================");
+
+    return [producerWriters = std::move(producerWriters), annotations = mAnnotations,
+            hashStringsInReport = mHashStringsInReport](std::set<string>* str_set,
+                                                        ProtoOutputStream* protoOutput) {
+        VLOG("=========================Metric Reports Start==========================");
+        for (const DumpReportWriter& producerWriter : producerWriters) {
+            uint64_t token = protoOutput->start(
+                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
+            producerWriter(hashStringsInReport ? str_set : nullptr, protoOutput);
+            protoOutput->end(token);
+        }
+        for (const auto& annotation : annotations) {
+            uint64_t token = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                                FIELD_ID_ANNOTATIONS);
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ANNOTATIONS_INT64,
+                               (long long)annotation.first);
+            protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_ANNOTATIONS_INT32, annotation.second);
+            protoOutput->end(token);
+        }
+        VLOG("=========================Metric Reports End==========================");
+    };
 }
 
 bool MetricsManager::checkLogCredentials(const LogEvent& event) {
@@ -600,6 +666,23 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
         return;
     }
 
+    if (mHeaderCountableTagIds.find(tagId) != mHeaderCountableTagIds.end()) {
+        // No matcher of this tag reads fields, and none of them drives a condition or an
+        // activation, so every matcher matches and the metrics only need to count the event.
+        for (const int matcherIndex : matchersIt->second) {
+            StatsdStats::getInstance().noteMatcherMatched(
+                    mConfigKey, mAllAtomMatchingTrackers[matcherIndex]->getId());
+            const auto metricsIt = mTrackerToMetricMap.find(matcherIndex);
+            if (metricsIt == mTrackerToMetricMap.end()) {
+                continue;
+            }
+            for (const int metricIndex : metricsIt->second) {
+                mAllMetricProducers[metricIndex]->onMatchedHeaderOnlyLogEvent(matcherIndex, event);
+            }
+        }
+        return;
+    }
+
     if (event.isParsedHeaderOnly()) {
         // This should not happen if metric config is defined for certain atom id
         const int64_t firstMatcherId =
@@ -612,9 +695,14 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
     vector<MatchingState> matcherCache(mAllAtomMatchingTrackers.size(),
                                        MatchingState::kNotComputed);
 
-    for (const auto& matcherIndex : matchersIt->second) {
-        mAllAtomMatchingTrackers[matcherIndex]->onLogEvent(event, mAllAtomMatchingTrackers,
-                                                           matcherCache);
+    const auto programIt = mTagIdsToMatchingPrograms.find(tagId);
+    if (programIt != mTagIdsToMatchingPrograms.end()) {
+        programIt->second.onLogEvent(event, mAllAtomMatchingTrackers, matcherCache);
+    } else {
+        for (const auto& matcherIndex : matchersIt->second) {
+            mAllAtomMatchingTrackers[matcherIndex]->onLogEvent(event, mAllAtomMatchingTrackers,
+                                                               matcherCache);
+        }
     }
 
     // Set of metrics that received an activation cancellation.
@@ -679,6 +767,12 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
                                      changedCache);
     }
 
+    // Conditions do not change for the rest of this event, so the metrics can share the results
+    // of their sliced condition queries.
+    if (mConditionWizard != nullptr) {
+        mConditionWizard->beginQueryCache();
+    }
+
     for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
         if (changedCache[i] == false) {
             continue;
@@ -717,6 +811,13 @@ void MetricsManager::onLogEvent(const LogEvent& event) {
             }
         }
     }
+
+    if (mConditionWizard != nullptr) {
+        const auto [hits, misses] = mConditionWizard->endQueryCache();
+        if (hits + misses > 0) {
+            StatsdStats::getInstance().noteConditionQueryCache(mConfigKey, hits, misses);
+        }
+    }
 }
 
 void MetricsManager::onAnomalyAlarmFired(
@@ -885,6 +986,14 @@ void MetricsManager::addAllAtomIds(LogEventFilter::AtomIdSet& allIds) const {
     }
 }
 
+void MetricsManager::addBodyAtomIds(LogEventFilter::AtomIdSet& bodyIds) const {
+    for (const auto& [atomId, _] : mTagIdsToMatchersMap) {
+        if (mHeaderCountableTagIds.find(atomId) == mHeaderCountableTagIds.end()) {
+            bodyIds.insert(atomId);
+        }
+    }
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
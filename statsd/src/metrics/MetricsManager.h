@@ -26,6 +26,7 @@
 #include "external/StatsPullerManager.h"
 #include "guardrail/StatsdStats.h"
 #include "logd/LogEvent.h"
+#include "matchers/AtomMatchingProgram.h"
 #include "matchers/AtomMatchingTracker.h"
 #include "metrics/MetricProducer.h"
 #include "packages/UidMap.h"
@@ -133,10 +134,12 @@ public:
 
     virtual void dropData(const int64_t dropTimeNs);
 
-    virtual void onDumpReport(const int64_t dumpTimeNs, const int64_t wallClockNs,
-                              const bool include_current_partial_bucket, const bool erase_data,
-                              const DumpLatency dumpLatency, std::set<string>* str_set,
-                              android::util::ProtoOutputStream* protoOutput);
+    // Flushes the metrics and takes their data out, to be called under the caller's lock. The
+    // returned writer outputs the StatsLogReports after the lock is released.
+    virtual DumpReportWriter prepareDumpReport(const int64_t dumpTimeNs, const int64_t wallClockNs,
+                                               const bool include_current_partial_bucket,
+                                               const bool erase_data,
+                                               const DumpLatency dumpLatency);
 
     // Computes the total byte size of all metrics managed by a single config source.
     // Does not change the state.
@@ -186,6 +189,10 @@ public:
     // Adds all atom ids referenced by matchers in the MetricsManager's config
     void addAllAtomIds(LogEventFilter::AtomIdSet& allIds) const;
 
+    // Adds the atom ids referenced by matchers in the MetricsManager's config whose fields are
+    // read, i.e. all atom ids except the header countable ones.
+    void addBodyAtomIds(LogEventFilter::AtomIdSet& bodyIds) const;
+
 private:
     // For test only.
     inline int64_t getTtlEndNs() const { return mTtlEndNs; }
@@ -245,6 +252,17 @@ private:
     // All event tags that are interesting to config metrics matchers.
     std::unordered_map<int, std::vector<int>> mTagIdsToMatchersMap;
 
+    // The matchers of mTagIdsToMatchersMap compiled into one program per event tag.
+    std::unordered_map<int, AtomMatchingProgram> mTagIdsToMatchingPrograms;
+
+    // Event tags that are only matched by matchers without field value matchers, which only
+    // feed header countable metrics and no condition or activation. Their events are counted
+    // without running matchers or conditions, and do not need their fields parsed.
+    std::unordered_set<int> mHeaderCountableTagIds;
+
+    // The ConditionWizard shared by all metrics of this config, or nullptr if there are none.
+    sp<ConditionWizard> mConditionWizard;
+
     // We only store the sp of AtomMatchingTracker, MetricProducer, and ConditionTracker in
     // MetricsManager. There are relationships between them, and the relationships are denoted by
     // index instead of pointers. The reasons for this are: (1) the relationship between them are
@@ -330,6 +348,19 @@ private:
     // Should be called on config creation/update.
     void initializeConfigActiveStatus();
 
+    // Sets mConditionWizard from the metric producers.
+    // Should be called on config creation/update.
+    void initConditionWizard();
+
+    // Rebuilds mTagIdsToMatchingPrograms from mTagIdsToMatchersMap. Invalid configs get no
+    // programs and fall back to the recursive AtomMatchingTracker evaluation.
+    // Should be called on config creation/update.
+    void initAtomMatchingPrograms();
+
+    // Rebuilds mHeaderCountableTagIds from the matchers and metrics of the config.
+    // Should be called on config creation/update.
+    void initHeaderCountableTagIds();
+
     // The metrics that don't need to be uploaded or even reported.
     std::set<int64_t> mNoReportMetricIds;
 
@@ -382,6 +413,7 @@ private:
     FRIEND_TEST(MetricsManagerTest, TestLogSources);
     FRIEND_TEST(MetricsManagerTest, TestLogSourcesOnConfigUpdate);
     FRIEND_TEST(MetricsManagerTest, TestOnMetricRemoveCalled);
+    FRIEND_TEST(MetricsManagerTest, TestHeaderCountableTagIds);
     FRIEND_TEST(MetricsManagerTest_SPlus, TestRestrictedMetricsConfig);
     FRIEND_TEST(MetricsManagerTest_SPlus, TestRestrictedMetricsConfigUpdate);
     FRIEND_TEST(MetricsManagerUtilTest, TestSampledMetrics);
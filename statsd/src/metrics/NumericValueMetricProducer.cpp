@@ -58,9 +58,6 @@ const int FIELD_ID_END_BUCKET_ELAPSED_MILLIS = 6;
 const int FIELD_ID_CONDITION_TRUE_NS = 10;
 const int FIELD_ID_CONDITION_CORRECTION_NS = 11;
 
-const Value ZERO_LONG((int64_t)0);
-const Value ZERO_DOUBLE(0.0);
-
 // ValueMetric has a minimum bucket size of 10min so that we don't pull too frequently
 NumericValueMetricProducer::NumericValueMetricProducer(
         const ConfigKey& key, const ValueMetric& metric, const uint64_t protoHash,
@@ -81,7 +78,9 @@ NumericValueMetricProducer::NumericValueMetricProducer(
       mUseZeroDefaultBase(metric.use_zero_default_base()),
       mHasGlobalBase(false),
       mMaxPullDelayNs(metric.has_max_pull_delay_sec() ? metric.max_pull_delay_sec() * NS_PER_SEC
-                                                      : StatsdStats::kPullMaxDelayNs) {
+                                                      : StatsdStats::kPullMaxDelayNs),
+      mPulledRowAggregator(mDimensionsInWhat, mFieldMatchers,
+                           {mValueDirection, mUseAbsoluteValueOnReset, mUseZeroDefaultBase}) {
     // TODO(b/186677791): Use initializer list to initialize mUploadThreshold.
     if (metric.has_threshold()) {
         mUploadThreshold = metric.threshold();
@@ -112,6 +111,7 @@ void NumericValueMetricProducer::resetBase() {
             base.reset();
         }
     }
+    mPulledRowAggregator.resetBases();
     mHasGlobalBase = false;
 }
 
@@ -219,23 +219,6 @@ void NumericValueMetricProducer::onDataPulled(const std::vector<std::shared_ptr<
     flushIfNeededLocked(originalPullTimeNs);
 }
 
-void NumericValueMetricProducer::combineValueFields(pair<LogEvent, vector<int>>& eventValues,
-                                                    const LogEvent& newEvent,
-                                                    const vector<int>& newValueIndices) const {
-    if (eventValues.second.size() != newValueIndices.size()) {
-        ALOGE("NumericValueMetricProducer value indices sizes don't match");
-        return;
-    }
-    vector<FieldValue>* const aggregateFieldValues = eventValues.first.getMutableValues();
-    const vector<FieldValue>& newFieldValues = newEvent.getValues();
-    for (size_t i = 0; i < eventValues.second.size(); ++i) {
-        if (newValueIndices[i] != -1 && eventValues.second[i] != -1) {
-            (*aggregateFieldValues)[eventValues.second[i]].mValue +=
-                    newFieldValues[newValueIndices[i]].mValue;
-        }
-    }
-}
-
 // Process events retrieved from a pull.
 void NumericValueMetricProducer::accumulateEvents(const vector<shared_ptr<LogEvent>>& allData,
                                                   int64_t originalPullTimeNs,
@@ -263,45 +246,28 @@ void NumericValueMetricProducer::accumulateEvents(const vector<shared_ptr<LogEve
 
     mMatchedMetricDimensionKeys.clear();
     if (mUseDiff) {
-        // An extra aggregation step is needed to sum values with matching dimensions
-        // before calculating the diff between sums of consecutive pulls.
-        std::unordered_map<HashableDimensionKey, pair<LogEvent, vector<int>>> aggregateEvents;
+        // Values with matching dimensions are summed, then diffed against the base of the
+        // dimension, which the aggregator keeps from one pull to the next.
+        mPulledRowAggregator.reset(allData.size());
         for (const auto& data : allData) {
             if (mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex) !=
                 MatchingState::kMatched) {
                 continue;
             }
-
-            // Get dimensions_in_what key and value indices.
-            HashableDimensionKey dimensionsInWhat;
-            vector<int> valueIndices(mFieldMatchers.size(), -1);
-            if (!filterValues(mDimensionsInWhat, mFieldMatchers, data->getValues(),
-                              dimensionsInWhat, valueIndices)) {
+            if (!mPulledRowAggregator.addRow(*data)) {
                 StatsdStats::getInstance().noteBadValueType(mMetricId);
             }
-
-            // Store new event in map or combine values in existing event.
-            auto it = aggregateEvents.find(dimensionsInWhat);
-            if (it == aggregateEvents.end()) {
-                aggregateEvents.emplace(std::piecewise_construct,
-                                        std::forward_as_tuple(dimensionsInWhat),
-                                        std::forward_as_tuple(*data, valueIndices));
-            } else {
-                combineValueFields(it->second, *data, valueIndices);
-            }
         }
 
-        for (auto& [dimKey, eventInfo] : aggregateEvents) {
-            eventInfo.first.setElapsedTimestampNs(eventElapsedTimeNs);
-            onMatchedLogEventLocked(mWhatMatcherIndex, eventInfo.first);
-        }
+        mPulledRowAggregator.forEachMergedRow(
+                mHasGlobalBase, [this, eventElapsedTimeNs](const LogEvent& row) {
+                    onMatchedPulledEventLocked(mWhatMatcherIndex, row, eventElapsedTimeNs);
+                });
     } else {
         for (const auto& data : allData) {
-            LogEvent localCopy = *data;
-            if (mEventMatcherWizard->matchLogEvent(localCopy, mWhatMatcherIndex) ==
+            if (mEventMatcherWizard->matchLogEvent(*data, mWhatMatcherIndex) ==
                 MatchingState::kMatched) {
-                localCopy.setElapsedTimestampNs(eventElapsedTimeNs);
-                onMatchedLogEventLocked(mWhatMatcherIndex, localCopy);
+                onMatchedPulledEventLocked(mWhatMatcherIndex, *data, eventElapsedTimeNs);
             }
         }
     }
@@ -322,6 +288,7 @@ void NumericValueMetricProducer::accumulateEvents(const vector<shared_ptr<LogEve
             if (it != mDimInfos.end()) {
                 mDimInfos.erase(it);
             }
+            mPulledRowAggregator.eraseDimension(whatKey);
             // Turn OFF condition timer for keys not present in pulled data.
             currentValueBucket.conditionTimer.onConditionChanged(false, eventElapsedTimeNs);
         }
@@ -404,75 +371,61 @@ bool NumericValueMetricProducer::aggregateFields(const int64_t eventTimeNs,
     // previous behaviour was correct. At the time of the fix, anomaly detection had no owner.
     // Whoever next works on it should look into the cases where it is triggered in this function.
     // Discussion here: http://ag/6124370.
+    // Merged pulled rows were already diffed against their bases by mPulledRowAggregator, which
+    // keeps these bases instead of mDimInfos.
+    const bool merged = mPulledRowAggregator.isMerging();
     bool useAnomalyDetection = true;
     bool seenNewData = false;
     for (size_t i = 0; i < mFieldMatchers.size(); i++) {
         const Matcher& matcher = mFieldMatchers[i];
         Interval& interval = intervals[i];
         interval.aggIndex = i;
-        optional<Value>& base = bases[i];
         Value value;
-        if (!getDoubleOrLong(event, matcher, value)) {
-            VLOG("Failed to get value %zu from event %s", i, event.ToString().c_str());
-            StatsdStats::getInstance().noteBadValueType(mMetricId);
-            return seenNewData;
-        }
-        seenNewData = true;
-        if (mUseDiff) {
-            if (!base.has_value()) {
-                if (mHasGlobalBase && mUseZeroDefaultBase) {
-                    // The bucket has global base. This key does not.
-                    // Optionally use zero as base.
-                    base = (value.type == LONG ? ZERO_LONG : ZERO_DOUBLE);
-                } else {
-                    // no base. just update base and return.
-                    base = value;
-
-                    // If we're missing a base, do not use anomaly detection on incomplete data
-                    useAnomalyDetection = false;
-
-                    // Continue (instead of return) here in order to set base value for other bases
-                    continue;
-                }
+        DiffResult diffResult = DIFF_OK;
+        if (merged) {
+            const PulledRowAggregator::MergedValue& mergedValue =
+                    mPulledRowAggregator.getMergedValue(i);
+            if (!mergedValue.hasValue) {
+                VLOG("Failed to get value %zu from event %s", i, event.ToString().c_str());
+                StatsdStats::getInstance().noteBadValueType(mMetricId);
+                return seenNewData;
             }
-            Value diff;
-            switch (mValueDirection) {
-                case ValueMetric::INCREASING:
-                    if (value >= base.value()) {
-                        diff = value - base.value();
-                    } else if (mUseAbsoluteValueOnReset) {
-                        diff = value;
-                    } else {
-                        VLOG("Unexpected decreasing value");
-                        StatsdStats::getInstance().notePullDataError(mPullAtomId);
-                        base = value;
-                        // If we've got bad data, do not use anomaly detection
-                        useAnomalyDetection = false;
-                        continue;
-                    }
-                    break;
-                case ValueMetric::DECREASING:
-                    if (base.value() >= value) {
-                        diff = base.value() - value;
-                    } else if (mUseAbsoluteValueOnReset) {
-                        diff = value;
-                    } else {
-                        VLOG("Unexpected increasing value");
-                        StatsdStats::getInstance().notePullDataError(mPullAtomId);
-                        base = value;
-                        // If we've got bad data, do not use anomaly detection
-                        useAnomalyDetection = false;
-                        continue;
-                    }
-                    break;
-                case ValueMetric::ANY:
-                    diff = value - base.value();
-                    break;
-                default:
-                    break;
+            mPulledRowAggregator.acceptValue(i);
+            value = mergedValue.value;
+            diffResult = mergedValue.diffResult;
+            if (diffResult == DIFF_OK) {
+                value = mergedValue.diff;
+            }
+        } else {
+            if (!getDoubleOrLong(event, matcher, value)) {
+                VLOG("Failed to get value %zu from event %s", i, event.ToString().c_str());
+                StatsdStats::getInstance().noteBadValueType(mMetricId);
+                return seenNewData;
+            }
+            if (mUseDiff) {
+                optional<Value>& base = bases[i];
+                Value diff;
+                diffResult = diffAgainstBase(mPulledRowAggregator.getDiffOptions(),
+                                             mHasGlobalBase, value, base, &diff);
+                base = value;
+                if (diffResult == DIFF_OK) {
+                    value = diff;
+                }
             }
-            base = value;
-            value = diff;
+        }
+        seenNewData = true;
+        if (diffResult == DIFF_NO_BASE) {
+            // If we're missing a base, do not use anomaly detection on incomplete data.
+            // Continue (instead of return) here in order to set base value for other bases.
+            useAnomalyDetection = false;
+            continue;
+        }
+        if (diffResult == DIFF_RESET) {
+            VLOG("Unexpected value against the value direction");
+            StatsdStats::getInstance().notePullDataError(mPullAtomId);
+            // If we've got bad data, do not use anomaly detection
+            useAnomalyDetection = false;
+            continue;
         }
 
         if (interval.hasValue()) {
@@ -554,6 +507,13 @@ void NumericValueMetricProducer::closeCurrentBucket(const int64_t eventTimeNs,
 void NumericValueMetricProducer::initNextSlicedBucket(int64_t nextBucketStartTimeNs) {
     ValueMetricProducer::initNextSlicedBucket(nextBucketStartTimeNs);
 
+    // Pulled bases are dropped along with the dimensions that had no new data.
+    if (mUseDiff) {
+        mPulledRowAggregator.retainDimensions([this](const HashableDimensionKey& dimensionsInWhat) {
+            return mDimInfos.find(dimensionsInWhat) != mDimInfos.end();
+        });
+    }
+
     // If we do not have a global base when the condition is true,
     // we will have incomplete bucket for the next bucket.
     if (mUseDiff && !mHasGlobalBase && mCondition) {
@@ -20,6 +20,7 @@
 
 #include <optional>
 
+#include "PulledRowAggregator.h"
 #include "ValueMetricProducer.h"
 
 namespace android {
@@ -139,12 +140,13 @@ private:
                                          const int sampleSize,
                                          ProtoOutputStream* const protoOutput) const override;
 
+    inline Value copyPastBucketAggregate(const Value& value) override {
+        return value;
+    }
+
     // Internal function to calculate the current used bytes.
     size_t byteSizeLocked() const override;
 
-    void combineValueFields(pair<LogEvent, vector<int>>& eventValues, const LogEvent& newEvent,
-                            const vector<int>& newValueIndices) const;
-
     const bool mUseAbsoluteValueOnReset;
 
     const ValueMetric::AggregationType mAggregationType;
@@ -171,6 +173,9 @@ private:
 
     const int64_t mMaxPullDelayNs;
 
+    // Sums the values of pulled rows with the same dimensions when using diff.
+    PulledRowAggregator mPulledRowAggregator;
+
     // For anomaly detection.
     std::unordered_map<MetricDimensionKey, int64_t> mCurrentFullBucket;
 
@@ -207,6 +212,7 @@ private:
     FRIEND_TEST(NumericValueMetricProducerTest, TestPushedAggregateSum);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPushedEventsWithCondition);
     FRIEND_TEST(NumericValueMetricProducerTest, TestPushedEventsWithoutCondition);
+    FRIEND_TEST(NumericValueMetricProducerTest, TestPrepareDumpReportCopiesPastBuckets);
     FRIEND_TEST(NumericValueMetricProducerTest, TestResetBaseOnPullDelayExceeded);
     FRIEND_TEST(NumericValueMetricProducerTest, TestResetBaseOnPullFailAfterConditionChange);
     FRIEND_TEST(NumericValueMetricProducerTest,
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Log.h"
+
+#include "PulledRowAggregator.h"
+
+#include <algorithm>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::function;
+using std::optional;
+using std::vector;
+
+namespace {
+
+const Value ZERO_LONG((int64_t)0);
+const Value ZERO_DOUBLE(0.0);
+const optional<Value> NO_BASE;
+
+// Converts a numeric value to LONG or DOUBLE. Returns false for other types.
+bool toDoubleOrLong(const Value& value, Value* ret) {
+    switch (value.type) {
+        case INT:
+            ret->setLong(value.int_value);
+            return true;
+        case LONG:
+            ret->setLong(value.long_value);
+            return true;
+        case FLOAT:
+            ret->setDouble(value.float_value);
+            return true;
+        case DOUBLE:
+            ret->setDouble(value.double_value);
+            return true;
+        default:
+            return false;
+    }
+}
+
+}  // anonymous namespace
+
+DiffResult diffAgainstBase(const DiffOptions& options, bool hasGlobalBase, const Value& value,
+                           const optional<Value>& base, Value* diff) {
+    if (!base.has_value() && !(hasGlobalBase && options.useZeroDefaultBase)) {
+        return DIFF_NO_BASE;
+    }
+    // The bucket has a global base, this key does not. Zero is used as its base.
+    const Value& baseValue =
+            base.has_value() ? base.value() : (value.type == LONG ? ZERO_LONG : ZERO_DOUBLE);
+    switch (options.valueDirection) {
+        case ValueMetric::INCREASING:
+            if (value >= baseValue) {
+                *diff = value - baseValue;
+            } else if (options.useAbsoluteValueOnReset) {
+                *diff = value;
+            } else {
+                return DIFF_RESET;
+            }
+            break;
+        case ValueMetric::DECREASING:
+            if (baseValue >= value) {
+                *diff = baseValue - value;
+            } else if (options.useAbsoluteValueOnReset) {
+                *diff = value;
+            } else {
+                return DIFF_RESET;
+            }
+            break;
+        case ValueMetric::ANY:
+            *diff = value - baseValue;
+            break;
+        default:
+            *diff = Value();
+            break;
+    }
+    return DIFF_OK;
+}
+
+PulledRowAggregator::PulledRowAggregator(const vector<Matcher>& dimensionsInWhat,
+                                         const vector<Matcher>& valueFields,
+                                         const DiffOptions& options)
+    : mDimensionsInWhat(dimensionsInWhat),
+      mValueFields(valueFields),
+      mOptions(options),
+      mMergedValues(valueFields.size()) {
+}
+
+void PulledRowAggregator::reset(size_t numRows) {
+    clear();
+    // Release the memory sized for a much larger pull.
+    if (mRows.capacity() > 4 * numRows) {
+        mPulledDimensions.shrink_to_fit();
+        mRows.shrink_to_fit();
+        mNext.shrink_to_fit();
+        mValueIndices.shrink_to_fit();
+    }
+    mRows.reserve(numRows);
+    mNext.reserve(numRows);
+    mValueIndices.reserve(numRows * mValueFields.size());
+}
+
+void PulledRowAggregator::clear() {
+    for (Dimension* dimension : mPulledDimensions) {
+        dimension->firstRow = -1;
+        dimension->lastRow = -1;
+    }
+    mPulledDimensions.clear();
+    mRows.clear();
+    mNext.clear();
+    mValueIndices.clear();
+}
+
+bool PulledRowAggregator::addRow(const LogEvent& row) {
+    const int rowIndex = mRows.size();
+    mRows.push_back(&row);
+    mNext.push_back(-1);
+
+    mRowDimensionsInWhat.mutableValues()->clear();
+    mRowValueIndices.assign(mValueFields.size(), -1);
+    const bool valid = filterValues(mDimensionsInWhat, mValueFields, row.getValues(),
+                                    mRowDimensionsInWhat, mRowValueIndices);
+    mValueIndices.insert(mValueIndices.end(), mRowValueIndices.begin(), mRowValueIndices.end());
+
+    // The key is only copied for dimensions that are not in the base table yet.
+    auto it = mDimensions.find(mRowDimensionsInWhat);
+    if (it == mDimensions.end()) {
+        it = mDimensions.emplace(mRowDimensionsInWhat, Dimension()).first;
+    }
+    Dimension& dimension = it->second;
+    if (dimension.firstRow == -1) {
+        dimension.firstRow = rowIndex;
+        mPulledDimensions.push_back(&dimension);
+    } else {
+        mNext[dimension.lastRow] = rowIndex;
+    }
+    dimension.lastRow = rowIndex;
+    return valid;
+}
+
+void PulledRowAggregator::forEachMergedRow(bool hasGlobalBase,
+                                           const function<void(const LogEvent&)>& visit) {
+    const size_t numValues = mValueFields.size();
+    for (Dimension* dimension : mPulledDimensions) {
+        const int first = dimension->firstRow;
+        const int* const firstIndices = mValueIndices.data() + first * numValues;
+        for (size_t i = 0; i < numValues; i++) {
+            MergedValue& merged = mMergedValues[i];
+            merged.hasValue = false;
+            if (firstIndices[i] == -1) {
+                continue;
+            }
+            // Values are summed in their own type, then converted like a single row would be.
+            Value sum = mRows[first]->getValues()[firstIndices[i]].mValue;
+            for (int row = mNext[first]; row != -1; row = mNext[row]) {
+                const int rowIndex = mValueIndices[row * numValues + i];
+                if (rowIndex != -1) {
+                    sum += mRows[row]->getValues()[rowIndex].mValue;
+                }
+            }
+            merged.hasValue = toDoubleOrLong(sum, &merged.value);
+            if (merged.hasValue) {
+                merged.diffResult = diffAgainstBase(
+                        mOptions, hasGlobalBase, merged.value,
+                        i < dimension->bases.size() ? dimension->bases[i] : NO_BASE, &merged.diff);
+            }
+        }
+        mMergingDimension = dimension;
+        visit(*mRows[first]);
+        mMergingDimension = nullptr;
+    }
+    clear();
+}
+
+void PulledRowAggregator::acceptValue(size_t valueIndex) {
+    vector<optional<Value>>& bases = mMergingDimension->bases;
+    if (bases.size() < mValueFields.size()) {
+        bases.resize(mValueFields.size());
+    }
+    bases[valueIndex] = mMergedValues[valueIndex].value;
+}
+
+const optional<Value>& PulledRowAggregator::getBase(const HashableDimensionKey& dimensionsInWhat,
+                                                    size_t valueIndex) const {
+    const auto it = mDimensions.find(dimensionsInWhat);
+    if (it == mDimensions.end() || valueIndex >= it->second.bases.size()) {
+        return NO_BASE;
+    }
+    return it->second.bases[valueIndex];
+}
+
+void PulledRowAggregator::resetBases() {
+    for (auto& [_, dimension] : mDimensions) {
+        for (optional<Value>& base : dimension.bases) {
+            base.reset();
+        }
+    }
+}
+
+void PulledRowAggregator::eraseDimension(const HashableDimensionKey& dimensionsInWhat) {
+    mDimensions.erase(dimensionsInWhat);
+}
+
+void PulledRowAggregator::retainDimensions(
+        const function<bool(const HashableDimensionKey&)>& keep) {
+    for (auto it = mDimensions.begin(); it != mDimensions.end();) {
+        if (keep(it->first)) {
+            it++;
+        } else {
+            it = mDimensions.erase(it);
+        }
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtest/gtest_prod.h>
+
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "FieldValue.h"
+#include "HashableDimensionKey.h"
+#include "logd/LogEvent.h"
+#include "src/statsd_config.pb.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// How a value compares to its base.
+enum DiffResult {
+    // There is no base to diff against.
+    DIFF_NO_BASE,
+    // The value moved against the value direction of the metric, e.g. a counter was reset.
+    DIFF_RESET,
+    DIFF_OK,
+};
+
+struct DiffOptions {
+    ValueMetric::ValueDirection valueDirection;
+    bool useAbsoluteValueOnReset;
+    // A missing base defaults to zero, if hasGlobalBase is passed to diffAgainstBase().
+    bool useZeroDefaultBase;
+};
+
+// Diffs value against base. Sets diff if DIFF_OK is returned. In every case, the new base of the
+// value metric is value.
+DiffResult diffAgainstBase(const DiffOptions& options, bool hasGlobalBase, const Value& value,
+                           const std::optional<Value>& base, Value* diff);
+
+// Diff engine of a pulled value metric that uses diff. Each pull is hashed once by dimensions in
+// what: rows with the same dimensions are merged by summing their value fields, and joined
+// against the base table of the metric, which the engine keeps from one pull to the next. The
+// merged values are diffed against their bases in the same pass.
+//
+// Rows are referenced rather than copied, and duplicates are chained by row index. The buffers
+// keep their capacity from one pull to the next, unless a pull is much smaller than the earlier
+// ones. No references to the pulled rows are kept once the merged rows have been handed out.
+class PulledRowAggregator {
+public:
+    // Sum of one value field over the rows of a dimension, and its diff to the base.
+    struct MergedValue {
+        // False if the first row of the dimension does not have the value field as a number.
+        bool hasValue = false;
+        Value value;
+        DiffResult diffResult = DIFF_NO_BASE;
+        Value diff;
+    };
+
+    PulledRowAggregator(const std::vector<Matcher>& dimensionsInWhat,
+                        const std::vector<Matcher>& valueFields, const DiffOptions& options);
+
+    const DiffOptions& getDiffOptions() const {
+        return mOptions;
+    }
+
+    // Drops the rows of the previous pull and reserves space for numRows rows.
+    void reset(size_t numRows);
+
+    // Adds a row. The row must outlive the next call to forEachMergedRow().
+    // Returns false if a value field is missing or does not have a numeric type. The row is still
+    // added, matching the behavior of filterValues().
+    bool addRow(const LogEvent& row);
+
+    // Calls visit once per distinct dimensions in what, in the order in which each dimension was
+    // first added, with the first row of these dimensions. During the call, getMergedValue()
+    // returns the merged values of the dimension, and acceptValue() makes them its bases. The
+    // bases of values that are not accepted are left unchanged. All rows are dropped afterwards.
+    void forEachMergedRow(bool hasGlobalBase, const std::function<void(const LogEvent&)>& visit);
+
+    bool isMerging() const {
+        return mMergingDimension != nullptr;
+    }
+
+    const MergedValue& getMergedValue(size_t valueIndex) const {
+        return mMergedValues[valueIndex];
+    }
+
+    void acceptValue(size_t valueIndex);
+
+    // Returns the base of a value field of a dimension. The reference stays valid until the
+    // dimension is dropped.
+    const std::optional<Value>& getBase(const HashableDimensionKey& dimensionsInWhat,
+                                        size_t valueIndex) const;
+
+    // The following must not be called between addRow() and the end of forEachMergedRow().
+
+    // Unsets every base. The dimensions are kept.
+    void resetBases();
+
+    // Drops the base of a dimension, e.g. because it is missing from a pull.
+    void eraseDimension(const HashableDimensionKey& dimensionsInWhat);
+
+    // Drops the bases of the dimensions for which keep returns false.
+    void retainDimensions(const std::function<bool(const HashableDimensionKey&)>& keep);
+
+    size_t getDimensionCount() const {
+        return mPulledDimensions.size();
+    }
+
+private:
+    struct Dimension {
+        // Base of each value field, kept from one pull to the next.
+        std::vector<std::optional<Value>> bases;
+
+        // First and last row with these dimensions in the current pull, by index in mRows. -1 if
+        // the dimensions are not in the current pull.
+        int firstRow = -1;
+        int lastRow = -1;
+    };
+
+    // Drops all rows. The buffers keep their capacity.
+    void clear();
+
+    const std::vector<Matcher> mDimensionsInWhat;
+
+    const std::vector<Matcher> mValueFields;
+
+    const DiffOptions mOptions;
+
+    // Base table, by dimensions in what. Dimensions of the current pull are also found here.
+    std::unordered_map<HashableDimensionKey, Dimension> mDimensions;
+
+    // Dimensions of the current pull, in the order in which they were first added.
+    std::vector<Dimension*> mPulledDimensions;
+
+    // Rows of the current pull.
+    std::vector<const LogEvent*> mRows;
+
+    // Next row with the same dimensions, or -1.
+    std::vector<int> mNext;
+
+    // Index of each value field in each row, mValueFields.size() entries per row. -1 if missing.
+    std::vector<int> mValueIndices;
+
+    // Dimensions in what and value indices of the row being added.
+    HashableDimensionKey mRowDimensionsInWhat;
+    std::vector<int> mRowValueIndices;
+
+    // Merged values of the dimension being visited by forEachMergedRow().
+    std::vector<MergedValue> mMergedValues;
+    Dimension* mMergingDimension = nullptr;
+
+    FRIEND_TEST(PulledRowAggregatorTest, TestMergeDuplicates);
+    FRIEND_TEST(PulledRowAggregatorTest, TestRowsDroppedAfterMerge);
+    FRIEND_TEST(PulledRowAggregatorTest, TestShrinkAfterSmallerPull);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
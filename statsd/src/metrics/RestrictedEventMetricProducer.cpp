@@ -64,11 +64,11 @@ void RestrictedEventMetricProducer::onMatchedLogEventInternalLocked(
     mTotalSize += getSize(event.getValues()) + sizeof(event);
 }
 
-void RestrictedEventMetricProducer::onDumpReportLocked(
+DumpReportWriter RestrictedEventMetricProducer::prepareDumpReportLocked(
         const int64_t dumpTimeNs, const bool include_current_partial_bucket, const bool erase_data,
-        const DumpLatency dumpLatency, std::set<string>* str_set,
-        android::util::ProtoOutputStream* protoOutput) {
-    VLOG("Unexpected call to onDumpReportLocked() in RestrictedEventMetricProducer");
+        const DumpLatency dumpLatency) {
+    VLOG("Unexpected call to prepareDumpReportLocked() in RestrictedEventMetricProducer");
+    return [](std::set<string>* str_set, android::util::ProtoOutputStream* protoOutput) {};
 }
 
 void RestrictedEventMetricProducer::onMetricRemove() {
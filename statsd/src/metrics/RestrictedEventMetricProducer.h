@@ -43,10 +43,10 @@ private:
             const ConditionKey& conditionKey, bool condition, const LogEvent& event,
             const std::map<int, HashableDimensionKey>& statePrimaryKeys) override;
 
-    void onDumpReportLocked(const int64_t dumpTimeNs, const bool include_current_partial_bucket,
-                            const bool erase_data, const DumpLatency dumpLatency,
-                            std::set<string>* str_set,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    DumpReportWriter prepareDumpReportLocked(const int64_t dumpTimeNs,
+                                             const bool include_current_partial_bucket,
+                                             const bool erase_data,
+                                             const DumpLatency dumpLatency) override;
 
     void clearPastBucketsLocked(const int64_t dumpTimeNs) override;
 
@@ -289,9 +289,9 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::clearPastBucketsLocked(
 }
 
 template <typename AggregatedValue, typename DimExtras>
-void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
+DumpReportWriter ValueMetricProducer<AggregatedValue, DimExtras>::prepareDumpReportLocked(
         const int64_t dumpTimeNs, const bool includeCurrentPartialBucket, const bool eraseData,
-        const DumpLatency dumpLatency, set<string>* strSet, ProtoOutputStream* protoOutput) {
+        const DumpLatency dumpLatency) {
     VLOG("metric %lld dump report now...", (long long)mMetricId);
 
     // Pulled metrics need to pull before flushing, which is why they do not call flushIfNeeded.
@@ -317,127 +317,173 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onDumpReportLocked(
         flushCurrentBucketLocked(dumpTimeNs, dumpTimeNs);
     }
 
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)mMetricId);
-    protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActiveLocked());
-
-    if (mPastBuckets.empty() && mSkippedBuckets.empty()) {
-        return;
-    }
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)mTimeBaseNs);
-    protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)mBucketSizeNs);
-    // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
-    if (!mShouldUseNestedDimensions) {
-        if (!mDimensionsInWhat.empty()) {
-            uint64_t dimenPathToken =
-                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
-            writeDimensionPathToProto(mDimensionsInWhat, protoOutput);
-            protoOutput->end(dimenPathToken);
+    using PastBuckets =
+            std::unordered_map<MetricDimensionKey, std::vector<PastBucket<AggregatedValue>>>;
+    std::shared_ptr<const PastBuckets> pastBuckets;
+    std::shared_ptr<const std::vector<SkippedBucket>> skippedBuckets;
+    if (eraseData) {
+        pastBuckets = std::make_shared<const PastBuckets>(std::move(mPastBuckets));
+        skippedBuckets = std::make_shared<const std::vector<SkippedBucket>>(
+                std::move(mSkippedBuckets));
+        mPastBuckets.clear();
+        mSkippedBuckets.clear();
+    } else {
+        // Aggregates are not always copyable, e.g. the KLL sketches.
+        PastBuckets pastBucketsCopy;
+        for (const auto& [metricDimensionKey, buckets] : mPastBuckets) {
+            std::vector<PastBucket<AggregatedValue>>& bucketsCopy =
+                    pastBucketsCopy[metricDimensionKey];
+            bucketsCopy.reserve(buckets.size());
+            for (const auto& bucket : buckets) {
+                PastBucket<AggregatedValue> bucketCopy;
+                bucketCopy.mBucketStartNs = bucket.mBucketStartNs;
+                bucketCopy.mBucketEndNs = bucket.mBucketEndNs;
+                bucketCopy.aggIndex = bucket.aggIndex;
+                bucketCopy.aggregates.reserve(bucket.aggregates.size());
+                for (const AggregatedValue& aggregate : bucket.aggregates) {
+                    bucketCopy.aggregates.push_back(copyPastBucketAggregate(aggregate));
+                }
+                bucketCopy.sampleSizes = bucket.sampleSizes;
+                bucketCopy.mConditionTrueNs = bucket.mConditionTrueNs;
+                bucketCopy.mConditionCorrectionNs = bucket.mConditionCorrectionNs;
+                bucketsCopy.push_back(std::move(bucketCopy));
+            }
         }
-    }
-
-    const auto& [metricTypeFieldId, bucketNumFieldId, startBucketMsFieldId, endBucketMsFieldId,
-                 conditionTrueNsFieldId,
-                 conditionCorrectionNsFieldId] = getDumpProtoFields();
-
-    uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | metricTypeFieldId);
-
-    for (const auto& skippedBucket : mSkippedBuckets) {
-        uint64_t wrapperToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED);
-        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
-                           (long long)(NanoToMillis(skippedBucket.bucketStartTimeNs)));
-        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_END_MILLIS,
-                           (long long)(NanoToMillis(skippedBucket.bucketEndTimeNs)));
-        for (const auto& dropEvent : skippedBucket.dropEvents) {
-            uint64_t dropEventToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                                         FIELD_ID_SKIPPED_DROP_EVENT);
-            protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_BUCKET_DROP_REASON, dropEvent.reason);
-            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DROP_TIME,
-                               (long long)(NanoToMillis(dropEvent.dropTimeNs)));
-            protoOutput->end(dropEventToken);
+        pastBuckets = std::make_shared<const PastBuckets>(std::move(pastBucketsCopy));
+        skippedBuckets = std::make_shared<const std::vector<SkippedBucket>>(mSkippedBuckets);
+    }
+
+    // We only write the condition timer value if the metric has a
+    // condition and/or is sliced by state.
+    // If the metric is sliced by state, the condition timer value is
+    // also sliced by state to reflect time spent in that state.
+    const bool writeConditionTrueNs = mConditionTrackerIndex >= 0 || !mSlicedStateAtoms.empty();
+    // We write the condition correction value when below conditions are true:
+    // - if metric is pulled
+    // - if it is enabled by metric configuration via dedicated field,
+    //   see condition_correction_threshold_nanos
+    // - if the abs(value) >= condition_correction_threshold_nanos
+    const optional<int64_t> conditionCorrectionThresholdNs =
+            isPulled() ? mConditionCorrectionThresholdNs : nullopt;
+
+    // The producer is only used for writePastBucketAggregateToProto(), which reads const members.
+    return [self = sp<ValueMetricProducer>(this), isActive = isActiveLocked(),
+            timeBaseNs = mTimeBaseNs, bucketSizeNs = mBucketSizeNs,
+            shouldUseNestedDimensions = mShouldUseNestedDimensions,
+            dimensionsInWhat = mDimensionsInWhat, dumpProtoFields = getDumpProtoFields(),
+            writeConditionTrueNs, conditionCorrectionThresholdNs, pastBuckets,
+            skippedBuckets](set<string>* strSet, ProtoOutputStream* protoOutput) {
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)self->mMetricId);
+        protoOutput->write(FIELD_TYPE_BOOL | FIELD_ID_IS_ACTIVE, isActive);
+
+        if (pastBuckets->empty() && skippedBuckets->empty()) {
+            return;
         }
-        protoOutput->end(wrapperToken);
-    }
-
-    for (const auto& [metricDimensionKey, buckets] : mPastBuckets) {
-        VLOG("  dimension key %s", metricDimensionKey.toString().c_str());
-        uint64_t wrapperToken =
-                protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
-
-        // First fill dimension.
-        if (mShouldUseNestedDimensions) {
-            uint64_t dimensionToken =
-                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
-            writeDimensionToProto(metricDimensionKey.getDimensionKeyInWhat(), strSet, protoOutput);
-            protoOutput->end(dimensionToken);
-        } else {
-            writeDimensionLeafNodesToProto(metricDimensionKey.getDimensionKeyInWhat(),
-                                           FIELD_ID_DIMENSION_LEAF_IN_WHAT, strSet, protoOutput);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_TIME_BASE, (long long)timeBaseNs);
+        protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_BUCKET_SIZE, (long long)bucketSizeNs);
+        // Fills the dimension path if not slicing by a primitive repeated field or position ALL.
+        if (!shouldUseNestedDimensions) {
+            if (!dimensionsInWhat.empty()) {
+                uint64_t dimenPathToken =
+                        protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_PATH_IN_WHAT);
+                writeDimensionPathToProto(dimensionsInWhat, protoOutput);
+                protoOutput->end(dimenPathToken);
+            }
         }
 
-        // Then fill slice_by_state.
-        for (auto state : metricDimensionKey.getStateValuesKey().getValues()) {
-            uint64_t stateToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
-                                                     FIELD_ID_SLICE_BY_STATE);
-            writeStateToProto(state, protoOutput);
-            protoOutput->end(stateToken);
+        const auto& [metricTypeFieldId, bucketNumFieldId, startBucketMsFieldId,
+                     endBucketMsFieldId, conditionTrueNsFieldId,
+                     conditionCorrectionNsFieldId] = dumpProtoFields;
+
+        uint64_t protoToken = protoOutput->start(FIELD_TYPE_MESSAGE | metricTypeFieldId);
+
+        for (const auto& skippedBucket : *skippedBuckets) {
+            uint64_t wrapperToken = protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED |
+                                                       FIELD_ID_SKIPPED);
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_START_MILLIS,
+                               (long long)(NanoToMillis(skippedBucket.bucketStartTimeNs)));
+            protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_SKIPPED_END_MILLIS,
+                               (long long)(NanoToMillis(skippedBucket.bucketEndTimeNs)));
+            for (const auto& dropEvent : skippedBucket.dropEvents) {
+                uint64_t dropEventToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_SKIPPED_DROP_EVENT);
+                protoOutput->write(FIELD_TYPE_INT32 | FIELD_ID_BUCKET_DROP_REASON,
+                                   dropEvent.reason);
+                protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_DROP_TIME,
+                                   (long long)(NanoToMillis(dropEvent.dropTimeNs)));
+                protoOutput->end(dropEventToken);
+            }
+            protoOutput->end(wrapperToken);
         }
 
-        // Then fill bucket_info (*BucketInfo).
-        for (const auto& bucket : buckets) {
-            uint64_t bucketInfoToken = protoOutput->start(
-                    FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
-
-            if (bucket.mBucketEndNs - bucket.mBucketStartNs != mBucketSizeNs) {
-                protoOutput->write(FIELD_TYPE_INT64 | startBucketMsFieldId,
-                                   (long long)NanoToMillis(bucket.mBucketStartNs));
-                protoOutput->write(FIELD_TYPE_INT64 | endBucketMsFieldId,
-                                   (long long)NanoToMillis(bucket.mBucketEndNs));
+        for (const auto& [metricDimensionKey, buckets] : *pastBuckets) {
+            VLOG("  dimension key %s", metricDimensionKey.toString().c_str());
+            uint64_t wrapperToken =
+                    protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_DATA);
+
+            // First fill dimension.
+            if (shouldUseNestedDimensions) {
+                uint64_t dimensionToken =
+                        protoOutput->start(FIELD_TYPE_MESSAGE | FIELD_ID_DIMENSION_IN_WHAT);
+                writeDimensionToProto(metricDimensionKey.getDimensionKeyInWhat(), strSet,
+                                      protoOutput);
+                protoOutput->end(dimensionToken);
             } else {
-                protoOutput->write(FIELD_TYPE_INT64 | bucketNumFieldId,
-                                   (long long)(getBucketNumFromEndTimeNs(bucket.mBucketEndNs)));
+                writeDimensionLeafNodesToProto(metricDimensionKey.getDimensionKeyInWhat(),
+                                               FIELD_ID_DIMENSION_LEAF_IN_WHAT, strSet,
+                                               protoOutput);
             }
-            // We only write the condition timer value if the metric has a
-            // condition and/or is sliced by state.
-            // If the metric is sliced by state, the condition timer value is
-            // also sliced by state to reflect time spent in that state.
-            if (mConditionTrackerIndex >= 0 || !mSlicedStateAtoms.empty()) {
-                protoOutput->write(FIELD_TYPE_INT64 | conditionTrueNsFieldId,
-                                   (long long)bucket.mConditionTrueNs);
+
+            // Then fill slice_by_state.
+            for (auto state : metricDimensionKey.getStateValuesKey().getValues()) {
+                uint64_t stateToken = protoOutput->start(FIELD_TYPE_MESSAGE |
+                                                         FIELD_COUNT_REPEATED |
+                                                         FIELD_ID_SLICE_BY_STATE);
+                writeStateToProto(state, protoOutput);
+                protoOutput->end(stateToken);
             }
 
-            if (conditionCorrectionNsFieldId) {
-                // We write the condition correction value when below conditions are true:
-                // - if metric is pulled
-                // - if it is enabled by metric configuration via dedicated field,
-                //   see condition_correction_threshold_nanos
-                // - if the abs(value) >= condition_correction_threshold_nanos
+            // Then fill bucket_info (*BucketInfo).
+            for (const auto& bucket : buckets) {
+                uint64_t bucketInfoToken = protoOutput->start(
+                        FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_BUCKET_INFO);
+
+                if (bucket.mBucketEndNs - bucket.mBucketStartNs != bucketSizeNs) {
+                    protoOutput->write(FIELD_TYPE_INT64 | startBucketMsFieldId,
+                                       (long long)NanoToMillis(bucket.mBucketStartNs));
+                    protoOutput->write(FIELD_TYPE_INT64 | endBucketMsFieldId,
+                                       (long long)NanoToMillis(bucket.mBucketEndNs));
+                } else {
+                    protoOutput->write(FIELD_TYPE_INT64 | bucketNumFieldId,
+                                       (long long)(getBucketNumFromEndTimeNs(
+                                               timeBaseNs, bucketSizeNs, bucket.mBucketEndNs)));
+                }
+                if (writeConditionTrueNs) {
+                    protoOutput->write(FIELD_TYPE_INT64 | conditionTrueNsFieldId,
+                                       (long long)bucket.mConditionTrueNs);
+                }
 
-                if (isPulled() && mConditionCorrectionThresholdNs &&
-                    (abs(bucket.mConditionCorrectionNs) >= mConditionCorrectionThresholdNs)) {
+                if (conditionCorrectionNsFieldId && conditionCorrectionThresholdNs &&
+                    (abs(bucket.mConditionCorrectionNs) >= conditionCorrectionThresholdNs)) {
                     protoOutput->write(FIELD_TYPE_INT64 | conditionCorrectionNsFieldId.value(),
                                        (long long)bucket.mConditionCorrectionNs);
                 }
-            }
 
-            for (int i = 0; i < (int)bucket.aggIndex.size(); i++) {
-                VLOG("\t bucket [%lld - %lld]", (long long)bucket.mBucketStartNs,
-                     (long long)bucket.mBucketEndNs);
-                int sampleSize = !bucket.sampleSizes.empty() ? bucket.sampleSizes[i] : 0;
-                writePastBucketAggregateToProto(bucket.aggIndex[i], bucket.aggregates[i],
-                                                sampleSize, protoOutput);
+                for (int i = 0; i < (int)bucket.aggIndex.size(); i++) {
+                    VLOG("\t bucket [%lld - %lld]", (long long)bucket.mBucketStartNs,
+                         (long long)bucket.mBucketEndNs);
+                    int sampleSize = !bucket.sampleSizes.empty() ? bucket.sampleSizes[i] : 0;
+                    self->writePastBucketAggregateToProto(bucket.aggIndex[i], bucket.aggregates[i],
+                                                          sampleSize, protoOutput);
+                }
+                protoOutput->end(bucketInfoToken);
             }
-            protoOutput->end(bucketInfoToken);
+            protoOutput->end(wrapperToken);
         }
-        protoOutput->end(wrapperToken);
-    }
-    protoOutput->end(protoToken);
+        protoOutput->end(protoToken);
 
-    VLOG("metric %lld done with dump report...", (long long)mMetricId);
-    if (eraseData) {
-        mPastBuckets.clear();
-        mSkippedBuckets.clear();
-    }
+        VLOG("metric %lld done with dump report...", (long long)self->mMetricId);
+    };
 }
 
 template <typename AggregatedValue, typename DimExtras>
@@ -655,7 +701,7 @@ void ValueMetricProducer<AggregatedValue, DimExtras>::onMatchedLogEventInternalL
         return;
     }
 
-    const int64_t eventTimeNs = event.GetElapsedTimestampNs();
+    const int64_t eventTimeNs = getEventTimeNsLocked(event);
     if (isEventLateLocked(eventTimeNs)) {
         VLOG("Skip event due to late arrival: %lld vs %lld", (long long)eventTimeNs,
              (long long)mCurrentBucketStartTimeNs);
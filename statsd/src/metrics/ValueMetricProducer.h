@@ -152,10 +152,10 @@ protected:
 
     void notifyAppUpgradeInternalLocked(const int64_t eventTimeNs) override;
 
-    void onDumpReportLocked(const int64_t dumpTimeNs, const bool includeCurrentPartialBucket,
-                            const bool eraseData, const DumpLatency dumpLatency,
-                            std::set<string>* strSet,
-                            android::util::ProtoOutputStream* protoOutput) override;
+    DumpReportWriter prepareDumpReportLocked(const int64_t dumpTimeNs,
+                                             const bool includeCurrentPartialBucket,
+                                             const bool eraseData,
+                                             const DumpLatency dumpLatency) override;
 
     struct DumpProtoFields {
         const int metricTypeFieldId;
@@ -340,11 +340,15 @@ protected:
     // condition change or an active state change.
     void updateCurrentSlicedBucketConditionTimers(bool newCondition, int64_t eventTimeNs);
 
+    // Called by the dump report writers without mMutex, so it must only read const members.
     virtual void writePastBucketAggregateToProto(const int aggIndex,
                                                  const AggregatedValue& aggregate,
                                                  const int sampleSize,
                                                  ProtoOutputStream* const protoOutput) const = 0;
 
+    // Returns a copy of an aggregate of mPastBuckets, for the dump reports that keep the data.
+    virtual AggregatedValue copyPastBucketAggregate(const AggregatedValue& aggregate) = 0;
+
     static const size_t kBucketSize = sizeof(PastBucket<AggregatedValue>{});
 
     const size_t mDimensionSoftLimit;
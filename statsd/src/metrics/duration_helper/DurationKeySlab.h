@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <gtest/gtest_prod.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "HashableDimensionKey.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+// Per-key state of a duration tracker. Records live in one vector and are found through a single
+// index, so all the state of a key is looked up once per event. Erased slots are put on a free
+// list and reused by later keys, so a tracker that sees the same number of keys bucket after
+// bucket stops growing the vector. Erasing releases the memory held by the key and the record,
+// and clear() shrinks the vector after a burst of keys.
+//
+// Erasing records while iterating with forEach() is allowed. Inserting is not. The key and the
+// record passed to the visitor must not be used after they are erased.
+template <typename Record>
+class DurationKeySlab {
+public:
+    // Returns the record of key, or nullptr if there is none.
+    Record* find(const HashableDimensionKey& key) {
+        const auto it = mIndex.find(key);
+        return it == mIndex.end() ? nullptr : &mSlots[it->second].record;
+    }
+
+    const Record* find(const HashableDimensionKey& key) const {
+        const auto it = mIndex.find(key);
+        return it == mIndex.end() ? nullptr : &mSlots[it->second].record;
+    }
+
+    // Returns the record of key, adding a default constructed one if there is none.
+    Record& operator[](const HashableDimensionKey& key) {
+        const auto [it, inserted] = mIndex.emplace(key, 0);
+        if (!inserted) {
+            return mSlots[it->second].record;
+        }
+        if (mFreeSlots.empty()) {
+            it->second = mSlots.size();
+            mSlots.emplace_back();
+        } else {
+            it->second = mFreeSlots.back();
+            mFreeSlots.pop_back();
+        }
+        Slot& slot = mSlots[it->second];
+        slot.key = key;
+        slot.record = Record();
+        slot.live = true;
+        return slot.record;
+    }
+
+    void erase(const HashableDimensionKey& key) {
+        const auto it = mIndex.find(key);
+        if (it == mIndex.end()) {
+            return;
+        }
+        // key may be the key of the slot, which release() resets.
+        const size_t index = it->second;
+        mIndex.erase(it);
+        release(mSlots[index]);
+        mFreeSlots.push_back(index);
+    }
+
+    void clear() {
+        // Keep as many slots as there were keys, but drop the rest if the slab is mostly free.
+        const size_t liveCount = mIndex.size();
+        mIndex.clear();
+        mFreeSlots.clear();
+        if (liveCount < mSlots.size() / 4) {
+            mSlots.resize(liveCount);
+            mSlots.shrink_to_fit();
+            mFreeSlots.shrink_to_fit();
+        }
+        for (size_t i = mSlots.size(); i > 0; i--) {
+            release(mSlots[i - 1]);
+            mFreeSlots.push_back(i - 1);
+        }
+    }
+
+    // Calls visit(key, record) for every record.
+    template <typename Visitor>
+    void forEach(Visitor visit) {
+        for (size_t i = 0; i < mSlots.size(); i++) {
+            if (mSlots[i].live) {
+                visit(mSlots[i].key, mSlots[i].record);
+            }
+        }
+    }
+
+    template <typename Visitor>
+    void forEach(Visitor visit) const {
+        for (const Slot& slot : mSlots) {
+            if (slot.live) {
+                visit(slot.key, slot.record);
+            }
+        }
+    }
+
+    size_t size() const {
+        return mIndex.size();
+    }
+
+    bool empty() const {
+        return mIndex.empty();
+    }
+
+private:
+    struct Slot {
+        HashableDimensionKey key;
+        Record record;
+        bool live = false;
+    };
+
+    static void release(Slot& slot) {
+        if (!slot.live) {
+            return;
+        }
+        slot.live = false;
+        // HashableDimensionKey has no move assignment, and assigning an empty key would keep the
+        // capacity of its values.
+        std::vector<FieldValue>().swap(*slot.key.mutableValues());
+        slot.record = Record();
+    }
+
+    // Maps each key to its slot in mSlots.
+    std::unordered_map<HashableDimensionKey, size_t> mIndex;
+
+    std::vector<Slot> mSlots;
+
+    // Slots that are not live, reused before mSlots grows.
+    std::vector<size_t> mFreeSlots;
+
+    FRIEND_TEST(DurationKeySlabTest, TestReuseSlots);
+    FRIEND_TEST(DurationKeySlabTest, TestReleaseMemory);
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -237,6 +237,13 @@ protected:
         }
     }
 
+    // Queries the sliced condition for all of mConditionKeyQueries in one call, and stores the
+    // results in mConditionKeyStates.
+    void queryConditionKeys() {
+        mWizard->queryAll(mConditionTrackerIndex, mConditionKeyQueries,
+                          !mHasLinksToAllConditionDimensionsInTracker, &mConditionKeyStates);
+    }
+
     // A reference to the DurationMetricProducer's config key.
     const ConfigKey& mConfigKey;
 
@@ -271,6 +278,11 @@ protected:
 
     bool mHasHitGuardrail;
 
+    // Condition keys to query on a sliced condition change, and their states. Kept across changes
+    // to reuse their capacity.
+    std::vector<const ConditionKey*> mConditionKeyQueries;
+    std::vector<ConditionState> mConditionKeyStates;
+
     FRIEND_TEST(OringDurationTrackerTest, TestPredictAnomalyTimestamp);
     FRIEND_TEST(OringDurationTrackerTest, TestAnomalyDetectionExpiredAlarm);
     FRIEND_TEST(OringDurationTrackerTest, TestAnomalyDetectionFiredAlarm);
@@ -33,12 +33,13 @@ MaxDurationTracker::MaxDurationTracker(const ConfigKey& key, const int64_t& id,
                                        const vector<sp<AnomalyTracker>>& anomalyTrackers)
     : DurationTracker(key, id, eventKey, wizard, conditionIndex, nesting, currentBucketStartNs,
                       currentBucketNum, startTimeNs, bucketSizeNs, conditionSliced, fullLink,
-                      anomalyTrackers) {
+                      anomalyTrackers),
+      mStartedCount(0) {
 }
 
 bool MaxDurationTracker::hitGuardRail(const HashableDimensionKey& newKey) {
     // ===========GuardRail==============
-    if (mInfos.find(newKey) != mInfos.end()) {
+    if (mInfos.find(newKey) != nullptr) {
         // if the key existed, we are good!
         return false;
     }
@@ -86,6 +87,7 @@ void MaxDurationTracker::noteStart(const HashableDimensionKey& key, bool conditi
             } else {
                 duration.state = DurationState::kStarted;
                 duration.lastStartTime = eventTime;
+                mStartedCount++;
                 startAnomalyAlarm(eventTime);
             }
             duration.startCount = 1;
@@ -96,11 +98,12 @@ void MaxDurationTracker::noteStart(const HashableDimensionKey& key, bool conditi
 void MaxDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t eventTime,
                                   bool forceStop) {
     VLOG("MaxDuration: key %s stop", key.toString().c_str());
-    if (mInfos.find(key) == mInfos.end()) {
+    DurationInfo* info = mInfos.find(key);
+    if (info == nullptr) {
         // we didn't see a start event before. do nothing.
         return;
     }
-    DurationInfo& duration = mInfos[key];
+    DurationInfo& duration = *info;
 
     switch (duration.state) {
         case DurationState::kStopped:
@@ -111,6 +114,7 @@ void MaxDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t
             if (forceStop || !mNested || duration.startCount <= 0) {
                 stopAnomalyAlarm(eventTime);
                 duration.state = DurationState::kStopped;
+                mStartedCount--;
                 int64_t durationTime = eventTime - duration.lastStartTime;
                 VLOG("Max, key %s, Stop %lld %lld %lld", key.toString().c_str(),
                      (long long)duration.lastStartTime, (long long)eventTime,
@@ -146,22 +150,14 @@ void MaxDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t
 }
 
 bool MaxDurationTracker::hasAccumulatingDuration() {
-    for (auto& pair : mInfos) {
-        if (pair.second.state == kStarted) {
-            return true;
-        }
-    }
-    return false;
+    return mStartedCount > 0;
 }
 
 void MaxDurationTracker::noteStopAll(const int64_t eventTime) {
-    std::set<HashableDimensionKey> keys;
-    for (const auto& pair : mInfos) {
-        keys.insert(pair.first);
-    }
-    for (auto& key : keys) {
+    // noteStop() erases every info it stops, which the slab allows while iterating.
+    mInfos.forEach([this, eventTime](const HashableDimensionKey& key, DurationInfo&) {
         noteStop(key, eventTime, true);
-    }
+    });
 }
 
 bool MaxDurationTracker::flushCurrentBucket(
@@ -185,15 +181,14 @@ bool MaxDurationTracker::flushCurrentBucket(
     bool hasPendingEvent =
             false;  // has either a kStarted or kPaused event across bucket boundaries
     // meaning we need to carry them over to the new bucket.
-    for (auto it = mInfos.begin(); it != mInfos.end();) {
-        if (it->second.state == DurationState::kStopped) {
+    mInfos.forEach([this, &hasPendingEvent](const HashableDimensionKey& key, DurationInfo& info) {
+        if (info.state == DurationState::kStopped) {
             // No need to keep buckets for events that were stopped before.
-            it = mInfos.erase(it);
+            mInfos.erase(key);
         } else {
-            ++it;
             hasPendingEvent = true;
         }
-    }
+    });
 
     // mDuration is updated in noteStop to the maximum duration that ended in the current bucket.
     if (durationPassesThreshold(uploadThreshold, mDuration)) {
@@ -233,18 +228,24 @@ bool MaxDurationTracker::flushIfNeeded(
 
 void MaxDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
     // Now for each of the on-going event, check if the condition has changed for them.
-    for (auto& pair : mInfos) {
-        if (pair.second.state == kStopped) {
-            continue;
+    mConditionKeyQueries.clear();
+    mInfos.forEach([this](const HashableDimensionKey&, DurationInfo& info) {
+        if (info.state != kStopped) {
+            mConditionKeyQueries.push_back(&info.conditionKeys);
         }
-        ConditionState conditionState = mWizard->query(
-            mConditionTrackerIndex, pair.second.conditionKeys,
-            !mHasLinksToAllConditionDimensionsInTracker);
-        bool conditionMet = (conditionState == ConditionState::kTrue);
+    });
+    queryConditionKeys();
 
-        VLOG("key: %s, condition: %d", pair.first.toString().c_str(), conditionMet);
-        noteConditionChanged(pair.first, conditionMet, timestamp);
-    }
+    size_t queryIndex = 0;
+    mInfos.forEach([&](const HashableDimensionKey& key, DurationInfo& info) {
+        if (info.state == kStopped) {
+            return;
+        }
+        bool conditionMet = (mConditionKeyStates[queryIndex++] == ConditionState::kTrue);
+
+        VLOG("key: %s, condition: %d", key.toString().c_str(), conditionMet);
+        noteConditionChanged(key, info, conditionMet, timestamp);
+    });
 }
 
 void MaxDurationTracker::onStateChanged(const int64_t timestamp, const int32_t atomId,
@@ -253,26 +254,32 @@ void MaxDurationTracker::onStateChanged(const int64_t timestamp, const int32_t a
 }
 
 void MaxDurationTracker::onConditionChanged(bool condition, const int64_t timestamp) {
-    for (auto& pair : mInfos) {
-        noteConditionChanged(pair.first, condition, timestamp);
-    }
+    mInfos.forEach([this, condition, timestamp](const HashableDimensionKey& key,
+                                                DurationInfo& info) {
+        noteConditionChanged(key, info, condition, timestamp);
+    });
 }
 
 void MaxDurationTracker::noteConditionChanged(const HashableDimensionKey& key, bool conditionMet,
                                               const int64_t timestamp) {
-    auto it = mInfos.find(key);
-    if (it == mInfos.end()) {
+    DurationInfo* info = mInfos.find(key);
+    if (info == nullptr) {
         return;
     }
+    noteConditionChanged(key, *info, conditionMet, timestamp);
+}
 
-    switch (it->second.state) {
+void MaxDurationTracker::noteConditionChanged(const HashableDimensionKey& key, DurationInfo& info,
+                                              bool conditionMet, const int64_t timestamp) {
+    switch (info.state) {
         case kStarted:
             // If condition becomes false, kStarted -> kPaused. Record the current duration and
             // stop anomaly alarm.
             if (!conditionMet) {
                 stopAnomalyAlarm(timestamp);
-                it->second.state = DurationState::kPaused;
-                it->second.lastDuration += (timestamp - it->second.lastStartTime);
+                info.state = DurationState::kPaused;
+                info.lastDuration += (timestamp - info.lastStartTime);
+                mStartedCount--;
                 if (hasAccumulatingDuration()) {
                     // In case any other dimensions are still started, we need to set the alarm.
                     startAnomalyAlarm(timestamp);
@@ -287,8 +294,9 @@ void MaxDurationTracker::noteConditionChanged(const HashableDimensionKey& key, b
             // If condition becomes true, kPaused -> kStarted. and the start time is the condition
             // change time.
             if (conditionMet) {
-                it->second.state = DurationState::kStarted;
-                it->second.lastStartTime = timestamp;
+                info.state = DurationState::kStarted;
+                info.lastStartTime = timestamp;
+                mStartedCount++;
                 startAnomalyAlarm(timestamp);
                 VLOG("MaxDurationTracker Key: %s Paused->Started", key.toString().c_str());
             }
@@ -302,15 +310,15 @@ int64_t MaxDurationTracker::predictAnomalyTimestampNs(const AnomalyTracker& anom
     // The allowed time we can continue in the current state is the
     // (anomaly threshold) - max(elapsed time of the started mInfos).
     int64_t maxElapsed = 0;
-    for (auto it = mInfos.begin(); it != mInfos.end(); ++it) {
-        if (it->second.state == DurationState::kStarted) {
-            int64_t duration =
-                    it->second.lastDuration + (currentTimestamp - it->second.lastStartTime);
+    mInfos.forEach([currentTimestamp, &maxElapsed](const HashableDimensionKey&,
+                                                   const DurationInfo& info) {
+        if (info.state == DurationState::kStarted) {
+            int64_t duration = info.lastDuration + (currentTimestamp - info.lastStartTime);
             if (duration > maxElapsed) {
                 maxElapsed = duration;
             }
         }
-    }
+    });
     int64_t anomalyTimeNs = currentTimestamp + anomalyTracker.getAnomalyThreshold() - maxElapsed;
     int64_t refractoryEndNs = anomalyTracker.getRefractoryPeriodEndsSec(mEventKey) * NS_PER_SEC;
     return std::max(anomalyTimeNs, refractoryEndNs);
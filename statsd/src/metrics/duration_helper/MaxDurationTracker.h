@@ -17,6 +17,7 @@
 #ifndef MAX_DURATION_TRACKER_H
 #define MAX_DURATION_TRACKER_H
 
+#include "DurationKeySlab.h"
 #include "DurationTracker.h"
 
 namespace android {
@@ -71,10 +72,15 @@ protected:
     bool hasAccumulatingDuration() override;
 
 private:
-    std::unordered_map<HashableDimensionKey, DurationInfo> mInfos;
+    DurationKeySlab<DurationInfo> mInfos;
+
+    // Number of mInfos in state kStarted.
+    size_t mStartedCount;
 
     void noteConditionChanged(const HashableDimensionKey& key, bool conditionMet,
                               const int64_t timestamp);
+    void noteConditionChanged(const HashableDimensionKey& key, DurationInfo& info,
+                              bool conditionMet, const int64_t timestamp);
 
     // return true if we should not allow newKey to be tracked because we are above the threshold
     bool hitGuardRail(const HashableDimensionKey& newKey);
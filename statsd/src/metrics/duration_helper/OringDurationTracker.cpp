@@ -22,8 +22,6 @@ namespace android {
 namespace os {
 namespace statsd {
 
-using std::pair;
-
 OringDurationTracker::OringDurationTracker(
         const ConfigKey& key, const int64_t& id, const MetricDimensionKey& eventKey,
         sp<ConditionWizard> wizard, int conditionIndex, bool nesting, int64_t currentBucketStartNs,
@@ -32,19 +30,21 @@ OringDurationTracker::OringDurationTracker(
     : DurationTracker(key, id, eventKey, wizard, conditionIndex, nesting, currentBucketStartNs,
                       currentBucketNum, startTimeNs, bucketSizeNs, conditionSliced, fullLink,
                       anomalyTrackers),
-      mStarted(),
-      mPaused() {
+      mStartedKeyCount(0),
+      mPausedKeyCount(0),
+      mConditionKeyCount(0) {
     mLastStartTime = 0;
 }
 
 bool OringDurationTracker::hitGuardRail(const HashableDimensionKey& newKey) {
     // ===========GuardRail==============
     // 1. Report the tuple count if the tuple count > soft limit
-    if (mConditionKeyMap.find(newKey) != mConditionKeyMap.end()) {
+    const KeyState* state = mKeys.find(newKey);
+    if (state != nullptr && state->hasConditionKey) {
         return false;
     }
-    if (mConditionKeyMap.size() > StatsdStats::kDimensionKeySizeSoftLimit - 1) {
-        size_t newTupleCount = mConditionKeyMap.size() + 1;
+    if (mConditionKeyCount > StatsdStats::kDimensionKeySizeSoftLimit - 1) {
+        size_t newTupleCount = mConditionKeyCount + 1;
         StatsdStats::getInstance().noteMetricDimensionSize(mConfigKey, mTrackerId, newTupleCount);
         // 2. Don't add more tuples, we are above the allowed threshold. Drop the data.
         if (newTupleCount > StatsdStats::kDimensionKeySizeHardLimit) {
@@ -64,19 +64,26 @@ void OringDurationTracker::noteStart(const HashableDimensionKey& key, bool condi
     if (hitGuardRail(key)) {
         return;
     }
+    KeyState& state = mKeys[key];
     if (condition) {
-        if (mStarted.size() == 0) {
+        if (mStartedKeyCount == 0) {
             mLastStartTime = eventTime;
             VLOG("record first start....");
             startAnomalyAlarm(eventTime);
         }
-        mStarted[key]++;
+        if (state.startedCount++ == 0) {
+            mStartedKeyCount++;
+        }
     } else {
-        mPaused[key]++;
+        if (state.pausedCount++ == 0) {
+            mPausedKeyCount++;
+        }
     }
 
-    if (mConditionSliced && mConditionKeyMap.find(key) == mConditionKeyMap.end()) {
-        mConditionKeyMap[key] = conditionKey;
+    if (mConditionSliced && !state.hasConditionKey) {
+        state.hasConditionKey = true;
+        state.conditionKey = conditionKey;
+        mConditionKeyCount++;
     }
     VLOG("Oring: %s start, condition %d", key.toString().c_str(), condition);
 }
@@ -84,14 +91,21 @@ void OringDurationTracker::noteStart(const HashableDimensionKey& key, bool condi
 void OringDurationTracker::noteStop(const HashableDimensionKey& key, const int64_t timestamp,
                                     const bool stopAll) {
     VLOG("Oring: %s stop", key.toString().c_str());
-    auto it = mStarted.find(key);
-    if (it != mStarted.end()) {
-        (it->second)--;
-        if (stopAll || !mNested || it->second <= 0) {
-            mStarted.erase(it);
-            mConditionKeyMap.erase(key);
+    KeyState* state = mKeys.find(key);
+    if (state == nullptr) {
+        if (mStartedKeyCount == 0) {
+            stopAnomalyAlarm(timestamp);
+        }
+        return;
+    }
+    if (state->startedCount > 0) {
+        state->startedCount--;
+        if (stopAll || !mNested || state->startedCount <= 0) {
+            state->startedCount = 0;
+            mStartedKeyCount--;
+            onKeyStopped(key, *state);
         }
-        if (mStarted.empty()) {
+        if (mStartedKeyCount == 0) {
             mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
                     (timestamp - mLastStartTime);
             detectAndDeclareAnomaly(
@@ -103,21 +117,32 @@ void OringDurationTracker::noteStop(const HashableDimensionKey& key, const int64
         }
     }
 
-    auto pausedIt = mPaused.find(key);
-    if (pausedIt != mPaused.end()) {
-        (pausedIt->second)--;
-        if (stopAll || !mNested || pausedIt->second <= 0) {
-            mPaused.erase(pausedIt);
-            mConditionKeyMap.erase(key);
+    // The record is only erased once the key is in neither set, so state is still valid here.
+    if (state->pausedCount > 0) {
+        state->pausedCount--;
+        if (stopAll || !mNested || state->pausedCount <= 0) {
+            state->pausedCount = 0;
+            mPausedKeyCount--;
+            onKeyStopped(key, *state);
         }
     }
-    if (mStarted.empty()) {
+    if (mStartedKeyCount == 0) {
         stopAnomalyAlarm(timestamp);
     }
 }
 
+void OringDurationTracker::onKeyStopped(const HashableDimensionKey& key, KeyState& state) {
+    if (state.hasConditionKey) {
+        state.hasConditionKey = false;
+        mConditionKeyCount--;
+    }
+    if (state.startedCount == 0 && state.pausedCount == 0) {
+        mKeys.erase(key);
+    }
+}
+
 void OringDurationTracker::noteStopAll(const int64_t timestamp) {
-    if (!mStarted.empty()) {
+    if (mStartedKeyCount > 0) {
         mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
                 (timestamp - mLastStartTime);
         VLOG("Oring Stop all: record duration %lld, total duration %lld for state key %s",
@@ -129,9 +154,10 @@ void OringDurationTracker::noteStopAll(const int64_t timestamp) {
     }
 
     stopAnomalyAlarm(timestamp);
-    mStarted.clear();
-    mPaused.clear();
-    mConditionKeyMap.clear();
+    mKeys.clear();
+    mStartedKeyCount = 0;
+    mPausedKeyCount = 0;
+    mConditionKeyCount = 0;
 }
 
 bool OringDurationTracker::flushCurrentBucket(
@@ -157,7 +183,7 @@ bool OringDurationTracker::flushCurrentBucket(
     }
 
     // Process the current bucket.
-    if (mStarted.size() > 0) {
+    if (mStartedKeyCount > 0) {
         // Calculate the duration for the current state key.
         mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
                 (currentBucketEndTimeNs - mLastStartTime);
@@ -193,7 +219,7 @@ bool OringDurationTracker::flushCurrentBucket(
         durationIt.second.mDuration = 0;
     }
 
-    if (mStarted.size() > 0) {
+    if (mStartedKeyCount > 0) {
         for (int i = 1; i < numBucketsForward; i++) {
             DurationBucket info;
             info.mBucketStartNs = fullBucketEnd + mBucketSizeNs * (i - 1);
@@ -227,7 +253,8 @@ bool OringDurationTracker::flushCurrentBucket(
     // for anomaly detection.
     // Note: Anomaly trackers can be added on config updates, in which case mAnomalyTrackers > 0 and
     // the full bucket duration could be used, but this is very rare so it is okay to clear.
-    return mStarted.empty() && mPaused.empty() && (isFullBucket || mAnomalyTrackers.size() == 0);
+    return mStartedKeyCount == 0 && mPausedKeyCount == 0 &&
+           (isFullBucket || mAnomalyTrackers.size() == 0);
 }
 
 bool OringDurationTracker::flushIfNeeded(
@@ -240,103 +267,116 @@ bool OringDurationTracker::flushIfNeeded(
 }
 
 void OringDurationTracker::onSlicedConditionMayChange(const int64_t timestamp) {
-    vector<pair<HashableDimensionKey, int>> startedToPaused;
-    vector<pair<HashableDimensionKey, int>> pausedToStarted;
-    if (!mStarted.empty()) {
-        for (auto it = mStarted.begin(); it != mStarted.end();) {
-            const auto& key = it->first;
-            const auto& condIt = mConditionKeyMap.find(key);
-            if (condIt == mConditionKeyMap.end()) {
-                VLOG("Key %s dont have condition key", key.toString().c_str());
-                ++it;
-                continue;
-            }
-            ConditionState conditionState =
-                mWizard->query(mConditionTrackerIndex, condIt->second,
-                               !mHasLinksToAllConditionDimensionsInTracker);
-            if (conditionState != ConditionState::kTrue) {
-                startedToPaused.push_back(*it);
-                it = mStarted.erase(it);
-                VLOG("Key %s started -> paused", key.toString().c_str());
-            } else {
-                ++it;
-            }
+    // First query the condition of every started or paused key in one call, so that the started
+    // set can be evaluated as a whole before any key moves.
+    mConditionKeyQueries.clear();
+    mKeys.forEach([this](const HashableDimensionKey&, KeyState& state) {
+        if (state.hasConditionKey) {
+            mConditionKeyQueries.push_back(&state.conditionKey);
         }
-
-        if (mStarted.empty()) {
-            mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
-                    (timestamp - mLastStartTime);
-            VLOG("record duration %lld, total duration %lld for state key %s",
-                 (long long)(timestamp - mLastStartTime), (long long)getCurrentStateKeyDuration(),
-                 mEventKey.getStateValuesKey().toString().c_str());
-            detectAndDeclareAnomaly(
-                    timestamp, mCurrentBucketNum,
-                    getCurrentStateKeyDuration() + getCurrentStateKeyFullBucketDuration());
+    });
+    queryConditionKeys();
+
+    size_t startedToPausedCount = 0;
+    size_t pausedToStartedCount = 0;
+    size_t queryIndex = 0;
+    mKeys.forEach([&](const HashableDimensionKey& key, KeyState& state) {
+        if (!state.hasConditionKey) {
+            VLOG("Key %s dont have condition key", key.toString().c_str());
+            return;
+        }
+        state.conditionMet = mConditionKeyStates[queryIndex++] == ConditionState::kTrue;
+        if (state.startedCount > 0 && !state.conditionMet) {
+            startedToPausedCount++;
+        }
+        if (state.pausedCount > 0 && state.conditionMet) {
+            pausedToStartedCount++;
         }
+    });
+
+    if (mStartedKeyCount > 0 && startedToPausedCount == mStartedKeyCount) {
+        mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
+                (timestamp - mLastStartTime);
+        VLOG("record duration %lld, total duration %lld for state key %s",
+             (long long)(timestamp - mLastStartTime), (long long)getCurrentStateKeyDuration(),
+             mEventKey.getStateValuesKey().toString().c_str());
+        detectAndDeclareAnomaly(
+                timestamp, mCurrentBucketNum,
+                getCurrentStateKeyDuration() + getCurrentStateKeyFullBucketDuration());
+    }
+    const bool noneStillStarted = startedToPausedCount == mStartedKeyCount;
+    if (noneStillStarted && pausedToStartedCount > 0) {
+        mLastStartTime = timestamp;
+        startAnomalyAlarm(timestamp);
     }
 
-    if (!mPaused.empty()) {
-        for (auto it = mPaused.begin(); it != mPaused.end();) {
-            const auto& key = it->first;
-            if (mConditionKeyMap.find(key) == mConditionKeyMap.end()) {
-                VLOG("Key %s dont have condition key", key.toString().c_str());
-                ++it;
-                continue;
+    // A key that is both started and paused keeps the count of the set it stays in.
+    if (startedToPausedCount > 0 || pausedToStartedCount > 0) {
+        mKeys.forEach([&](const HashableDimensionKey& key, KeyState& state) {
+            if (!state.hasConditionKey) {
+                return;
             }
-            ConditionState conditionState =
-                mWizard->query(mConditionTrackerIndex, mConditionKeyMap[key],
-                               !mHasLinksToAllConditionDimensionsInTracker);
-            if (conditionState == ConditionState::kTrue) {
-                pausedToStarted.push_back(*it);
-                it = mPaused.erase(it);
+            if (state.startedCount > 0 && !state.conditionMet) {
+                if (state.pausedCount == 0) {
+                    state.pausedCount = state.startedCount;
+                    mPausedKeyCount++;
+                }
+                state.startedCount = 0;
+                mStartedKeyCount--;
+                VLOG("Key %s started -> paused", key.toString().c_str());
+            } else if (state.pausedCount > 0 && state.conditionMet) {
+                if (state.startedCount == 0) {
+                    state.startedCount = state.pausedCount;
+                    mStartedKeyCount++;
+                }
+                state.pausedCount = 0;
+                mPausedKeyCount--;
                 VLOG("Key %s paused -> started", key.toString().c_str());
-            } else {
-                ++it;
             }
-        }
-
-        if (mStarted.empty() && pausedToStarted.size() > 0) {
-            mLastStartTime = timestamp;
-        }
+        });
     }
 
-    if (mStarted.empty() && !pausedToStarted.empty()) {
-        startAnomalyAlarm(timestamp);
-    }
-    mStarted.insert(pausedToStarted.begin(), pausedToStarted.end());
-    mPaused.insert(startedToPaused.begin(), startedToPaused.end());
-
-    if (mStarted.empty()) {
+    if (mStartedKeyCount == 0) {
         stopAnomalyAlarm(timestamp);
     }
 }
 
 void OringDurationTracker::onConditionChanged(bool condition, const int64_t timestamp) {
     if (condition) {
-        if (!mPaused.empty()) {
+        if (mPausedKeyCount > 0) {
             VLOG("Condition true, all started");
-            if (mStarted.empty()) {
+            if (mStartedKeyCount == 0) {
                 mLastStartTime = timestamp;
-            }
-            if (mStarted.empty() && !mPaused.empty()) {
                 startAnomalyAlarm(timestamp);
             }
-            mStarted.insert(mPaused.begin(), mPaused.end());
-            mPaused.clear();
+            mKeys.forEach([this](const HashableDimensionKey&, KeyState& state) {
+                if (state.pausedCount > 0 && state.startedCount == 0) {
+                    state.startedCount = state.pausedCount;
+                    mStartedKeyCount++;
+                }
+                state.pausedCount = 0;
+            });
+            mPausedKeyCount = 0;
         }
     } else {
-        if (!mStarted.empty()) {
+        if (mStartedKeyCount > 0) {
             VLOG("Condition false, all paused");
             mStateKeyDurationMap[mEventKey.getStateValuesKey()].mDuration +=
                     (timestamp - mLastStartTime);
-            mPaused.insert(mStarted.begin(), mStarted.end());
-            mStarted.clear();
+            mKeys.forEach([this](const HashableDimensionKey&, KeyState& state) {
+                if (state.startedCount > 0 && state.pausedCount == 0) {
+                    state.pausedCount = state.startedCount;
+                    mPausedKeyCount++;
+                }
+                state.startedCount = 0;
+            });
+            mStartedKeyCount = 0;
             detectAndDeclareAnomaly(
                     timestamp, mCurrentBucketNum,
                     getCurrentStateKeyDuration() + getCurrentStateKeyFullBucketDuration());
         }
     }
-    if (mStarted.empty()) {
+    if (mStartedKeyCount == 0) {
         stopAnomalyAlarm(timestamp);
     }
 }
@@ -345,9 +385,9 @@ void OringDurationTracker::onStateChanged(const int64_t timestamp, const int32_t
                                           const FieldValue& newState) {
     // Nothing needs to be done on a state change if we have not seen a start
     // event, the metric is currently not active, or condition is false.
-    // For these cases, no keys are being tracked in mStarted, so update
+    // For these cases, no keys are being tracked in the started set, so update
     // the current state key and return.
-    if (mStarted.empty()) {
+    if (mStartedKeyCount == 0) {
         updateCurrentStateKey(atomId, newState);
         return;
     }
@@ -359,7 +399,7 @@ void OringDurationTracker::onStateChanged(const int64_t timestamp, const int32_t
 }
 
 bool OringDurationTracker::hasAccumulatingDuration() {
-    return !mStarted.empty();
+    return mStartedKeyCount > 0;
 }
 int64_t OringDurationTracker::predictAnomalyTimestampNs(const AnomalyTracker& anomalyTracker,
                                                         const int64_t eventTimestampNs) const {
@@ -442,8 +482,8 @@ int64_t OringDurationTracker::predictAnomalyTimestampNs(const AnomalyTracker& an
 }
 
 void OringDurationTracker::dumpStates(FILE* out, bool verbose) const {
-    fprintf(out, "\t\t started count %lu\n", (unsigned long)mStarted.size());
-    fprintf(out, "\t\t paused count %lu\n", (unsigned long)mPaused.size());
+    fprintf(out, "\t\t started count %lu\n", (unsigned long)mStartedKeyCount);
+    fprintf(out, "\t\t paused count %lu\n", (unsigned long)mPausedKeyCount);
     fprintf(out, "\t\t current duration %lld\n", (long long)getCurrentStateKeyDuration());
 }
 
@@ -17,6 +17,7 @@
 #ifndef ORING_DURATION_TRACKER_H
 #define ORING_DURATION_TRACKER_H
 
+#include "DurationKeySlab.h"
 #include "DurationTracker.h"
 
 namespace android {
@@ -75,10 +76,32 @@ private:
     // 2) which keys are paused (started but condition was false)
     // 3) whenever a key stops, we remove it from the started set. And if the set becomes empty,
     //    it means everything has stopped, we then record the end time.
-    std::unordered_map<HashableDimensionKey, int> mStarted;
-    std::unordered_map<HashableDimensionKey, int> mPaused;
+    // Both sets and the condition keys are kept in a single record per key.
+    struct KeyState {
+        // Number of nested starts of the key while it is started, and while it is paused. A key
+        // is in the started (paused) set iff its count is positive.
+        int startedCount = 0;
+        int pausedCount = 0;
+
+        // Set on the first start of the key if the condition is sliced.
+        bool hasConditionKey = false;
+        ConditionKey conditionKey;
+
+        // Scratch result of the condition query in onSlicedConditionMayChange.
+        bool conditionMet = false;
+    };
+    DurationKeySlab<KeyState> mKeys;
+
+    // Number of keys in the started set, in the paused set and with a condition key.
+    size_t mStartedKeyCount;
+    size_t mPausedKeyCount;
+    size_t mConditionKeyCount;
+
     int64_t mLastStartTime;
-    std::unordered_map<HashableDimensionKey, ConditionKey> mConditionKeyMap;
+
+    // Called when key left the started or the paused set because it was stopped. Drops its
+    // condition key, and its record once it is in neither set.
+    void onKeyStopped(const HashableDimensionKey& key, KeyState& state);
 
     // return true if we should not allow newKey to be tracked because we are above the threshold
     bool hitGuardRail(const HashableDimensionKey& newKey);
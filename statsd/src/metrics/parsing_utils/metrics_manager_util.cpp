@@ -191,6 +191,9 @@ optional<InvalidConfigReason> handleMetricWithConditions(
                     INVALID_CONFIG_REASON_METRIC_CONDITION_LINK_NOT_FOUND, metricId,
                     link.condition());
         }
+        vector<Matcher> conditionFields;
+        translateFieldMatcher(link.fields_in_condition(), &conditionFields);
+        allConditionTrackers[it->second]->addLinkedDimensions(conditionFields);
     }
     conditionIndex = condition_it->second;
 
@@ -1261,7 +1264,14 @@ optional<sp<AnomalyTracker>> createAnomalyTracker(
                 INVALID_CONFIG_REASON_ALERT_METRIC_NOT_FOUND, alert.metric_id(), alert.id());
         return nullopt;
     }
-    if (!alert.has_trigger_if_sum_gt()) {
+    if (alert.has_detector()) {
+        if (!StatisticalAnomalyTracker::isValidDetector(alert)) {
+            ALOGW("invalid alert: invalid detector");
+            invalidConfigReason = createInvalidConfigReasonWithAlert(
+                    INVALID_CONFIG_REASON_ALERT_INVALID_DETECTOR, alert.id());
+            return nullopt;
+        }
+    } else if (!alert.has_trigger_if_sum_gt()) {
         ALOGW("invalid alert: missing threshold");
         invalidConfigReason = createInvalidConfigReasonWithAlert(
                 INVALID_CONFIG_REASON_ALERT_THRESHOLD_MISSING, alert.id());
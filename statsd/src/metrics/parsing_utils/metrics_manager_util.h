@@ -74,6 +74,7 @@ optional<InvalidConfigReason> handleMetricWithAtomMatchingTrackers(
 
 // 1. Validates condition existence, including those in links
 // 2. Gets condition index and updates condition to metric map
+// 3. Registers the condition side of each link with the linked ConditionTracker
 optional<InvalidConfigReason> handleMetricWithConditions(
         const int64_t condition, const int64_t metricId, const int metricIndex,
         const std::unordered_map<int64_t, int>& conditionTrackerMap,
@@ -423,8 +423,13 @@ void UidMap::appendUidMap(const int64_t& timestamp, const ConfigKey& key,
                           ProtoOutputStream* proto) {
     lock_guard<mutex> lock(mMutex);  // Lock for updates
 
+    // Reports are written without the StatsLogProcessor lock, so the config may have been removed
+    // since the dump started. It must not be tracked again then.
+    const auto lastUpdateIt = mLastUpdatePerConfigKey.find(key);
+    const int64_t lastUpdateNs =
+            lastUpdateIt != mLastUpdatePerConfigKey.end() ? lastUpdateIt->second : 0;
     for (const ChangeRecord& record : mChanges) {
-        if (record.timestampNs > mLastUpdatePerConfigKey[key]) {
+        if (record.timestampNs > lastUpdateNs) {
             uint64_t changesToken =
                     proto->start(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_CHANGES);
             proto->write(FIELD_TYPE_BOOL | FIELD_ID_CHANGE_DELETION, (bool)record.deletion);
@@ -490,8 +495,11 @@ void UidMap::appendUidMap(const int64_t& timestamp, const ConfigKey& key,
         }
     }
 
+    if (lastUpdateIt == mLastUpdatePerConfigKey.end()) {
+        return;
+    }
     int64_t prevMin = getMinimumTimestampNs();
-    mLastUpdatePerConfigKey[key] = timestamp;
+    lastUpdateIt->second = timestamp;
     int64_t newMin = getMinimumTimestampNs();
 
     if (newMin > prevMin) {  // Delete anything possible now that the minimum has
@@ -531,10 +539,12 @@ void UidMap::printUidMap(int out, bool includeCertificateHash) const {
 }
 
 void UidMap::OnConfigUpdated(const ConfigKey& key) {
+    lock_guard<mutex> lock(mMutex);
     mLastUpdatePerConfigKey[key] = -1;
 }
 
 void UidMap::OnConfigRemoved(const ConfigKey& key) {
+    lock_guard<mutex> lock(mMutex);
     mLastUpdatePerConfigKey.erase(key);
 }
 
@@ -84,6 +84,20 @@ public:
      * @param consumer used to differentiate the consumers to form proper superset of ids
      */
     virtual void setAtomIds(AtomIdSet tagIds, ConsumerId consumer) {
+        setAtomIds(std::move(tagIds), AtomIdSet(), consumer);
+    }
+
+    /**
+     * @brief Set the Atom Ids object, and the ids of atoms for which the consumer only reads
+     *        the header. The body of an atom is not parsed if every consumer using it only reads
+     *        its header. Both sets are updated together, so the filter never combines the atoms
+     *        of one update with the header only atoms of another.
+     *
+     * @param tagIds set of atoms ids
+     * @param headerOnlyTagIds subset of tagIds for which the consumer only reads the header
+     * @param consumer used to differentiate the consumers to form proper superset of ids
+     */
+    virtual void setAtomIds(AtomIdSet tagIds, AtomIdSet headerOnlyTagIds, ConsumerId consumer) {
         std::lock_guard lock(mTagIdsMutex);
         // update ids list from consumer
         if (tagIds.size() == 0) {
@@ -91,21 +105,41 @@ public:
         } else {
             mTagIdsPerConsumer[consumer].swap(tagIds);
         }
-        // populate the superset incorporating list of distinct atom ids from all consumers
+        if (headerOnlyTagIds.size() == 0) {
+            mHeaderOnlyTagIdsPerConsumer.erase(consumer);
+        } else {
+            mHeaderOnlyTagIdsPerConsumer[consumer].swap(headerOnlyTagIds);
+        }
+        updateTagIdsLocked();
+    }
+
+private:
+    void updateTagIdsLocked() {
+        // populate the superset incorporating list of distinct atom ids from all consumers,
+        // leaving out the atoms a consumer only reads the header of
         mTagIds.clear();
-        for (const auto& [_, atomIds] : mTagIdsPerConsumer) {
-            mTagIds.insert(atomIds.begin(), atomIds.end());
+        for (const auto& [consumer, atomIds] : mTagIdsPerConsumer) {
+            const auto headerOnlyIt = mHeaderOnlyTagIdsPerConsumer.find(consumer);
+            if (headerOnlyIt == mHeaderOnlyTagIdsPerConsumer.end()) {
+                mTagIds.insert(atomIds.begin(), atomIds.end());
+                continue;
+            }
+            for (const int atomId : atomIds) {
+                if (headerOnlyIt->second.find(atomId) == headerOnlyIt->second.end()) {
+                    mTagIds.insert(atomId);
+                }
+            }
         }
         mSetUpdateCounter.fetch_add(1, std::memory_order_relaxed);
     }
 
-private:
     std::atomic_bool mLogsFilteringEnabled = true;
     std::atomic_int mSetUpdateCounter;
     mutable int mLocalSetUpdateCounter;
 
     mutable std::mutex mTagIdsMutex;
     std::unordered_map<ConsumerId, AtomIdSet> mTagIdsPerConsumer;
+    std::unordered_map<ConsumerId, AtomIdSet> mHeaderOnlyTagIdsPerConsumer;
     mutable AtomIdSet mTagIds;
     mutable AtomIdSet mLocalTagIds;
 
@@ -124,6 +158,8 @@ private:
     FRIEND_TEST(LogEventFilterTest, TestMultipleConsumerOverlapIdsRemoved);
     FRIEND_TEST(LogEventFilterTest, TestMultipleConsumerNonOverlapIdsRemoved);
     FRIEND_TEST(LogEventFilterTest, TestMultipleConsumerEmptyFilter);
+    FRIEND_TEST(LogEventFilterTest, TestHeaderOnlyIds);
+    FRIEND_TEST(LogEventFilterTest, TestMultipleConsumerHeaderOnlyIds);
 };
 
 typedef LogEventFilterGeneric<std::unordered_set<int>> LogEventFilter;
@@ -17,12 +17,23 @@
 
 #include <utils/RefBase.h>
 
+#include <vector>
+
 #include "HashableDimensionKey.h"
 
 namespace android {
 namespace os {
 namespace statsd {
 
+// A state change of one primary key.
+struct StateChange {
+    HashableDimensionKey primaryKey;
+    // hashDimensionSortedByField() of primaryKey, computed once for all listeners.
+    size_t primaryKeyHash;
+    FieldValue oldState;
+    FieldValue newState;
+};
+
 class StateListener : public virtual RefBase {
 public:
     StateListener(){};
@@ -47,6 +58,26 @@ public:
     virtual void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
                                 const HashableDimensionKey& primaryKey, const FieldValue& oldState,
                                 const FieldValue& newState) = 0;
+
+    /**
+     * Interface for handling all state changes caused by one state atom event.
+     *
+     * Most events change the state of a single primary key, but a reset event changes the state
+     * of every primary key at once. Listeners that need to match the changes against their own
+     * dimensions can override this to process them together. By default, onStateChanged() is
+     * called for each change.
+     *
+     * [eventTimeNs]: Time of the state change log event.
+     * [atomId]: The id of the state atom
+     * [changes]: The state changes, at most one per primary key
+     */
+    virtual void onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                                const std::vector<StateChange>& changes) {
+        for (const StateChange& change : changes) {
+            onStateChanged(eventTimeNs, atomId, change.primaryKey, change.oldState,
+                           change.newState);
+        }
+    }
 };
 
 }  // namespace statsd
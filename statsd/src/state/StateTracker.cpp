@@ -38,7 +38,8 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     FieldValue newState;
     if (!getStateFieldValueFromLogEvent(event, &newState)) {
         ALOGE("StateTracker error extracting state from log event. Missing exclusive state field.");
-        clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        clearStateForPrimaryKey(primaryKey);
+        notifyListeners(eventTimeNs);
         return;
     }
 
@@ -47,20 +48,26 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     if (newState.mValue.getType() != INT) {
         ALOGE("StateTracker error extracting state from log event. Type: %d",
               newState.mValue.getType());
-        clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        clearStateForPrimaryKey(primaryKey);
+        notifyListeners(eventTimeNs);
         return;
     }
 
     if (int resetState = event.getResetState(); resetState != -1) {
         VLOG("StateTracker new reset state: %d", resetState);
         const FieldValue resetStateFieldValue(mField, Value(resetState));
-        handleReset(eventTimeNs, resetStateFieldValue);
+        handleReset(resetStateFieldValue);
+        notifyListeners(eventTimeNs);
         return;
     }
 
     const bool nested = newState.mAnnotations.isNested();
     StateValueInfo* stateValueInfo = &mStateMap[primaryKey];
-    updateStateForPrimaryKey(eventTimeNs, primaryKey, newState, nested, stateValueInfo);
+    updateStateForPrimaryKey(primaryKey, newState, nested, stateValueInfo);
+    if (newState.mValue.int_value == kStateUnknown) {
+        mStateMap.erase(primaryKey);
+    }
+    notifyListeners(eventTimeNs);
 }
 
 void StateTracker::registerListener(wp<StateListener> listener) {
@@ -85,17 +92,19 @@ bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValu
     return false;
 }
 
-void StateTracker::handleReset(const int64_t eventTimeNs, const FieldValue& newState) {
+void StateTracker::handleReset(const FieldValue& newState) {
     VLOG("StateTracker handle reset");
     for (auto& [primaryKey, stateValueInfo] : mStateMap) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, newState,
+        updateStateForPrimaryKey(primaryKey, newState,
                                  false /* nested; treat this state change as not nested */,
                                  &stateValueInfo);
     }
+    if (newState.mValue.int_value == kStateUnknown) {
+        mStateMap.clear();
+    }
 }
 
-void StateTracker::clearStateForPrimaryKey(const int64_t eventTimeNs,
-                                           const HashableDimensionKey& primaryKey) {
+void StateTracker::clearStateForPrimaryKey(const HashableDimensionKey& primaryKey) {
     VLOG("StateTracker clear state for primary key");
     const std::unordered_map<HashableDimensionKey, StateValueInfo>::iterator it =
             mStateMap.find(primaryKey);
@@ -104,25 +113,25 @@ void StateTracker::clearStateForPrimaryKey(const int64_t eventTimeNs,
     // kStateUnknown.
     const FieldValue state(mField, Value(kStateUnknown));
     if (it != mStateMap.end()) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, state,
+        updateStateForPrimaryKey(primaryKey, state,
                                  false /* nested; treat this state change as not nested */,
                                  &it->second);
+        mStateMap.erase(it);
     }
 }
 
-void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
-                                            const HashableDimensionKey& primaryKey,
+void StateTracker::updateStateForPrimaryKey(const HashableDimensionKey& primaryKey,
                                             const FieldValue& newState, const bool nested,
                                             StateValueInfo* stateValueInfo) {
-    FieldValue oldState;
-    oldState.mField = mField;
-    oldState.mValue.setInt(stateValueInfo->state);
     const int32_t oldStateValue = stateValueInfo->state;
     const int32_t newStateValue = newState.mValue.int_value;
-
-    if (kStateUnknown == newStateValue) {
-        mStateMap.erase(primaryKey);
-    }
+    auto recordChange = [&]() {
+        FieldValue oldState;
+        oldState.mField = mField;
+        oldState.mValue.setInt(oldStateValue);
+        mChanges.push_back(
+                {primaryKey, hashDimensionSortedByField(primaryKey), oldState, newState});
+    };
 
     // Update state map for non-nested counting case.
     // Every state event triggers a state overwrite.
@@ -132,7 +141,7 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
 
         // Notify listeners if state has changed.
         if (oldStateValue != newStateValue) {
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+            recordChange();
         }
         return;
     }
@@ -149,30 +158,34 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
     // The atom must be logged correctly.
     if (kStateUnknown == newStateValue) {
         if (kStateUnknown != oldStateValue) {
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+            recordChange();
         }
     } else if (oldStateValue == kStateUnknown) {
         stateValueInfo->state = newStateValue;
         stateValueInfo->count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+        recordChange();
     } else if (oldStateValue == newStateValue) {
         stateValueInfo->count++;
     } else if (--stateValueInfo->count == 0) {
         stateValueInfo->state = newStateValue;
         stateValueInfo->count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+        recordChange();
     }
 }
 
-void StateTracker::notifyListeners(const int64_t eventTimeNs,
-                                   const HashableDimensionKey& primaryKey,
-                                   const FieldValue& oldState, const FieldValue& newState) {
+void StateTracker::notifyListeners(const int64_t eventTimeNs) {
+    if (mChanges.empty()) {
+        return;
+    }
+    // Listeners may query this tracker, so the changes are delivered after the state map has
+    // been fully updated.
     for (auto l : mListeners) {
         auto sl = l.promote();
         if (sl != nullptr) {
-            sl->onStateChanged(eventTimeNs, mField.getTag(), primaryKey, oldState, newState);
+            sl->onStateChanges(eventTimeNs, mField.getTag(), mChanges);
         }
     }
+    mChanges.clear();
 }
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output) {
@@ -71,20 +71,24 @@ private:
     // Set of all StateListeners (objects listening for state changes)
     std::set<wp<StateListener>> mListeners;
 
+    // State changes caused by the event being processed. Reused across events.
+    std::vector<StateChange> mChanges;
+
     // Reset all state values in map to the given state.
-    void handleReset(const int64_t eventTimeNs, const FieldValue& newState);
+    void handleReset(const FieldValue& newState);
 
     // Clears the state value mapped to the given primary key by setting it to kStateUnknown.
-    void clearStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey);
+    void clearStateForPrimaryKey(const HashableDimensionKey& primaryKey);
 
-    // Update the StateMap based on the received state value.
-    void updateStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
+    // Update the StateMap based on the received state value and records the change, if any, in
+    // mChanges. The caller is responsible for erasing the entry if the new state is
+    // kStateUnknown.
+    void updateStateForPrimaryKey(const HashableDimensionKey& primaryKey,
                                   const FieldValue& newState, const bool nested,
                                   StateValueInfo* stateValueInfo);
 
-    // Notify registered state listeners of state change.
-    void notifyListeners(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
-                         const FieldValue& oldState, const FieldValue& newState);
+    // Notify registered state listeners of all changes in mChanges, then clears it.
+    void notifyListeners(const int64_t eventTimeNs);
 };
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output);
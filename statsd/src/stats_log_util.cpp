@@ -19,6 +19,7 @@
 
 #include <aidl/android/os/IStatsCompanionService.h>
 #include <private/android_filesystem_config.h>
+#include <sys/resource.h>
 #include <set>
 #include <utils/SystemClock.h>
 
@@ -84,6 +85,11 @@ const int FIELD_ID_PULLER_NOT_FOUND = 21;
 const int FIELD_ID_PULL_TIMEOUT_METADATA = 22;
 const int FIELD_ID_PULL_TIMEOUT_METADATA_UPTIME_MILLIS = 1;
 const int FIELD_ID_PULL_TIMEOUT_METADATA_ELAPSED_MILLIS = 2;
+const int FIELD_ID_AVERAGE_PULL_ALARM_TO_COMPLETION_NANOS = 23;
+const int FIELD_ID_MAX_PULL_ALARM_TO_COMPLETION_NANOS = 24;
+const int FIELD_ID_AVERAGE_PULL_ALARM_TO_START_NANOS = 25;
+const int FIELD_ID_MAX_PULL_ALARM_TO_START_NANOS = 26;
+const int FIELD_ID_PULLS_SAVED_BY_ALIGNMENT = 27;
 
 // for AtomMetricStats proto
 const int FIELD_ID_ATOM_METRIC_STATS = 17;
@@ -506,6 +512,16 @@ void writePullerStatsToStream(const std::pair<int, StatsdStats::PulledAtomStats>
                        (long long)pair.second.pullUidProviderNotFound);
     protoOutput->write(FIELD_TYPE_INT64 | FIELD_ID_PULLER_NOT_FOUND,
                        (long long)pair.second.pullerNotFound);
+    writeNonZeroStatToStream(FIELD_TYPE_INT64 | FIELD_ID_AVERAGE_PULL_ALARM_TO_COMPLETION_NANOS,
+                             (long long)pair.second.avgPullAlarmToCompletionNs, protoOutput);
+    writeNonZeroStatToStream(FIELD_TYPE_INT64 | FIELD_ID_MAX_PULL_ALARM_TO_COMPLETION_NANOS,
+                             (long long)pair.second.maxPullAlarmToCompletionNs, protoOutput);
+    writeNonZeroStatToStream(FIELD_TYPE_INT64 | FIELD_ID_AVERAGE_PULL_ALARM_TO_START_NANOS,
+                             (long long)pair.second.avgPullAlarmToStartNs, protoOutput);
+    writeNonZeroStatToStream(FIELD_TYPE_INT64 | FIELD_ID_MAX_PULL_ALARM_TO_START_NANOS,
+                             (long long)pair.second.maxPullAlarmToStartNs, protoOutput);
+    writeNonZeroStatToStream(FIELD_TYPE_INT64 | FIELD_ID_PULLS_SAVED_BY_ALIGNMENT,
+                             (long long)pair.second.pullsSavedByAlignment, protoOutput);
     for (const auto& pullTimeoutMetadata : pair.second.pullTimeoutMetadata) {
         uint64_t timeoutMetadataToken = protoOutput->start(FIELD_TYPE_MESSAGE |
                                                            FIELD_ID_PULL_TIMEOUT_METADATA |
@@ -581,13 +597,26 @@ int64_t getWallClockMillis() {
     return time(nullptr) * MS_PER_SEC;
 }
 
+int64_t getLifetimePeakRssKb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // Linux reports ru_maxrss in KB.
+    return usage.ru_maxrss;
+}
+
 int64_t truncateTimestampIfNecessary(const LogEvent& event) {
+    return truncateTimestampIfNecessary(event, event.GetElapsedTimestampNs());
+}
+
+int64_t truncateTimestampIfNecessary(const LogEvent& event, int64_t elapsedTimestampNs) {
     if (event.shouldTruncateTimestamp() ||
         (event.GetTagId() >= StatsdStats::kTimestampTruncationStartTag &&
          event.GetTagId() <= StatsdStats::kTimestampTruncationEndTag)) {
-        return event.GetElapsedTimestampNs() / NS_PER_SEC / (5 * 60) * NS_PER_SEC * (5 * 60);
+        return elapsedTimestampNs / NS_PER_SEC / (5 * 60) * NS_PER_SEC * (5 * 60);
     } else {
-        return event.GetElapsedTimestampNs();
+        return elapsedTimestampNs;
     }
 }
 
@@ -74,6 +74,10 @@ int64_t getWallClockMillis();
 // Gets the wall clock timestamp in seconds.
 int64_t getWallClockSec();
 
+// Gets the largest resident set size of statsd since it started (ru_maxrss), in KB. It never
+// decreases.
+int64_t getLifetimePeakRssKb();
+
 int64_t NanoToMillis(const int64_t nano);
 
 int64_t MillisToNano(const int64_t millis);
@@ -106,6 +110,9 @@ bool parseProtoOutputStream(ProtoOutputStream& protoOutput, T* message) {
 // Returns the truncated timestamp to the nearest 5 minutes if needed.
 int64_t truncateTimestampIfNecessary(const LogEvent& event);
 
+// Same as above, for an event handled as if its elapsed timestamp were elapsedTimestampNs.
+int64_t truncateTimestampIfNecessary(const LogEvent& event, int64_t elapsedTimestampNs);
+
 // Checks permission for given pid and uid.
 bool checkPermissionForIds(const char* permission, pid_t pid, uid_t uid);
 
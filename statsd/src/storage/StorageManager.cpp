@@ -53,6 +53,7 @@ const int FIELD_ID_REPORTS = 2;
 std::mutex StorageManager::sTrainInfoMutex;
 
 using android::base::StringPrintf;
+using android::base::unique_fd;
 using std::unique_ptr;
 
 struct FileName {
@@ -555,10 +556,22 @@ bool StorageManager::hasConfigMetricsReport(const ConfigKey& key) {
 
 void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
                                                bool erase_data, bool isAdb) {
+    for (const unique_fd& fd : openConfigMetricsReports(key, erase_data, isAdb)) {
+        string content;
+        if (android::base::ReadFdToString(fd.get(), &content)) {
+            proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
+                         content.c_str(), content.size());
+        }
+    }
+}
+
+vector<unique_fd> StorageManager::openConfigMetricsReports(const ConfigKey& key, bool erase_data,
+                                                           bool isAdb) {
+    vector<unique_fd> reports;
     unique_ptr<DIR, decltype(&closedir)> dir(opendir(STATS_DATA_DIR), closedir);
     if (dir == NULL) {
         VLOG("Path %s does not exist", STATS_DATA_DIR);
-        return;
+        return reports;
     }
 
     dirent* de;
@@ -575,14 +588,9 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
         }
 
         auto fullPathName = StringPrintf("%s/%s", STATS_DATA_DIR, fileName.c_str());
-        int fd = open(fullPathName.c_str(), O_RDONLY | O_CLOEXEC);
+        unique_fd fd(open(fullPathName.c_str(), O_RDONLY | O_CLOEXEC));
         if (fd != -1) {
-            string content;
-            if (android::base::ReadFdToString(fd, &content)) {
-                proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
-                             content.c_str(), content.size());
-            }
-            close(fd);
+            reports.push_back(std::move(fd));
         } else {
             ALOGE("file cannot be opened");
         }
@@ -599,6 +607,7 @@ void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutput
             }
         }
     }
+    return reports;
 }
 
 bool StorageManager::readFileToString(const char* file, string* content) {
@@ -17,6 +17,7 @@
 #ifndef STORAGE_MANAGER_H
 #define STORAGE_MANAGER_H
 
+#include <android-base/unique_fd.h>
 #include <android/util/ProtoOutputStream.h>
 #include <utils/Log.h>
 #include <utils/RefBase.h>
@@ -127,6 +128,15 @@ public:
     static void appendConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
                                           bool erase_data, bool isAdb);
 
+    /**
+     * Same as appendConfigMetricsReport, but returns the opened report files instead of reading
+     * them. The files are removed or renamed before returning, the reports can still be read from
+     * the returned fds.
+     */
+    static std::vector<android::base::unique_fd> openConfigMetricsReports(const ConfigKey& key,
+                                                                          bool erase_data,
+                                                                          bool isAdb);
+
     /**
      * Call to load the saved configs from disk.
      */
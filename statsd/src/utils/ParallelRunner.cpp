@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ParallelRunner.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+ParallelRunner::ParallelRunner(size_t maxThreads) : mMaxThreads(max(maxThreads, (size_t)1)) {
+}
+
+ParallelRunner::~ParallelRunner() {
+    {
+        lock_guard<mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWorkAvailable.notify_all();
+    for (thread& worker : mWorkers) {
+        worker.join();
+    }
+}
+
+void ParallelRunner::run(size_t numTasks, const function<void(size_t)>& task) {
+    if (numTasks <= 1 || mMaxThreads <= 1) {
+        for (size_t i = 0; i < numTasks; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    Batch batch = {&task, numTasks, /*nextTask=*/0, /*doneTasks=*/0};
+    unique_lock<mutex> lock(mMutex);
+    startWorkersLocked();
+    const auto it = mBatches.insert(mBatches.end(), &batch);
+    if (numTasks - 1 >= mWorkers.size()) {
+        mWorkAvailable.notify_all();
+    } else {
+        for (size_t i = 1; i < numTasks; i++) {
+            mWorkAvailable.notify_one();
+        }
+    }
+
+    while (batch.nextTask < numTasks) {
+        runTaskLocked(lock, &batch, takeTaskLocked(it));
+    }
+    mBatchDone.wait(lock, [&batch] { return batch.doneTasks == batch.numTasks; });
+}
+
+size_t ParallelRunner::takeTaskLocked(list<Batch*>::iterator batch) {
+    const size_t i = (*batch)->nextTask++;
+    if ((*batch)->nextTask == (*batch)->numTasks) {
+        mBatches.erase(batch);
+    }
+    return i;
+}
+
+void ParallelRunner::runTaskLocked(unique_lock<mutex>& lock, Batch* batch, size_t i) {
+    lock.unlock();
+    (*batch->task)(i);
+    lock.lock();
+    if (++batch->doneTasks == batch->numTasks) {
+        mBatchDone.notify_all();
+    }
+}
+
+void ParallelRunner::startWorkersLocked() {
+    if (!mWorkers.empty()) {
+        return;
+    }
+    mWorkers.reserve(mMaxThreads - 1);
+    for (size_t i = 1; i < mMaxThreads; i++) {
+        mWorkers.emplace_back(&ParallelRunner::runWorker, this);
+    }
+}
+
+void ParallelRunner::runWorker() {
+    unique_lock<mutex> lock(mMutex);
+    while (true) {
+        mWorkAvailable.wait(lock, [this] { return mStopping || !mBatches.empty(); });
+        if (mStopping) {
+            return;
+        }
+        Batch* batch = mBatches.front();
+        runTaskLocked(lock, batch, takeTaskLocked(mBatches.begin()));
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * This class provides a utility to run batches of independent tasks on a fixed pool of threads.
+ *
+ * The pool has maxThreads - 1 worker threads. They are started by the first batch that has more
+ * than one task and are kept until the runner is destroyed. The calling thread runs tasks of its
+ * own batch as well, so a batch always makes progress even when every worker is busy, and run()
+ * may be called from within a task. A runner with maxThreads <= 1 runs every batch entirely on
+ * the calling thread.
+ */
+class ParallelRunner {
+public:
+    explicit ParallelRunner(size_t maxThreads);
+
+    ~ParallelRunner();
+
+    ParallelRunner(const ParallelRunner&) = delete;
+    ParallelRunner& operator=(const ParallelRunner&) = delete;
+
+    // Calls task(i) for every i in [0, numTasks), possibly concurrently, and returns once all
+    // calls have returned.
+    void run(size_t numTasks, const std::function<void(size_t)>& task);
+
+private:
+    struct Batch {
+        const std::function<void(size_t)>* task;
+        size_t numTasks;
+        // Index of the next task to hand out.
+        size_t nextTask;
+        // Number of tasks that have returned.
+        size_t doneTasks;
+    };
+
+    // Hands out the next task of the batch. The batch is removed from mBatches once its last task
+    // has been handed out. mMutex must be held.
+    size_t takeTaskLocked(std::list<Batch*>::iterator batch);
+
+    // Runs task i of the batch and notes its completion. mMutex must be held, and is released
+    // while the task runs.
+    void runTaskLocked(std::unique_lock<std::mutex>& lock, Batch* batch, size_t i);
+
+    void startWorkersLocked();
+
+    void runWorker();
+
+    const size_t mMaxThreads;
+
+    std::mutex mMutex;
+
+    // Signaled when a batch is added, or when the runner is being destroyed.
+    std::condition_variable mWorkAvailable;
+
+    // Signaled when the last task of a batch returns.
+    std::condition_variable mBatchDone;
+
+    // Batches that still have tasks to hand out, in the order they were added.
+    std::list<Batch*> mBatches;
+
+    std::vector<std::thread> mWorkers;
+
+    bool mStopping = false;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
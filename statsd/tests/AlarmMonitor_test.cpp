@@ -64,6 +64,41 @@ TEST(AlarmMonitor, popSoonerThan) {
     ASSERT_EQ(0u, set.size());
 }
 
+TEST(AlarmMonitor, updatesRegisteredAlarmWhenSoonestChanges) {
+    int updates = 0;
+    int cancels = 0;
+    AlarmMonitor am(2,
+                    [&updates](const shared_ptr<IStatsCompanionService>&, int64_t) { updates++; },
+                    [&cancels](const shared_ptr<IStatsCompanionService>&) { cancels++; });
+
+    sp<const InternalAlarm> a = new InternalAlarm{100};
+    sp<const InternalAlarm> b = new InternalAlarm{101};
+    sp<const InternalAlarm> c = new InternalAlarm{500};
+    am.add(a);
+    EXPECT_EQ(100u, am.getRegisteredAlarmTimeSec());
+    am.add(b);
+    am.add(c);
+    am.add(c);
+    EXPECT_EQ(1, updates);
+
+    // Removing an alarm later than the soonest leaves the registered alarm alone.
+    am.remove(c);
+    EXPECT_EQ(1, updates);
+    // So does removing the soonest one when the next is within the update threshold.
+    am.remove(a);
+    EXPECT_EQ(1, updates);
+    EXPECT_EQ(100u, am.getRegisteredAlarmTimeSec());
+
+    am.add(c);
+    am.remove(b);
+    EXPECT_EQ(2, updates);
+    EXPECT_EQ(500u, am.getRegisteredAlarmTimeSec());
+
+    am.remove(c);
+    EXPECT_EQ(1, cancels);
+    EXPECT_EQ(0u, am.getRegisteredAlarmTimeSec());
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
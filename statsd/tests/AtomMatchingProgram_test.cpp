@@ -0,0 +1,174 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/matchers/AtomMatchingProgram.h"
+
+#include <gtest/gtest.h>
+
+#include "src/metrics/parsing_utils/metrics_manager_util.h"
+#include "tests/statsd_test_util.h"
+
+using namespace testing;
+using std::unordered_map;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int kAtomA = 10;
+const int kAtomB = 11;
+
+AtomMatcher CreateValueMatcher(const string& name, int atomId, int value) {
+    AtomMatcher matcher = CreateSimpleAtomMatcher(name, atomId);
+    FieldValueMatcher* fieldValueMatcher =
+            matcher.mutable_simple_atom_matcher()->add_field_value_matcher();
+    fieldValueMatcher->set_field(1);
+    fieldValueMatcher->set_eq_int(value);
+    return matcher;
+}
+
+AtomMatcher CreateCombinationMatcher(const string& name, LogicalOperation operation,
+                                     const vector<AtomMatcher>& children) {
+    AtomMatcher matcher;
+    matcher.set_id(StringToId(name));
+    matcher.mutable_combination()->set_operation(operation);
+    for (const AtomMatcher& child : children) {
+        addMatcherToMatcherCombination(child, &matcher);
+    }
+    return matcher;
+}
+
+// Checks that the compiled programs produce the same results as the recursive matchers.
+void ExpectSameResults(const StatsdConfig& config, const vector<shared_ptr<LogEvent>>& events) {
+    sp<UidMap> uidMap = new UidMap();
+    unordered_map<int64_t, int> atomMatchingTrackerMap;
+    vector<sp<AtomMatchingTracker>> allAtomMatchingTrackers;
+    unordered_map<int, vector<int>> tagIdsToMatchersMap;
+    ASSERT_EQ(initAtomMatchingTrackers(config, uidMap, atomMatchingTrackerMap,
+                                       allAtomMatchingTrackers, tagIdsToMatchersMap),
+              nullopt);
+
+    for (const shared_ptr<LogEvent>& event : events) {
+        const vector<int>& matcherIndices = tagIdsToMatchersMap[event->GetTagId()];
+        AtomMatchingProgram program(matcherIndices, allAtomMatchingTrackers);
+
+        vector<MatchingState> expected(allAtomMatchingTrackers.size(),
+                                       MatchingState::kNotComputed);
+        for (const int matcherIndex : matcherIndices) {
+            allAtomMatchingTrackers[matcherIndex]->onLogEvent(*event, allAtomMatchingTrackers,
+                                                              expected);
+        }
+        vector<MatchingState> actual(allAtomMatchingTrackers.size(),
+                                     MatchingState::kNotComputed);
+        program.onLogEvent(*event, allAtomMatchingTrackers, actual);
+
+        for (const int matcherIndex : matcherIndices) {
+            EXPECT_EQ(expected[matcherIndex], actual[matcherIndex])
+                    << "matcher " << allAtomMatchingTrackers[matcherIndex]->getId() << " atom "
+                    << event->GetTagId();
+        }
+    }
+}
+
+}  // anonymous namespace
+
+TEST(AtomMatchingProgramTest, TestAllOperations) {
+    StatsdConfig config;
+    AtomMatcher aAny = CreateSimpleAtomMatcher("AAny", kAtomA);
+    AtomMatcher aOne = CreateValueMatcher("AOne", kAtomA, 1);
+    AtomMatcher bAny = CreateSimpleAtomMatcher("BAny", kAtomB);
+    AtomMatcher orMatcher = CreateCombinationMatcher("Or", LogicalOperation::OR, {aOne, bAny});
+    AtomMatcher andMatcher = CreateCombinationMatcher("And", LogicalOperation::AND, {aAny, aOne});
+    AtomMatcher notMatcher = CreateCombinationMatcher("Not", LogicalOperation::NOT, {aOne});
+    AtomMatcher nandMatcher =
+            CreateCombinationMatcher("Nand", LogicalOperation::NAND, {aAny, bAny});
+    AtomMatcher norMatcher = CreateCombinationMatcher("Nor", LogicalOperation::NOR, {aOne, bAny});
+    AtomMatcher notB = CreateCombinationMatcher("NotB", LogicalOperation::NOT, {bAny});
+    AtomMatcher nested =
+            CreateCombinationMatcher("Nested", LogicalOperation::AND, {orMatcher, notMatcher});
+
+    // Parents are added before their children to exercise the topological sort.
+    *config.add_atom_matcher() = nested;
+    *config.add_atom_matcher() = orMatcher;
+    *config.add_atom_matcher() = andMatcher;
+    *config.add_atom_matcher() = notMatcher;
+    *config.add_atom_matcher() = nandMatcher;
+    *config.add_atom_matcher() = norMatcher;
+    *config.add_atom_matcher() = notB;
+    *config.add_atom_matcher() = aAny;
+    *config.add_atom_matcher() = aOne;
+    *config.add_atom_matcher() = bAny;
+
+    ExpectSameResults(config, {CreateTwoValueLogEvent(kAtomA, 1, 1, 0),
+                               CreateTwoValueLogEvent(kAtomA, 2, 2, 0),
+                               CreateTwoValueLogEvent(kAtomB, 3, 1, 0)});
+}
+
+TEST(AtomMatchingProgramTest, TestMoreThanOneWord) {
+    StatsdConfig config;
+    vector<AtomMatcher> children;
+    for (int i = 0; i < 150; i++) {
+        children.push_back(CreateValueMatcher("A" + std::to_string(i), kAtomA, i % 7));
+        *config.add_atom_matcher() = children.back();
+    }
+    *config.add_atom_matcher() = CreateCombinationMatcher("Or", LogicalOperation::OR, children);
+    *config.add_atom_matcher() = CreateCombinationMatcher("And", LogicalOperation::AND, children);
+    *config.add_atom_matcher() =
+            CreateCombinationMatcher("Nor", LogicalOperation::NOR, {children[3], children[130]});
+    *config.add_atom_matcher() = CreateCombinationMatcher(
+            "Nand", LogicalOperation::NAND, {children[0], children[7], children[140]});
+
+    ExpectSameResults(config, {CreateTwoValueLogEvent(kAtomA, 1, 0, 0),
+                               CreateTwoValueLogEvent(kAtomA, 2, 3, 0),
+                               CreateTwoValueLogEvent(kAtomA, 3, 9, 0)});
+}
+
+TEST(AtomMatchingProgramTest, TestTopologicalOrder) {
+    StatsdConfig config;
+    AtomMatcher aAny = CreateSimpleAtomMatcher("AAny", kAtomA);
+    AtomMatcher aOne = CreateValueMatcher("AOne", kAtomA, 1);
+    AtomMatcher inner = CreateCombinationMatcher("Inner", LogicalOperation::OR, {aAny, aOne});
+    AtomMatcher outer = CreateCombinationMatcher("Outer", LogicalOperation::NOT, {inner});
+    *config.add_atom_matcher() = outer;
+    *config.add_atom_matcher() = inner;
+    *config.add_atom_matcher() = aOne;
+    *config.add_atom_matcher() = aAny;
+
+    sp<UidMap> uidMap = new UidMap();
+    unordered_map<int64_t, int> atomMatchingTrackerMap;
+    vector<sp<AtomMatchingTracker>> allAtomMatchingTrackers;
+    unordered_map<int, vector<int>> tagIdsToMatchersMap;
+    ASSERT_EQ(initAtomMatchingTrackers(config, uidMap, atomMatchingTrackerMap,
+                                       allAtomMatchingTrackers, tagIdsToMatchersMap),
+              nullopt);
+    AtomMatchingProgram program(tagIdsToMatchersMap[kAtomA], allAtomMatchingTrackers);
+
+    EXPECT_EQ(program.mSimpleMatchers.size(), 2);
+    ASSERT_EQ(program.mInstructions.size(), 2);
+    EXPECT_EQ(program.mInstructions[0].matcherIndex, atomMatchingTrackerMap[inner.id()]);
+    EXPECT_EQ(program.mInstructions[1].matcherIndex, atomMatchingTrackerMap[outer.id()]);
+    EXPECT_EQ(program.mWordCount, 1);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -183,6 +183,51 @@ TEST(LogEventFilterTest, TestMultipleConsumerEmptyFilter) {
     EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
 }
 
+TEST(LogEventFilterTest, TestHeaderOnlyIds) {
+    LogEventFilter filter;
+    auto filterIds = generateAtomIds(1, kAtomIdsCount);
+    auto headerOnlyIds = generateAtomIds(kAtomIdsCount / 2 + 1, kAtomIdsCount);
+    filter.setAtomIds(filterIds, std::move(headerOnlyIds),
+                      reinterpret_cast<LogEventFilter::ConsumerId>(0));
+    EXPECT_EQ(1, filter.mHeaderOnlyTagIdsPerConsumer.size());
+    const auto sampleIds = generateAtomIds(1, kAtomIdsCount);
+    for (const auto& atomId : sampleIds) {
+        bool const atomInUse = atomId <= kAtomIdsCount / 2;
+        EXPECT_EQ(atomInUse, filter.isAtomInUse(atomId));
+    }
+    EXPECT_EQ(kAtomIdsCount / 2, filter.mLocalTagIds.size());
+    EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
+
+    // clear header only ids
+    LogEventFilter::AtomIdSet emptyAtomIdsSet;
+    filter.setAtomIds(std::move(filterIds), emptyAtomIdsSet,
+                      reinterpret_cast<LogEventFilter::ConsumerId>(0));
+    EXPECT_EQ(0, filter.mHeaderOnlyTagIdsPerConsumer.size());
+    for (const auto& atomId : sampleIds) {
+        EXPECT_TRUE(filter.isAtomInUse(atomId));
+    }
+    EXPECT_EQ(kAtomIdsCount, filter.mLocalTagIds.size());
+}
+
+TEST(LogEventFilterTest, TestMultipleConsumerHeaderOnlyIds) {
+    LogEventFilter filter;
+    auto filterIds1 = generateAtomIds(1, kAtomIdsCount);
+    auto headerOnlyIds1 = generateAtomIds(1, kAtomIdsCount);
+    auto filterIds2 = generateAtomIds(kAtomIdsCount / 2 + 1, kAtomIdsCount);
+    filter.setAtomIds(std::move(filterIds1), std::move(headerOnlyIds1),
+                      reinterpret_cast<LogEventFilter::ConsumerId>(0));
+    filter.setAtomIds(std::move(filterIds2), reinterpret_cast<LogEventFilter::ConsumerId>(1));
+
+    // the second consumer reads the body of the upper half of the atoms
+    const auto sampleIds = generateAtomIds(1, kAtomIdsCount);
+    for (const auto& atomId : sampleIds) {
+        bool const atomInUse = atomId > kAtomIdsCount / 2;
+        EXPECT_EQ(atomInUse, filter.isAtomInUse(atomId));
+    }
+    EXPECT_EQ(kAtomIdsCount / 2, filter.mLocalTagIds.size());
+    EXPECT_TRUE(testGuaranteedUnusedAtomsNotInUse(filter));
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -319,6 +319,79 @@ INSTANTIATE_TEST_SUITE_P(
             return info.param.label;
         });
 
+TEST(MetricsManagerTest, TestHeaderCountableTagIds) {
+    sp<UidMap> uidMap = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");
+    const AtomMatcher countedMatcher = CreateSimpleAtomMatcher("Counted", 10);
+    const AtomMatcher slicedMatcher = CreateSimpleAtomMatcher("Sliced", 11);
+    AtomMatcher fieldMatcher = CreateSimpleAtomMatcher("Field", 12);
+    FieldValueMatcher* fieldValueMatcher =
+            fieldMatcher.mutable_simple_atom_matcher()->add_field_value_matcher();
+    fieldValueMatcher->set_field(1);
+    fieldValueMatcher->set_eq_int(1);
+    const AtomMatcher conditionMatcher = CreateSimpleAtomMatcher("Condition", 13);
+    *config.add_atom_matcher() = countedMatcher;
+    *config.add_atom_matcher() = slicedMatcher;
+    *config.add_atom_matcher() = fieldMatcher;
+    *config.add_atom_matcher() = conditionMatcher;
+
+    Predicate predicate;
+    predicate.set_id(StringToId("Predicate"));
+    predicate.mutable_simple_predicate()->set_start(conditionMatcher.id());
+    *config.add_predicate() = predicate;
+
+    for (const AtomMatcher& matcher : {countedMatcher, slicedMatcher, fieldMatcher,
+                                       conditionMatcher}) {
+        CountMetric* metric = config.add_count_metric();
+        metric->set_id(matcher.id());
+        metric->set_what(matcher.id());
+        metric->set_bucket(FIVE_MINUTES);
+    }
+    *config.mutable_count_metric(1)->mutable_dimensions_in_what() = CreateDimensions(11, {1});
+
+    MetricsManager metricsManager(kConfigKey, config, timeBaseSec, timeBaseSec, uidMap,
+                                  pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor);
+    ASSERT_TRUE(metricsManager.isConfigValid());
+
+    EXPECT_THAT(metricsManager.mHeaderCountableTagIds, UnorderedElementsAre(10));
+    LogEventFilter::AtomIdSet bodyAtomIds;
+    metricsManager.addBodyAtomIds(bodyAtomIds);
+    EXPECT_THAT(bodyAtomIds, UnorderedElementsAre(11, 12, 13));
+
+    // Events parsed up to their header are counted.
+    for (int64_t timestampNs : {timeBaseSec + 10, timeBaseSec + 20}) {
+        AStatsEvent* statsEvent = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(statsEvent, 10);
+        AStatsEvent_overwriteTimestamp(statsEvent, timestampNs);
+        AStatsEvent_writeInt32(statsEvent, 1);
+        AStatsEvent_build(statsEvent);
+        size_t size;
+        const uint8_t* buf = AStatsEvent_getBuffer(statsEvent, &size);
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        event.parseHeader(buf, size);
+        AStatsEvent_release(statsEvent);
+        ASSERT_TRUE(event.isParsedHeaderOnly());
+        metricsManager.onLogEvent(event);
+    }
+
+    const sp<MetricProducer>& producer =
+            metricsManager.mAllMetricProducers[metricsManager.mMetricProducerMap.at(
+                    countedMatcher.id())];
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    producer->onDumpReport(timeBaseSec + 30, /*include_current_partial_bucket=*/true,
+                           /*erase_data=*/true, FAST, &strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(1, report.count_metrics().data_size());
+    ASSERT_EQ(1, report.count_metrics().data(0).bucket_info_size());
+    EXPECT_EQ(2, report.count_metrics().data(0).bucket_info(0).count());
+}
+
 TEST(MetricsManagerTest, TestCheckLogCredentialsWhitelistedAtom) {
     sp<UidMap> uidMap;
     sp<StatsPullerManager> pullerManager = new StatsPullerManager();
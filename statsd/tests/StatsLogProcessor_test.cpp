@@ -14,6 +14,7 @@
 
 #include "StatsLogProcessor.h"
 
+#include <android-base/file.h>
 #include <android-base/stringprintf.h>
 #include <android-modules-utils/sdk_level.h>
 #include <gmock/gmock.h>
@@ -73,11 +74,10 @@ public:
 
     MOCK_METHOD(void, onLogEvent, (const LogEvent& event), (override));
 
-    MOCK_METHOD(void, onDumpReport,
+    MOCK_METHOD(DumpReportWriter, prepareDumpReport,
                 (const int64_t dumpTimeNs, const int64_t wallClockNs,
                  const bool include_current_partial_bucket, const bool erase_data,
-                 const DumpLatency dumpLatency, std::set<string>* str_set,
-                 android::util::ProtoOutputStream* protoOutput),
+                 const DumpLatency dumpLatency),
                 (override));
 };
 
@@ -211,11 +211,10 @@ public:
     }
 
     MOCK_METHOD(void, onLogEvent, (const LogEvent& event), (override));
-    MOCK_METHOD(void, onDumpReport,
+    MOCK_METHOD(DumpReportWriter, prepareDumpReport,
                 (const int64_t dumpTimeNs, const int64_t wallClockNs,
                  const bool include_current_partial_bucket, const bool erase_data,
-                 const DumpLatency dumpLatency, std::set<string>* str_set,
-                 android::util::ProtoOutputStream* protoOutput),
+                 const DumpLatency dumpLatency),
                 (override));
     MOCK_METHOD(size_t, byteSize, (), (override));
     MOCK_METHOD(void, flushRestrictedData, (), (override));
@@ -2148,6 +2147,79 @@ TEST(StatsLogProcessorTest, TestDumpReportWithoutErasingDataDoesNotUpdateTimesta
     EXPECT_EQ(output.reports(0).last_report_elapsed_nanos(), dumpTime1Ns);
 }
 
+TEST(StatsLogProcessorTest, TestOnDumpReportToFd) {
+    ConfigKey key(3, 5);
+    // This removes any reports that were present.
+    ProtoOutputStream proto;
+    StorageManager::appendConfigMetricsReport(key, &proto, /*erase data=*/true, /*isAdb=*/false);
+
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, MakeConfig(true), key);
+    processor->WriteDataToDiskLocked(key, /*timestampNs=*/NS_PER_SEC, /*wallClockNs=*/NS_PER_SEC,
+                                     ADB_DUMP, FAST);
+
+    vector<uint8_t> bytes;
+    processor->onDumpReport(key, /*dumpTimeStampNs=*/2 * NS_PER_SEC,
+                            /*wallClockNs=*/2 * NS_PER_SEC, /*include_current_bucket=*/false,
+                            /*erase_data=*/false, ADB_DUMP, FAST, &bytes);
+
+    // The saved report is copied from its file, the other parts are the same as in the buffer.
+    TemporaryFile file;
+    processor->onDumpReport(key, /*dumpTimeStampNs=*/2 * NS_PER_SEC,
+                            /*wallClockNs=*/2 * NS_PER_SEC, /*include_current_bucket=*/false,
+                            /*erase_data=*/true, ADB_DUMP, FAST, file.fd);
+    string content;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &content));
+    EXPECT_EQ(content, string(bytes.begin(), bytes.end()));
+
+    ConfigMetricsReportList output;
+    ASSERT_TRUE(output.ParseFromString(content));
+    EXPECT_EQ(output.config_key().uid(), 3);
+    EXPECT_EQ(output.config_key().id(), 5);
+    ASSERT_EQ(output.reports_size(), 2);
+    EXPECT_EQ(output.reports(0).current_report_elapsed_nanos(), NS_PER_SEC);
+    EXPECT_EQ(output.reports(1).current_report_elapsed_nanos(), 2 * NS_PER_SEC);
+
+    // The saved report was erased.
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(key));
+}
+
+TEST(StatsLogProcessorTest, TestOnDumpReportSkipsUnreadableSavedReport) {
+    ConfigKey key(3, 5);
+    // This removes any reports that were present.
+    ProtoOutputStream proto;
+    StorageManager::appendConfigMetricsReport(key, &proto, /*erase data=*/true, /*isAdb=*/false);
+
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, MakeConfig(true), key);
+    processor->WriteDataToDiskLocked(key, /*timestampNs=*/NS_PER_SEC, /*wallClockNs=*/NS_PER_SEC,
+                                     ADB_DUMP, FAST);
+    // A saved report that can be opened and stat'ed, but not read.
+    const string unreadableReport = StorageManager::getDataFileName(/*wallClockSec=*/2, 3, 5);
+    ASSERT_EQ(symlink(STATS_DATA_DIR, unreadableReport.c_str()), 0);
+
+    TemporaryFile file;
+    processor->onDumpReport(key, /*dumpTimeStampNs=*/2 * NS_PER_SEC,
+                            /*wallClockNs=*/2 * NS_PER_SEC, /*include_current_bucket=*/false,
+                            /*erase_data=*/false, ADB_DUMP, FAST, file.fd);
+    string content;
+    ASSERT_TRUE(android::base::ReadFileToString(file.path, &content));
+    ConfigMetricsReportList output;
+    ASSERT_TRUE(output.ParseFromString(content));
+    ASSERT_EQ(output.reports_size(), 2);
+    EXPECT_EQ(output.reports(0).current_report_elapsed_nanos(), NS_PER_SEC);
+    EXPECT_EQ(output.reports(1).current_report_elapsed_nanos(), 2 * NS_PER_SEC);
+
+    // The other reports are kept when the data is erased.
+    vector<uint8_t> bytes;
+    processor->onDumpReport(key, /*dumpTimeStampNs=*/3 * NS_PER_SEC,
+                            /*wallClockNs=*/3 * NS_PER_SEC, /*include_current_bucket=*/false,
+                            /*erase_data=*/true, ADB_DUMP, FAST, &bytes);
+    ASSERT_TRUE(output.ParseFromArray(bytes.data(), bytes.size()));
+    ASSERT_EQ(output.reports_size(), 2);
+    EXPECT_EQ(output.reports(0).current_report_elapsed_nanos(), NS_PER_SEC);
+    EXPECT_EQ(output.reports(1).current_report_elapsed_nanos(), 3 * NS_PER_SEC);
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(key));
+}
+
 class StatsLogProcessorTestRestricted : public Test {
 protected:
     const ConfigKey mConfigKey = ConfigKey(1, 12345);
@@ -2240,7 +2312,7 @@ TEST_F(StatsLogProcessorTestRestricted, RestrictedMetricsManagerOnDumpReportNotC
             /*timeBaseNs=*/1, /*currentTimeNs=*/1, makeRestrictedConfig(/*includeMetric=*/true),
             mConfigKey);
     sp<MockRestrictedMetricsManager> metricsManager = new MockRestrictedMetricsManager(mConfigKey);
-    EXPECT_CALL(*metricsManager, onDumpReport).Times(0);
+    EXPECT_CALL(*metricsManager, prepareDumpReport).Times(0);
 
     processor->mMetricsManagers[mConfigKey] = metricsManager;
     EXPECT_TRUE(processor->mMetricsManagers[mConfigKey]->hasRestrictedMetricsDelegate());
@@ -2288,7 +2360,9 @@ TEST_F(StatsLogProcessorTestRestricted, NonRestrictedMetricsManagerOnDumpReportC
     sp<StatsLogProcessor> processor = CreateStatsLogProcessor(
             /*timeBaseNs=*/1, /*currentTimeNs=*/1, MakeConfig(/*includeMetric=*/true), mConfigKey);
     sp<MockMetricsManager> metricsManager = new MockMetricsManager(mConfigKey);
-    EXPECT_CALL(*metricsManager, onDumpReport).Times(1);
+    EXPECT_CALL(*metricsManager, prepareDumpReport)
+            .Times(1)
+            .WillOnce(Return(DumpReportWriter([](std::set<string>*, ProtoOutputStream*) {})));
 
     processor->mMetricsManagers[mConfigKey] = metricsManager;
     EXPECT_FALSE(processor->mMetricsManagers[mConfigKey]->hasRestrictedMetricsDelegate());
@@ -0,0 +1,137 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/anomaly/AlarmTimerWheel.h"
+
+#include <gtest/gtest.h>
+
+#include "src/anomaly/AlarmMonitor.h"
+
+using std::unordered_set;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+using AlarmSet = unordered_set<sp<const InternalAlarm>, SpHash<InternalAlarm>>;
+
+AlarmSet popSoonerThan(AlarmTimerWheel& wheel, uint32_t timestampSec) {
+    AlarmSet alarms;
+    wheel.popSoonerThan(timestampSec, &alarms);
+    return alarms;
+}
+
+}  // anonymous namespace
+
+TEST(AlarmTimerWheelTest, TestAddRemove) {
+    AlarmTimerWheel wheel;
+    sp<const InternalAlarm> a = new InternalAlarm{10};
+    sp<const InternalAlarm> b = new InternalAlarm{10};
+    sp<const InternalAlarm> c = new InternalAlarm{500};
+
+    EXPECT_EQ(wheel.soonestTimestampSec(), 0u);
+    EXPECT_TRUE(wheel.add(a));
+    EXPECT_FALSE(wheel.add(a));
+    EXPECT_TRUE(wheel.add(b));
+    EXPECT_TRUE(wheel.add(c));
+    EXPECT_EQ(wheel.size(), 3u);
+    EXPECT_EQ(wheel.soonestTimestampSec(), 10u);
+
+    // An alarm can only be in one wheel.
+    AlarmTimerWheel otherWheel;
+    EXPECT_FALSE(otherWheel.add(a));
+    EXPECT_FALSE(otherWheel.remove(a));
+
+    EXPECT_TRUE(wheel.remove(a));
+    EXPECT_FALSE(wheel.remove(a));
+    EXPECT_EQ(wheel.soonestTimestampSec(), 10u);
+    EXPECT_TRUE(wheel.remove(b));
+    EXPECT_EQ(wheel.soonestTimestampSec(), 500u);
+
+    // A removed alarm can be added again.
+    EXPECT_TRUE(otherWheel.add(a));
+    EXPECT_EQ(otherWheel.size(), 1u);
+    EXPECT_EQ(wheel.size(), 1u);
+}
+
+TEST(AlarmTimerWheelTest, TestCascade) {
+    AlarmTimerWheel wheel;
+    const uint32_t nowSec = 1700000000;
+    sp<const InternalAlarm> a = new InternalAlarm{nowSec};
+    sp<const InternalAlarm> b = new InternalAlarm{nowSec + 100};
+    sp<const InternalAlarm> c = new InternalAlarm{nowSec + 100000};
+    sp<const InternalAlarm> d = new InternalAlarm{nowSec + 100001};
+    wheel.add(d);
+    wheel.add(c);
+    wheel.add(b);
+    wheel.add(a);
+
+    EXPECT_TRUE(popSoonerThan(wheel, nowSec - 1).empty());
+    EXPECT_EQ(wheel.size(), 4u);
+
+    AlarmSet alarms = popSoonerThan(wheel, nowSec);
+    ASSERT_EQ(alarms.size(), 1u);
+    EXPECT_EQ(alarms.count(a), 1u);
+    EXPECT_EQ(wheel.mNowSec, nowSec);
+    EXPECT_EQ(wheel.soonestTimestampSec(), nowSec + 100);
+
+    alarms = popSoonerThan(wheel, nowSec + 100000);
+    ASSERT_EQ(alarms.size(), 2u);
+    EXPECT_EQ(alarms.count(b), 1u);
+    EXPECT_EQ(alarms.count(c), 1u);
+    EXPECT_EQ(wheel.soonestTimestampSec(), nowSec + 100001);
+    // d now sits in level 0, next to where c was.
+    EXPECT_EQ(d->wheelSlot / AlarmTimerWheel::kSlotsPerLevel, 0);
+
+    alarms = popSoonerThan(wheel, UINT32_MAX);
+    ASSERT_EQ(alarms.size(), 1u);
+    EXPECT_EQ(alarms.count(d), 1u);
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(wheel.soonestTimestampSec(), 0u);
+}
+
+TEST(AlarmTimerWheelTest, TestAlarmsAddedInThePast) {
+    AlarmTimerWheel wheel;
+    sp<const InternalAlarm> a = new InternalAlarm{1000};
+    wheel.add(a);
+    ASSERT_EQ(popSoonerThan(wheel, 1000).size(), 1u);
+
+    sp<const InternalAlarm> b = new InternalAlarm{900};
+    sp<const InternalAlarm> c = new InternalAlarm{950};
+    sp<const InternalAlarm> d = new InternalAlarm{1000};
+    wheel.add(b);
+    wheel.add(c);
+    wheel.add(d);
+    EXPECT_EQ(wheel.soonestTimestampSec(), 900u);
+
+    AlarmSet alarms = popSoonerThan(wheel, 920);
+    ASSERT_EQ(alarms.size(), 1u);
+    EXPECT_EQ(alarms.count(b), 1u);
+
+    alarms = popSoonerThan(wheel, 1000);
+    ASSERT_EQ(alarms.size(), 2u);
+    EXPECT_EQ(alarms.count(c), 1u);
+    EXPECT_EQ(alarms.count(d), 1u);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -0,0 +1,151 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/anomaly/StatisticalAnomalyTracker.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "tests/statsd_test_util.h"
+
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const ConfigKey kConfigKey(0, 12345);
+
+Alert createAlert(Alert::Detector::Type type, int32_t numBuckets, double triggerIfGt) {
+    Alert alert;
+    alert.set_id(1);
+    alert.set_metric_id(2);
+    alert.set_num_buckets(numBuckets);
+    // Each declared anomaly starts a refractory period, which is what the tests look at.
+    alert.set_refractory_period_secs(1000);
+    alert.mutable_detector()->set_type(type);
+    alert.mutable_detector()->set_trigger_if_gt(triggerIfGt);
+    return alert;
+}
+
+MetricDimensionKey getKey(int value) {
+    int pos[] = {1, 0, 0};
+    HashableDimensionKey dim;
+    dim.addValue(FieldValue(Field(1, pos, 0), Value(value)));
+    return MetricDimensionKey(dim, DEFAULT_DIMENSION_KEY);
+}
+
+// Adds the values as consecutive buckets starting at firstBucketNum. Returns the index of the
+// first value that caused an anomaly, or -1.
+int addBuckets(AnomalyTracker& tracker, const MetricDimensionKey& key, int64_t firstBucketNum,
+               const vector<int64_t>& values) {
+    for (size_t i = 0; i < values.size(); i++) {
+        tracker.addPastBucket(key, values[i], firstBucketNum + i);
+        if (tracker.getRefractoryPeriodEndsSec(key) != 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+}  // anonymous namespace
+
+TEST(StatisticalAnomalyTrackerTest, TestIsValidDetector) {
+    Alert alert = createAlert(Alert::Detector::EWMA_DEVIATION, 3, 3);
+    EXPECT_FALSE(StatisticalAnomalyTracker::isValidDetector(alert));
+    alert.mutable_detector()->set_ewma_alpha(0.5);
+    EXPECT_TRUE(StatisticalAnomalyTracker::isValidDetector(alert));
+    alert.set_trigger_if_sum_gt(10);
+    EXPECT_FALSE(StatisticalAnomalyTracker::isValidDetector(alert));
+
+    alert = createAlert(Alert::Detector::Z_SCORE, 2, 3);
+    EXPECT_FALSE(StatisticalAnomalyTracker::isValidDetector(alert));
+    alert.set_num_buckets(3);
+    EXPECT_TRUE(StatisticalAnomalyTracker::isValidDetector(alert));
+
+    alert = createAlert(Alert::Detector::RATE_OF_CHANGE, 1, 0);
+    EXPECT_FALSE(StatisticalAnomalyTracker::isValidDetector(alert));
+    alert.mutable_detector()->set_trigger_if_gt(0.5);
+    EXPECT_TRUE(StatisticalAnomalyTracker::isValidDetector(alert));
+
+    alert.mutable_detector()->clear_type();
+    EXPECT_FALSE(StatisticalAnomalyTracker::isValidDetector(alert));
+}
+
+TEST(StatisticalAnomalyTrackerTest, TestEwmaDeviation) {
+    Alert alert = createAlert(Alert::Detector::EWMA_DEVIATION, 3, 3);
+    alert.mutable_detector()->set_ewma_alpha(0.5);
+    StatisticalAnomalyTracker tracker(alert, kConfigKey);
+
+    // The first 3 buckets only train the average, however far off they are.
+    EXPECT_EQ(addBuckets(tracker, getKey(1), 0, {10, 12, 100, 12, 10}), -1);
+
+    StatisticalAnomalyTracker tracker2(alert, kConfigKey);
+    EXPECT_EQ(addBuckets(tracker2, getKey(1), 0, {10, 12, 10, 12, 10, 100}), 5);
+    // Another dimension has its own average.
+    EXPECT_EQ(addBuckets(tracker2, getKey(2), 6, {100, 100, 100, 90}), -1);
+}
+
+TEST(StatisticalAnomalyTrackerTest, TestZScore) {
+    StatisticalAnomalyTracker tracker(createAlert(Alert::Detector::Z_SCORE, 4, 3), kConfigKey);
+
+    // Compared to the 3 buckets before: 13 is within 3 standard deviations, 40 is not.
+    EXPECT_EQ(addBuckets(tracker, getKey(1), 0, {10, 12, 14, 13, 40}), 4);
+
+    // Buckets without a value count as 0.
+    StatisticalAnomalyTracker tracker2(createAlert(Alert::Detector::Z_SCORE, 4, 0.5), kConfigKey);
+    tracker2.addPastBucket(getKey(1), 10, 0);
+    tracker2.addPastBucket(getKey(1), 10, 2);
+    EXPECT_EQ(tracker2.getRefractoryPeriodEndsSec(getKey(1)), 0u);
+    tracker2.addPastBucket(getKey(1), 10, 3);
+    EXPECT_NE(tracker2.getRefractoryPeriodEndsSec(getKey(1)), 0u);
+}
+
+TEST(StatisticalAnomalyTrackerTest, TestRateOfChange) {
+    StatisticalAnomalyTracker tracker(createAlert(Alert::Detector::RATE_OF_CHANGE, 1, 1),
+                                      kConfigKey);
+    EXPECT_EQ(addBuckets(tracker, getKey(1), 0, {10, 15, 5, 40}), 3);
+
+    // The bucket after a bucket without a value is not evaluated.
+    StatisticalAnomalyTracker tracker2(createAlert(Alert::Detector::RATE_OF_CHANGE, 1, 1),
+                                       kConfigKey);
+    tracker2.addPastBucket(getKey(1), 10, 0);
+    tracker2.addPastBucket(getKey(1), 100, 2);
+    EXPECT_EQ(tracker2.getRefractoryPeriodEndsSec(getKey(1)), 0u);
+}
+
+TEST(StatisticalAnomalyTrackerTest, TestIdleDimensionsAreDropped) {
+    StatisticalAnomalyTracker tracker(createAlert(Alert::Detector::RATE_OF_CHANGE, 1, 1),
+                                      kConfigKey);
+    tracker.addPastBucket(getKey(1), 10, 0);
+    tracker.addPastBucket(getKey(2), 10, 0);
+    tracker.addPastBucket(getKey(1), 10, 1);
+    EXPECT_EQ(tracker.mStates.size(), 2u);
+
+    tracker.addPastBucket(getKey(1), 10, StatisticalAnomalyTracker::kMaxIdleBuckets + 1);
+    EXPECT_EQ(tracker.mStates.size(), 1u);
+    EXPECT_EQ(tracker.mStates.count(getKey(1)), 1u);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
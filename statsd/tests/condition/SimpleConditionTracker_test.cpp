@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "src/condition/SimpleConditionTracker.h"
+#include "src/condition/ConditionWizard.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -800,6 +801,224 @@ TEST(SimpleConditionTrackerTest, TestGuardrailHitWhenDefaultUnknown) {
               conditionTracker.mSlicedConditionState.size());
     EXPECT_EQ(conditionCache[0], ConditionState::kUnknown);
 }
+
+TEST_P(SimpleConditionTrackerTest, TestPartialLinkIndex) {
+    // Predicate sliced by (first uid, wakelock tag), queried through a link on the uid only.
+    SimplePredicate simplePredicate =
+            getWakeLockHeldCondition(true /*nesting*/, GetParam() /*initialValue*/,
+                                     true /*output slice by uid*/, Position::FIRST);
+    simplePredicate.mutable_dimensions()->add_child()->set_field(2);
+    string conditionName = "WL_HELD_BY_UID_AND_TAG";
+
+    unordered_map<int64_t, int> trackerNameIndexMap;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_ACQUIRE")] = 0;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_RELEASE")] = 1;
+    trackerNameIndexMap[StringToId("RELEASE_ALL")] = 2;
+
+    SimpleConditionTracker indexedTracker(kConfigKey, StringToId(conditionName), protoHash,
+                                          0 /*condition tracker index*/, simplePredicate,
+                                          trackerNameIndexMap);
+    SimpleConditionTracker scanningTracker(kConfigKey, StringToId(conditionName), protoHash,
+                                           0 /*condition tracker index*/, simplePredicate,
+                                           trackerNameIndexMap);
+
+    FieldMatcher linkFields;
+    linkFields.set_field(TAG_ID);
+    linkFields.add_child()->set_field(ATTRIBUTION_NODE_FIELD_ID);
+    linkFields.mutable_child(0)->set_position(Position::FIRST);
+    linkFields.mutable_child(0)->add_child()->set_field(ATTRIBUTION_UID_FIELD_ID);
+    vector<Matcher> linkMatchers;
+    translateFieldMatcher(linkFields, &linkMatchers);
+    indexedTracker.addLinkedDimensions(linkMatchers);
+    ASSERT_EQ(1UL, indexedTracker.mLinkIndices.size());
+
+    // Links on every output dimension are not indexed.
+    vector<Matcher> fullLinkMatchers;
+    translateFieldMatcher(simplePredicate.dimensions(), &fullLinkMatchers);
+    indexedTracker.addLinkedDimensions(fullLinkMatchers);
+    ASSERT_EQ(1UL, indexedTracker.mLinkIndices.size());
+
+    vector<sp<ConditionTracker>> allPredicates;
+    auto process = [&](const vector<int>& uids, const string& tag, int acquire) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeWakeLockEvent(&event, uids, tag, acquire);
+        vector<MatchingState> matcherState(3, MatchingState::kNotMatched);
+        matcherState[acquire ? 0 : 1] = MatchingState::kMatched;
+        for (SimpleConditionTracker* tracker : {&indexedTracker, &scanningTracker}) {
+            vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+            vector<bool> changedCache(1, false);
+            tracker->evaluateCondition(event, matcherState, allPredicates, conditionCache,
+                                       changedCache);
+        }
+    };
+    auto expectQuery = [&](int uid, ConditionState expected) {
+        const auto queryKey = getWakeLockQueryKey(Position::FIRST, {uid}, conditionName);
+        vector<ConditionState> indexedCache(1, ConditionState::kNotEvaluated);
+        indexedTracker.isConditionMet(queryKey, allPredicates, true /*isPartialLink*/,
+                                      indexedCache);
+        vector<ConditionState> scanningCache(1, ConditionState::kNotEvaluated);
+        scanningTracker.isConditionMet(queryKey, allPredicates, true /*isPartialLink*/,
+                                       scanningCache);
+        EXPECT_EQ(expected, indexedCache[0]);
+        EXPECT_EQ(scanningCache[0], indexedCache[0]);
+    };
+    const ConditionState unseen = GetParam() == SimplePredicate_InitialValue_FALSE
+                                            ? ConditionState::kFalse
+                                            : ConditionState::kUnknown;
+
+    process({111, 222}, "wl1", /*acquire=*/1);
+    process({111}, "wl2", /*acquire=*/1);
+    process({333}, "wl1", /*acquire=*/1);
+    expectQuery(111, ConditionState::kTrue);
+    expectQuery(333, ConditionState::kTrue);
+    expectQuery(222, unseen);
+
+    // uid 111 still holds wl2.
+    process({111}, "wl1", /*acquire=*/0);
+    expectQuery(111, ConditionState::kTrue);
+
+    process({111}, "wl2", /*acquire=*/0);
+    expectQuery(111, ConditionState::kFalse);
+    expectQuery(333, ConditionState::kTrue);
+
+    // Indices registered after the tracker holds state are backfilled.
+    SimpleConditionTracker lateTracker(kConfigKey, StringToId(conditionName), protoHash,
+                                       0 /*condition tracker index*/, simplePredicate,
+                                       trackerNameIndexMap);
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    makeWakeLockEvent(&event, {444}, "wl1", /*acquire=*/1);
+    vector<MatchingState> matcherState = {MatchingState::kMatched, MatchingState::kNotMatched,
+                                          MatchingState::kNotMatched};
+    vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+    vector<bool> changedCache(1, false);
+    lateTracker.evaluateCondition(event, matcherState, allPredicates, conditionCache,
+                                  changedCache);
+    lateTracker.addLinkedDimensions(linkMatchers);
+    ASSERT_EQ(1UL, lateTracker.mLinkIndices[0].slices.size());
+    conditionCache[0] = ConditionState::kNotEvaluated;
+    lateTracker.isConditionMet(getWakeLockQueryKey(Position::FIRST, {444}, conditionName),
+                               allPredicates, true /*isPartialLink*/, conditionCache);
+    EXPECT_EQ(ConditionState::kTrue, conditionCache[0]);
+
+    // Stop all empties the index.
+    matcherState = {MatchingState::kNotMatched, MatchingState::kNotMatched,
+                    MatchingState::kMatched};
+    conditionCache[0] = ConditionState::kNotEvaluated;
+    indexedTracker.evaluateCondition(event, matcherState, allPredicates, conditionCache,
+                                     changedCache);
+    EXPECT_TRUE(indexedTracker.mLinkIndices[0].slices.empty());
+}
+
+TEST_P(SimpleConditionTrackerTest, TestQueryCache) {
+    SimplePredicate simplePredicate =
+            getWakeLockHeldCondition(true /*nesting*/, GetParam() /*initialValue*/,
+                                     true /*output slice by uid*/, Position::FIRST);
+    string conditionName = "WL_HELD_BY_UID";
+
+    unordered_map<int64_t, int> trackerNameIndexMap;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_ACQUIRE")] = 0;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_RELEASE")] = 1;
+    trackerNameIndexMap[StringToId("RELEASE_ALL")] = 2;
+
+    sp<SimpleConditionTracker> tracker = new SimpleConditionTracker(
+            kConfigKey, StringToId(conditionName), protoHash, 0 /*condition tracker index*/,
+            simplePredicate, trackerNameIndexMap);
+    vector<sp<ConditionTracker>> allPredicates = {tracker};
+    sp<ConditionWizard> wizard = new ConditionWizard(allPredicates);
+
+    auto process = [&](int uid, int acquire) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeWakeLockEvent(&event, {uid}, "wl", acquire);
+        vector<MatchingState> matcherState(3, MatchingState::kNotMatched);
+        matcherState[acquire ? 0 : 1] = MatchingState::kMatched;
+        vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+        vector<bool> changedCache(1, false);
+        tracker->evaluateCondition(event, matcherState, allPredicates, conditionCache,
+                                   changedCache);
+    };
+    const auto uid111 = getWakeLockQueryKey(Position::FIRST, {111}, conditionName);
+    const auto uid222 = getWakeLockQueryKey(Position::FIRST, {222}, conditionName);
+
+    // Queries outside of the cache scope are not counted.
+    process(111, /*acquire=*/1);
+    EXPECT_EQ(ConditionState::kTrue, wizard->query(0, uid111, false /*isPartialLink*/));
+    EXPECT_EQ(std::make_pair(int64_t(0), int64_t(0)), wizard->endQueryCache());
+
+    wizard->beginQueryCache();
+    EXPECT_EQ(ConditionState::kTrue, wizard->query(0, uid111, false /*isPartialLink*/));
+    EXPECT_EQ(ConditionState::kTrue, wizard->query(0, uid111, false /*isPartialLink*/));
+    EXPECT_EQ(ConditionState::kTrue, wizard->query(0, uid111, true /*isPartialLink*/));
+    EXPECT_NE(ConditionState::kTrue, wizard->query(0, uid222, false /*isPartialLink*/));
+    EXPECT_EQ(3UL, wizard->mQueryCache.size());
+    EXPECT_EQ(std::make_pair(int64_t(1), int64_t(3)), wizard->endQueryCache());
+    EXPECT_TRUE(wizard->mQueryCache.empty());
+
+    // The next event sees the new condition state.
+    process(111, /*acquire=*/0);
+    wizard->beginQueryCache();
+    EXPECT_EQ(ConditionState::kFalse, wizard->query(0, uid111, false /*isPartialLink*/));
+    EXPECT_EQ(ConditionState::kFalse, wizard->query(0, uid111, false /*isPartialLink*/));
+    EXPECT_EQ(std::make_pair(int64_t(1), int64_t(1)), wizard->endQueryCache());
+}
+
+TEST_P(SimpleConditionTrackerTest, TestQueryAll) {
+    SimplePredicate simplePredicate =
+            getWakeLockHeldCondition(true /*nesting*/, GetParam() /*initialValue*/,
+                                     true /*output slice by uid*/, Position::FIRST);
+    string conditionName = "WL_HELD_BY_UID";
+
+    unordered_map<int64_t, int> trackerNameIndexMap;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_ACQUIRE")] = 0;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_RELEASE")] = 1;
+    trackerNameIndexMap[StringToId("RELEASE_ALL")] = 2;
+
+    sp<SimpleConditionTracker> tracker = new SimpleConditionTracker(
+            kConfigKey, StringToId(conditionName), protoHash, 0 /*condition tracker index*/,
+            simplePredicate, trackerNameIndexMap);
+    vector<sp<ConditionTracker>> allPredicates = {tracker};
+    sp<ConditionWizard> wizard = new ConditionWizard(allPredicates);
+
+    auto process = [&](int uid, int acquire) {
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        makeWakeLockEvent(&event, {uid}, "wl", acquire);
+        vector<MatchingState> matcherState(3, MatchingState::kNotMatched);
+        matcherState[acquire ? 0 : 1] = MatchingState::kMatched;
+        vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+        vector<bool> changedCache(1, false);
+        tracker->evaluateCondition(event, matcherState, allPredicates, conditionCache,
+                                   changedCache);
+    };
+    process(111, /*acquire=*/1);
+    process(222, /*acquire=*/1);
+    process(222, /*acquire=*/0);
+
+    const ConditionKey uid111 = getWakeLockQueryKey(Position::FIRST, {111}, conditionName);
+    const ConditionKey uid222 = getWakeLockQueryKey(Position::FIRST, {222}, conditionName);
+    const ConditionKey uid333 = getWakeLockQueryKey(Position::FIRST, {333}, conditionName);
+    const ConditionKey noLink;
+    const vector<const ConditionKey*> keys = {&uid111, &uid222, &uid333, &noLink};
+
+    // The results match a query per key, with and without the query cache.
+    for (const bool isPartialLink : {false, true}) {
+        for (const bool cached : {false, true}) {
+            if (cached) {
+                wizard->beginQueryCache();
+            }
+            vector<ConditionState> states;
+            wizard->queryAll(0, keys, isPartialLink, &states);
+            ASSERT_EQ(keys.size(), states.size());
+            for (size_t i = 0; i < keys.size(); i++) {
+                EXPECT_EQ(wizard->query(0, *keys[i], isPartialLink), states[i])
+                        << "key " << i << " isPartialLink " << isPartialLink;
+            }
+            EXPECT_EQ(ConditionState::kTrue, states[0]);
+            EXPECT_NE(ConditionState::kTrue, states[1]);
+            EXPECT_NE(ConditionState::kTrue, states[2]);
+            wizard->endQueryCache();
+        }
+    }
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -0,0 +1,250 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/external/StatsDeltaCallbackPuller.h"
+
+#include <aidl/android/os/BnDeltaPullAtomCallback.h>
+#include <aidl/android/os/IPullAtomResultReceiver.h>
+#include <aidl/android/util/StatsEventParcel.h>
+#include <android/binder_interface_utils.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <map>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "src/stats_log_util.h"
+#include "stats_event.h"
+#include "tests/statsd_test_util.h"
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using Status = ::ndk::ScopedAStatus;
+using aidl::android::os::BnDeltaPullAtomCallback;
+using aidl::android::os::IPullAtomResultReceiver;
+using aidl::android::util::StatsEventParcel;
+using ::ndk::SharedRefBase;
+using std::map;
+using std::shared_ptr;
+using std::vector;
+
+namespace {
+
+const int pullTagId = -12;
+const int64_t pullCoolDownNs = NS_PER_SEC;
+const int64_t pullTimeoutNs = 10 * NS_PER_SEC;
+
+// Rows have a key in field 1 and a value in field 2. Tombstones only have the key.
+StatsEventParcel createRowParcel(int32_t key, std::optional<int64_t> value) {
+    AStatsEvent* event = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(event, pullTagId);
+    AStatsEvent_writeInt32(event, key);
+    if (value) {
+        AStatsEvent_writeInt64(event, *value);
+    }
+    AStatsEvent_build(event);
+    size_t size;
+    uint8_t* buffer = AStatsEvent_getBuffer(event, &size);
+    StatsEventParcel parcel;
+    parcel.buffer.assign(buffer, buffer + size);
+    AStatsEvent_release(event);
+    return parcel;
+}
+
+class FakeDeltaPullAtomCallback : public BnDeltaPullAtomCallback {
+public:
+    ~FakeDeltaPullAtomCallback() {
+        if (pullThread.joinable()) {
+            pullThread.join();
+        }
+    }
+
+    Status onPullAtomDelta(int atomTag, int64_t sinceToken,
+                           const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        if (pullThread.joinable()) {
+            pullThread.join();
+        }
+        sinceTokens.push_back(sinceToken);
+        vector<StatsEventParcel> changedParcels;
+        for (const auto& [key, value] : changed) {
+            changedParcels.push_back(createRowParcel(key, value));
+        }
+        vector<StatsEventParcel> removedParcels;
+        for (const int32_t key : removed) {
+            removedParcels.push_back(createRowParcel(key, std::nullopt));
+        }
+        // Force pull to happen in separate thread to simulate binder.
+        pullThread = std::thread([=, delayNs = pullDelayNs, success = success, token = token,
+                                  fullSnapshot = fullSnapshot] {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(delayNs));
+            resultReceiver->pullDeltaFinished(atomTag, success, token, fullSnapshot,
+                                              changedParcels, removedParcels);
+        });
+        return Status::ok();
+    }
+
+    bool success = true;
+    int64_t token = 0;
+    bool fullSnapshot = false;
+    map<int32_t, int64_t> changed;
+    vector<int32_t> removed;
+    int64_t pullDelayNs = 0;
+    vector<int64_t> sinceTokens;
+    std::thread pullThread;
+};
+
+// Returns the pulled rows by key.
+map<int32_t, int64_t> getRows(const vector<shared_ptr<LogEvent>>& data) {
+    map<int32_t, int64_t> rows;
+    for (const shared_ptr<LogEvent>& event : data) {
+        EXPECT_EQ(pullTagId, event->GetTagId());
+        rows[event->getValues()[0].mValue.int_value] = event->getValues()[1].mValue.long_value;
+    }
+    return rows;
+}
+
+}  // anonymous namespace
+
+TEST(StatsDeltaCallbackPullerTest, PullFullSnapshot) {
+    shared_ptr<FakeDeltaPullAtomCallback> cb = SharedRefBase::make<FakeDeltaPullAtomCallback>();
+    cb->token = 5;
+    cb->changed = {{1, 10}, {2, 20}};
+    StatsDeltaCallbackPuller puller(pullTagId, cb, pullCoolDownNs, pullTimeoutNs, {}, {1});
+
+    vector<shared_ptr<LogEvent>> dataHolder;
+    const int64_t startTimeNs = getElapsedRealtimeNs();
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    EXPECT_EQ(getRows(dataHolder), (map<int32_t, int64_t>{{1, 10}, {2, 20}}));
+    EXPECT_LE(startTimeNs, dataHolder[0]->GetElapsedTimestampNs());
+    EXPECT_EQ(cb->sinceTokens, vector<int64_t>{0});
+    EXPECT_EQ(puller.mToken, 5);
+
+    // The provider can't serve the token and sends all rows again.
+    cb->token = 8;
+    cb->fullSnapshot = true;
+    cb->changed = {{3, 30}};
+    dataHolder.clear();
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    EXPECT_EQ(getRows(dataHolder), (map<int32_t, int64_t>{{3, 30}}));
+    EXPECT_EQ(cb->sinceTokens, (vector<int64_t>{0, 5}));
+    EXPECT_EQ(puller.mToken, 8);
+}
+
+TEST(StatsDeltaCallbackPullerTest, PullDelta) {
+    shared_ptr<FakeDeltaPullAtomCallback> cb = SharedRefBase::make<FakeDeltaPullAtomCallback>();
+    cb->token = 1;
+    cb->changed = {{1, 10}, {2, 20}, {3, 30}};
+    StatsDeltaCallbackPuller puller(pullTagId, cb, pullCoolDownNs, pullTimeoutNs, {}, {1});
+    vector<shared_ptr<LogEvent>> dataHolder;
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+
+    cb->token = 2;
+    cb->changed = {{2, 25}, {4, 40}};
+    cb->removed = {3};
+    dataHolder.clear();
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    EXPECT_EQ(getRows(dataHolder), (map<int32_t, int64_t>{{1, 10}, {2, 25}, {4, 40}}));
+    EXPECT_EQ(cb->sinceTokens, (vector<int64_t>{0, 1}));
+
+    // Returned rows are copies, changing them does not change the next pull.
+    dataHolder[0]->getMutableValues()->at(1).mValue.setLong(0);
+    cb->token = 3;
+    cb->changed.clear();
+    cb->removed.clear();
+    dataHolder.clear();
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    EXPECT_EQ(getRows(dataHolder), (map<int32_t, int64_t>{{1, 10}, {2, 25}, {4, 40}}));
+    EXPECT_EQ(puller.mRows.size(), 3u);
+}
+
+TEST(StatsDeltaCallbackPullerTest, PullFailKeepsRows) {
+    shared_ptr<FakeDeltaPullAtomCallback> cb = SharedRefBase::make<FakeDeltaPullAtomCallback>();
+    cb->token = 1;
+    cb->changed = {{1, 10}};
+    StatsDeltaCallbackPuller puller(pullTagId, cb, pullCoolDownNs, pullTimeoutNs, {}, {1});
+    vector<shared_ptr<LogEvent>> dataHolder;
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+
+    cb->success = false;
+    dataHolder.clear();
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_FAIL);
+    EXPECT_TRUE(dataHolder.empty());
+
+    // The next pull still asks for the changes since the last successful one.
+    cb->success = true;
+    cb->token = 2;
+    cb->changed = {{2, 20}};
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    EXPECT_EQ(getRows(dataHolder), (map<int32_t, int64_t>{{1, 10}, {2, 20}}));
+    EXPECT_EQ(cb->sinceTokens, (vector<int64_t>{0, 1, 1}));
+}
+
+TEST(StatsDeltaCallbackPullerTest, PullTimeoutResetsRows) {
+    shared_ptr<FakeDeltaPullAtomCallback> cb = SharedRefBase::make<FakeDeltaPullAtomCallback>();
+    cb->token = 1;
+    cb->changed = {{1, 10}};
+    StatsDeltaCallbackPuller puller(pullTagId, cb, pullCoolDownNs, MillisToNano(50), {}, {1});
+    vector<shared_ptr<LogEvent>> dataHolder;
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    ASSERT_EQ(dataHolder.size(), 1u);
+
+    // The result arrives after the wait timed out.
+    cb->pullDelayNs = MillisToNano(200);
+    cb->token = 2;
+    cb->changed = {{2, 20}};
+    dataHolder.clear();
+    // Returns success to let StatsPuller code evaluate the timeout.
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    EXPECT_TRUE(dataHolder.empty());
+    EXPECT_TRUE(puller.mRows.empty());
+    EXPECT_EQ(puller.mToken, 0);
+
+    cb->pullDelayNs = 0;
+    cb->token = 3;
+    cb->changed = {{1, 15}, {2, 20}};
+    EXPECT_EQ(puller.PullInternal(&dataHolder), PULL_SUCCESS);
+    EXPECT_EQ(getRows(dataHolder), (map<int32_t, int64_t>{{1, 15}, {2, 20}}));
+    EXPECT_EQ(cb->sinceTokens, (vector<int64_t>{0, 1, 0}));
+}
+
+TEST(StatsDeltaCallbackPullerTest, RegisterRequiresKeyFields) {
+    shared_ptr<FakeDeltaPullAtomCallback> cb = SharedRefBase::make<FakeDeltaPullAtomCallback>();
+    cb->token = 1;
+    cb->changed = {{1, 10}};
+    const int32_t uid = 123;
+
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    pullerManager->RegisterDeltaPullAtomCallback(uid, pullTagId, pullCoolDownNs, pullTimeoutNs,
+                                                 {}, {}, cb);
+    vector<shared_ptr<LogEvent>> dataHolder;
+    EXPECT_FALSE(pullerManager->Pull(pullTagId, {uid}, getElapsedRealtimeNs(), &dataHolder));
+
+    pullerManager->RegisterDeltaPullAtomCallback(uid, pullTagId, pullCoolDownNs, pullTimeoutNs,
+                                                 {}, {1}, cb);
+    EXPECT_TRUE(pullerManager->Pull(pullTagId, {uid}, getElapsedRealtimeNs(), &dataHolder));
+    EXPECT_EQ(getRows(dataHolder), (map<int32_t, int64_t>{{1, 10}}));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -19,6 +19,10 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
 #include "stats_event.h"
 #include "tests/statsd_test_util.h"
 
@@ -52,28 +56,72 @@ AStatsEvent* createSimpleEvent(int32_t atomId, int32_t value) {
     return event;
 }
 
+StatsEventParcel createSimpleEventParcel(int32_t atomId, int32_t value) {
+    AStatsEvent* event = createSimpleEvent(atomId, value);
+    size_t size;
+    uint8_t* buffer = AStatsEvent_getBuffer(event, &size);
+
+    StatsEventParcel p;
+    // vector.assign() creates a copy, but this is inevitable unless
+    // stats_event.h/c uses a vector as opposed to a buffer.
+    p.buffer.assign(buffer, buffer + size);
+    AStatsEvent_release(event);
+    return p;
+}
+
 class FakePullAtomCallback : public BnPullAtomCallback {
 public:
     FakePullAtomCallback(int32_t uid) : mUid(uid){};
     Status onPullAtom(int atomTag,
                       const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
         vector<StatsEventParcel> parcels;
-        AStatsEvent* event = createSimpleEvent(atomTag, mUid);
-        size_t size;
-        uint8_t* buffer = AStatsEvent_getBuffer(event, &size);
-
-        StatsEventParcel p;
-        // vector.assign() creates a copy, but this is inevitable unless
-        // stats_event.h/c uses a vector as opposed to a buffer.
-        p.buffer.assign(buffer, buffer + size);
-        parcels.push_back(std::move(p));
-        AStatsEvent_release(event);
+        parcels.push_back(createSimpleEventParcel(atomTag, mUid));
         resultReceiver->pullFinished(atomTag, /*success*/ true, parcels);
         return Status::ok();
     }
     int32_t mUid;
 };
 
+// Only succeeds if numPulls pulls are in progress at the same time.
+class ConcurrentPullAtomCallback : public BnPullAtomCallback {
+public:
+    ConcurrentPullAtomCallback(int numPulls) : mNumPulls(numPulls){};
+    Status onPullAtom(int atomTag,
+                      const shared_ptr<IPullAtomResultReceiver>& resultReceiver) override {
+        bool success;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNumPulling++;
+            mCv.notify_all();
+            // Stays below the puller timeout.
+            success = mCv.wait_for(lock, std::chrono::milliseconds(200),
+                                   [this] { return mNumPulling >= mNumPulls; });
+        }
+        vector<StatsEventParcel> parcels;
+        parcels.push_back(createSimpleEventParcel(atomTag, atomTag));
+        resultReceiver->pullFinished(atomTag, success, parcels);
+        return Status::ok();
+    }
+    const int mNumPulls;
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    int mNumPulling = 0;
+};
+
+class FakePullDataReceiver : public PullDataReceiver {
+public:
+    void onDataPulled(const vector<shared_ptr<LogEvent>>& data, PullResult pullResult,
+                      int64_t originalPullTimeNs) override {
+        mPullResult = pullResult;
+        mData = data;
+    }
+    bool isPullNeeded() const override {
+        return true;
+    }
+    PullResult mPullResult = PullResult::PULL_NOT_NEEDED;
+    vector<shared_ptr<LogEvent>> mData;
+};
+
 class FakePullUidProvider : public PullUidProvider {
 public:
     vector<int32_t> getPullAtomUids(int atomId) override {
@@ -145,6 +193,141 @@ TEST(StatsPullerManagerTest, TestPullConfigKeyNoPullerWithUid) {
     EXPECT_FALSE(pullerManager->Pull(pullTagId2, configKey, /*timestamp =*/1, &data));
 }
 
+TEST(StatsPullerManagerTest, TestOnAlarmFiredPullsConcurrently) {
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    shared_ptr<ConcurrentPullAtomCallback> cb =
+            SharedRefBase::make<ConcurrentPullAtomCallback>(/*numPulls=*/2);
+    pullerManager->RegisterPullAtomCallback(uid2, pullTagId1, coolDownNs, timeoutNs, {}, cb);
+    pullerManager->RegisterPullAtomCallback(uid2, pullTagId2, coolDownNs, timeoutNs, {}, cb);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+
+    const int64_t intervalNs = 60 * NS_PER_SEC;
+    sp<FakePullDataReceiver> receiver1 = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> receiver2 = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(pullTagId1, configKey, receiver1, intervalNs, intervalNs);
+    pullerManager->RegisterReceiver(pullTagId2, configKey, receiver2, intervalNs, intervalNs);
+
+    // Each pull waits for the other one, so both only succeed if they are issued concurrently.
+    pullerManager->OnAlarmFired(intervalNs);
+    EXPECT_EQ(receiver1->mPullResult, PullResult::PULL_RESULT_SUCCESS);
+    EXPECT_EQ(receiver1->mData.size(), 1u);
+    EXPECT_EQ(receiver2->mPullResult, PullResult::PULL_RESULT_SUCCESS);
+    EXPECT_EQ(receiver2->mData.size(), 1u);
+}
+
+TEST(StatsPullerManagerTest, TestOnAlarmFiredSharesPullAcrossConfigs) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    const ConfigKey configKey2(70, 12345);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    pullerManager->RegisterPullUidProvider(configKey2, uidProvider);
+
+    const int64_t intervalNs = 60 * NS_PER_SEC;
+    sp<FakePullDataReceiver> receiver1 = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> receiver2 = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(pullTagId1, configKey, receiver1, intervalNs, intervalNs);
+    pullerManager->RegisterReceiver(pullTagId1, configKey2, receiver2, intervalNs, intervalNs);
+
+    StatsdStats::getInstance().reset();
+    pullerManager->OnAlarmFired(intervalNs);
+
+    // Both configs pull the atom from uid2, so they get the events of a single pull.
+    EXPECT_EQ(receiver1->mPullResult, PullResult::PULL_RESULT_SUCCESS);
+    ASSERT_EQ(receiver1->mData.size(), 1u);
+    ASSERT_EQ(receiver2->mData.size(), 1u);
+    EXPECT_EQ(receiver1->mData[0], receiver2->mData[0]);
+    EXPECT_EQ(receiver1->mData[0]->GetElapsedTimestampNs(), intervalNs);
+
+    vector<uint8_t> output;
+    StatsdStats::getInstance().dumpStats(&output, /*reset=*/true);
+    StatsdStatsReport report;
+    ASSERT_TRUE(report.ParseFromArray(output.data(), output.size()));
+    int64_t totalPull = 0;
+    for (const auto& pulledAtomStats : report.pulled_atom_stats()) {
+        if (pulledAtomStats.atom_id() == pullTagId1) {
+            totalPull = pulledAtomStats.total_pull();
+        }
+    }
+    EXPECT_EQ(totalPull, 1);
+}
+
+TEST(StatsPullerManagerTest, TestOnAlarmFiredAlignsPullsAcrossConfigs) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    const ConfigKey configKey2(70, 12345);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    pullerManager->RegisterPullUidProvider(configKey2, uidProvider);
+
+    // The buckets of the second config end 2 seconds later. A 15 minute interval can be delayed
+    // by 9 seconds.
+    const int64_t intervalNs = 15 * 60 * NS_PER_SEC;
+    const int64_t bucketEndNs = intervalNs;
+    const int64_t bucketEnd2Ns = intervalNs + 2 * NS_PER_SEC;
+    sp<FakePullDataReceiver> receiver1 = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> receiver2 = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(pullTagId1, configKey, receiver1, bucketEndNs, intervalNs);
+    pullerManager->RegisterReceiver(pullTagId1, configKey2, receiver2, bucketEnd2Ns, intervalNs);
+    // The alarm was set for the first receiver, before the second one was registered.
+    EXPECT_EQ(pullerManager->mNextPullTimeNs, bucketEndNs);
+
+    StatsdStats::getInstance().reset();
+    // The pull waits for the bucket end of the second config.
+    pullerManager->OnAlarmFired(bucketEndNs);
+    EXPECT_TRUE(receiver1->mData.empty());
+    EXPECT_TRUE(receiver2->mData.empty());
+    EXPECT_EQ(pullerManager->mNextPullTimeNs, bucketEnd2Ns);
+
+    pullerManager->OnAlarmFired(bucketEnd2Ns);
+    EXPECT_EQ(receiver1->mPullResult, PullResult::PULL_RESULT_SUCCESS);
+    ASSERT_EQ(receiver1->mData.size(), 1u);
+    ASSERT_EQ(receiver2->mData.size(), 1u);
+    EXPECT_EQ(receiver1->mData[0], receiver2->mData[0]);
+    EXPECT_EQ(pullerManager->mNextPullTimeNs, bucketEnd2Ns + intervalNs);
+
+    vector<uint8_t> output;
+    StatsdStats::getInstance().dumpStats(&output, /*reset=*/true);
+    StatsdStatsReport report;
+    ASSERT_TRUE(report.ParseFromArray(output.data(), output.size()));
+    int64_t totalPull = 0;
+    int64_t pullsSavedByAlignment = 0;
+    for (const auto& pulledAtomStats : report.pulled_atom_stats()) {
+        if (pulledAtomStats.atom_id() == pullTagId1) {
+            totalPull = pulledAtomStats.total_pull();
+            pullsSavedByAlignment = pulledAtomStats.pulls_saved_by_alignment();
+        }
+    }
+    EXPECT_EQ(totalPull, 1);
+    EXPECT_EQ(pullsSavedByAlignment, 1);
+}
+
+TEST(StatsPullerManagerTest, TestOnAlarmFiredDoesNotDelayPullsPastTolerance) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    const ConfigKey configKey2(70, 12345);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    pullerManager->RegisterPullUidProvider(configKey2, uidProvider);
+
+    // A 1 minute interval can only be delayed by 0.6 seconds.
+    const int64_t intervalNs = 60 * NS_PER_SEC;
+    const int64_t bucketEndNs = intervalNs;
+    const int64_t bucketEnd2Ns = intervalNs + 2 * NS_PER_SEC;
+    sp<FakePullDataReceiver> receiver1 = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> receiver2 = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(pullTagId1, configKey, receiver1, bucketEndNs, intervalNs);
+    pullerManager->RegisterReceiver(pullTagId1, configKey2, receiver2, bucketEnd2Ns, intervalNs);
+    EXPECT_EQ(pullerManager->mNextPullTimeNs, bucketEndNs);
+
+    pullerManager->OnAlarmFired(bucketEndNs);
+    EXPECT_EQ(receiver1->mPullResult, PullResult::PULL_RESULT_SUCCESS);
+    EXPECT_TRUE(receiver2->mData.empty());
+    EXPECT_EQ(pullerManager->mNextPullTimeNs, bucketEnd2Ns);
+
+    pullerManager->OnAlarmFired(bucketEnd2Ns);
+    EXPECT_EQ(receiver2->mPullResult, PullResult::PULL_RESULT_SUCCESS);
+    EXPECT_EQ(pullerManager->mNextPullTimeNs, bucketEndNs + intervalNs);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
\ No newline at end of file
@@ -554,9 +554,6 @@ TEST(PullerUtilTest, MultipleRepeatedFields) {
     const vector<int> secondAdditiveField = {2};
 
     vector<shared_ptr<LogEvent>> data = {
-            // TODO: Once b/224880904 is fixed, can use different additive data without
-            // having the sort order messed up.
-
             // Event 1 {30, 20}->21->{1, 2, 3} (merged with event 4)
             makeRepeatedUidLogEvent(uidAtomTagId, timestamp, uidArray1, hostAdditiveData,
                                     nonAdditiveArray1),
@@ -570,9 +567,8 @@ TEST(PullerUtilTest, MultipleRepeatedFields) {
             makeRepeatedUidLogEvent(uidAtomTagId, timestamp, uidArray3, hostAdditiveData,
                                     nonAdditiveArray3),
 
-            // Event 4 {30, 20}->21->{1, 2, 3} (merged with event 1)
-            // TODO: once sorting bug is fixed, can change this additive field
-            makeRepeatedUidLogEvent(uidAtomTagId, timestamp, uidArray1, hostAdditiveData,
+            // Event 4 {30, 20}->31->{1, 2, 3} (merged with event 1)
+            makeRepeatedUidLogEvent(uidAtomTagId, timestamp, uidArray1, isolatedAdditiveData,
                                     nonAdditiveArray1),
 
             // Event 5 {30, 20}->21->{1, 5, 3} (different repeated field, not merged)
@@ -589,7 +585,7 @@ TEST(PullerUtilTest, MultipleRepeatedFields) {
     // Event 3 {30, 20, 40}->21->{1, 2} (total size equal to event 1, merged with event 6)
     // Event 6 {30, 20, 40}->22->{1, 2} (total size equal to event 1, merged with event 3)
     // Event 1 {30, 20}->21->{1, 2, 3}
-    // Event 4 {30, 20}->21->{1, 2, 3} (merged with event 1)
+    // Event 4 {30, 20}->31->{1, 2, 3} (merged with event 1)
     // Event 5 {30, 20}->21->{1, 5, 3} (different repeated field, not merged)
     // Event 2 {30, 3000}->21->{1, 2, 3} (different uid, not merged)
 
@@ -614,7 +610,7 @@ TEST(PullerUtilTest, MultipleRepeatedFields) {
     ASSERT_EQ(6, actualFieldValues->size());
     EXPECT_EQ(hostUid, actualFieldValues->at(0).mValue.int_value);
     EXPECT_EQ(hostUid, actualFieldValues->at(1).mValue.int_value);
-    EXPECT_EQ(hostAdditiveData + hostAdditiveData, actualFieldValues->at(2).mValue.int_value);
+    EXPECT_EQ(hostAdditiveData + isolatedAdditiveData, actualFieldValues->at(2).mValue.int_value);
     EXPECT_EQ(1, actualFieldValues->at(3).mValue.int_value);
     EXPECT_EQ(2, actualFieldValues->at(4).mValue.int_value);
     EXPECT_EQ(3, actualFieldValues->at(5).mValue.int_value);
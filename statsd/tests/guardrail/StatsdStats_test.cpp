@@ -207,6 +207,31 @@ TEST(StatsdStatsTest, TestConfigRemove) {
     EXPECT_TRUE(configReport2.has_deletion_time_sec());
 }
 
+TEST(StatsdStatsTest, TestConditionQueryCacheStats) {
+    StatsdStats stats;
+    ConfigKey key(0, 12345);
+    stats.noteConfigReceived(key, 2, 3, 4, 5, {}, nullopt);
+    stats.noteConditionQueryCache(key, 3, 1);
+    stats.noteConditionQueryCache(key, 2, 2);
+    // Unknown configs are ignored.
+    stats.noteConditionQueryCache(ConfigKey(0, 54321), 10, 10);
+
+    vector<uint8_t> output;
+    stats.dumpStats(&output, true);
+    StatsdStatsReport report;
+    ASSERT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    ASSERT_EQ(1, report.config_stats_size());
+    EXPECT_EQ(5, report.config_stats(0).condition_query_cache_hits());
+    EXPECT_EQ(3, report.config_stats(0).condition_query_cache_misses());
+
+    // The counters are cleared on reset.
+    stats.dumpStats(&output, false);
+    ASSERT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    ASSERT_EQ(1, report.config_stats_size());
+    EXPECT_FALSE(report.config_stats(0).has_condition_query_cache_hits());
+    EXPECT_FALSE(report.config_stats(0).has_condition_query_cache_misses());
+}
+
 TEST(StatsdStatsTest, TestSubStats) {
     StatsdStats stats;
     ConfigKey key(0, 12345);
@@ -417,6 +442,12 @@ TEST(StatsdStatsTest, TestPullAtomStats) {
     stats.notePullerNotFound(util::DISK_SPACE);
     stats.notePullTimeout(util::DISK_SPACE, 3000L, 6000L);
     stats.notePullTimeout(util::DISK_SPACE, 4000L, 7000L);
+    stats.notePullAlarmToCompletion(util::DISK_SPACE, 1000L);
+    stats.notePullAlarmToCompletion(util::DISK_SPACE, 5000L);
+    stats.notePullAlarmToStart(util::DISK_SPACE, 100L);
+    stats.notePullAlarmToStart(util::DISK_SPACE, 300L);
+    stats.notePullsSavedByAlignment(util::DISK_SPACE, 1);
+    stats.notePullsSavedByAlignment(util::DISK_SPACE, 2);
 
     vector<uint8_t> output;
     stats.dumpStats(&output, false);
@@ -439,6 +470,11 @@ TEST(StatsdStatsTest, TestPullAtomStats) {
     EXPECT_EQ(1L, report.pulled_atom_stats(0).binder_call_failed());
     EXPECT_EQ(1L, report.pulled_atom_stats(0).failed_uid_provider_not_found());
     EXPECT_EQ(2L, report.pulled_atom_stats(0).puller_not_found());
+    EXPECT_EQ(3000L, report.pulled_atom_stats(0).average_pull_alarm_to_completion_nanos());
+    EXPECT_EQ(5000L, report.pulled_atom_stats(0).max_pull_alarm_to_completion_nanos());
+    EXPECT_EQ(200L, report.pulled_atom_stats(0).average_pull_alarm_to_start_nanos());
+    EXPECT_EQ(300L, report.pulled_atom_stats(0).max_pull_alarm_to_start_nanos());
+    EXPECT_EQ(3L, report.pulled_atom_stats(0).pulls_saved_by_alignment());
     ASSERT_EQ(2, report.pulled_atom_stats(0).pull_atom_metadata_size());
     EXPECT_EQ(3000L, report.pulled_atom_stats(0).pull_atom_metadata(0).pull_timeout_uptime_millis());
     EXPECT_EQ(4000L, report.pulled_atom_stats(0).pull_atom_metadata(1).pull_timeout_uptime_millis());
@@ -889,6 +925,52 @@ TEST(StatsdStatsTest, TestAtomLoggedAndDroppedAndSkippedStats) {
     EXPECT_FALSE(nonPlatformPushedAtomStats.has_error_count());
 }
 
+TEST(StatsdStatsTest, TestDumpReportQueueSize) {
+    StatsdStats stats;
+    vector<uint8_t> output;
+    stats.dumpStats(&output, false);
+    StatsdStatsReport report;
+    EXPECT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    EXPECT_FALSE(report.has_dump_report_queue_stats());
+
+    stats.noteDumpReportQueueSize(7);
+    stats.noteDumpReportQueueSize(3);
+    output.clear();
+    stats.dumpStats(&output, /*reset=*/true);
+    EXPECT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    EXPECT_EQ(report.dump_report_queue_stats().dump_count(), 2);
+    EXPECT_EQ(report.dump_report_queue_stats().max_queue_size(), 7);
+
+    output.clear();
+    stats.dumpStats(&output, false);
+    report.Clear();
+    EXPECT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    EXPECT_FALSE(report.has_dump_report_queue_stats());
+}
+
+TEST(StatsdStatsTest, TestDumpReportLifetimePeakRss) {
+    StatsdStats stats;
+    stats.noteDumpReportLifetimePeakRss(/*lifetimePeakRssKb=*/1000,
+                                        /*lifetimePeakRssIncreaseKb=*/200);
+    stats.noteDumpReportLifetimePeakRss(/*lifetimePeakRssKb=*/1500,
+                                        /*lifetimePeakRssIncreaseKb=*/0);
+    // A concurrent dump that started earlier reports last.
+    stats.noteDumpReportLifetimePeakRss(/*lifetimePeakRssKb=*/1200,
+                                        /*lifetimePeakRssIncreaseKb=*/0);
+    vector<uint8_t> output;
+    stats.dumpStats(&output, /*reset=*/true);
+    StatsdStatsReport report;
+    EXPECT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    EXPECT_EQ(report.dump_report_memory_stats().lifetime_peak_rss_kb(), 1500);
+    EXPECT_EQ(report.dump_report_memory_stats().max_lifetime_peak_rss_increase_kb(), 200);
+
+    output.clear();
+    stats.dumpStats(&output, false);
+    report.Clear();
+    EXPECT_TRUE(report.ParseFromArray(&output[0], output.size()));
+    EXPECT_FALSE(report.has_dump_report_memory_stats());
+}
+
 TEST(StatsdStatsTest, TestShardOffsetProvider) {
     StatsdStats stats;
     ShardOffsetProvider::getInstance().setShardOffset(15);
@@ -106,6 +106,29 @@ TEST(LogEventQueue_test, TestSlowConsumer) {
     writer.join();
 }
 
+TEST(LogEventQueue_test, TestMaxSizeDuringDumps) {
+    LogEventQueue queue(50);
+    int64_t oldestEventNs;
+    EXPECT_TRUE(queue.push(makeLogEvent(100), &oldestEventNs));
+    // The size is not tracked outside dumps.
+    EXPECT_EQ(queue.mMaxSizeDuringDumps, 0u);
+
+    queue.noteDumpStarted();
+    EXPECT_TRUE(queue.push(makeLogEvent(200), &oldestEventNs));
+    EXPECT_TRUE(queue.push(makeLogEvent(300), &oldestEventNs));
+    queue.waitPop();
+
+    // The dumps overlap, so the second one reports the peak of the first one too.
+    queue.noteDumpStarted();
+    queue.waitPop();
+    EXPECT_EQ(queue.noteDumpFinished(), 3u);
+    EXPECT_EQ(queue.noteDumpFinished(), 3u);
+
+    // A new dump starts from the current size.
+    queue.noteDumpStarted();
+    EXPECT_EQ(queue.noteDumpFinished(), 1u);
+}
+
 #else
 GTEST_LOG_(INFO) << "This test does nothing.\n";
 #endif
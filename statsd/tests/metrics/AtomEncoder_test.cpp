@@ -0,0 +1,224 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/AtomEncoder.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "src/hash.h"
+#include "tests/statsd_test_util.h"
+
+using namespace testing;
+using android::util::ProtoOutputStream;
+using std::set;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int kAtomId = 10;
+const int kOtherAtomId = 11;
+
+// AggregatedAtomInfo fields.
+const int FIELD_ID_ENCODED_ATOM = 3;
+const int FIELD_ID_ELAPSED_TIMESTAMP_DELTAS = 4;
+// StatsLogReport field.
+const int FIELD_ID_ATOM_ENCODING_DICTIONARY = 17;
+
+vector<FieldValue> createAtomValues(int atomId, int32_t intValue, int64_t longValue,
+                                    const string& str, float floatValue,
+                                    const vector<uint8_t>& bytes) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, atomId);
+    AStatsEvent_overwriteTimestamp(statsEvent, 1000);
+    AStatsEvent_writeInt32(statsEvent, intValue);
+    AStatsEvent_writeInt64(statsEvent, longValue);
+    AStatsEvent_writeString(statsEvent, str.c_str());
+    AStatsEvent_writeFloat(statsEvent, floatValue);
+    AStatsEvent_writeByteArray(statsEvent, bytes.data(), bytes.size());
+
+    LogEvent logEvent(/*uid=*/0, /*pid=*/0);
+    parseStatsEventToLogEvent(statsEvent, &logEvent);
+    return logEvent.getValues();
+}
+
+// Reference decoder for EncodedAtom messages, fed in report order.
+class AtomDecoder {
+public:
+    explicit AtomDecoder(const AtomEncodingDictionary& dictionary) : mDictionary(dictionary) {
+    }
+
+    vector<FieldValue> decode(const EncodedAtom& atom) {
+        const AtomEncodingDictionary::Layout& layout = mDictionary.layout(atom.layout_index());
+        vector<int64_t>& lastIntValues = mLastIntValues[atom.layout_index()];
+        lastIntValues.resize(atom.int_delta_size());
+
+        vector<FieldValue> values;
+        int intIndex = 0, stringIndex = 0, floatIndex = 0, storageIndex = 0;
+        for (int i = 0; i < layout.field_size(); i++) {
+            const Field field(layout.atom_id(), layout.field(i));
+            switch (layout.type(i)) {
+                case INT:
+                case LONG:
+                    lastIntValues[intIndex] = (int64_t)((uint64_t)lastIntValues[intIndex] +
+                                                        (uint64_t)atom.int_delta(intIndex));
+                    if (layout.type(i) == INT) {
+                        values.emplace_back(field, Value((int32_t)lastIntValues[intIndex]));
+                    } else {
+                        values.emplace_back(field, Value(lastIntValues[intIndex]));
+                    }
+                    intIndex++;
+                    break;
+                case STRING:
+                    values.emplace_back(
+                            field,
+                            Value(mDictionary.string(atom.string_index(stringIndex++))));
+                    break;
+                case FLOAT:
+                    values.emplace_back(field, Value(atom.float_value(floatIndex++)));
+                    break;
+                case STORAGE: {
+                    const string& bytes = atom.storage_value(storageIndex++);
+                    values.emplace_back(field, Value(vector<uint8_t>(bytes.begin(), bytes.end())));
+                    break;
+                }
+                default:
+                    ADD_FAILURE() << "Unexpected type " << layout.type(i);
+            }
+        }
+        return values;
+    }
+
+private:
+    const AtomEncodingDictionary mDictionary;
+
+    unordered_map<int, vector<int64_t>> mLastIntValues;
+};
+
+AtomEncodingDictionary getDictionary(const AtomEncoder& encoder) {
+    ProtoOutputStream output;
+    encoder.writeDictionary(FIELD_ID_ATOM_ENCODING_DICTIONARY, &output);
+    return outputStreamToProto(&output).atom_encoding_dictionary();
+}
+
+AggregatedAtomInfo writeAtom(AtomEncoder* encoder, const vector<FieldValue>& values,
+                             const vector<int64_t>& timestampsNs) {
+    ProtoOutputStream output;
+    encoder->writeAtom(values[0].mField.getTag(), values, FIELD_ID_ENCODED_ATOM, &output);
+    AtomEncoder::writeTimestamps(timestampsNs, FIELD_ID_ELAPSED_TIMESTAMP_DELTAS, &output);
+    AggregatedAtomInfo atomInfo;
+    outputStreamToProto(&output, &atomInfo);
+    return atomInfo;
+}
+
+}  // anonymous namespace
+
+TEST(AtomEncoderTest, TestRoundTrip) {
+    const vector<vector<FieldValue>> atoms = {
+            createAtomValues(kAtomId, 100, 1LL << 40, "com.example.a", 1.5f, {1, 2}),
+            createAtomValues(kAtomId, 101, (1LL << 40) + 5, "com.example.b", 2.5f, {}),
+            createAtomValues(kOtherAtomId, -3, -7, "com.example.a", 0.0f, {3}),
+            createAtomValues(kAtomId, 99, (1LL << 40) - 2, "com.example.a", -1.0f, {4, 5, 6})};
+
+    AtomEncoder encoder(/*str_set=*/nullptr);
+    vector<AggregatedAtomInfo> written;
+    for (const vector<FieldValue>& atom : atoms) {
+        written.push_back(writeAtom(&encoder, atom, {}));
+    }
+    const AtomEncodingDictionary dictionary = getDictionary(encoder);
+
+    // One layout per atom id, and each string is written once.
+    ASSERT_EQ(dictionary.layout_size(), 2);
+    EXPECT_EQ(dictionary.layout(0).atom_id(), kAtomId);
+    EXPECT_EQ(dictionary.layout(1).atom_id(), kOtherAtomId);
+    ASSERT_EQ(dictionary.string_size(), 2);
+    EXPECT_EQ(dictionary.string(0), "com.example.a");
+    EXPECT_EQ(dictionary.string(1), "com.example.b");
+    EXPECT_EQ(dictionary.string_hash_size(), 0);
+
+    // Integral leaves are deltas against the previous atom with the same layout.
+    EXPECT_EQ(written[1].encoded_atom().int_delta(0), 1);
+    EXPECT_EQ(written[1].encoded_atom().int_delta(1), 5);
+    EXPECT_EQ(written[3].encoded_atom().int_delta(0), -2);
+    EXPECT_EQ(written[3].encoded_atom().int_delta(1), -7);
+
+    AtomDecoder decoder(dictionary);
+    for (size_t i = 0; i < atoms.size(); i++) {
+        EXPECT_FALSE(written[i].has_atom());
+        EXPECT_EQ(decoder.decode(written[i].encoded_atom()), atoms[i]) << "atom " << i;
+    }
+}
+
+TEST(AtomEncoderTest, TestRoundTripExtremeValues) {
+    const vector<vector<FieldValue>> atoms = {
+            createAtomValues(kAtomId, INT32_MIN, INT64_MIN, "a", 0.0f, {}),
+            createAtomValues(kAtomId, INT32_MAX, INT64_MAX, "a", 0.0f, {}),
+            createAtomValues(kAtomId, INT32_MIN, INT64_MIN, "a", 0.0f, {}),
+            createAtomValues(kAtomId, -1, 1, "a", 0.0f, {})};
+
+    AtomEncoder encoder(/*str_set=*/nullptr);
+    vector<AggregatedAtomInfo> written;
+    for (const vector<FieldValue>& atom : atoms) {
+        written.push_back(writeAtom(&encoder, atom, {}));
+    }
+
+    // INT64_MAX - INT64_MIN wraps around to -1.
+    EXPECT_EQ(written[1].encoded_atom().int_delta(1), -1);
+    EXPECT_EQ(written[2].encoded_atom().int_delta(1), 1);
+
+    AtomDecoder decoder(getDictionary(encoder));
+    for (size_t i = 0; i < atoms.size(); i++) {
+        EXPECT_EQ(decoder.decode(written[i].encoded_atom()), atoms[i]) << "atom " << i;
+    }
+}
+
+TEST(AtomEncoderTest, TestTimestampDeltas) {
+    AtomEncoder encoder(/*str_set=*/nullptr);
+    AggregatedAtomInfo atomInfo =
+            writeAtom(&encoder, createAtomValues(kAtomId, 1, 2, "a", 0.0f, {}),
+                      {1000000000LL, 1000000010LL, 1000000005LL, 2000000000LL});
+
+    EXPECT_EQ(atomInfo.elapsed_timestamp_nanos_size(), 0);
+    EXPECT_THAT(atomInfo.elapsed_timestamp_delta_nanos(),
+                ElementsAre(1000000000LL, 10, -5, 999999995LL));
+}
+
+TEST(AtomEncoderTest, TestHashStrings) {
+    set<string> strSet;
+    AtomEncoder encoder(&strSet);
+    writeAtom(&encoder, createAtomValues(kAtomId, 1, 2, "com.example.a", 0.0f, {}), {});
+    writeAtom(&encoder, createAtomValues(kAtomId, 1, 2, "com.example.a", 0.0f, {}), {});
+    writeAtom(&encoder, createAtomValues(kAtomId, 1, 2, "com.example.b", 0.0f, {}), {});
+    const AtomEncodingDictionary dictionary = getDictionary(encoder);
+
+    EXPECT_EQ(dictionary.string_size(), 0);
+    EXPECT_THAT(dictionary.string_hash(),
+                ElementsAre(Hash64("com.example.a"), Hash64("com.example.b")));
+    EXPECT_THAT(strSet, UnorderedElementsAre("com.example.a", "com.example.b"));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -521,6 +521,48 @@ TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced) {
               std::ceil(1.0 * event7.GetElapsedTimestampNs() / NS_PER_SEC + refPeriodSec));
 }
 
+TEST(CountMetricProducerTest, TestPrepareDumpReportTakesPastBuckets) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+
+    CountMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    CountMetricProducer countProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, bucketStartTimeNs, bucketStartTimeNs);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, bucketStartTimeNs + 1, tagId);
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+
+    DumpReportWriter writeReport = countProducer.prepareDumpReport(
+            bucketStartTimeNs + bucketSizeNs + 1, /*include_current_partial_bucket=*/false,
+            /*erase_data=*/true, FAST);
+    EXPECT_TRUE(countProducer.mPastBuckets.empty());
+
+    // Events logged before the report is written go to the producer, not to the report.
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, bucketStartTimeNs + bucketSizeNs + 2, tagId);
+    countProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    writeReport(&strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(1, report.count_metrics().data_size());
+    ASSERT_EQ(1, report.count_metrics().data(0).bucket_info_size());
+    EXPECT_EQ(1, report.count_metrics().data(0).bucket_info(0).count());
+
+    countProducer.flushIfNeededLocked(bucketStartTimeNs + 2 * bucketSizeNs + 1);
+    ASSERT_EQ(1UL, countProducer.mPastBuckets.size());
+    ASSERT_EQ(1UL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY].size());
+    EXPECT_EQ(1LL, countProducer.mPastBuckets[DEFAULT_METRIC_DIMENSION_KEY][0].mCount);
+}
+
 TEST(CountMetricProducerTest, TestOneWeekTimeUnit) {
     CountMetric metric;
     metric.set_id(1);
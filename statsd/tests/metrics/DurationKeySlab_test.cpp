@@ -0,0 +1,130 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/duration_helper/DurationKeySlab.h"
+
+#include <gtest/gtest.h>
+
+#include "tests/statsd_test_util.h"
+
+using namespace testing;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+HashableDimensionKey getKey(int value) {
+    int32_t pos[] = {1, 0, 0};
+    HashableDimensionKey key;
+    key.addValue(FieldValue(Field(10, pos, 0), Value(value)));
+    return key;
+}
+
+}  // anonymous namespace
+
+TEST(DurationKeySlabTest, TestFindAndErase) {
+    DurationKeySlab<int> slab;
+    EXPECT_EQ(slab.find(getKey(1)), nullptr);
+
+    slab[getKey(1)] = 10;
+    slab[getKey(2)] = 20;
+    slab[getKey(1)]++;
+    ASSERT_EQ(slab.size(), 2);
+    ASSERT_NE(slab.find(getKey(1)), nullptr);
+    EXPECT_EQ(*slab.find(getKey(1)), 11);
+    EXPECT_EQ(*slab.find(getKey(2)), 20);
+
+    slab.erase(getKey(1));
+    EXPECT_EQ(slab.find(getKey(1)), nullptr);
+    EXPECT_EQ(slab.size(), 1);
+
+    // A key that is added again starts from a default record.
+    EXPECT_EQ(slab[getKey(1)], 0);
+}
+
+TEST(DurationKeySlabTest, TestReuseSlots) {
+    DurationKeySlab<int> slab;
+    for (int i = 0; i < 4; i++) {
+        slab[getKey(i)] = i;
+    }
+    slab.clear();
+    EXPECT_TRUE(slab.empty());
+    EXPECT_EQ(slab.mSlots.size(), 4);
+
+    for (int i = 4; i < 8; i++) {
+        slab[getKey(i)] = i;
+    }
+    EXPECT_EQ(slab.size(), 4);
+    EXPECT_EQ(slab.mSlots.size(), 4);
+    EXPECT_TRUE(slab.mFreeSlots.empty());
+
+    slab.erase(getKey(5));
+    slab[getKey(9)] = 9;
+    EXPECT_EQ(slab.mSlots.size(), 4);
+}
+
+TEST(DurationKeySlabTest, TestReleaseMemory) {
+    DurationKeySlab<vector<int>> slab;
+    for (int i = 0; i < 8; i++) {
+        slab[getKey(i)] = vector<int>(100, i);
+    }
+
+    slab.erase(getKey(3));
+    ASSERT_EQ(slab.mSlots.size(), 8);
+    EXPECT_EQ(slab.mSlots[3].key.getValues().capacity(), 0);
+    EXPECT_EQ(slab.mSlots[3].record.capacity(), 0);
+
+    // Most of the slots were live, so they are kept for the next bucket.
+    slab.clear();
+    ASSERT_EQ(slab.mSlots.size(), 8);
+    for (size_t i = 0; i < slab.mSlots.size(); i++) {
+        EXPECT_EQ(slab.mSlots[i].key.getValues().capacity(), 0);
+        EXPECT_EQ(slab.mSlots[i].record.capacity(), 0);
+    }
+
+    // A bucket that uses few of the slots shrinks the slab.
+    slab[getKey(1)].push_back(1);
+    slab.clear();
+    EXPECT_EQ(slab.mSlots.size(), 1);
+    EXPECT_EQ(slab.mFreeSlots, vector<size_t>({0}));
+}
+
+TEST(DurationKeySlabTest, TestEraseWhileIterating) {
+    DurationKeySlab<int> slab;
+    for (int i = 0; i < 6; i++) {
+        slab[getKey(i)] = i;
+    }
+    slab.forEach([&slab](const HashableDimensionKey& key, int& value) {
+        if (value % 2 == 0) {
+            slab.erase(key);
+        }
+    });
+    ASSERT_EQ(slab.size(), 3);
+
+    vector<int> values;
+    slab.forEach([&values](const HashableDimensionKey&, int value) { values.push_back(value); });
+    EXPECT_EQ(values, vector<int>({1, 3, 5}));
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -574,6 +574,68 @@ TEST(DurationMetricProducerTest, TestSumDurationAppUpgradeSplitDisabled) {
     EXPECT_EQ(1, durationProducer.getCurrentBucketNum());
 }
 
+TEST(DurationMetricProducerTest, TestStateLinkIndex) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int64_t bucketSizeNs = TimeUnitToBucketSizeInMillis(ONE_MINUTE) * 1000000LL;
+    int tagId = 1;
+    int stateAtomId = util::UID_PROCESS_STATE_CHANGED;
+
+    DurationMetric metric;
+    metric.set_id(1);
+    metric.set_bucket(ONE_MINUTE);
+    metric.set_aggregation_type(DurationMetric_AggregationType_SUM);
+    *metric.mutable_dimensions_in_what() = CreateDimensions(tagId, {1 /* uid */});
+    MetricStateLink* stateLink = metric.add_state_link();
+    stateLink->set_state_atom_id(stateAtomId);
+    *stateLink->mutable_fields_in_what() = CreateDimensions(tagId, {1 /* uid */});
+    *stateLink->mutable_fields_in_state() = CreateDimensions(stateAtomId, {1 /* uid */});
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+
+    DurationMetricProducer durationProducer(
+            kConfigKey, metric, -1 /* no condition */, {}, -1 /*what index not needed*/,
+            1 /* start index */, 2 /* stop index */, 3 /* stop_all index */, false /*nesting*/,
+            wizard, protoHash, metric.dimensions_in_what(), bucketStartTimeNs, bucketStartTimeNs,
+            {}, {}, {stateAtomId});
+    ASSERT_EQ(1UL, durationProducer.mStateLinkIndices.size());
+    const auto& trackers = durationProducer.mStateLinkIndices[stateAtomId].trackers;
+
+    LogEvent startEvent1(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&startEvent1, tagId, bucketStartTimeNs + 1 * NS_PER_SEC, 1001, 1);
+    durationProducer.onMatchedLogEvent(1 /* start index*/, startEvent1);
+    LogEvent startEvent2(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&startEvent2, tagId, bucketStartTimeNs + 2 * NS_PER_SEC, 1002, 1);
+    durationProducer.onMatchedLogEvent(1 /* start index*/, startEvent2);
+    EXPECT_EQ(2UL, trackers.size());
+
+    // Only the tracker of uid 1001 is linked to the primary key of the state change.
+    HashableDimensionKey primaryKey;
+    primaryKey.addValue(FieldValue(Field(stateAtomId, getSimpleField(1)), Value(1001)));
+    FieldValue oldState(Field(stateAtomId, getSimpleField(2)), Value(StateTracker::kStateUnknown));
+    FieldValue newState(Field(stateAtomId, getSimpleField(2)), Value(2));
+    durationProducer.onStateChanges(bucketStartTimeNs + 5 * NS_PER_SEC, stateAtomId,
+                                    {{primaryKey, hashDimensionSortedByField(primaryKey), oldState,
+                                      newState}});
+
+    LogEvent stopEvent1(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&stopEvent1, tagId, bucketStartTimeNs + 10 * NS_PER_SEC, 1001, 1);
+    durationProducer.onMatchedLogEvent(2 /* stop index*/, stopEvent1);
+    LogEvent stopEvent2(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&stopEvent2, tagId, bucketStartTimeNs + 10 * NS_PER_SEC, 1002, 1);
+    durationProducer.onMatchedLogEvent(2 /* stop index*/, stopEvent2);
+
+    // The trackers are dropped from the index with the bucket.
+    durationProducer.flushIfNeededLocked(bucketStartTimeNs + bucketSizeNs + 1);
+    EXPECT_TRUE(durationProducer.mCurrentSlicedDurationTrackerMap.empty());
+    EXPECT_TRUE(trackers.empty());
+
+    unordered_map<int32_t, int> stateKeyCounts;
+    for (const auto& [metricKey, _] : durationProducer.mPastBuckets) {
+        stateKeyCounts[metricKey.getDimensionKeyInWhat().getValues()[0].mValue.int_value]++;
+    }
+    EXPECT_EQ(2, stateKeyCounts[1001]);
+    EXPECT_EQ(1, stateKeyCounts[1002]);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
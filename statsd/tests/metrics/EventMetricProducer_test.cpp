@@ -245,6 +245,58 @@ TEST_F(EventMetricProducerTest, TestOneAtomTagAggregatedEvents) {
     }
 }
 
+TEST_F(EventMetricProducerTest, TestCompactAtomEncoding) {
+    int64_t bucketStartTimeNs = 10000000000;
+    int tagId = 1;
+
+    EventMetric metric;
+    metric.set_id(1);
+    metric.set_compact_atom_encoding(true);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event1, tagId, bucketStartTimeNs + 10, "111");
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event2, tagId, bucketStartTimeNs + 20, "111");
+    LogEvent event3(/*uid=*/0, /*pid=*/0);
+    makeLogEvent(&event3, tagId, bucketStartTimeNs + 40, "222");
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    EventMetricProducer eventProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, bucketStartTimeNs);
+
+    eventProducer.onMatchedLogEvent(1 /*matcher index*/, event1);
+    eventProducer.onMatchedLogEvent(1 /*matcher index*/, event2);
+    eventProducer.onMatchedLogEvent(1 /*matcher index*/, event3);
+
+    // Check dump report content.
+    ProtoOutputStream output;
+    eventProducer.onDumpReport(bucketStartTimeNs + 50, true /*include current partial bucket*/,
+                               true /*erase data*/, FAST, nullptr, &output);
+
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(2, report.event_metrics().data_size());
+    const AtomEncodingDictionary& dictionary = report.atom_encoding_dictionary();
+    ASSERT_EQ(1, dictionary.layout_size());
+    EXPECT_EQ(tagId, dictionary.layout(0).atom_id());
+    EXPECT_THAT(dictionary.layout(0).type(), ElementsAre(STRING));
+    EXPECT_THAT(dictionary.string(), UnorderedElementsAre("111", "222"));
+
+    for (const EventMetricData& metricData : report.event_metrics().data()) {
+        const AggregatedAtomInfo& atomInfo = metricData.aggregated_atom_info();
+        EXPECT_FALSE(atomInfo.has_atom());
+        EXPECT_EQ(0, atomInfo.elapsed_timestamp_nanos_size());
+        ASSERT_EQ(1, atomInfo.encoded_atom().string_index_size());
+        const string& str = dictionary.string(atomInfo.encoded_atom().string_index(0));
+        if (str == "111") {
+            EXPECT_THAT(atomInfo.elapsed_timestamp_delta_nanos(),
+                        ElementsAre(bucketStartTimeNs + 10, 10));
+        } else {
+            EXPECT_THAT(atomInfo.elapsed_timestamp_delta_nanos(),
+                        ElementsAre(bucketStartTimeNs + 40));
+        }
+    }
+}
+
 TEST_F(EventMetricProducerTest, TestBytesFieldAggregatedEvents) {
     int64_t bucketStartTimeNs = 10000000000;
     int tagId = 1;
@@ -161,7 +161,7 @@ TEST(GaugeMetricProducerTest, TestPulledEventsNoCondition) {
     EXPECT_EQ(3, gaugeProducer.mPastBuckets.begin()
                          ->second.back()
                          .mAggregatedAtoms.begin()
-                         ->first.getAtomFieldValues()
+                         ->first->getAtomFieldValues()
                          .getValues()
                          .begin()
                          ->mValue.int_value);
@@ -182,7 +182,7 @@ TEST(GaugeMetricProducerTest, TestPulledEventsNoCondition) {
     auto it2 = gaugeProducer.mPastBuckets.begin()
                        ->second.back()
                        .mAggregatedAtoms.begin()
-                       ->first.getAtomFieldValues()
+                       ->first->getAtomFieldValues()
                        .getValues()
                        .begin();
     EXPECT_EQ(INT, it2->mValue.getType());
@@ -199,7 +199,7 @@ TEST(GaugeMetricProducerTest, TestPulledEventsNoCondition) {
     it2 = gaugeProducer.mPastBuckets.begin()
                   ->second.back()
                   .mAggregatedAtoms.begin()
-                  ->first.getAtomFieldValues()
+                  ->first->getAtomFieldValues()
                   .getValues()
                   .begin();
     EXPECT_EQ(INT, it2->mValue.getType());
@@ -475,7 +475,7 @@ TEST(GaugeMetricProducerTest, TestPulledEventsWithCondition) {
     EXPECT_EQ(100, gaugeProducer.mPastBuckets.begin()
                            ->second.back()
                            .mAggregatedAtoms.begin()
-                           ->first.getAtomFieldValues()
+                           ->first->getAtomFieldValues()
                            .getValues()
                            .begin()
                            ->mValue.int_value);
@@ -487,7 +487,7 @@ TEST(GaugeMetricProducerTest, TestPulledEventsWithCondition) {
     EXPECT_EQ(110L, gaugeProducer.mPastBuckets.begin()
                             ->second.back()
                             .mAggregatedAtoms.begin()
-                            ->first.getAtomFieldValues()
+                            ->first->getAtomFieldValues()
                             .getValues()
                             .begin()
                             ->mValue.int_value);
@@ -701,9 +701,9 @@ TEST(GaugeMetricProducerTest, TestPullOnTrigger) {
     ASSERT_EQ(2UL, gaugeProducer.mPastBuckets.begin()->second.back().mAggregatedAtoms.size());
     auto it = gaugeProducer.mPastBuckets.begin()->second.back().mAggregatedAtoms.begin();
     vector<int> atomValues;
-    atomValues.emplace_back(it->first.getAtomFieldValues().getValues().begin()->mValue.int_value);
+    atomValues.emplace_back(it->first->getAtomFieldValues().getValues().begin()->mValue.int_value);
     it++;
-    atomValues.emplace_back(it->first.getAtomFieldValues().getValues().begin()->mValue.int_value);
+    atomValues.emplace_back(it->first->getAtomFieldValues().getValues().begin()->mValue.int_value);
     EXPECT_THAT(atomValues, UnorderedElementsAre(4, 5));
 }
 
@@ -757,11 +757,11 @@ TEST(GaugeMetricProducerTest, TestPullNWithoutTrigger) {
     ASSERT_EQ(3UL, gaugeProducer.mPastBuckets.begin()->second.back().mAggregatedAtoms.size());
     auto it = gaugeProducer.mPastBuckets.begin()->second.back().mAggregatedAtoms.begin();
     vector<int> atomValues;
-    atomValues.emplace_back(it->first.getAtomFieldValues().getValues().begin()->mValue.int_value);
+    atomValues.emplace_back(it->first->getAtomFieldValues().getValues().begin()->mValue.int_value);
     it++;
-    atomValues.emplace_back(it->first.getAtomFieldValues().getValues().begin()->mValue.int_value);
+    atomValues.emplace_back(it->first->getAtomFieldValues().getValues().begin()->mValue.int_value);
     it++;
-    atomValues.emplace_back(it->first.getAtomFieldValues().getValues().begin()->mValue.int_value);
+    atomValues.emplace_back(it->first->getAtomFieldValues().getValues().begin()->mValue.int_value);
     EXPECT_THAT(atomValues, UnorderedElementsAre(4, 5, 6));
 }
 
@@ -834,7 +834,7 @@ TEST(GaugeMetricProducerTest, TestRemoveDimensionInOutput) {
     EXPECT_EQ(3, bucketIt->first.getDimensionKeyInWhat().getValues().begin()->mValue.int_value);
     EXPECT_EQ(4, bucketIt->second.back()
                          .mAggregatedAtoms.begin()
-                         ->first.getAtomFieldValues()
+                         ->first->getAtomFieldValues()
                          .getValues()
                          .begin()
                          ->mValue.int_value);
@@ -844,13 +844,123 @@ TEST(GaugeMetricProducerTest, TestRemoveDimensionInOutput) {
     auto atomIt = bucketIt->second.back().mAggregatedAtoms.begin();
     vector<int> atomValues;
     atomValues.emplace_back(
-            atomIt->first.getAtomFieldValues().getValues().begin()->mValue.int_value);
+            atomIt->first->getAtomFieldValues().getValues().begin()->mValue.int_value);
     atomIt++;
     atomValues.emplace_back(
-            atomIt->first.getAtomFieldValues().getValues().begin()->mValue.int_value);
+            atomIt->first->getAtomFieldValues().getValues().begin()->mValue.int_value);
     EXPECT_THAT(atomValues, UnorderedElementsAre(5, 6));
 }
 
+TEST(GaugeMetricProducerTest, TestPastAtomsSharedAcrossBuckets) {
+    GaugeMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.mutable_gauge_fields_filter()->set_include_all(true);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+
+    GaugeMetricProducer gaugeProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, logEventMatcherIndex, eventMatcherWizard,
+                                      -1 /* -1 means no pulling */, -1, tagId, bucketStartTimeNs,
+                                      bucketStartTimeNs, pullerManager);
+    gaugeProducer.prepareFirstBucket();
+
+    // The same atom in the first two buckets, and a different one in the third.
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&event1, tagId, bucketStartTimeNs + 10, 1, 10);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&event2, tagId, bucket2StartTimeNs + 10, 1, 10);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+    LogEvent event3(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&event3, tagId, bucket3StartTimeNs + 10, 2, 20);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event3);
+    gaugeProducer.flushIfNeededLocked(bucket4StartTimeNs);
+
+    ASSERT_EQ(1UL, gaugeProducer.mPastBuckets.size());
+    const vector<GaugeBucket>& buckets = gaugeProducer.mPastBuckets.begin()->second;
+    ASSERT_EQ(3UL, buckets.size());
+    ASSERT_EQ(1UL, buckets[0].mAggregatedAtoms.size());
+    ASSERT_EQ(1UL, buckets[1].mAggregatedAtoms.size());
+    ASSERT_EQ(1UL, buckets[2].mAggregatedAtoms.size());
+    EXPECT_EQ(buckets[0].mAggregatedAtoms.begin()->first,
+              buckets[1].mAggregatedAtoms.begin()->first);
+    EXPECT_NE(buckets[1].mAggregatedAtoms.begin()->first,
+              buckets[2].mAggregatedAtoms.begin()->first);
+    EXPECT_EQ(2UL, gaugeProducer.mPastAtoms.size());
+
+    // Two distinct atoms of two fields, and one timestamp per bucket.
+    EXPECT_EQ(4 * sizeof(FieldValue) + 3 * sizeof(int64_t), gaugeProducer.byteSizeLocked());
+
+    gaugeProducer.clearPastBucketsLocked(bucket4StartTimeNs);
+    EXPECT_EQ(0UL, gaugeProducer.mPastAtoms.size());
+    EXPECT_EQ(0UL, gaugeProducer.byteSizeLocked());
+}
+
+TEST(GaugeMetricProducerTest, TestPrepareDumpReportKeepsPastAtoms) {
+    GaugeMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    metric.mutable_gauge_fields_filter()->set_include_all(true);
+
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<EventMatcherWizard> eventMatcherWizard =
+            createEventMatcherWizard(tagId, logEventMatcherIndex);
+
+    GaugeMetricProducer gaugeProducer(kConfigKey, metric, -1 /*-1 meaning no condition*/, {},
+                                      wizard, protoHash, logEventMatcherIndex, eventMatcherWizard,
+                                      -1 /* -1 means no pulling */, -1, tagId, bucketStartTimeNs,
+                                      bucketStartTimeNs, pullerManager);
+    gaugeProducer.prepareFirstBucket();
+
+    // The same atom in both buckets.
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&event1, tagId, bucketStartTimeNs + 10, 1, 10);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event1);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    CreateTwoValueLogEvent(&event2, tagId, bucket2StartTimeNs + 10, 1, 10);
+    gaugeProducer.onMatchedLogEvent(1 /*log matcher index*/, event2);
+
+    // A report that keeps the data shares the atoms of mPastAtoms with the producer.
+    DumpReportWriter writeKeptReport = gaugeProducer.prepareDumpReport(
+            bucket3StartTimeNs, /*include_current_partial_bucket=*/false,
+            /*erase_data=*/false, FAST);
+    ASSERT_EQ(1UL, gaugeProducer.mPastBuckets.size());
+    ASSERT_EQ(2UL, gaugeProducer.mPastBuckets.begin()->second.size());
+    EXPECT_EQ(1UL, gaugeProducer.mPastAtoms.size());
+
+    DumpReportWriter writeErasedReport = gaugeProducer.prepareDumpReport(
+            bucket3StartTimeNs, /*include_current_partial_bucket=*/false,
+            /*erase_data=*/true, FAST);
+    EXPECT_TRUE(gaugeProducer.mPastBuckets.empty());
+    EXPECT_TRUE(gaugeProducer.mPastAtoms.empty());
+
+    // Both reports still have the atoms once the producer no longer holds them.
+    gaugeProducer.clearPastBucketsLocked(bucket3StartTimeNs);
+    for (DumpReportWriter* writeReport : {&writeKeptReport, &writeErasedReport}) {
+        ProtoOutputStream output;
+        std::set<string> strSet;
+        (*writeReport)(&strSet, &output);
+        StatsLogReport report = outputStreamToProto(&output);
+        ASSERT_EQ(1, report.gauge_metrics().data_size());
+        const GaugeMetricData& data = report.gauge_metrics().data(0);
+        ASSERT_EQ(2, data.bucket_info_size());
+        ASSERT_EQ(1, data.bucket_info(0).aggregated_atom_info_size());
+        EXPECT_TRUE(data.bucket_info(0).aggregated_atom_info(0).has_atom());
+        EXPECT_THAT(data.bucket_info(0).aggregated_atom_info(0).elapsed_timestamp_nanos(),
+                    ElementsAre(bucketStartTimeNs + 10));
+        ASSERT_EQ(1, data.bucket_info(1).aggregated_atom_info_size());
+        EXPECT_EQ(data.bucket_info(0).aggregated_atom_info(0).atom().SerializeAsString(),
+                  data.bucket_info(1).aggregated_atom_info(0).atom().SerializeAsString());
+        EXPECT_THAT(data.bucket_info(1).aggregated_atom_info(0).elapsed_timestamp_nanos(),
+                    ElementsAre(bucket2StartTimeNs + 10));
+    }
+}
+
 /*
  * Test that BUCKET_TOO_SMALL dump reason is logged when a flushed bucket size
  * is smaller than the "min_bucket_size_nanos" specified in the metric config.
@@ -459,6 +459,43 @@ TEST(KllMetricProducerTest, TestByteSize) {
     EXPECT_EQ(expectedSize, kllProducer->byteSize());
 }
 
+TEST(KllMetricProducerTest, TestPrepareDumpReportCopiesPastBuckets) {
+    const KllMetric& metric = KllMetricProducerTestHelper::createMetric();
+    sp<KllMetricProducer> kllProducer =
+            KllMetricProducerTestHelper::createKllProducerNoConditions(metric);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&event1, atomId, bucketStartTimeNs + 10, 10);
+    kllProducer->onMatchedLogEvent(1 /*log matcher index*/, event1);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&event2, atomId, bucketStartTimeNs + 20, 20);
+    kllProducer->onMatchedLogEvent(1 /*log matcher index*/, event2);
+
+    DumpReportWriter writeReport = kllProducer->prepareDumpReport(
+            bucket2StartTimeNs + 1, /*include_current_partial_bucket=*/false,
+            /*erase_data=*/false, FAST);
+    TRACE_CALL(assertPastBucketsSingleKey, kllProducer->mPastBuckets, {2}, {bucketSizeNs},
+               {bucketStartTimeNs}, {bucket2StartTimeNs});
+
+    // The report has its own copy of the sketch.
+    kllProducer->mPastBuckets.begin()->second[0].aggregates[0]->Add(30);
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    writeReport(&strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(1, report.kll_metrics().data_size());
+    ASSERT_EQ(1, report.kll_metrics().data(0).bucket_info_size());
+    const KllBucketInfo& bucketInfo = report.kll_metrics().data(0).bucket_info(0);
+    ASSERT_EQ(1, bucketInfo.sketches_size());
+    zetasketch::android::AggregatorStateProto sketch;
+    ASSERT_TRUE(sketch.ParseFromString(bucketInfo.sketches(0).kll_sketch()));
+    EXPECT_EQ(2, sketch.num_values());
+
+    TRACE_CALL(assertPastBucketsSingleKey, kllProducer->mPastBuckets, {3}, {bucketSizeNs},
+               {bucketStartTimeNs}, {bucket2StartTimeNs});
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
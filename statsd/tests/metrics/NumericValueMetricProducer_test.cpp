@@ -105,6 +105,13 @@ static void assertPastBucketValuesSingleKey(
 
 class NumericValueMetricProducerTestHelper {
 public:
+    // Returns the base of a value field of a dimension of a pulled metric that uses diff.
+    static const optional<Value>& getBase(const sp<NumericValueMetricProducer>& valueProducer,
+                                          const HashableDimensionKey& dimensionsInWhat,
+                                          size_t valueIndex = 0) {
+        return valueProducer->mPulledRowAggregator.getBase(dimensionsInWhat, valueIndex);
+    }
+
     static sp<NumericValueMetricProducer> createValueProducerNoConditions(
             sp<MockStatsPullerManager>& pullerManager, ValueMetric& metric,
             const int pullAtomId = tagId) {
@@ -361,7 +368,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsNoCondition) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     // dimInfos holds the base
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(11, curBase.value().long_value);
@@ -375,7 +383,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsNoCondition) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     // dimInfos holds the base
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(23, curBase.value().long_value);
@@ -390,7 +399,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsNoCondition) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     // dimInfos holds the base
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(36, curBase.value().long_value);
@@ -486,7 +496,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsWithFiltering) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     // dimInfos holds the base
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(11, curBase.value().long_value);
@@ -505,7 +516,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsWithFiltering) {
     valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket4StartTimeNs);
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     // the base was reset
     EXPECT_EQ(true, curBase.has_value());
@@ -537,7 +549,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsTakeAbsoluteValueOnReset) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     // dimInfos holds the base
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(11, curBase.value().long_value);
@@ -550,7 +563,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsTakeAbsoluteValueOnReset) {
     // empty since the bucket is flushed.
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(10, curBase.value().long_value);
     assertPastBucketValuesSingleKey(valueProducer->mPastBuckets, {10}, {bucketSizeNs}, {0},
@@ -561,7 +575,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsTakeAbsoluteValueOnReset) {
     valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket4StartTimeNs);
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(36, curBase.value().long_value);
     assertPastBucketValuesSingleKey(
@@ -590,7 +605,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsTakeZeroOnReset) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     // mDimInfos holds the base
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(11, curBase.value().long_value);
@@ -602,7 +618,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsTakeZeroOnReset) {
     valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket3StartTimeNs);
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(10, curBase.value().long_value);
     ASSERT_EQ(0UL, valueProducer->mPastBuckets.size());
@@ -612,7 +629,8 @@ TEST(NumericValueMetricProducerTest, TestPulledEventsTakeZeroOnReset) {
     valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket4StartTimeNs);
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(36, curBase.value().long_value);
     assertPastBucketValuesSingleKey(valueProducer->mPastBuckets, {26}, {bucketSizeNs}, {0},
@@ -661,7 +679,8 @@ TEST(NumericValueMetricProducerTest, TestEventsWithNonSlicedCondition) {
     NumericValueMetricProducer::Interval curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     // startUpdated:false sum:0 start:100
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(100, curBase.value().long_value);
@@ -677,7 +696,8 @@ TEST(NumericValueMetricProducerTest, TestEventsWithNonSlicedCondition) {
 
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(110, curBase.value().long_value);
 
@@ -689,7 +709,8 @@ TEST(NumericValueMetricProducerTest, TestEventsWithNonSlicedCondition) {
     ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
     curInterval = valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_TRUE(curInterval.hasValue());
     EXPECT_EQ(20, curInterval.aggregate.long_value);
     EXPECT_EQ(false, curBase.has_value());
@@ -942,6 +963,44 @@ TEST(NumericValueMetricProducerTest, TestPushedEventsWithoutCondition) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
 }
 
+TEST(NumericValueMetricProducerTest, TestPrepareDumpReportCopiesPastBuckets) {
+    ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+    sp<NumericValueMetricProducer> valueProducer =
+            NumericValueMetricProducerTestHelper::createValueProducerNoConditions(
+                    pullerManager, metric, /*pullAtomId=*/-1);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&event1, tagId, bucketStartTimeNs + 10, 10);
+    valueProducer->onMatchedLogEvent(1 /*log matcher index*/, event1);
+
+    DumpReportWriter writeReport = valueProducer->prepareDumpReport(
+            bucket2StartTimeNs + 10, /*include_current_partial_bucket=*/false,
+            /*erase_data=*/false, FAST);
+    ASSERT_EQ(1UL, valueProducer->mPastBuckets.size());
+    ASSERT_EQ(1UL, valueProducer->mPastBuckets.begin()->second.size());
+
+    // The report has its own copy of the past buckets.
+    valueProducer->mPastBuckets.begin()->second[0].aggregates[0] = Value((int64_t)20);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    CreateRepeatedValueLogEvent(&event2, tagId, bucket2StartTimeNs + 20, 30);
+    valueProducer->onMatchedLogEvent(1 /*log matcher index*/, event2);
+    valueProducer->flushIfNeededLocked(bucket3StartTimeNs + 10);
+
+    ProtoOutputStream output;
+    std::set<string> strSet;
+    writeReport(&strSet, &output);
+    StatsLogReport report = outputStreamToProto(&output);
+    ASSERT_EQ(1, report.value_metrics().data_size());
+    ASSERT_EQ(1, report.value_metrics().data(0).bucket_info_size());
+    EXPECT_EQ(10, report.value_metrics().data(0).bucket_info(0).values(0).value_long());
+
+    // The past buckets were kept.
+    ASSERT_EQ(2UL, valueProducer->mPastBuckets.begin()->second.size());
+    EXPECT_EQ(20, valueProducer->mPastBuckets.begin()->second[0].aggregates[0].long_value);
+    EXPECT_EQ(30, valueProducer->mPastBuckets.begin()->second[1].aggregates[0].long_value);
+}
+
 TEST(NumericValueMetricProducerTest, TestPushedEventsWithCondition) {
     ValueMetric metric = NumericValueMetricProducerTestHelper::createMetric();
 
@@ -1152,7 +1211,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryNoCondition) {
     // empty since bucket is finished
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
 
     // startUpdated:true sum:0 start:11
     EXPECT_EQ(true, curBase.has_value());
@@ -1166,7 +1226,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryNoCondition) {
     // empty since bucket is finished
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     // tartUpdated:false sum:12
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(23, curBase.value().long_value);
@@ -1182,7 +1243,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryNoCondition) {
     valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket6StartTimeNs);
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     // startUpdated:false sum:12
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(36, curBase.value().long_value);
@@ -1241,7 +1303,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryWithCondition) {
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     NumericValueMetricProducer::Interval curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(100, curBase.value().long_value);
     EXPECT_EQ(0, curInterval.sampleSize);
@@ -1251,7 +1314,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryWithCondition) {
     valueProducer->onConditionChanged(false, bucket2StartTimeNs + 1);
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     assertPastBucketValuesSingleKey(valueProducer->mPastBuckets, {20}, {bucketSizeNs - 8}, {1},
                                     {bucketStartTimeNs}, {bucket2StartTimeNs});
     EXPECT_EQ(false, curBase.has_value());
@@ -1266,7 +1330,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryWithCondition) {
                                     {bucketStartTimeNs}, {bucket2StartTimeNs});
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(false, curBase.has_value());
 }
 
@@ -1314,7 +1379,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryWithCondition2) {
     ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
     NumericValueMetricProducer::Interval curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     // startUpdated:false sum:0 start:100
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(100, curBase.value().long_value);
@@ -1327,7 +1393,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryWithCondition2) {
                                     {bucketStartTimeNs}, {bucket2StartTimeNs});
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(false, curBase.has_value());
 
     // condition changed to true again, before the pull alarm is delivered
@@ -1337,7 +1404,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryWithCondition2) {
     ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     curInterval = valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(130, curBase.value().long_value);
     EXPECT_EQ(0, curInterval.sampleSize);
@@ -1351,7 +1419,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundaryWithCondition2) {
     ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     curInterval = valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(140, curBase.value().long_value);
     EXPECT_TRUE(curInterval.hasValue());
@@ -1737,7 +1806,7 @@ TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBase) {
     auto iter = valueProducer->mCurrentSlicedBucket.begin();
     auto& interval1 = iter->second.intervals[0];
     auto iterBase = valueProducer->mDimInfos.begin();
-    auto& base1 = iterBase->second.dimExtras[0];
+    auto& base1 = NumericValueMetricProducerTestHelper::getBase(valueProducer, iterBase->first);
     EXPECT_EQ(1, iter->first.getDimensionKeyInWhat().getValues()[0].mValue.int_value);
     EXPECT_EQ(true, base1.has_value());
     EXPECT_EQ(3, base1.value().long_value);
@@ -1763,7 +1832,7 @@ TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBase) {
         }
     }
     EXPECT_TRUE(itBase != iterBase);
-    auto& base2 = itBase->second.dimExtras[0];
+    auto& base2 = NumericValueMetricProducerTestHelper::getBase(valueProducer, itBase->first);
     EXPECT_EQ(true, base2.has_value());
     EXPECT_EQ(4, base2.value().long_value);
 
@@ -1802,8 +1871,8 @@ TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBaseWithPullFailures) {
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     const auto& it = valueProducer->mCurrentSlicedBucket.begin();
     NumericValueMetricProducer::Interval& interval1 = it->second.intervals[0];
-    optional<Value>& base1 =
-            valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat())->second.dimExtras[0];
+    const optional<Value>& base1 = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, it->first.getDimensionKeyInWhat());
     EXPECT_EQ(1, it->first.getDimensionKeyInWhat().getValues()[0].mValue.int_value);
     EXPECT_EQ(true, base1.has_value());
     EXPECT_EQ(3, base1.value().long_value);
@@ -1824,11 +1893,12 @@ TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBaseWithPullFailures) {
 
     auto itBase2 = valueProducer->mDimInfos.begin();
     for (; itBase2 != valueProducer->mDimInfos.end(); itBase2++) {
-        if (itBase2->second.dimExtras[0] != base1) {
+        if (NumericValueMetricProducerTestHelper::getBase(valueProducer, itBase2->first) != base1) {
             break;
         }
     }
-    optional<Value>& base2 = itBase2->second.dimExtras[0];
+    const optional<Value>& base2 = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase2->first);
     EXPECT_TRUE(base2 != base1);
     EXPECT_EQ(2, itBase2->first.getValues()[0].mValue.int_value);
     EXPECT_EQ(true, base2.has_value());
@@ -1844,7 +1914,8 @@ TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBaseWithPullFailures) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     EXPECT_EQ(2, valueProducer->mDimInfos.begin()->first.getValues()[0].mValue.int_value);
-    optional<Value>& base3 = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    const optional<Value>& base3 = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, base3.has_value());
     EXPECT_EQ(5, base3.value().long_value);
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
@@ -1857,8 +1928,10 @@ TEST(NumericValueMetricProducerTest, TestUseZeroDefaultBaseWithPullFailures) {
 
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(2UL, valueProducer->mDimInfos.size());
-    optional<Value>& base4 = valueProducer->mDimInfos.begin()->second.dimExtras[0];
-    optional<Value>& base5 = std::next(valueProducer->mDimInfos.begin())->second.dimExtras[0];
+    const optional<Value>& base4 = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
+    const optional<Value>& base5 = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, std::next(valueProducer->mDimInfos.begin())->first);
 
     EXPECT_EQ(true, base4.has_value());
     EXPECT_EQ(5, base4.value().long_value);
@@ -1895,7 +1968,7 @@ TEST(NumericValueMetricProducerTest, TestTrimUnusedDimensionKey) {
     auto iter = valueProducer->mCurrentSlicedBucket.begin();
     auto& interval1 = iter->second.intervals[0];
     auto iterBase = valueProducer->mDimInfos.begin();
-    auto& base1 = iterBase->second.dimExtras[0];
+    auto& base1 = NumericValueMetricProducerTestHelper::getBase(valueProducer, iterBase->first);
     EXPECT_EQ(1, iter->first.getDimensionKeyInWhat().getValues()[0].mValue.int_value);
     EXPECT_EQ(true, base1.has_value());
     EXPECT_EQ(3, base1.value().long_value);
@@ -1923,7 +1996,7 @@ TEST(NumericValueMetricProducerTest, TestTrimUnusedDimensionKey) {
         }
     }
     EXPECT_TRUE(itBase != iterBase);
-    auto base2 = itBase->second.dimExtras[0];
+    auto base2 = NumericValueMetricProducerTestHelper::getBase(valueProducer, itBase->first);
     EXPECT_EQ(2, itBase->first.getValues()[0].mValue.int_value);
     EXPECT_EQ(true, base2.has_value());
     EXPECT_EQ(4, base2.value().long_value);
@@ -1936,7 +2009,8 @@ TEST(NumericValueMetricProducerTest, TestTrimUnusedDimensionKey) {
     // Only one dimension left. One was trimmed.
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    base2 = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    base2 = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(2, valueProducer->mDimInfos.begin()->first.getValues()[0].mValue.int_value);
     EXPECT_EQ(true, base2.has_value());
     EXPECT_EQ(5, base2.value().long_value);
@@ -2011,7 +2085,8 @@ TEST(NumericValueMetricProducerTest, TestResetBaseOnPullFailAfterConditionChange
     ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
     NumericValueMetricProducer::Interval& curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value>& curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    const optional<Value>& curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(100, curBase.value().long_value);
     EXPECT_EQ(0, curInterval.sampleSize);
@@ -2051,7 +2126,8 @@ TEST(NumericValueMetricProducerTest, TestResetBaseOnPullFailAfterConditionChange
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     NumericValueMetricProducer::Interval& curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value>& curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    const optional<Value>& curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(100, curBase.value().long_value);
     EXPECT_EQ(0, curInterval.sampleSize);
@@ -2100,7 +2176,8 @@ TEST(NumericValueMetricProducerTest, TestResetBaseOnPullFailBeforeConditionChang
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     NumericValueMetricProducer::Interval& curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(false, curBase.has_value());
     EXPECT_EQ(0, curInterval.sampleSize);
     EXPECT_EQ(false, valueProducer->mHasGlobalBase);
@@ -2171,7 +2248,8 @@ TEST(NumericValueMetricProducerTest, TestBaseSetOnConditionChange) {
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     NumericValueMetricProducer::Interval& curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(100, curBase.value().long_value);
     EXPECT_EQ(0, curInterval.sampleSize);
@@ -2223,7 +2301,8 @@ TEST(NumericValueMetricProducerTest_BucketDrop, TestInvalidBucketWhenOneConditio
     // Contains base from last pull which was successful.
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(140, curBase.value().long_value);
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
@@ -2359,7 +2438,8 @@ TEST(NumericValueMetricProducerTest_BucketDrop, TestInvalidBucketWhenInitialPull
     // Contains base from last pull which was successful.
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(140, curBase.value().long_value);
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
@@ -2436,7 +2516,8 @@ TEST(NumericValueMetricProducerTest_BucketDrop, TestInvalidBucketWhenLastPullFai
     // Last pull failed so base has been reset.
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(false, curBase.has_value());
     EXPECT_EQ(false, valueProducer->mHasGlobalBase);
 
@@ -2557,7 +2638,8 @@ TEST(NumericValueMetricProducerTest, TestEmptyDataResetsBase_onConditionChanged)
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     NumericValueMetricProducer::Interval& curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(0, curInterval.sampleSize);
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
@@ -2575,7 +2657,8 @@ TEST(NumericValueMetricProducerTest, TestEmptyDataResetsBase_onConditionChanged)
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     curInterval = valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
     EXPECT_EQ(0, curInterval.sampleSize);
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(10, curBase.value().long_value);
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
@@ -2585,7 +2668,8 @@ TEST(NumericValueMetricProducerTest, TestEmptyDataResetsBase_onConditionChanged)
     valueProducer->onDataPulled(allData, PullResult::PULL_RESULT_SUCCESS, bucket2StartTimeNs);
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
-    curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(120, curBase.value().long_value);
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
@@ -2632,7 +2716,8 @@ TEST(NumericValueMetricProducerTest, TestEmptyDataResetsBase_onBucketBoundary) {
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     NumericValueMetricProducer::Interval& curInterval =
             valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    optional<Value> curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    optional<Value> curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_TRUE(curInterval.hasValue());
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
@@ -2683,8 +2768,10 @@ TEST(NumericValueMetricProducerTest, TestPartialResetOnBucketBoundaries) {
     ASSERT_EQ(0UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     auto baseInfoIter = valueProducer->mDimInfos.begin();
-    EXPECT_EQ(true, baseInfoIter->second.dimExtras[0].has_value());
-    EXPECT_EQ(2, baseInfoIter->second.dimExtras[0].value().long_value);
+    EXPECT_EQ(true, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, baseInfoIter->first).has_value());
+    EXPECT_EQ(2, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, baseInfoIter->first).value().long_value);
 
     EXPECT_EQ(true, valueProducer->mHasGlobalBase);
 }
@@ -2796,7 +2883,8 @@ TEST(NumericValueMetricProducerTest, TestBucketBoundariesOnConditionChange) {
     ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     auto curInterval = valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    auto curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    auto curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_EQ(true, curBase.has_value());
     EXPECT_EQ(5, curBase.value().long_value);
     EXPECT_EQ(0, curInterval.sampleSize);
@@ -2936,7 +3024,8 @@ TEST(NumericValueMetricProducerTest, TestDataIsNotUpdatedWhenNoConditionChanged)
 
     ASSERT_EQ(1UL, valueProducer->mCurrentSlicedBucket.size());
     auto curInterval = valueProducer->mCurrentSlicedBucket.begin()->second.intervals[0];
-    auto curBase = valueProducer->mDimInfos.begin()->second.dimExtras[0];
+    auto curBase = NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, valueProducer->mDimInfos.begin()->first);
     EXPECT_TRUE(curInterval.hasValue());
     EXPECT_EQ(2, curInterval.aggregate.long_value);
 
@@ -4087,8 +4176,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedState) {
     // Base for dimension key {
     auto it = valueProducer->mCurrentSlicedBucket.begin();
     auto itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(3, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(3, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(-1 /* StateTracker::kStateUnknown */,
@@ -4110,8 +4201,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedState) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(5, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(5, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(android::view::DisplayStateEnum::DISPLAY_STATE_ON,
@@ -4143,8 +4236,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedState) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(9, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(9, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     EXPECT_EQ(android::view::DisplayStateEnum::DISPLAY_STATE_OFF,
               itBase->second.currentState.getValues()[0].mValue.int_value);
@@ -4185,8 +4280,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedState) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(21, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(21, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(android::view::DisplayStateEnum::DISPLAY_STATE_ON,
@@ -4233,8 +4330,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedState) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(30, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(30, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(android::view::DisplayStateEnum::DISPLAY_STATE_ON,
@@ -4361,8 +4460,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithMap) {
     // Base for dimension key {}
     auto it = valueProducer->mCurrentSlicedBucket.begin();
     auto itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(3, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(3, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(-1 /* StateTracker::kStateUnknown */,
@@ -4384,8 +4485,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithMap) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(5, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(5, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(screenOnGroup.group_id(),
@@ -4417,8 +4520,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithMap) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(5, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(5, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(screenOnGroup.group_id(),
@@ -4450,8 +4555,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithMap) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(5, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(5, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(screenOnGroup.group_id(),
@@ -4482,8 +4589,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithMap) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(21, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(21, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(screenOffGroup.group_id(),
@@ -4527,8 +4636,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithMap) {
     // Base for dimension key {}
     it = valueProducer->mCurrentSlicedBucket.begin();
     itBase = valueProducer->mDimInfos.find(it->first.getDimensionKeyInWhat());
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(30, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(30, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(screenOffGroup.group_id(),
@@ -5911,8 +6022,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithCondition) {
     std::unordered_map<HashableDimensionKey,
                        NumericValueMetricProducer::DimensionsInWhatInfo>::iterator itBase =
             valueProducer->mDimInfos.find(DEFAULT_DIMENSION_KEY);
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(3, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(3, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(BatterySaverModeStateChanged::ON,
@@ -5942,8 +6055,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithCondition) {
     // Base for dimension key {}
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     itBase = valueProducer->mDimInfos.find(DEFAULT_DIMENSION_KEY);
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(5, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(5, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(BatterySaverModeStateChanged::OFF,
@@ -5982,8 +6097,10 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithCondition) {
     // Base for dimension key {}
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     itBase = valueProducer->mDimInfos.find(DEFAULT_DIMENSION_KEY);
-    EXPECT_TRUE(itBase->second.dimExtras[0].has_value());
-    EXPECT_EQ(11, itBase->second.dimExtras[0].value().long_value);
+    EXPECT_TRUE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
+    EXPECT_EQ(11, NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).value().long_value);
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(BatterySaverModeStateChanged::OFF,
@@ -5997,7 +6114,8 @@ TEST(NumericValueMetricProducerTest, TestSlicedStateWithCondition) {
     // Base for dimension key {}
     ASSERT_EQ(1UL, valueProducer->mDimInfos.size());
     itBase = valueProducer->mDimInfos.find(DEFAULT_DIMENSION_KEY);
-    EXPECT_FALSE(itBase->second.dimExtras[0].has_value());
+    EXPECT_FALSE(NumericValueMetricProducerTestHelper::getBase(
+            valueProducer, itBase->first).has_value());
     EXPECT_TRUE(itBase->second.hasCurrentState);
     ASSERT_EQ(1, itBase->second.currentState.getValues().size());
     EXPECT_EQ(BatterySaverModeStateChanged::OFF,
@@ -484,10 +484,10 @@ TEST(OringDurationTrackerTest, TestAnomalyDetectionExpiredAlarm) {
     tracker.noteStart(kEventKey1, true, eventStartTimeNs, ConditionKey());
     tracker.noteStop(kEventKey1, eventStartTimeNs + 10, false);
     EXPECT_EQ(anomalyTracker->getRefractoryPeriodEndsSec(eventKey), 0U);
-    EXPECT_TRUE(tracker.mStarted.empty());
+    EXPECT_EQ(0u, tracker.mStartedKeyCount);
     EXPECT_EQ(10LL, tracker.mStateKeyDurationMap[DEFAULT_DIMENSION_KEY].mDuration);  // 10ns
 
-    ASSERT_EQ(0u, tracker.mStarted.size());
+    ASSERT_EQ(0u, tracker.mKeys.size());
 
     tracker.noteStart(kEventKey1, true, eventStartTimeNs + 20, ConditionKey());
     ASSERT_EQ(1u, anomalyTracker->mAlarms.size());
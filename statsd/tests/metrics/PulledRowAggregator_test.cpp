@@ -0,0 +1,280 @@
+// Copyright (C) 2023 The Android Open Source Project
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/metrics/PulledRowAggregator.h"
+
+#include <gtest/gtest.h>
+
+#include "tests/statsd_test_util.h"
+
+using namespace testing;
+using std::vector;
+
+#ifdef __ANDROID__
+
+namespace android {
+namespace os {
+namespace statsd {
+
+namespace {
+
+const int kAtomId = 10;
+const int64_t kPullTimeNs = 1000;
+const DiffOptions kDiffOptions = {ValueMetric::INCREASING, /*useAbsoluteValueOnReset=*/false,
+                                  /*useZeroDefaultBase=*/false};
+
+struct MergedRow {
+    int32_t dimension;
+    PulledRowAggregator::MergedValue value1;
+    PulledRowAggregator::MergedValue value2;
+};
+
+vector<Matcher> getDimensionsInWhat() {
+    vector<Matcher> dimensionsInWhat;
+    translateFieldMatcher(CreateDimensions(kAtomId, {1}), &dimensionsInWhat);
+    return dimensionsInWhat;
+}
+
+PulledRowAggregator createAggregator(const DiffOptions& options = kDiffOptions) {
+    vector<Matcher> dimensionsInWhat = getDimensionsInWhat();
+    vector<Matcher> valueFields;
+    translateFieldMatcher(CreateDimensions(kAtomId, {2, 3}), &valueFields);
+    return PulledRowAggregator(dimensionsInWhat, valueFields, options);
+}
+
+// Returns the merged rows. Their values become the bases if acceptValues is true.
+vector<MergedRow> getMergedRows(PulledRowAggregator& aggregator, bool acceptValues = true,
+                                bool hasGlobalBase = false) {
+    vector<MergedRow> rows;
+    aggregator.forEachMergedRow(hasGlobalBase, [&](const LogEvent& event) {
+        EXPECT_TRUE(aggregator.isMerging());
+        rows.push_back({event.getValues()[0].mValue.int_value, aggregator.getMergedValue(0),
+                        aggregator.getMergedValue(1)});
+        if (acceptValues) {
+            aggregator.acceptValue(0);
+            aggregator.acceptValue(1);
+        }
+    });
+    EXPECT_FALSE(aggregator.isMerging());
+    return rows;
+}
+
+// Adds the rows of a pull and returns the merged rows.
+vector<MergedRow> mergePull(PulledRowAggregator& aggregator,
+                            const vector<shared_ptr<LogEvent>>& pull, bool acceptValues = true,
+                            bool hasGlobalBase = false) {
+    aggregator.reset(pull.size());
+    for (const auto& row : pull) {
+        aggregator.addRow(*row);
+    }
+    return getMergedRows(aggregator, acceptValues, hasGlobalBase);
+}
+
+}  // anonymous namespace
+
+TEST(PulledRowAggregatorTest, TestMergeDuplicates) {
+    PulledRowAggregator aggregator = createAggregator();
+    vector<shared_ptr<LogEvent>> pull = {
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 2, 10, 100),
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 5, 50),
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 2, 3, 30),
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 2, 1, 10)};
+
+    aggregator.reset(pull.size());
+    for (const auto& row : pull) {
+        EXPECT_TRUE(aggregator.addRow(*row));
+    }
+    EXPECT_EQ(aggregator.getDimensionCount(), 2);
+    EXPECT_EQ(aggregator.mNext, vector<int>({2, -1, 3, -1}));
+
+    vector<MergedRow> rows = getMergedRows(aggregator);
+    ASSERT_EQ(rows.size(), 2);
+    EXPECT_EQ(rows[0].dimension, 2);
+    EXPECT_TRUE(rows[0].value1.hasValue);
+    EXPECT_EQ(rows[0].value1.value, Value((int64_t)14));
+    EXPECT_EQ(rows[0].value2.value, Value((int64_t)140));
+    EXPECT_EQ(rows[1].dimension, 1);
+    EXPECT_EQ(rows[1].value1.value, Value((int64_t)5));
+    EXPECT_EQ(rows[1].value2.value, Value((int64_t)50));
+
+    // The pulled rows are not modified.
+    EXPECT_EQ(pull[0]->getValues()[1].mValue.int_value, 10);
+    EXPECT_EQ(pull[0]->GetElapsedTimestampNs(), kPullTimeNs);
+}
+
+TEST(PulledRowAggregatorTest, TestReset) {
+    PulledRowAggregator aggregator = createAggregator();
+    ASSERT_EQ(mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 1, 1),
+                                     CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 2, 2)})
+                      .size(),
+              1);
+
+    vector<MergedRow> rows =
+            mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 3, 7, 8)});
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].dimension, 3);
+    EXPECT_EQ(rows[0].value1.value, Value((int64_t)7));
+    EXPECT_EQ(rows[0].value2.value, Value((int64_t)8));
+}
+
+TEST(PulledRowAggregatorTest, TestRowsDroppedAfterMerge) {
+    PulledRowAggregator aggregator = createAggregator();
+    ASSERT_EQ(mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 1, 1),
+                                     CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 2, 2),
+                                     CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 2, 3, 3)})
+                      .size(),
+              2);
+
+    // No references to the pulled rows are kept once they have been merged, but the buffers keep
+    // their capacity for the next pull.
+    EXPECT_EQ(aggregator.getDimensionCount(), 0);
+    EXPECT_TRUE(aggregator.mRows.empty());
+    EXPECT_GE(aggregator.mRows.capacity(), 3);
+    EXPECT_GE(aggregator.mNext.capacity(), 3);
+    EXPECT_GE(aggregator.mValueIndices.capacity(), 6);
+    for (const auto& [_, dimension] : aggregator.mDimensions) {
+        EXPECT_EQ(dimension.firstRow, -1);
+        EXPECT_EQ(dimension.lastRow, -1);
+    }
+    EXPECT_TRUE(getMergedRows(aggregator).empty());
+}
+
+TEST(PulledRowAggregatorTest, TestShrinkAfterSmallerPull) {
+    PulledRowAggregator aggregator = createAggregator();
+    vector<shared_ptr<LogEvent>> pull;
+    for (int i = 0; i < 100; i++) {
+        pull.push_back(CreateThreeValueLogEvent(kAtomId, kPullTimeNs, i, 1, 1));
+    }
+    mergePull(aggregator, pull);
+    EXPECT_GE(aggregator.mRows.capacity(), 100);
+
+    // A pull of a similar size reuses the buffers.
+    mergePull(aggregator, vector<shared_ptr<LogEvent>>(pull.begin(), pull.begin() + 50));
+    EXPECT_GE(aggregator.mRows.capacity(), 100);
+
+    // A much smaller pull releases them.
+    mergePull(aggregator, {pull[0]});
+    EXPECT_LT(aggregator.mRows.capacity(), 100);
+    EXPECT_LT(aggregator.mValueIndices.capacity(), 200);
+}
+
+TEST(PulledRowAggregatorTest, TestMissingValueField) {
+    PulledRowAggregator aggregator = createAggregator();
+    vector<shared_ptr<LogEvent>> pull = {
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 4, 40),
+            CreateTwoValueLogEvent(kAtomId, kPullTimeNs, 1, 6)};
+
+    aggregator.reset(pull.size());
+    EXPECT_TRUE(aggregator.addRow(*pull[0]));
+    EXPECT_FALSE(aggregator.addRow(*pull[1]));
+
+    // Only the value field present in both rows is summed.
+    vector<MergedRow> rows = getMergedRows(aggregator);
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].value1.value, Value((int64_t)10));
+    EXPECT_EQ(rows[0].value2.value, Value((int64_t)40));
+}
+
+TEST(PulledRowAggregatorTest, TestDiffAgainstBases) {
+    PulledRowAggregator aggregator = createAggregator();
+
+    // The first pull sets the bases.
+    vector<MergedRow> rows =
+            mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 5, 50),
+                                   CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 5, 50)});
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].value1.diffResult, DIFF_NO_BASE);
+    EXPECT_EQ(rows[0].value2.diffResult, DIFF_NO_BASE);
+
+    // The merged values of the next pull are diffed against them.
+    rows = mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 8, 30),
+                                  CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 7, 60)});
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].value1.diffResult, DIFF_OK);
+    EXPECT_EQ(rows[0].value1.diff, Value((int64_t)5));
+    EXPECT_EQ(rows[0].value2.diffResult, DIFF_RESET);
+
+    // The reset value became the base.
+    rows = mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 20, 100)});
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].value1.diff, Value((int64_t)5));
+    EXPECT_EQ(rows[0].value2.diffResult, DIFF_OK);
+    EXPECT_EQ(rows[0].value2.diff, Value((int64_t)10));
+}
+
+TEST(PulledRowAggregatorTest, TestBasesKeptIfNotAccepted) {
+    PulledRowAggregator aggregator = createAggregator();
+    mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 5, 50)});
+    mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 6, 60)},
+              /*acceptValues=*/false);
+
+    vector<MergedRow> rows =
+            mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 7, 70)});
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].value1.diff, Value((int64_t)2));
+    EXPECT_EQ(rows[0].value2.diff, Value((int64_t)20));
+}
+
+TEST(PulledRowAggregatorTest, TestZeroDefaultBase) {
+    PulledRowAggregator aggregator = createAggregator(
+            {ValueMetric::INCREASING, /*useAbsoluteValueOnReset=*/false,
+             /*useZeroDefaultBase=*/true});
+    vector<MergedRow> rows =
+            mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 5, 50)},
+                      /*acceptValues=*/false);
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].value1.diffResult, DIFF_NO_BASE);
+
+    rows = mergePull(aggregator, {CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 5, 50)},
+                     /*acceptValues=*/true, /*hasGlobalBase=*/true);
+    ASSERT_EQ(rows.size(), 1);
+    EXPECT_EQ(rows[0].value1.diffResult, DIFF_OK);
+    EXPECT_EQ(rows[0].value1.diff, Value((int64_t)5));
+}
+
+TEST(PulledRowAggregatorTest, TestDropBases) {
+    PulledRowAggregator aggregator = createAggregator();
+    const vector<shared_ptr<LogEvent>> pull = {
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 1, 1, 1),
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 2, 1, 1),
+            CreateThreeValueLogEvent(kAtomId, kPullTimeNs, 3, 1, 1)};
+    mergePull(aggregator, pull);
+
+    HashableDimensionKey dimensionsInWhat;
+    ASSERT_TRUE(filterValues(getDimensionsInWhat(), pull[0]->getValues(), &dimensionsInWhat));
+    aggregator.eraseDimension(dimensionsInWhat);
+    aggregator.retainDimensions([](const HashableDimensionKey& key) {
+        return key.getValues()[0].mValue.int_value != 2;
+    });
+
+    vector<MergedRow> rows = mergePull(aggregator, pull);
+    ASSERT_EQ(rows.size(), 3);
+    EXPECT_EQ(rows[0].value1.diffResult, DIFF_NO_BASE);
+    EXPECT_EQ(rows[1].value1.diffResult, DIFF_NO_BASE);
+    EXPECT_EQ(rows[2].value1.diffResult, DIFF_OK);
+
+    aggregator.resetBases();
+    rows = mergePull(aggregator, pull);
+    ASSERT_EQ(rows.size(), 3);
+    for (const MergedRow& row : rows) {
+        EXPECT_EQ(row.value1.diffResult, DIFF_NO_BASE);
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif
@@ -1356,6 +1356,39 @@ TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerMissingBuckets) {
                       INVALID_CONFIG_REASON_ALERT_INVALID_TRIGGER_OR_NUM_BUCKETS, alert.id()));
 }
 
+TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerInvalidDetector) {
+    int64_t metricId = 1;
+    Alert alert;
+    alert.set_id(123);
+    alert.set_metric_id(metricId);
+    alert.set_num_buckets(2);
+    alert.mutable_detector()->set_type(Alert::Detector::Z_SCORE);
+    alert.mutable_detector()->set_trigger_if_gt(3);
+
+    CountMetric metric;
+    metric.set_id(metricId);
+    metric.set_bucket(ONE_MINUTE);
+    sp<MockConditionWizard> wizard = new NaggyMock<MockConditionWizard>();
+    vector<sp<MetricProducer>> metricProducers({new CountMetricProducer(
+            kConfigKey, metric, 0, {ConditionState::kUnknown}, wizard, 0x0123456789, 0, 0)});
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    optional<InvalidConfigReason> invalidConfigReason;
+    // A z-score needs at least two past buckets.
+    EXPECT_EQ(createAnomalyTracker(alert, anomalyAlarmMonitor, UPDATE_NEW, /*updateTime=*/123,
+                                   {{1, 0}}, metricProducers, invalidConfigReason),
+              nullopt);
+    EXPECT_EQ(invalidConfigReason,
+              createInvalidConfigReasonWithAlert(INVALID_CONFIG_REASON_ALERT_INVALID_DETECTOR,
+                                                 alert.id()));
+
+    alert.set_num_buckets(3);
+    invalidConfigReason = nullopt;
+    EXPECT_NE(createAnomalyTracker(alert, anomalyAlarmMonitor, UPDATE_NEW, /*updateTime=*/123,
+                                   {{1, 0}}, metricProducers, invalidConfigReason),
+              nullopt);
+    EXPECT_EQ(invalidConfigReason, nullopt);
+}
+
 TEST_F(MetricsManagerUtilTest, TestCreateAnomalyTrackerGood) {
     int64_t metricId = 1;
     Alert alert;
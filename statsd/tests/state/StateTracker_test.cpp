@@ -331,6 +331,60 @@ TEST(StateTrackerTest, TestStateChangeReset) {
     }
 }
 
+/**
+ * Test that a reset event delivers all of its state changes to each listener in a
+ * single batch, after the state map has been fully updated.
+ */
+TEST(StateTrackerTest, TestStateChangeResetBatched) {
+    class BatchStateListener : public virtual StateListener {
+    public:
+        void onStateChanged(const int64_t eventTimeNs, const int32_t atomId,
+                            const HashableDimensionKey& primaryKey, const FieldValue& oldState,
+                            const FieldValue& newState) override {
+        }
+
+        void onStateChanges(const int64_t eventTimeNs, const int32_t atomId,
+                            const std::vector<StateChange>& changes) override {
+            batches.push_back(changes);
+        }
+
+        std::vector<std::vector<StateChange>> batches;
+    };
+
+    sp<BatchStateListener> listener = new BatchStateListener();
+    StateManager mgr;
+    mgr.registerListener(util::BLE_SCAN_STATE_CHANGED, listener);
+
+    std::vector<string> attributionTags = {"tag1"};
+    for (int uid : {1000, 2000, 3000}) {
+        mgr.onLogEvent(*CreateBleScanStateChangedEvent(timestampNs, {uid}, attributionTags,
+                                                       BleScanStateChanged::ON, false, false,
+                                                       false));
+    }
+    ASSERT_EQ(3, listener->batches.size());
+    listener->batches.clear();
+
+    mgr.onLogEvent(*CreateBleScanStateChangedEvent(timestampNs + 1000, {1000}, attributionTags,
+                                                   BleScanStateChanged::RESET, false, false,
+                                                   false));
+    ASSERT_EQ(1, listener->batches.size());
+    ASSERT_EQ(3, listener->batches[0].size());
+    for (const StateChange& change : listener->batches[0]) {
+        EXPECT_EQ(BleScanStateChanged::ON, change.oldState.mValue.int_value);
+        EXPECT_EQ(BleScanStateChanged::OFF, change.newState.mValue.int_value);
+        EXPECT_EQ(hashDimensionSortedByField(change.primaryKey), change.primaryKeyHash);
+        EXPECT_EQ(BleScanStateChanged::OFF,
+                  getStateInt(mgr, util::BLE_SCAN_STATE_CHANGED, change.primaryKey));
+    }
+
+    // No batch is delivered if nothing changed.
+    listener->batches.clear();
+    mgr.onLogEvent(*CreateBleScanStateChangedEvent(timestampNs + 2000, {1000}, attributionTags,
+                                                   BleScanStateChanged::RESET, false, false,
+                                                   false));
+    EXPECT_TRUE(listener->batches.empty());
+}
+
 /**
  * Test StateManager's onLogEvent and StateListener's onStateChanged correctly
  * updates listener for states without primary keys.
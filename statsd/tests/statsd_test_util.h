@@ -90,6 +90,12 @@ class BasicMockLogEventFilter : public LogEventFilter {
 public:
     MOCK_METHOD(void, setFilteringEnabled, (bool isEnabled), (override));
     MOCK_METHOD(void, setAtomIds, (AtomIdSet tagIds, ConsumerId consumer), (override));
+
+    // Tests set their expectations on the atoms of a consumer, whichever of them are header only.
+    void setAtomIds(AtomIdSet tagIds, AtomIdSet /*headerOnlyTagIds*/,
+                    ConsumerId consumer) override {
+        setAtomIds(std::move(tagIds), consumer);
+    }
 };
 
 class MockPendingIntentRef : public aidl::android::os::BnPendingIntentRef {
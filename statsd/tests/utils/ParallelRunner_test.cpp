@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2023 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "utils/ParallelRunner.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#ifdef __ANDROID__
+
+using namespace std;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+TEST(ParallelRunnerTest, TestRunsEveryTaskOnce) {
+    ParallelRunner runner(/*maxThreads=*/4);
+    vector<atomic<int>> counts(100);
+
+    runner.run(counts.size(), [&counts](size_t i) { counts[i]++; });
+
+    for (const atomic<int>& count : counts) {
+        EXPECT_EQ(count, 1);
+    }
+}
+
+TEST(ParallelRunnerTest, TestBoundedThreads) {
+    ParallelRunner runner(/*maxThreads=*/3);
+    mutex lock;
+    set<thread::id> threadIds;
+
+    runner.run(50, [&lock, &threadIds](size_t) {
+        lock_guard<mutex> lg(lock);
+        threadIds.insert(this_thread::get_id());
+    });
+
+    EXPECT_GE(threadIds.size(), 1);
+    EXPECT_LE(threadIds.size(), 3);
+}
+
+TEST(ParallelRunnerTest, TestReusesThreads) {
+    ParallelRunner runner(/*maxThreads=*/3);
+    mutex lock;
+    set<thread::id> threadIds;
+
+    for (int batch = 0; batch < 10; batch++) {
+        runner.run(20, [&lock, &threadIds](size_t) {
+            lock_guard<mutex> lg(lock);
+            threadIds.insert(this_thread::get_id());
+        });
+    }
+
+    // The same two workers and the calling thread run every batch.
+    EXPECT_LE(threadIds.size(), 3);
+}
+
+TEST(ParallelRunnerTest, TestNestedRun) {
+    ParallelRunner runner(/*maxThreads=*/3);
+    mutex lock;
+    set<thread::id> threadIds;
+    vector<atomic<int>> counts(8 * 8);
+
+    // Every thread of the pool blocks in a nested batch, which its own thread completes.
+    runner.run(8, [&](size_t i) {
+        runner.run(8, [&, i](size_t j) {
+            counts[i * 8 + j]++;
+            lock_guard<mutex> lg(lock);
+            threadIds.insert(this_thread::get_id());
+        });
+    });
+
+    for (const atomic<int>& count : counts) {
+        EXPECT_EQ(count, 1);
+    }
+    EXPECT_LE(threadIds.size(), 3);
+}
+
+TEST(ParallelRunnerTest, TestSingleTaskRunsOnCallingThread) {
+    ParallelRunner runner(/*maxThreads=*/4);
+    thread::id taskThreadId;
+
+    runner.run(1, [&taskThreadId](size_t) { taskThreadId = this_thread::get_id(); });
+
+    EXPECT_EQ(taskThreadId, this_thread::get_id());
+}
+
+TEST(ParallelRunnerTest, TestNoTasks) {
+    ParallelRunner runner(/*maxThreads=*/4);
+    int calls = 0;
+
+    runner.run(0, [&calls](size_t) { calls++; });
+
+    EXPECT_EQ(calls, 0);
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+#else
+GTEST_LOG_(INFO) << "This test does nothing.\n";
+#endif